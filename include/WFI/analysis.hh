@@ -0,0 +1,38 @@
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "ast.hh"
+#pragma once
+
+namespace analysis {
+    // What the parser has seen done to each name, in one program or in every
+    // program run in one global scope so far.
+    struct NameCounts {
+        // Assignments. While a name's count is zero every binding of it keeps
+        // the value it was created with, which closure capture, the inliner,
+        // types and the JIT rely on.
+        std::unordered_map<const intern::Symbol*, size_t> assigned;
+        // Assignments to any name, so a pass that relied on names never
+        // being assigned can tell when it has to re-check.
+        size_t total = 0;
+        // Bindings as a parameter, a loop variable or a let inside a function
+        // or loop, all of which bind in a scope other than the global one.
+        // While a name's count is zero, it resolves in the global scope or to
+        // a builtin wherever it is used, which lets the evaluator cache the
+        // lookup.
+        std::unordered_map<const intern::Symbol*, size_t> local;
+        size_t assignments(const intern::Symbol *name) const;
+        size_t localBindings(const intern::Symbol *name) const;
+        void noteAssignment(const intern::Symbol *name);
+        void noteLocalBinding(const intern::Symbol *name);
+        void add(const NameCounts &other);
+    };
+
+    // Returns the direct children of node, skipping any that failed to parse.
+    std::vector<Node*> children(Node *node);
+    // Calls visit on node and, whenever it returns true, recurses into the children.
+    void walk(Node *node, const std::function<bool(Node*)> &visit);
+    // Fills in fn->freeVariables and fn->locals. Nested literals are analysed too,
+    // and their free variables count as references from fn.
+    void analyseFunction(FunctionLiteral *fn);
+} // namespace analysis
@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+#include <typeinfo>
+#include "ast.hh"
+#include "object.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "iterator.hh"
+#pragma once
+
+// Ahead-of-time compilation of Fletchlang programs to C++ (wfi --emit-cpp).
+// The generated translation unit keeps the interpreter's object model and
+// environments, so closures, builtins and errors behave exactly as they do
+// in the interpreter, but every node becomes straight-line C++: there is no
+// AST dispatch, and literals, symbols and builtin bindings are resolved once
+// at startup. It links against the wfi_runtime library.
+namespace aot {
+    typedef object::Object* (*body_t)(object::Environment*);
+
+    // Returns a C++ translation unit with a main() that runs program.
+    std::string emitProgram(Program *program);
+
+    // Runtime support for generated code.
+
+    // Builds the FunctionLiteral a generated function body runs for. The body
+    // is kept only as printed source for Function::inspect; freeVariables and
+    // locals come from the emitter's own analysis of the original literal.
+    FunctionLiteral* literal(const std::vector<std::string> &parameters, const std::vector<std::string> &freeVariables, const std::vector<std::string> &locals, const std::string &body, body_t code, bool generator = false);
+    object::Object* builtin(const std::string &name);
+    object::Object* lookup(object::Environment *env, const intern::Symbol *name, object::Object *builtin);
+    object::Object* index(object::Object *left, object::Object *index);
+    // Runs program in a fresh global scope, with names counting what it
+    // assigns; errors are reported on stderr.
+    int run(body_t program, const analysis::NameCounts &names);
+
+    inline bool isError(object::Object *obj) {
+        return typeid(*obj) == typeid(object::Error);
+    }
+
+    inline object::Object* infix(Specialization intOp, const char *op, object::Object *left, object::Object *right) {
+        if (intOp != Specialization::GENERIC && typeid(*left) == typeid(object::Integer) && typeid(*right) == typeid(object::Integer)) {
+            object::Object *result = evaluator::evalSmallIntegerInfixExpression(intOp, static_cast<object::Integer*>(left), static_cast<object::Integer*>(right));
+            if (result != nullptr) {
+                return result;
+            }
+        }
+        return evaluator::evalInfixExpression(op, left, right);
+    }
+
+    // The value for the index-th iteration of a for loop over iterable, which
+    // checkIterable accepted, or nullptr once there are no more. Generators
+    // and iterators ignore index and are advanced instead.
+    inline object::Object* element(object::Object *iterable, size_t index) {
+        if (typeid(*iterable) == typeid(object::Array)) {
+            std::vector<object::Object*> &elements = static_cast<object::Array*>(iterable)->elements;
+            return index < elements.size() ? elements[index] : nullptr;
+        } else if (typeid(*iterable) == typeid(object::PackedArray)) {
+            object::PackedArray *array = static_cast<object::PackedArray*>(iterable);
+            return index < array->size() ? array->at(index) : nullptr;
+        }
+        return iterator::advance(iterable);
+    }
+
+    inline object::Object* negate(object::Object *right) {
+        if (typeid(*right) == typeid(object::Integer)) {
+            object::Integer *integer = static_cast<object::Integer*>(right);
+            if (integer->big == nullptr && integer->value != INT64_MIN) {
+                return object::Integer::make(-integer->value);
+            }
+        }
+        return evaluator::evalMinusPrefixOperatorExpression(right);
+    }
+} // namespace aot
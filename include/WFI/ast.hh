@@ -0,0 +1,496 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <cstdint>
+#include "token.hh"
+#include "intern.hh"
+#pragma once
+
+namespace object {
+    class Object;
+    class Integer;
+    class String;
+    class Function;
+    class Environment;
+    class Shape;
+}
+
+namespace compiler {
+    struct Code;
+}
+
+namespace analysis {
+    struct NameCounts;
+}
+
+namespace jit {
+    struct Code;
+}
+
+// Operand-type specializations the evaluator installs on InfixExpression,
+// PrefixExpression and IndexExpression nodes after observing their operands.
+// UNINITIALIZED nodes have not run yet; GENERIC nodes have seen operand types
+// no specialization covers, or failed a guard, and stay on the generic path.
+enum class Specialization {
+    UNINITIALIZED,
+    GENERIC,
+    INT_ADD,
+    INT_SUB,
+    INT_MUL,
+    INT_DIV,
+    INT_LT,
+    INT_GT,
+    INT_EQ,
+    INT_NOT_EQ,
+    BOOL_EQ,
+    BOOL_NOT_EQ,
+    STRING_CONCAT,
+    STRING_EQ,
+    STRING_NOT_EQ,
+    INT_NEGATE,
+    BOOL_NOT,
+    ARRAY_INDEX,
+    HASH_INDEX,
+};
+
+std::string specializationName(Specialization specialization);
+
+// Type feedback for one node: the installed specialization, how many executions
+// took its fast path, and how many fell back to the generic path.
+struct NodeProfile {
+    Specialization specialization = Specialization::UNINITIALIZED;
+    size_t hits = 0;
+    size_t misses = 0;
+    // Set by types::infer when the operand types are proven, so the
+    // specialization's type guards can be skipped.
+    bool proven = false;
+};
+
+// An inline cache for an identifier whose symbol has no local bindings:
+// the value it resolved to, in the global scope globals or among the
+// builtins, while globals was at version.
+struct GlobalCache {
+    const object::Environment *globals = nullptr;
+    uint64_t version = 0;
+    object::Object *value = nullptr;
+};
+
+// An inline cache for an index site: the slot key was found in when last
+// read from a hash of shape. A hash of the same shape, read with the same
+// key, has it in the same slot. Only string literals are cached as keys,
+// since they live as long as the program.
+struct ShapeCache {
+    const object::Shape *shape = nullptr;
+    const object::Object *key = nullptr;
+    size_t slot = 0;
+};
+
+// What parallel::evaluateArguments has learned about one call site.
+struct ArgumentProfile {
+    enum Decision { UNDECIDED, SEQUENTIAL, PARALLEL };
+    Decision decision = UNDECIDED;
+    // Timed sequential evaluations so far, and the nanoseconds each argument
+    // took over all of them.
+    size_t samples = 0;
+    std::vector<uint64_t> nanos;
+    // Names the arguments mention, whose values are checked for effects
+    // before every parallel evaluation.
+    std::vector<const intern::Symbol*> names;
+};
+
+// Result types types::infer can prove for an expression. NONE means nothing
+// is known yet and only appears while inference runs.
+enum class StaticType {
+    NONE,
+    UNKNOWN,
+    INTEGER,
+    BOOLEAN,
+    STRING,
+    ARRAY,
+    HASH,
+    FUNCTION,
+};
+
+std::string staticTypeName(StaticType type);
+
+class Node {
+public:
+    virtual ~Node() {};
+    virtual std::string token_literal() = 0;
+    virtual std::string string() = 0;
+    virtual std::string type() = 0;
+};
+
+class Statement : public Node {
+public:
+    virtual std::string statement_node() = 0;
+    std::string type() { return this->statement_node(); };
+};
+
+class Expression : public Node {
+public:
+    StaticType staticType = StaticType::UNKNOWN;
+    virtual std::string expression_node() = 0;
+    std::string type() { return this->expression_node(); };
+};
+
+class Program : public Node {
+public:
+    std::vector<Statement*> *statements;
+    // What the parser counted in this program, or nullptr for a program the
+    // parser did not make; see analysis::NameCounts.
+    analysis::NameCounts *names = nullptr;
+    // The global scope the counts were last added to, so running the program
+    // again there does not count them twice.
+    object::Environment *counted = nullptr;
+    Program() = default;
+    Program(std::vector<Statement*> *statements) : statements(statements) {};
+    std::string token_literal();
+    std::string string();
+    std::string type() { return "Program"; };
+};
+
+class Identifier : public Expression {
+public:
+    Token token;
+    std::string value;
+    const intern::Symbol *symbol;
+    GlobalCache cache;
+    Identifier(Token token, std::string value) : token(token), value(value), symbol(intern::symbol(value)) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class LetStatement : public Statement {
+public:
+    Token token;
+    Identifier *name;
+    Expression *value;
+    LetStatement() = default;
+    LetStatement(Token token, Identifier *name, Expression *value) : token(token), name(name), value(value) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class ReturnStatement : public Statement {
+public:
+    Token token;
+    Expression *returnValue;
+    ReturnStatement() = default;
+    ReturnStatement(Token token, Expression *returnValue) : token(token), returnValue(returnValue) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+// yield value; only inside a function body, which makes the function a
+// generator. Hands value to the caller of next and suspends the body there.
+class YieldStatement : public Statement {
+public:
+    Token token;
+    Expression *value;
+    YieldStatement(Token token) : token(token), value(nullptr) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class ExpressionStatement : public Statement {
+public:
+    Token token;
+    Expression *expression;
+    ExpressionStatement(Token token, Expression *expression) : token(token), expression(expression) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class BlockStatement : public Statement {
+public:
+    Token token;
+    std::vector<Statement*> *statements;
+    BlockStatement(Token token) : token(token), statements(new std::vector<Statement*>()) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+// Loops run their body in a single scope of their own, created once and
+// emptied at the start of every iteration, or replaced when a closure made
+// in it still reads it; see evaluator::resetLoopScope.
+class WhileStatement : public Statement {
+public:
+    Token token;
+    Expression *condition;
+    BlockStatement *body;
+    WhileStatement(Token token) : token(token), condition(nullptr), body(nullptr) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+// for (variable in iterable) over an array, or for (variable in iterable..end)
+// over the integers from iterable up to but not including end.
+class ForStatement : public Statement {
+public:
+    Token token;
+    Identifier *variable;
+    Expression *iterable;
+    // nullptr unless this is a range loop.
+    Expression *end;
+    BlockStatement *body;
+    ForStatement(Token token) : token(token), variable(nullptr), iterable(nullptr), end(nullptr), body(nullptr) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class BreakStatement : public Statement {
+public:
+    Token token;
+    BreakStatement(Token token) : token(token) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class ContinueStatement : public Statement {
+public:
+    Token token;
+    ContinueStatement(Token token) : token(token) {};
+    std::string token_literal();
+    std::string statement_node();
+    std::string string();
+};
+
+class IntegerLiteral : public Expression {
+public:
+    Token token;
+    int64_t value;
+    // Set when the literal does not fit in 64 bits; the digits are then read from the token.
+    bool big;
+    // The integer every evaluation of the literal returns, built with the
+    // node so big literals are not parsed again each time.
+    object::Integer *constant;
+    IntegerLiteral(Token token, int64_t value, bool big = false);
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class FloatLiteral : public Expression {
+public:
+    Token token;
+    double value;
+    FloatLiteral(Token token, double value) : token(token), value(value) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class StringLiteral : public Expression {
+public:
+    Token token;
+    std::string value;
+    const intern::Symbol *symbol;
+    // The string every evaluation of the literal returns, built with the node.
+    object::String *constant;
+    StringLiteral(Token token, std::string value);
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class PrefixExpression : public Expression {
+public:
+    Token token;
+    std::string op;
+    Expression *right;
+    NodeProfile profile;
+    PrefixExpression(Token token, std::string op) : token(token), op(op), right(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class InfixExpression : public Expression {
+public:
+    Token token;
+    std::string op;
+    Expression *left;
+    Expression *right;
+    NodeProfile profile;
+    InfixExpression(Token token, std::string op, Expression *left) : token(token), op(op), left(left), right(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+// target = value, where target is an Identifier (rebinding the nearest
+// binding of the name) or an IndexExpression (storing into an array or hash
+// in place). Evaluates to value.
+class AssignExpression : public Expression {
+public:
+    Token token;
+    Expression *target;
+    Expression *value;
+    AssignExpression(Token token, Expression *target) : token(token), target(target), value(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class Boolean : public Expression {
+public:
+    Token token;
+    bool value;
+    Boolean(Token token, bool value) : token(token), value(value) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class IfExpression : public Expression {
+public:
+    Token token;
+    Expression *condition;
+    BlockStatement *consequence;
+    BlockStatement *alternative;
+    IfExpression(Token token) : token(token), condition(nullptr), consequence(nullptr), alternative(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class FunctionLiteral : public Expression {
+public:
+    Token token;
+    std::vector<Identifier*> parameters;
+    BlockStatement *body;
+    // Filled in by analysis::analyseFunction the first time the literal is evaluated.
+    bool analysed;
+    std::vector<const intern::Symbol*> freeVariables;
+    std::set<const intern::Symbol*> locals;
+    // Shared closure for evaluations that capture nothing, per global scope.
+    object::Function *hoisted;
+    object::Environment *hoistedGlobals;
+    // Body compiled by the closure compiler, built on first use.
+    compiler::Code *compiled;
+    // Calls so far, and the native code jit::tryCall installs once the literal is hot.
+    size_t calls;
+    jit::Code *native;
+    bool nativeFailed;
+    // Set by the parser when the body yields outside any nested literal:
+    // calls return a generator::Generator instead of running the body.
+    bool generator;
+    FunctionLiteral(Token token) : token(token), body(nullptr), analysed(false), hoisted(nullptr), hoistedGlobals(nullptr), compiled(nullptr), calls(0), native(nullptr), nativeFailed(false), generator(false) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class CallExpression : public Expression {
+public:
+    Token token;
+    Expression *function;
+    std::vector<Expression*> arguments;
+    ArgumentProfile argumentProfile;
+    CallExpression(Token token, Expression *function) : token(token), function(function) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+// A call the inliner replaced with a copy of the callee's body. It prints as
+// the original call, so the source shown by Function::inspect is unchanged.
+// The inliner clears valid when a later assignment could change what the
+// call refers to, and the original call runs instead.
+class InlinedCall : public Expression {
+public:
+    Token token;
+    CallExpression *call;
+    Expression *body;
+    bool valid;
+    InlinedCall(CallExpression *call, Expression *body) : token(call->token), call(call), body(body), valid(true) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+struct MatchArm {
+    Expression *pattern;
+    // An Expression, or a BlockStatement for arms written with braces.
+    Node *body;
+};
+
+// Dispatch table for a match whose patterns are all integer and string
+// literals; see evaluator::matchTable. Both maps give the index of the first
+// arm with that pattern.
+struct MatchTable {
+    // Arm index for each integer from base on, or -1 where no arm matches.
+    // Used instead of integers when the integer patterns are dense enough.
+    int64_t base = 0;
+    std::vector<int> dense;
+    std::unordered_map<int64_t, size_t> integers;
+    // Keyed by String::hash_value; a hit is confirmed against the pattern.
+    std::unordered_map<uint64_t, size_t> strings;
+};
+
+// match (subject) { pattern => body, ..., _ => otherwise }. The first arm
+// whose pattern equals the subject runs; without one the match evaluates to
+// otherwise, or null if there is no _ arm.
+class MatchExpression : public Expression {
+public:
+    Token token;
+    Expression *subject;
+    std::vector<MatchArm> arms;
+    Node *otherwise;
+    // Built the first time the match runs. table stays nullptr, and the arms
+    // are compared in order, when some pattern is not a literal.
+    bool tableBuilt;
+    MatchTable *table;
+    MatchExpression(Token token) : token(token), subject(nullptr), otherwise(nullptr), tableBuilt(false), table(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class ArrayLiteral : public Expression {
+public:
+    Token token;
+    std::vector<Expression*> elements;
+    ArrayLiteral(Token token) : token(token) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class IndexExpression : public Expression {
+public:
+    Token token;
+    Expression *left;
+    Expression *index;
+    NodeProfile profile;
+    ShapeCache cache;
+    IndexExpression(Token token, Expression *left) : token(token), left(left), index(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
+
+class HashLiteral : public Expression {
+public:
+    Token token;
+    std::map<Expression*, Expression*> pairs;
+    // Set by the parser when every key is a string literal; the literal
+    // then builds hashes of this shape.
+    const object::Shape *shape;
+    HashLiteral(Token token) : token(token), shape(nullptr) {};
+    std::string token_literal();
+    std::string expression_node();
+    std::string string();
+};
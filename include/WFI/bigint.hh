@@ -0,0 +1,37 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#pragma once
+
+namespace bigint {
+    // Sign-magnitude arbitrary precision integer. The magnitude is stored as
+    // little-endian base 2^32 limbs with no leading zero limbs, so zero is an
+    // empty vector.
+    class BigInt {
+    public:
+        bool negative;
+        std::vector<uint32_t> limbs;
+        BigInt() : negative(false) {};
+        static BigInt fromInt64(int64_t value);
+        static BigInt fromString(const std::string &digits);
+        bool isZero() const;
+        bool fitsInt64() const;
+        int64_t toInt64() const;
+        std::string toString() const;
+        uint64_t hash() const;
+        int compare(const BigInt &other) const;
+        BigInt operator-() const;
+        BigInt operator+(const BigInt &other) const;
+        BigInt operator-(const BigInt &other) const;
+        BigInt operator*(const BigInt &other) const;
+        // Truncating division, matching C++ integer division. The divisor must not be zero.
+        BigInt operator/(const BigInt &other) const;
+        BigInt operator%(const BigInt &other) const;
+    };
+
+    // Operands at least this many limbs long are multiplied with Karatsuba.
+    static const size_t KARATSUBA_THRESHOLD = 32;
+
+    std::vector<uint32_t> multiplySchoolbook(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+    std::vector<uint32_t> multiplyKaratsuba(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+} // namespace bigint
@@ -0,0 +1,23 @@
+#include <vector>
+#include <functional>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+namespace compiler {
+    // A node compiled into a C++ closure. Everything that can be decided from
+    // the AST alone (operator, literal values, builtin bindings, children) is
+    // resolved once at compile time, so running it is just a chain of calls.
+    typedef std::function<object::Object*(object::Environment*)> closure_t;
+
+    struct Code {
+        closure_t run;
+    };
+
+    closure_t compile(Node *node);
+    // Drop-in alternative to evaluator::eval: compiles node, then runs it.
+    object::Object* eval(Node *node, object::Environment *env);
+    object::Object* applyFunction(object::Object *fn, std::vector<object::Object*> &args);
+    // Returns the compiled body of fn, compiling it on first use.
+    Code* compiledBody(FunctionLiteral *fn);
+} // namespace compiler
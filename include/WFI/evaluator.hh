@@ -0,0 +1,105 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include "ast.hh"
+#include "object.hh"
+#include "strsearch.hh"
+#include "parallel.hh"
+#include "isolate.hh"
+#include "iterator.hh"
+#include "packed.hh"
+#include "memo.hh"
+#pragma once
+
+namespace evaluator {
+    // Defined once in evaluator.cpp so every translation unit shares the same
+    // singletons; isTruthy and boolean equality compare them by address.
+    extern object::Boolean *TRUE;
+    extern object::Boolean *FALSE;
+    extern object::Null *NULLobj;
+    extern object::LoopControl *BREAK;
+    extern object::LoopControl *CONTINUE;
+
+    object::Object* eval(Node *node, object::Environment *env);
+    object::Object* evalProgram(Program *program, object::Environment *env);
+    std::vector<object::Object*> evalExpressions(std::vector<Expression*> expressions, object::Environment *env);
+    object::Object* evalBlockStatement(BlockStatement *block, object::Environment *env);
+    object::Object* nativeBoolToBooleanObject(bool input);
+    object::Object* evalPrefixExpression(std::string op, object::Object *right);
+    object::Object* evalBangOperatorExpression(object::Object *right);
+    object::Object* evalMinusPrefixOperatorExpression(object::Object *right);
+    object::Object* evalInfixExpression(std::string op, object::Object *left, object::Object *right);
+    object::Object* evalIntegerInfixExpression(std::string op, object::Integer *left, object::Integer *right);
+    object::Object* evalBigIntegerInfixExpression(std::string op, object::Integer *left, object::Integer *right);
+    // Both operands are numbers and one is a float; integers are converted.
+    object::Object* evalFloatInfixExpression(std::string op, object::Object *left, object::Object *right);
+    object::Object* evalBooleanInfixExpression(std::string op, object::Boolean *left, object::Boolean *right);
+    object::Object* evalStringInfixExpression(std::string op, object::String *left, object::String *right);
+    Specialization specializeInfixExpression(const std::string &op, object::Object *left, object::Object *right);
+    object::Object* evalSmallIntegerInfixExpression(Specialization specialization, object::Integer *left, object::Integer *right);
+    object::Object* evalSpecializedInfixExpression(InfixExpression *node, object::Object *left, object::Object *right);
+    object::Object* evalSpecializedPrefixExpression(PrefixExpression *node, object::Object *right);
+    object::Object* evalSpecializedIndexExpression(IndexExpression *node, object::Object *left, object::Object *index);
+    // Lists the specialization state of every profiled node under root that has run.
+    std::string dumpSpecializations(Node *root);
+    object::Object* evalIfExpression(IfExpression *ie, object::Environment *env);
+    object::Object* evalMatchExpression(MatchExpression *node, object::Environment *env);
+    // Returns node's dispatch table, building it on first use, or nullptr if
+    // some pattern is not an integer or string literal. Pool threads never
+    // build it; they get nullptr until a single-threaded run has.
+    MatchTable* matchTable(MatchExpression *node);
+    // With a dispatch table: the index of the first arm whose pattern equals
+    // subject, or -1.
+    int selectArm(MatchExpression *node, object::Object *subject);
+    // Whether subject matches an evaluated pattern: equal integers, floats or
+    // strings, or the same object otherwise.
+    bool matchEquals(object::Object *subject, object::Object *pattern);
+    object::Object* evalWhileStatement(WhileStatement *node, object::Environment *env);
+    object::Object* evalForStatement(ForStatement *node, object::Environment *env);
+    // Starts an iteration in a loop's scope: drops the lets of the previous
+    // iteration and binds variable, if any, to value. The scope's map is
+    // reused, so a body that lets nothing allocates nothing here, unless a
+    // closure made in the previous iteration reads through the scope: then
+    // scope is replaced by a fresh one, so each closure keeps its own.
+    void resetLoopScope(object::Environment *&scope, const intern::Symbol *variable, object::Object *value);
+    // Returns an Error for bounds that are not 64-bit integers, else nullptr
+    // with from and to set.
+    object::Object* evalRangeBounds(object::Object *start, object::Object *end, int64_t &from, int64_t &to);
+    // Returns an Error unless a for loop can iterate over iterable: an array,
+    // packed or not, or a generator or iterator, whose values the loop takes
+    // until it ends.
+    object::Object* checkIterable(object::Object *iterable);
+    object::Object* evalIndexExpression(object::Object *left, object::Object *index);
+    object::Object* evalArrayIndexExpression(object::Array *array, object::Integer *index);
+    object::Object* evalArrayIndexExpression(object::PackedArray *array, object::Integer *index);
+    object::Object* evalHashIndexExpression(object::Hash *hash, object::Object *index);
+    // The same, first trying the slot cache says index is in, and filling
+    // cache when a string literal is found in a shaped hash. The caller
+    // keeps other threads off cache.
+    object::Object* evalHashIndexExpression(ShapeCache &cache, object::Hash *hash, object::Object *index);
+    object::Object* evalAssignExpression(AssignExpression *node, object::Environment *env);
+    // Rebinds the nearest binding of name, or returns an Error if there is none.
+    object::Object* evalAssignment(const intern::Symbol *name, object::Object *value, object::Environment *env);
+    // Stores value at left[index] in place. Storing one past the end of an
+    // array appends to it.
+    object::Object* evalIndexAssignment(object::Object *left, object::Object *index, object::Object *value);
+    object::Object* evalIdentifier(Identifier *node, object::Environment *env);
+    // What node names in env, a binding or a builtin, or nullptr if it names
+    // nothing. Names with no local bindings are looked up in the global
+    // scope alone, through node's cache while no tasks run concurrently.
+    object::Object* lookup(Identifier *node, object::Environment *env);
+    object::Object* evalFunctionLiteral(FunctionLiteral *node, object::Environment *env);
+    object::Object* applyFunction(object::Object *fn, std::vector<object::Object*> args);
+    object::Environment* extendFunctionEnv(object::Function *fn, std::vector<object::Object*> args);
+    object::Object* unwrapReturnValue(object::Object *obj);
+    object::Object* evalHashLiteral(HashLiteral *node, object::Environment *env);
+    bool isTruthy(object::Object *obj);
+    bool isError(object::Object *obj);
+    bool isLoopControl(object::Object *obj);
+
+    // Defined once in evaluator.cpp, so every translation unit sees the same
+    // Builtin objects and can compare them by address.
+    extern std::map<std::string, object::Builtin*> builtins;
+} // namespace evaluator
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <ucontext.h>
+#include "object.hh"
+#pragma once
+
+// Generators: functions whose body yields. Calling one binds the arguments
+// and returns a Generator without running any of the body; each next then
+// runs the body from where it stopped up to its next yield. The body runs as
+// a stackful coroutine, on a stack of its own that swapcontext switches to
+// and from, so a suspended generator is only that stack and its saved
+// registers. It holds no thread, and any thread may resume it, one at a time.
+namespace generator {
+    // Stack each body runs on. Pages are only backed once touched, so this
+    // is address space, sized like a main thread's stack for deep recursion.
+    static const size_t STACK_SIZE = 8 * 1024 * 1024;
+    // Stacks are carved out of arenas of this many, one mapping each, so
+    // suspended generators do not use up the process's mappings. Only the
+    // lowest stack of an arena sits on a guard page.
+    static const size_t ARENA_STACKS = 32;
+    // Calls that start with less stack than this left fail with an Error
+    // instead of running into the stack below.
+    static const size_t STACK_MARGIN = 256 * 1024;
+
+    class Generator : public object::Object {
+    public:
+        // body runs the function body in its call scope and returns what the
+        // call would have.
+        Generator(std::function<object::Object*()> body);
+        // Hands the stack back. A body that was suspended never finishes,
+        // so what its frames hold is not destroyed.
+        ~Generator();
+        ObjectType type();
+        std::string inspect();
+        // Runs the body up to its next yield and returns the value yielded,
+        // or the Error that stopped the body. Returns nullptr once the body
+        // has ended; the value it ends with is dropped.
+        object::Object* resume();
+        bool done();
+    private:
+        std::function<object::Object*()> body;
+        ucontext_t context;
+        ucontext_t caller;
+        // Allocated on the first resume and handed back when the body ends,
+        // or when the generator is freed.
+        char *stack;
+        void *fiber;
+        void *callerFiber;
+        std::atomic<bool> running;
+        bool finished;
+        object::Object *value;
+        static void start();
+        friend object::Object* yield(object::Object *value);
+        friend bool overflowing();
+    };
+
+    // Suspends the generator whose body is running on this thread, handing
+    // value to the resume that ran it. Returns null when resumed.
+    object::Object* yield(object::Object *value);
+
+    // Whether this thread is running a generator body.
+    bool running();
+    // Whether the generator body running on this thread is within
+    // STACK_MARGIN of the end of its stack. The engines check it on every
+    // call, as stacks have no guard page between them.
+    bool overflowing();
+    // How many stacks have been mapped so far, handed out or free.
+    size_t mappedStacks();
+} // namespace generator
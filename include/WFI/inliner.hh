@@ -0,0 +1,28 @@
+#include <cstddef>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+namespace inliner {
+    // Largest callee body, in AST nodes, that is copied into call sites.
+    const size_t MAX_INLINE_NODES = 16;
+
+    // Set to false to leave every call alone (wfi --no-inline).
+    extern bool enabled;
+
+    // Replaces calls to small, non-recursive functions bound by a top-level let
+    // with InlinedCall nodes holding a copy of the callee's body, and returns
+    // the number of call sites rewritten. globals is the scope the program will
+    // run in; functions it already binds are inlined too.
+    //
+    // Arguments are substituted for the parameters rather than bound to renamed
+    // copies of them: let never rebinds a name, so a fresh binding in the
+    // caller would go stale the second time the same call site ran in it. To
+    // keep argument evaluation order and error messages exact, only calls whose
+    // arguments cannot fail (literals and names that are certainly bound and
+    // never assigned) are inlined, and only where none of the callee's own free
+    // names is shadowed. Callees bound to a name that is ever assigned are left
+    // alone, and sites inlined earlier are switched back to the call once a
+    // later program assigns their callee or an argument.
+    size_t inlineCalls(Program *program, object::Environment *globals);
+} // namespace inliner
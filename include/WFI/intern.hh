@@ -0,0 +1,18 @@
+#include <string>
+#include <atomic>
+#include <cstdint>
+#pragma once
+
+namespace intern {
+    // A canonical, immutable string. Two symbols are equal iff they are the
+    // same pointer, and the hash is computed once when the symbol is created.
+    class Symbol {
+    public:
+        const std::string value;
+        const uint64_t hash;
+        Symbol(std::string value, uint64_t hash) : value(value), hash(hash) {};
+    };
+
+    const Symbol* symbol(const std::string &str);
+    size_t size();
+} // namespace intern
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+// Interpreters that run side by side in one process. An isolate parses and
+// runs its own program on its own thread, with its own global scope. Its
+// heap is that thread's slab pool, and parser, inliner and type inference
+// state is per thread too. The singletons (TRUE, FALSE, NULLobj, small
+// integers), builtins and interned symbols are immutable or locked, so they
+// are shared. Isolates only exchange values through channels, and by the
+// bindings they start with and the result they end with.
+namespace isolate {
+    typedef object::Object* (*engine_t)(Node *node, object::Environment *env);
+
+    // The engine isolates started from scripts run on (wfi --engine=...).
+    extern engine_t engine;
+
+    // Returns obj as another isolate may hold it. Integers, strings, booleans,
+    // null, errors, builtins and channels never change once made, so they are
+    // shared. Arrays and hashes are copied deeply. Functions, futures,
+    // generators and iterators refer to the state of the isolate that made
+    // them, so they give an Error.
+    object::Object* share(object::Object *obj);
+
+    // A bounded multi-producer multi-consumer queue. Every cell carries a
+    // sequence number saying whether it is ready to be written or read in the
+    // current lap of the ring. Senders and receivers claim a position with a
+    // compare-and-swap, then hand the cell over by bumping its sequence, so
+    // neither side ever takes a lock.
+    class Channel : public object::Object {
+    public:
+        // Rounded up to a power of two.
+        Channel(size_t capacity);
+        ~Channel();
+        ObjectType type();
+        std::string inspect();
+        size_t capacity();
+        // Returns false instead of waiting when the channel is full.
+        bool trySend(object::Object *value);
+        // Returns false instead of waiting when the channel is empty.
+        bool tryReceive(object::Object *&value);
+        // Senders get an Error from now on; receivers drain what is left.
+        void close();
+        bool closed();
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            object::Object *value;
+        };
+        Cell *cells;
+        size_t mask;
+        // Kept on separate cache lines, so senders and receivers do not
+        // invalidate each other's line on every claim.
+        char padBefore[64];
+        std::atomic<size_t> sendAt;
+        char padBetween[64];
+        std::atomic<size_t> receiveAt;
+        char padAfter[64];
+        std::atomic<bool> done;
+    };
+
+    class Isolate : public object::Object {
+    public:
+        // Starts running source on a new thread. Each binding is shared into
+        // the new global scope before the program runs.
+        Isolate(const std::string &source, const std::map<std::string, object::Object*> &bindings, engine_t run);
+        ~Isolate();
+        ObjectType type();
+        std::string inspect();
+        // Waits for the program to end and returns the value of its last
+        // statement, shared, or the Error that stopped it. Later calls return
+        // the same object.
+        object::Object* join();
+        // Whether the program itself stopped on an Error, rather than ending
+        // with a value join cannot share. Only meaningful after join.
+        bool failed();
+    private:
+        std::thread thread;
+        std::mutex lock;
+        bool joined;
+        bool error;
+        object::Object *result;
+    };
+
+    // channel(capacity), send(channel, value), receive(channel), close(channel)
+    // and isolate(source, bindings). send waits while the channel is full and
+    // receive while it is empty; receive on a closed, drained channel returns
+    // null. Waiting threads yield rather than sleep.
+    object::Object* channel(std::vector<object::Object*> args);
+    object::Object* send(std::vector<object::Object*> args);
+    object::Object* receive(std::vector<object::Object*> args);
+    object::Object* close(std::vector<object::Object*> args);
+    object::Object* start(std::vector<object::Object*> args);
+} // namespace isolate
@@ -0,0 +1,83 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "object.hh"
+#include "generator.hh"
+#pragma once
+
+// Lazy iterators: range, map, filter, take and zip build them, and fold,
+// collect, next and for loops pull from them. Nothing is computed until an
+// element is pulled, and then only that element. Chains are fused as they
+// are built: map(filter(range(0, n), f), g) is one Iterator holding the
+// range and the stages [filter f, map g], and pulling runs each element
+// through every stage in a single loop, without iterators calling into
+// each other or arrays in between. A take stage whose count has run out
+// ends the chain before its source is touched again.
+namespace iterator {
+    class Iterator : public object::Object {
+    public:
+        enum Kind { RANGE, ARRAY, PACKED, GENERATOR, ZIP };
+        enum StageKind { MAP, FILTER, TAKE };
+        struct Stage {
+            StageKind kind;
+            object::Object *fn;
+            // The iterator that added the stage; take counts down its left.
+            Iterator *owner;
+        };
+
+        // A range from from up to, but not including, to.
+        Iterator(int64_t from, int64_t to, int64_t step);
+        // The elements of array, read by index as they are pulled, so
+        // elements pushed meanwhile are seen.
+        Iterator(object::Array *array);
+        Iterator(object::PackedArray *packed);
+        Iterator(generator::Generator *gen);
+        Iterator(std::vector<Iterator*> zipped);
+        // upstream with stage appended. The result pulls from upstream's
+        // source, so pulling from either advances both.
+        Iterator(Iterator *upstream, StageKind kind, object::Object *fn, int64_t left);
+        ObjectType type();
+        std::string inspect();
+        // The next element that makes it through every stage, the Error a
+        // stage or the source stopped with, or nullptr once there are none.
+        object::Object* pull();
+    private:
+        // The iterator holding the source state; itself unless fused.
+        Iterator *root;
+        std::vector<Stage> stages;
+        Kind kind;
+        int64_t at, to, step;
+        object::Array *array;
+        object::PackedArray *packed;
+        generator::Generator *gen;
+        std::vector<Iterator*> zipped;
+        // Elements a take stage added by this iterator still lets through.
+        int64_t left;
+        bool ended;
+        object::Object* produce();
+    };
+
+    // Iterator over the elements of an array, packed or not, a generator or
+    // an iterator (returned as is), or nullptr for anything else.
+    Iterator* of(object::Object *iterable);
+
+    // The next value of a generator or iterator, the Error that stopped it,
+    // or nullptr once there are no more.
+    object::Object* advance(object::Object *iterable);
+
+    // range(to), range(from, to) or range(from, to, step).
+    object::Object* range(std::vector<object::Object*> args);
+    // map(iterable, f) and filter(iterable, f) over anything `of` takes.
+    object::Object* map(std::vector<object::Object*> args);
+    object::Object* filter(std::vector<object::Object*> args);
+    // take(iterable, n): at most the first n elements.
+    object::Object* take(std::vector<object::Object*> args);
+    // zip(a, b, ...): arrays of one element from each, until one runs out.
+    object::Object* zip(std::vector<object::Object*> args);
+    // fold(iterable, initial, f) and collect(iterable) pull everything left.
+    object::Object* fold(std::vector<object::Object*> args);
+    object::Object* collect(std::vector<object::Object*> args);
+    // next(iterable): the next element of a generator or iterator, or null
+    // once it has ended.
+    object::Object* next(std::vector<object::Object*> args);
+} // namespace iterator
@@ -0,0 +1,53 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+namespace jit {
+    // Native code for one function literal. Calls between jitted functions go
+    // through `entry`, so a caller can be compiled before its callee is finished.
+    struct Code {
+        void *entry;
+        // Bytes mapped at entry, or 0 until the code is installed.
+        size_t mapped;
+        size_t parameters;
+        // The global scope the code's callee and constant lookups were resolved against.
+        object::Environment *globals;
+        // The global scope's count of assignments at compile time. Only names
+        // that were never assigned are baked in, so code compiled before a
+        // later program assigned one is dropped and compiled again.
+        size_t assignments;
+    };
+
+    // Native functions return their result in rax and a bailout flag in rdx.
+    struct Result {
+        int64_t value;
+        int64_t failed;
+    };
+
+    // Set to false to always interpret (wfi --no-jit).
+    extern bool enabled;
+    // Calls before a function is considered hot.
+    extern size_t threshold;
+    // Counted across threads: isolates compile and pool threads run native code.
+    extern std::atomic<size_t> compiled;
+    extern std::atomic<size_t> bailouts;
+    // Bytes of native code currently mapped. Stale code is unmapped when its
+    // function is recompiled.
+    extern std::atomic<size_t> mapped;
+
+    // Counts a call to fn and, once it is hot, runs it as native code. Pool
+    // threads only run code that is already installed, and generator bodies
+    // none. Returns nullptr whenever the interpreter must run the call
+    // instead: fn is not jittable, an argument is not a small integer, or the
+    // native code bailed out on overflow or division by zero. Jittable
+    // functions are pure integer code, so re-running a bailed-out call in the
+    // interpreter is safe.
+    object::Object* tryCall(object::Function *fn, std::vector<object::Object*> &args);
+    // Compiles fn and every function it calls; returns nullptr if any of them
+    // uses something the code generator does not support.
+    Code* compile(object::Function *fn);
+} // namespace jit
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "object.hh"
+#pragma once
+
+// Memoized functions: memo(f) returns a builtin that calls f once per
+// distinct arguments and answers repeats from a cache. Arguments are looked
+// up by their type and hash_key and then compared, so calls with an
+// argument that is not hashable (an array, a hash, a function) always go
+// through to f, and arguments whose hashes collide still miss. Errors
+// are not cached. The cache is a bounded LRU: once full, a new result
+// replaces the one used least recently.
+//
+// In automatic mode (wfi --memo), a global let binding a pure recursive
+// function binds it memoized, so recursive calls, which go through the
+// global name, hit the cache too: a naive fib(90) makes 91 calls. Such a
+// memo checks pure again whenever a later program has assigned a global,
+// and stops caching once fn is no longer pure.
+namespace memo {
+    // Whether global lets memoize pure recursive functions. Off by default.
+    extern bool automatic;
+    // Entries a cache holds unless memo is given another size.
+    extern size_t capacity;
+
+    class Memo : public object::Builtin {
+    public:
+        // The function memoized.
+        object::Object *callee;
+        // self is the global name an automatic memo was bound as, or null
+        // for memo(f).
+        Memo(object::Object *fn, size_t capacity, const intern::Symbol *self = nullptr);
+        std::string inspect();
+        // f(args), from the cache if it was called with the same arguments
+        // recently enough.
+        object::Object* call(std::vector<object::Object*> &args);
+        // Calls answered from the cache, calls that went through to f, and
+        // results held, read under the lock.
+        void counts(size_t &hits, size_t &misses, size_t &size);
+    private:
+        // The arguments of a call, kept to tell calls with colliding
+        // hashes apart.
+        struct Key {
+            std::vector<object::Object*> args;
+            size_t hash;
+        };
+        struct KeyHash {
+            size_t operator()(const Key &key) const;
+        };
+        struct KeyEqual {
+            bool operator()(const Key &a, const Key &b) const;
+        };
+        // Whether the cache may be used, checking pure again when the global
+        // scope's assignment total is not the one it was last checked at.
+        // Called under the lock.
+        bool current();
+        size_t limit;
+        size_t hits, misses;
+        const intern::Symbol *self;
+        size_t checked;
+        bool withdrawn;
+        // Most recently used first. The lock is not held while f runs, so
+        // recursive and concurrent calls can use the cache meanwhile.
+        std::list<std::pair<Key, object::Object*>> recent;
+        std::unordered_map<Key, std::list<std::pair<Key, object::Object*>>::iterator, KeyHash, KeyEqual> entries;
+        std::mutex lock;
+    };
+
+    // Whether fn may be memoized automatically as name: it calls itself
+    // through name, is parallel::isolated, and every free variable is
+    // name, a builtin, or a never-assigned number, string, boolean or
+    // function meeting the same conditions, so nothing it reads can change
+    // between calls.
+    bool pure(object::Function *fn, const intern::Symbol *name);
+    // value as a let binding name in env should bind it: memoized in
+    // automatic mode when env is a global scope and value a pure recursive
+    // function, unchanged otherwise.
+    object::Object* bind(const intern::Symbol *name, object::Object *value, object::Environment *env);
+
+    // memo(f) or memo(f, capacity).
+    object::Object* memoize(std::vector<object::Object*> args);
+    // memoStats(f): a hash of the hits, misses and size of memoized f.
+    object::Object* stats(std::vector<object::Object*> args);
+} // namespace memo
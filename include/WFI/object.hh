@@ -0,0 +1,319 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "ast.hh"
+#include "analysis.hh"
+#include "intern.hh"
+#include "bigint.hh"
+#include "pool.hh"
+#pragma once
+
+typedef std::string ObjectType;
+
+// Integers in [SMALL_INT_MIN, SMALL_INT_MAX] are preallocated and shared.
+#ifndef WFI_SMALL_INT_MIN
+#define WFI_SMALL_INT_MIN (-128)
+#endif
+#ifndef WFI_SMALL_INT_MAX
+#define WFI_SMALL_INT_MAX (1023)
+#endif
+
+namespace object {
+    static const ObjectType INTEGER_OBJ = "INTEGER";
+    static const ObjectType FLOAT_OBJ = "FLOAT";
+    static const ObjectType BOOLEAN_OBJ = "BOOLEAN";
+    static const ObjectType NULL_OBJ = "NULL";
+    static const ObjectType RETURN_VALUE_OBJ = "RETURN_VALUE";
+    static const ObjectType BREAK_OBJ = "BREAK";
+    static const ObjectType CONTINUE_OBJ = "CONTINUE";
+    static const ObjectType ERROR_OBJ = "ERROR";
+    static const ObjectType FUNCTION_OBJ = "FUNCTION";
+    static const ObjectType STRING_OBJ = "STRING";
+    static const ObjectType BUILTIN_OBJ = "BUILTIN";
+    static const ObjectType ARRAY_OBJ = "ARRAY";
+    static const ObjectType INT64_ARRAY_OBJ = "INT64_ARRAY";
+    static const ObjectType FLOAT64_ARRAY_OBJ = "FLOAT64_ARRAY";
+    static const ObjectType HASH_OBJ = "HASH";
+    static const ObjectType FUTURE_OBJ = "FUTURE";
+    static const ObjectType CHANNEL_OBJ = "CHANNEL";
+    static const ObjectType ISOLATE_OBJ = "ISOLATE";
+    static const ObjectType GENERATOR_OBJ = "GENERATOR";
+    static const ObjectType ITERATOR_OBJ = "ITERATOR";
+
+    class Object {
+    public:
+        virtual ~Object() {};
+        // Every runtime value is carved out of the slab pools in pool.hh.
+        static void* operator new(size_t size) { return pool::allocate(size); };
+        static void operator delete(void *ptr, size_t size) { pool::deallocate(ptr, size); };
+        virtual ObjectType type() = 0;
+        virtual std::string inspect() = 0;
+        uint64_t hash_key();
+        bool hashable();
+    };
+
+    class Integer : public Object {
+    public:
+        // Values outside the int64_t range keep their exact value in `big` and
+        // saturate `value` to INT64_MAX/INT64_MIN, so range checks on `value`
+        // still behave sensibly. Small values never allocate a BigInt.
+        int64_t value;
+        bigint::BigInt *big;
+        Integer(int64_t value) : value(value), big(nullptr) {};
+        ObjectType type();
+        std::string inspect();
+        bigint::BigInt toBig();
+        double toDouble();
+        // Returns a shared object for small values; use this instead of new.
+        static Integer* make(int64_t value);
+        static Integer* fromBig(const bigint::BigInt &value);
+        static size_t cacheHits();
+    };
+
+    class Float : public Object {
+    public:
+        double value;
+        Float(double value) : value(value) {};
+        ObjectType type();
+        // The shortest digits that read back as the same double, always with
+        // a point or an exponent so it never reads as an integer.
+        std::string inspect();
+    };
+
+    class Boolean : public Object {
+    public:
+        bool value;
+        Boolean(bool value) : value(value) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    // A String is flat, a rope node joining two other strings, or a slice
+    // sharing the buffer of a parent string. Rope nodes are flattened the first
+    // time their contents are read, so building a string from n fragments
+    // costs O(n) instead of O(n^2). Slices only copy their bytes when value()
+    // is asked for a std::string; data() reads them in place.
+    class String : public Object {
+    public:
+        // Set for strings that came from the source text; nullptr for strings built at runtime.
+        const intern::Symbol *symbol;
+        size_t length;
+        String(std::string value) : symbol(nullptr), length(value.size()), flat(value), left(nullptr), right(nullptr), parent(nullptr), offset(0), copied(false), hash(0), hashed(false) {};
+        String(const intern::Symbol *symbol) : symbol(symbol), length(symbol->value.size()), flat(symbol->value), left(nullptr), right(nullptr), parent(nullptr), offset(0), copied(false), hash(symbol->hash), hashed(true) {};
+        String(String *left, String *right) : symbol(nullptr), length(left->length + right->length), left(left), right(right), parent(nullptr), offset(0), copied(false), hash(0), hashed(false) {};
+        String(String *parent, size_t offset, size_t length) : symbol(nullptr), length(length), left(nullptr), right(nullptr), parent(parent), offset(offset), copied(false), hash(0), hashed(false) {};
+        String(const String &other) : symbol(other.symbol), length(other.length), flat(other.flat), left(other.left.load()), right(other.right), parent(other.parent), offset(other.offset), copied(other.copied.load()), hash(other.hash), hashed(other.hashed.load()) {};
+        ObjectType type();
+        std::string inspect();
+        const std::string& value();
+        const char* data();
+        uint64_t hash_value();
+        bool equals(String *other);
+        static String* concat(String *left, String *right);
+        static String* slice(String *str, size_t offset, size_t length);
+        // The one string shared by every literal of symbol. It takes a
+        // lock, so callers look it up once, as StringLiteral does when built.
+        static String* literal(const intern::Symbol *symbol);
+    private:
+        // Flattening, copying a slice and hashing each happen once, under a
+        // lock, and are published through left, copied and hashed, so pool
+        // threads can share strings.
+        std::string flat;
+        std::atomic<String*> left;
+        String *right;
+        String *parent;
+        size_t offset;
+        std::atomic<bool> copied;
+        uint64_t hash;
+        std::atomic<bool> hashed;
+        void flatten();
+    };
+
+    class Null : public Object {
+    public:
+        Null() = default;
+        ObjectType type();
+        std::string inspect();
+    };
+
+    class ReturnValue : public Object {
+    public:
+        Object *value;
+        ReturnValue(Object *value) : value(value) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    // The value of a break or continue statement. Like a ReturnValue it ends
+    // every enclosing block, up to the innermost loop.
+    class LoopControl : public Object {
+    public:
+        bool isBreak;
+        LoopControl(bool isBreak) : isBreak(isBreak) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    class Error : public Object {
+    public:
+        std::string message;
+        Error(std::string message) : message(message) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    class Environment {
+    public:
+        std::map<const intern::Symbol*, Object*> *store;
+        Environment *outer;
+        // The function whose call created this scope, or nullptr.
+        FunctionLiteral *function;
+        // True for the scope holding a closure's captured variables. It is
+        // filled once when the closure is created and never changes after.
+        bool captured;
+        // True once a closure reads variables through this scope, so it
+        // must not be emptied and reused for another loop iteration.
+        bool escaped;
+        // For a global scope that is a copy taken for a spawned task, the
+        // global scope it was copied from, whose native code still applies.
+        Environment *copiedFrom;
+        // Bumped by every set and assign, so a cached lookup of a binding
+        // here can tell it may be stale.
+        uint64_t version;
+        // For a global scope, the counts of every program run in it so far,
+        // or nullptr before the first. A copy taken for a spawned task shares
+        // its original's.
+        analysis::NameCounts *names;
+        Environment();
+        Environment* globals();
+        // The counts of the global scope this scope is in.
+        const analysis::NameCounts& counts();
+        // Adds program's counts to this global scope's. Every pass that runs
+        // a program in a scope calls this before relying on the counts.
+        void count(Program *program);
+        Object* get(std::string name);
+        Object* get(const intern::Symbol *name);
+        Object* set(std::string name, Object *value);
+        Object* set(const intern::Symbol *name, Object *value);
+        // Overwrites the nearest existing binding of name, returning nullptr
+        // if there is none.
+        Object* assign(const intern::Symbol *name, Object *value);
+        Environment* newEnclosedEnvironment();
+    };
+
+    class Function : public Object {
+    public:
+        std::vector<Identifier*> *parameters;
+        BlockStatement *body;
+        Environment *env;
+        FunctionLiteral *literal;
+        Function(std::vector<Identifier*> *parameters, BlockStatement *body, Environment *env, FunctionLiteral *literal = nullptr) : parameters(parameters), body(body), env(env), literal(literal) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    typedef std::function<Object*(std::vector<Object*>)> BuiltinFunction;
+
+    class Builtin : public Object {
+    public:
+        BuiltinFunction fn;
+        // Whether calling it does something besides returning a value: output,
+        // channel and isolate operations, or advancing a generator or
+        // iterator. Calls to it never run in parallel.
+        bool effects;
+        Builtin(BuiltinFunction fn, bool effects = false) : fn(fn), effects(effects) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    class Array : public Object {
+    public:
+        std::vector<Object*> elements;
+        Array(std::vector<Object*> elements) : elements(elements) {};
+        ObjectType type();
+        std::string inspect();
+    };
+
+    // An array of numbers stored unboxed and contiguously: int64 elements in
+    // ints, or float64 elements in floats, by kind. Indexing boxes the one
+    // element read. pack converts a boxed array of numbers, so the numeric
+    // builtins in packed.hh can run over plain memory.
+    class PackedArray : public Object {
+    public:
+        enum Kind { INT64, FLOAT64 };
+        Kind kind;
+        std::vector<int64_t> ints;
+        std::vector<double> floats;
+        PackedArray(std::vector<int64_t> ints) : kind(INT64), ints(ints) {};
+        PackedArray(std::vector<double> floats) : kind(FLOAT64), floats(floats) {};
+        ObjectType type();
+        std::string inspect();
+        size_t size();
+        Object* at(size_t index);
+        // Stores value at index, one past the end appending. Returns an Error
+        // for values the kind cannot hold; int64 arrays take no floats and no
+        // integers beyond 64 bits.
+        Object* store(size_t index, Object *value);
+        // The packed form of array: int64 when every element is an integer,
+        // float64 when one of them is a float. Returns nullptr if any element
+        // is not a number, or is an integer beyond 64 bits.
+        static PackedArray* pack(Array *array);
+    };
+
+    class HashPair {
+    public:
+        Object *key;
+        Object *value;
+        HashPair(Object *key, Object *value) : key(key), value(value) {};
+    };
+
+    // The layout of hashes built by a literal whose keys are all string
+    // literals: which slot of the hash's values holds each key. Shapes are
+    // interned, so every hash built from the same keys shares one and a
+    // cache can tell hashes of one layout apart by comparing pointers.
+    class Shape {
+    public:
+        // Ordered by hash_key, as a dictionary hash's pairs are, so slot i
+        // holds the value of keys[i] and inspect prints the same either way.
+        std::vector<String*> keys;
+        std::vector<uint64_t> hashes;
+        // The slot of the key with hash_key hash, or -1 if there is none.
+        int64_t slot(uint64_t hash) const;
+        // The shape with these keys; duplicates count once.
+        static const Shape* of(std::vector<const intern::Symbol*> keys);
+    };
+
+    class Hash : public Object {
+    public:
+        // A dictionary hash keeps its pairs by hash_key. A shaped hash keeps
+        // only values, by slot of shape, and leaves pairs empty until a key
+        // is added; then it moves them into pairs and forgets its shape.
+        std::map<uint64_t, HashPair*> pairs;
+        const Shape *shape;
+        std::vector<Object*> values;
+        Hash() : shape(nullptr) {};
+        Hash(std::map<Object*, Object*> pairs);
+        Hash(const Shape *shape, std::vector<Object*> values) : shape(shape), values(values) {};
+        ObjectType type();
+        std::string inspect();
+        // The value of a hashable key, or nullptr if it has none.
+        Object* get(Object *key);
+        void set(Object *key, Object *value);
+        // Every key and value, ordered by hash_key.
+        std::vector<std::pair<Object*, Object*>> entries();
+    };
+
+    // The result of a spawned call. value is written once, by the thread
+    // that ran the call, before done is set.
+    class Future : public Object {
+    public:
+        std::atomic<bool> done;
+        Object *value;
+        Future() : done(false), value(nullptr) {};
+        ObjectType type();
+        std::string inspect();
+    };
+} // namespace object
@@ -0,0 +1,58 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "object.hh"
+#pragma once
+
+// Numeric builtins over packed arrays: pack, sum, min, max, dot, add, mul,
+// scale and prefixSum. Boxed arrays of numbers are packed on the way in, and
+// an int64 array meeting a float64 one is widened to float64. Integer
+// results that overflow 64 bits are worked out again on boxed integers, so
+// they come out exact, as they would from a loop. Float sums and dot
+// products add in four lanes, so their last bits may differ from adding left
+// to right.
+namespace packed {
+    // Whether kernels may use AVX2 when the CPU has it (wfi --no-simd turns
+    // it off). Each kernel also has a portable loop, used otherwise.
+    extern bool vectorize;
+
+    // The kernels behind the builtins. The integer ones return false when a
+    // result overflows, leaving out and the output array unspecified. min
+    // and max need n > 0, and are NaN when any element is.
+    namespace kernel {
+        bool sum(const int64_t *xs, size_t n, int64_t &out);
+        double sum(const double *xs, size_t n);
+        int64_t min(const int64_t *xs, size_t n);
+        double min(const double *xs, size_t n);
+        int64_t max(const int64_t *xs, size_t n);
+        double max(const double *xs, size_t n);
+        // AVX2 has no 64-bit integer multiply, so the integer products stay
+        // scalar.
+        bool dot(const int64_t *a, const int64_t *b, size_t n, int64_t &out);
+        double dot(const double *a, const double *b, size_t n);
+        bool add(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+        void add(const double *a, const double *b, double *out, size_t n);
+        bool mul(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+        void mul(const double *a, const double *b, double *out, size_t n);
+        bool scale(const int64_t *xs, int64_t k, int64_t *out, size_t n);
+        void scale(const double *xs, double k, double *out, size_t n);
+        // Each element depends on the one before, so these stay scalar.
+        bool prefixSum(const int64_t *xs, int64_t *out, size_t n);
+        void prefixSum(const double *xs, double *out, size_t n);
+    } // namespace kernel
+
+    // pack(xs): xs as a packed array; packed arrays are returned as they are.
+    object::Object* pack(std::vector<object::Object*> args);
+    // sum(xs), min(xs) and max(xs). The sum of nothing is 0; min and max of
+    // nothing are null.
+    object::Object* sum(std::vector<object::Object*> args);
+    object::Object* min(std::vector<object::Object*> args);
+    object::Object* max(std::vector<object::Object*> args);
+    // dot(a, b), add(a, b) and mul(a, b) take arrays of the same length.
+    object::Object* dot(std::vector<object::Object*> args);
+    object::Object* add(std::vector<object::Object*> args);
+    object::Object* mul(std::vector<object::Object*> args);
+    // scale(xs, k): every element times the number k.
+    object::Object* scale(std::vector<object::Object*> args);
+    object::Object* prefixSum(std::vector<object::Object*> args);
+} // namespace packed
@@ -0,0 +1,68 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+// Data-parallel builtins: pmap(xs, f), pfilter(xs, f) and preduce(xs, initial, f).
+// Arrays are cut into chunks that run on the scheduler's pool. Results are
+// stored by position, so the output, and which error is reported, never
+// depend on timing. The first chunk runs alone on the calling thread first,
+// which fills the shared caches (profiles, match tables, JIT code) that
+// pool threads only read. Short arrays, builtins and callees that are not
+// isolated run sequentially.
+namespace parallel {
+    // Arrays shorter than this are processed on the calling thread.
+    extern size_t threshold;
+    // Whether call arguments may be evaluated in parallel (wfi
+    // --parallel-args). Off by default.
+    extern bool arguments;
+    // Mean nanoseconds at least two arguments of a call must each take for
+    // the call's arguments to be evaluated in parallel.
+    extern uint64_t argumentNanos;
+
+    // Whether calls to fn may run at the same time: its body, and the bodies
+    // of the functions its free variables name, assign nothing and never
+    // mention a builtin with effects (puts, channels, isolates), nor does any
+    // free variable hold one. Functions reached only through parameters or
+    // data are not checked, and bodies that exist only as generated C++ never
+    // qualify.
+    bool isolated(object::Function *fn);
+
+    // Evaluates the arguments of call into args, calling evaluate(i) for the
+    // i-th, and returns the first Error in argument order or nullptr. The
+    // first few evaluations at a call site run in order and are timed. If
+    // at least two arguments took argumentNanos on average, no argument
+    // assigns or names a builtin with effects, and the functions they name
+    // are isolated, later evaluations run the arguments on the pool, as long
+    // as what they name in env is still isolated. All of them are evaluated
+    // then, even after one fails, but the Error returned is still the
+    // leftmost.
+    object::Object* evaluateArguments(CallExpression *call, object::Environment *env, const std::function<object::Object*(size_t)> &evaluate, std::vector<object::Object*> &args);
+
+    // Calls fn on the engine that built it: closure-compiled functions keep
+    // running compiled code.
+    object::Object* call(object::Object *fn, std::vector<object::Object*> args);
+
+    object::Object* pmap(std::vector<object::Object*> args);
+    object::Object* pfilter(std::vector<object::Object*> args);
+    // f must be associative: chunks are folded separately, then their
+    // results are folded onto initial from left to right. Chunks have a
+    // fixed size, and the same chunks are folded when the call runs
+    // sequentially, so the result never depends on the number of threads.
+    object::Object* preduce(std::vector<object::Object*> args);
+
+    // spawn(f) calls f with no arguments on the pool and returns a future;
+    // await(future) returns the call's result, running queued tasks while it
+    // waits. The task gets a copy of f's scopes, and of the scopes of the
+    // functions they name, taken at the spawn, so later lets and assignments
+    // on the spawning thread are not seen. Arrays and hashes they hold are
+    // copied deeply too, so neither side sees the other's index stores.
+    // Callees that are not isolated, or spawns with no workers to run them,
+    // are called right away. await also takes an isolate, and waits for its
+    // program to end.
+    object::Object* spawn(std::vector<object::Object*> args);
+    object::Object* await(std::vector<object::Object*> args);
+} // namespace parallel
@@ -0,0 +1,90 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+#include "lexer.hh"
+#include "ast.hh"
+#include "analysis.hh"
+#pragma once
+
+typedef Expression* (prefixParseFn_t)();
+typedef Expression* (infixParseFn_t)(Expression*);
+
+typedef enum {
+    LOWEST = 1,
+    ASSIGNMENT, // x = y
+    EQUALS, // ==
+    LESSGREATER, // > or <
+    SUM, // +
+    PRODUCT, // *
+    PREFIX, // -X or !X
+    CALL, // myFunction(X)
+    INDEX // array[index]
+} precedence_t;
+
+class Parser {
+private:
+    /* data */
+    // Parser state is per thread, so isolates on different threads can each
+    // parse their own programs.
+    static thread_local Lexer* l;
+    static thread_local Token curToken;
+    static thread_local Token peekToken;
+    static thread_local std::vector<std::string> errors;
+    static thread_local std::map<token_t, prefixParseFn_t*> prefixParseFns;
+    static thread_local std::map<token_t, infixParseFn_t*> infixParseFns;
+    static const std::map<token_t, precedence_t> precedences;
+    // Loops enclosing the current token within the current function; break
+    // and continue are only allowed where it is non-zero.
+    static thread_local int loopDepth;
+    // The function literal whose body is being parsed, or nullptr at the top
+    // level; a yield marks it as a generator.
+    static thread_local FunctionLiteral* function;
+    // What the program being parsed assigns and binds locally.
+    static thread_local analysis::NameCounts names;
+public:
+    Parser(Lexer* l);
+    ~Parser();
+    static void nextToken();
+    static Program* parseProgram();
+    static Statement* parseStatement();
+    static LetStatement* parseLetStatement();
+    static ReturnStatement* parseReturnStatement();
+    static YieldStatement* parseYieldStatement();
+    static ExpressionStatement* parseExpressionStatement();
+    static WhileStatement* parseWhileStatement();
+    static ForStatement* parseForStatement();
+    static Statement* parseLoopControl();
+    static BlockStatement* parseLoopBody();
+    static Expression* parseExpression(precedence_t precedence);
+    static Expression* parseIdentifier();
+    static Expression* parseIntegerLiteral();
+    static Expression* parseFloatLiteral();
+    static Expression* parseStringLiteral();
+    static Expression* parsePrefixExpression();
+    static Expression* parseInfixExpression(Expression* left);
+    static Expression* parseAssignExpression(Expression* target);
+    static Expression* parseGroupedExpression();
+    static Expression* parseBoolean();
+    static Expression* parseIfExpression();
+    static Expression* parseMatchExpression();
+    static BlockStatement* parseBlockStatement();
+    static Expression* parseFunctionLiteral();
+    static std::vector<Identifier*> parseFunctionParameters();
+    static Expression* parseCallExpression(Expression* function);
+    static std::vector<Expression*> parseCallArguments();
+    static std::vector<Expression*> parseExpressionList(token_t end);
+    static Expression* parseArrayLiteral();
+    static Expression* parseIndexExpression(Expression* left);
+    static Expression* parseHashLiteral();
+    static bool curTokenIs(token_t t);
+    static bool peekTokenIs(token_t t);
+    static bool expectPeek(token_t t);
+    static void peekError(token_t t);
+    static precedence_t peekPrecedence();
+    static precedence_t curPrecedence();
+    static std::vector<std::string> getErrors();
+    static void registerPrefix(token_t t, prefixParseFn_t* fn);
+    static void registerInfix(token_t t, infixParseFn_t* fn);
+    static void noPrefixParseFnError(token_t t);
+};
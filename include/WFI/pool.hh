@@ -0,0 +1,24 @@
+#include <cstddef>
+#pragma once
+
+namespace pool {
+    // Allocations are rounded up to a multiple of SIZE_CLASS_STEP and served from
+    // per-class slabs. Anything larger than the biggest class goes to ::operator new.
+    static const size_t SIZE_CLASS_STEP = 16;
+    static const size_t SIZE_CLASSES = 16;
+    static const size_t SLAB_SIZE = 64 * 1024;
+
+    struct Stats {
+        size_t allocations[SIZE_CLASSES];
+        size_t reused;
+        size_t frees;
+        size_t slabs;
+        size_t large;
+    };
+
+    // Free lists and counters are thread-local, so allocation never takes a lock.
+    // A block freed on another thread simply joins that thread's free list.
+    void* allocate(size_t size);
+    void deallocate(void *ptr, size_t size);
+    Stats stats();
+} // namespace pool
@@ -0,0 +1,25 @@
+#include <string>
+#include <vector>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+namespace repl {
+    static const std::string PROMPT = ">> ";
+
+    // evaluator::eval or compiler::eval.
+    typedef object::Object* (*engine_t)(Node *node, object::Environment *env);
+
+    void Start(engine_t engine);
+    // Runs a whole script file; returns the process exit status.
+    int Run(const std::string &path, engine_t engine);
+    // Runs every script at once, each in its own isolate; fails if any does.
+    int RunIsolated(const std::vector<std::string> &paths, engine_t engine);
+    // Writes the C++ translation of a script to output, or stdout if it is empty.
+    int EmitCpp(const std::string &path, const std::string &output);
+    void printParserErrors(std::vector<std::string> errors);
+    // Inference errors are warnings: the program still runs.
+    void printTypeErrors(std::vector<std::string> errors);
+    void printAllocatorStats();
+    void printSpecializations(std::vector<Program*> programs);
+} // namespace repl
@@ -0,0 +1,45 @@
+#include <cstddef>
+#include <functional>
+#include <vector>
+#pragma once
+
+namespace scheduler {
+    // Worker threads the pool starts on first use, besides the threads that
+    // hand it work. Zero means one less than the hardware threads. Read once,
+    // when the pool starts (wfi --threads=N, N at most 4096).
+    extern size_t threads;
+
+    // Runs body(i) for every i in [0, count) on the work-stealing pool and
+    // returns once all of them have finished. The calling thread works too.
+    // Ranges are split in halves: a thread keeps the lower half and pushes the
+    // upper one on its own deque, which it pops newest first while idle
+    // threads steal oldest first, so thieves take the biggest pieces.
+    void forEach(size_t count, const std::function<void(size_t)> &body);
+
+    // Queues task on the pool, or runs it right away when there are no workers.
+    void spawn(std::function<void()> task);
+    // Returns once ready() does. Until then the calling thread runs queued
+    // tasks, so waiting on a task that is still queued runs it here.
+    void await(const std::function<bool()> &ready);
+
+    // Workers in the pool, starting it if needed. Zero when there is nothing
+    // to run in parallel with.
+    size_t workers();
+
+    // What the threads of one deque have done since the pool started.
+    struct Counters {
+        // Tasks taken from another thread's deque.
+        size_t steals;
+        // Times they found nothing to run: a worker going to sleep, or a
+        // thread in forEach or await yielding.
+        size_t idles;
+    };
+    // One entry per worker, then one shared by the threads outside the pool.
+    std::vector<Counters> counters();
+
+    // Whether this thread is running pool work, or spawned tasks have not all
+    // finished. While it is, caches the engines fill lazily on shared AST
+    // nodes are only read: profiles, match tables, hoisted closures and JIT
+    // counters stay as they are.
+    bool concurrent();
+} // namespace scheduler
@@ -0,0 +1,13 @@
+#include <cstddef>
+#pragma once
+
+namespace strsearch {
+    static const size_t npos = static_cast<size_t>(-1);
+
+    // Returns the offset of the first occurrence of needle in haystack, or npos.
+    // Picks an AVX2 or SSE2 kernel at runtime when the CPU supports it and falls
+    // back to a memchr/memcmp scan otherwise.
+    size_t find(const char *haystack, size_t n, const char *needle, size_t m);
+    size_t findScalar(const char *haystack, size_t n, const char *needle, size_t m);
+    bool startsWith(const char *haystack, size_t n, const char *prefix, size_t m);
+} // namespace strsearch
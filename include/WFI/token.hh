@@ -24,6 +24,7 @@ namespace token {
     // Identifiers + literals
     static const token_t IDENT = "IDENT"; // add, foobar, x, y, ...
     static const token_t INT = "INT"; // 1343456
+    static const token_t FLOAT = "FLOAT"; // 3.25
     static const token_t STRING = "STRING";
     // Operators
     static const token_t ASSIGN = "=";
@@ -46,6 +47,8 @@ namespace token {
     static const token_t RBRACE = "}";
     static const token_t LBRACKET = "[";
     static const token_t RBRACKET = "]";
+    static const token_t DOTDOT = "..";
+    static const token_t ARROW = "=>";
     // Keywords
     static const token_t FUNCTION = "FUNCTION";
     static const token_t LET = "LET";
@@ -54,6 +57,13 @@ namespace token {
     static const token_t IF = "IF";
     static const token_t ELSE = "ELSE";
     static const token_t RETURN = "RETURN";
+    static const token_t WHILE = "WHILE";
+    static const token_t FOR = "FOR";
+    static const token_t IN = "IN";
+    static const token_t BREAK = "BREAK";
+    static const token_t CONTINUE = "CONTINUE";
+    static const token_t MATCH = "MATCH";
+    static const token_t YIELD = "YIELD";
 
     static const std::map<std::string, token_t> keywords = {
         {"fn", FUNCTION},
@@ -63,5 +73,12 @@ namespace token {
         {"if", IF},
         {"else", ELSE},
         {"return", RETURN},
+        {"while", WHILE},
+        {"for", FOR},
+        {"in", IN},
+        {"break", BREAK},
+        {"continue", CONTINUE},
+        {"match", MATCH},
+        {"yield", YIELD},
     };
 } // namespace Token
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include <string>
+#include <vector>
+#include "ast.hh"
+#include "object.hh"
+#pragma once
+
+namespace types {
+    struct Report {
+        // Infix, prefix and index operations plus if and while conditions,
+        // and how many of them had every operand type proven.
+        size_t operations = 0;
+        size_t monomorphic = 0;
+        // Operations that fail whenever they run, in the evaluator's wording.
+        std::vector<std::string> errors;
+        std::string summary();
+    };
+
+    // Set to false to skip inference (wfi --no-types).
+    extern bool enabled;
+
+    // Flow-insensitive type inference over program. Every expression gets a
+    // staticType; operations whose operand types are proven get their
+    // specialization installed with NodeProfile::proven set, so the engines
+    // skip the type guards. A name's type is the join of every binding it may
+    // resolve to: lets in its own scope, then enclosing scopes, because a
+    // reference can run before the let that shadows an outer binding.
+    // Parameters and call results are unknown, except for builtins. Names
+    // globals already binds have the exact type of their value, joined with
+    // the type of everything assigned to the name. Proofs from earlier
+    // programs are withdrawn once a later one assigns any name, or shadows a
+    // builtin whose result type they relied on.
+    Report infer(Program *program, object::Environment *globals);
+} // namespace types
@@ -0,0 +1,154 @@
+#include <set>
+#include "analysis.hh"
+
+std::vector<Node*> analysis::children(Node *node) {
+    std::vector<Node*> out;
+    std::string type = node->type();
+    if (type == "Program") {
+        out.insert(out.end(), dynamic_cast<Program*>(node)->statements->begin(), dynamic_cast<Program*>(node)->statements->end());
+    } else if (type == "BlockStatement") {
+        out.insert(out.end(), dynamic_cast<BlockStatement*>(node)->statements->begin(), dynamic_cast<BlockStatement*>(node)->statements->end());
+    } else if (type == "ExpressionStatement") {
+        out.push_back(dynamic_cast<ExpressionStatement*>(node)->expression);
+    } else if (type == "LetStatement") {
+        out.push_back(dynamic_cast<LetStatement*>(node)->value);
+    } else if (type == "ReturnStatement") {
+        out.push_back(dynamic_cast<ReturnStatement*>(node)->returnValue);
+    } else if (type == "YieldStatement") {
+        out.push_back(dynamic_cast<YieldStatement*>(node)->value);
+    } else if (type == "PrefixExpression") {
+        out.push_back(dynamic_cast<PrefixExpression*>(node)->right);
+    } else if (type == "InfixExpression") {
+        out.push_back(dynamic_cast<InfixExpression*>(node)->left);
+        out.push_back(dynamic_cast<InfixExpression*>(node)->right);
+    } else if (type == "AssignExpression") {
+        out.push_back(dynamic_cast<AssignExpression*>(node)->target);
+        out.push_back(dynamic_cast<AssignExpression*>(node)->value);
+    } else if (type == "IfExpression") {
+        IfExpression *ie = dynamic_cast<IfExpression*>(node);
+        out.push_back(ie->condition);
+        out.push_back(ie->consequence);
+        out.push_back(ie->alternative);
+    } else if (type == "MatchExpression") {
+        MatchExpression *match = dynamic_cast<MatchExpression*>(node);
+        out.push_back(match->subject);
+        for (auto &arm : match->arms) {
+            out.push_back(arm.pattern);
+            out.push_back(arm.body);
+        }
+        out.push_back(match->otherwise);
+    } else if (type == "WhileStatement") {
+        out.push_back(dynamic_cast<WhileStatement*>(node)->condition);
+        out.push_back(dynamic_cast<WhileStatement*>(node)->body);
+    } else if (type == "ForStatement") {
+        ForStatement *loop = dynamic_cast<ForStatement*>(node);
+        out.push_back(loop->iterable);
+        out.push_back(loop->end);
+        out.push_back(loop->body);
+    } else if (type == "FunctionLiteral") {
+        out.push_back(dynamic_cast<FunctionLiteral*>(node)->body);
+    } else if (type == "CallExpression") {
+        CallExpression *call = dynamic_cast<CallExpression*>(node);
+        out.push_back(call->function);
+        out.insert(out.end(), call->arguments.begin(), call->arguments.end());
+    } else if (type == "InlinedCall") {
+        out.push_back(dynamic_cast<InlinedCall*>(node)->body);
+    } else if (type == "ArrayLiteral") {
+        ArrayLiteral *array = dynamic_cast<ArrayLiteral*>(node);
+        out.insert(out.end(), array->elements.begin(), array->elements.end());
+    } else if (type == "IndexExpression") {
+        out.push_back(dynamic_cast<IndexExpression*>(node)->left);
+        out.push_back(dynamic_cast<IndexExpression*>(node)->index);
+    } else if (type == "HashLiteral") {
+        for (auto pair : dynamic_cast<HashLiteral*>(node)->pairs) {
+            out.push_back(pair.first);
+            out.push_back(pair.second);
+        }
+    }
+    std::vector<Node*> present;
+    for (auto child : out) {
+        if (child != nullptr) {
+            present.push_back(child);
+        }
+    }
+    return present;
+}
+
+void analysis::walk(Node *node, const std::function<bool(Node*)> &visit) {
+    if (node == nullptr || !visit(node)) {
+        return;
+    }
+    for (auto child : analysis::children(node)) {
+        analysis::walk(child, visit);
+    }
+}
+
+void analysis::analyseFunction(FunctionLiteral *fn) {
+    if (fn->analysed) {
+        return;
+    }
+    std::set<const intern::Symbol*> params;
+    for (auto param : fn->parameters) {
+        params.insert(param->symbol);
+    }
+    std::vector<const intern::Symbol*> refs;
+    std::set<const intern::Symbol*> seen;
+    auto reference = [&](const intern::Symbol *name) {
+        if (params.count(name) == 0 && seen.insert(name).second) {
+            refs.push_back(name);
+        }
+    };
+    for (auto stmt : *fn->body->statements) {
+        analysis::walk(stmt, [&](Node *node) {
+            std::string type = node->type();
+            if (type == "Identifier") {
+                reference(dynamic_cast<Identifier*>(node)->symbol);
+            } else if (type == "LetStatement") {
+                fn->locals.insert(dynamic_cast<LetStatement*>(node)->name->symbol);
+            } else if (type == "ForStatement") {
+                fn->locals.insert(dynamic_cast<ForStatement*>(node)->variable->symbol);
+            } else if (type == "FunctionLiteral") {
+                FunctionLiteral *inner = dynamic_cast<FunctionLiteral*>(node);
+                analysis::analyseFunction(inner);
+                for (auto name : inner->freeVariables) {
+                    reference(name);
+                }
+                return false;
+            }
+            return true;
+        });
+    }
+    // A local may still be read before its let runs, in which case the lookup
+    // falls through to the enclosing scope, so locals stay in the free set.
+    fn->freeVariables = refs;
+    fn->analysed = true;
+}
+
+size_t analysis::NameCounts::assignments(const intern::Symbol *name) const {
+    auto found = this->assigned.find(name);
+    return found != this->assigned.end() ? found->second : 0;
+}
+
+size_t analysis::NameCounts::localBindings(const intern::Symbol *name) const {
+    auto found = this->local.find(name);
+    return found != this->local.end() ? found->second : 0;
+}
+
+void analysis::NameCounts::noteAssignment(const intern::Symbol *name) {
+    this->assigned[name]++;
+    this->total++;
+}
+
+void analysis::NameCounts::add(const analysis::NameCounts &other) {
+    for (auto &count : other.assigned) {
+        this->assigned[count.first] += count.second;
+    }
+    this->total += other.total;
+    for (auto &count : other.local) {
+        this->local[count.first] += count.second;
+    }
+}
+
+void analysis::NameCounts::noteLocalBinding(const intern::Symbol *name) {
+    this->local[name]++;
+}
@@ -0,0 +1,683 @@
+#include <cctype>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <map>
+#include "aot.hh"
+#include "analysis.hh"
+
+namespace {
+    // A function body that exists only as generated C++. Its statements are
+    // empty; string() returns the original body so Function::inspect matches.
+    class PrintedBlock : public BlockStatement {
+    public:
+        std::string text;
+        PrintedBlock(const std::string &text) : BlockStatement(Token(token::LBRACE, "{")), text(text) {};
+        std::string string() {
+            return text;
+        }
+    };
+
+    std::string quote(const std::string &str) {
+        std::string out = "\"";
+        for (unsigned char c : str) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else if (c == '\t') {
+                out += "\\t";
+            } else if (c < 0x20 || c >= 0x7F) {
+                char buf[5];
+                snprintf(buf, sizeof(buf), "\\%03o", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    std::string quoteAll(const std::vector<std::string> &strs) {
+        std::string out = "{";
+        for (size_t i = 0; i < strs.size(); i++) {
+            out += (i > 0 ? ", " : "") + quote(strs[i]);
+        }
+        return out + "}";
+    }
+
+    std::string specialization(const std::string &op) {
+        static const std::map<std::string, std::string> ops = {
+            {"+", "INT_ADD"}, {"-", "INT_SUB"}, {"*", "INT_MUL"}, {"/", "INT_DIV"},
+            {"<", "INT_LT"}, {">", "INT_GT"}, {"==", "INT_EQ"}, {"!=", "INT_NOT_EQ"},
+        };
+        auto found = ops.find(op);
+        return "Specialization::" + (found != ops.end() ? found->second : "GENERIC");
+    }
+
+    // The temporaries a line of generated code names, outside string literals.
+    std::vector<std::string> tempsIn(const std::string &text) {
+        std::vector<std::string> names;
+        bool quoted = false;
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            if (quoted) {
+                if (c == '\\') {
+                    i++;
+                } else if (c == '"') {
+                    quoted = false;
+                }
+                continue;
+            }
+            if (c == '"') {
+                quoted = true;
+                continue;
+            }
+            bool start = c == 't' && (i == 0 || !(isalnum((unsigned char) text[i - 1]) || text[i - 1] == '_' || text[i - 1] == ':'));
+            if (!start) {
+                continue;
+            }
+            size_t end = i + 1;
+            while (end < text.size() && isdigit((unsigned char) text[end])) {
+                end++;
+            }
+            if (end > i + 1 && (end == text.size() || !(isalnum((unsigned char) text[end]) || text[end] == '_'))) {
+                names.push_back(text.substr(i, end - i));
+            }
+            i = end - 1;
+        }
+        return names;
+    }
+
+    // Drops the temporaries a function never reads, so generated programs
+    // build without unused-variable warnings. Every expression gets a
+    // temporary, but a statement's value is only read when it is the last
+    // one of its block. A dropped temporary's initializer still runs, as an
+    // expression statement, unless it is just NULLobj; plain copies into it
+    // are dropped with it, which may leave their source unread in turn.
+    std::string pruneTemps(const std::string &code) {
+        std::vector<std::string> lines;
+        std::istringstream in(code);
+        for (std::string text; std::getline(in, text);) {
+            lines.push_back(text);
+        }
+        const std::string declaration = "object::Object *";
+        // Per line: the temporary it declares or copies into, if any.
+        std::vector<std::string> written(lines.size());
+        for (size_t i = 0; i < lines.size(); i++) {
+            size_t at = lines[i].find_first_not_of(' ');
+            std::string text = at == std::string::npos ? "" : lines[i].substr(at);
+            std::vector<std::string> names = tempsIn(text);
+            if (names.empty()) {
+                continue;
+            }
+            std::string assigns = names[0] + " = ";
+            bool declares = text.compare(0, declaration.size() + assigns.size(), declaration + assigns) == 0;
+            // tN = value; where value is a single name.
+            bool copies = text.compare(0, assigns.size(), assigns) == 0 && text.back() == ';'
+                && text.find_first_of(" (", assigns.size()) == std::string::npos;
+            if (declares || copies) {
+                written[i] = names[0];
+            }
+        }
+        std::vector<bool> dropped(lines.size(), false);
+        std::set<std::string> unread;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            std::set<std::string> read;
+            for (size_t i = 0; i < lines.size(); i++) {
+                if (dropped[i]) {
+                    continue;
+                }
+                std::vector<std::string> names = tempsIn(lines[i]);
+                for (size_t n = written[i].empty() ? 0 : 1; n < names.size(); n++) {
+                    read.insert(names[n]);
+                }
+            }
+            for (size_t i = 0; i < lines.size(); i++) {
+                if (dropped[i] || written[i].empty() || read.count(written[i]) > 0) {
+                    continue;
+                }
+                unread.insert(written[i]);
+                if (lines[i].find(declaration) == std::string::npos) {
+                    dropped[i] = true;
+                    changed = true;
+                }
+            }
+        }
+        std::string pruned;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (dropped[i]) {
+                continue;
+            }
+            std::string text = lines[i];
+            if (!written[i].empty() && unread.count(written[i]) > 0) {
+                size_t at = text.find(declaration);
+                std::string value = text.substr(at + declaration.size() + written[i].size() + 3);
+                if (value == "evaluator::NULLobj;") {
+                    continue;
+                }
+                text = text.substr(0, at) + value;
+            }
+            pruned += text + "\n";
+        }
+        return pruned;
+    }
+
+    // Emits one C++ function per function literal plus one for the program.
+    // Every expression is evaluated into its own temporary and checked for an
+    // error straight away, which is where the interpreter checks it too.
+    // Fletchlang return statements become C++ returns: the interpreter unwinds
+    // a ReturnValue to the enclosing call, which is exactly the C++ frame.
+    class Emitter {
+    public:
+        std::string emitProgram(Program *program);
+    private:
+        std::vector<std::string> declarations;
+        std::vector<std::string> inits;
+        std::vector<std::string> definitions;
+        std::map<const intern::Symbol*, std::string> symbols;
+        std::map<std::string, std::string> builtins;
+        size_t constants = 0;
+        size_t literals = 0;
+        // State of the function being emitted.
+        std::ostringstream *out = nullptr;
+        std::string indent;
+        size_t temps = 0;
+
+        std::string global(const std::string &prefix, size_t index, const std::string &type, const std::string &init);
+        std::string symbol(const intern::Symbol *name);
+        std::string builtin(const std::string &name);
+        std::string temp(const std::string &value);
+        void line(const std::string &text);
+        void check(const std::string &value);
+        std::string function(FunctionLiteral *fn);
+        void body(const std::string &name, std::vector<Statement*> &statements);
+        void block(std::vector<Statement*> &statements, const std::string &target);
+        std::string statement(Statement *stmt);
+        std::string loop(Statement *stmt);
+        void loopBody(const std::string &scope, BlockStatement *body, const std::string &target);
+        std::string match(MatchExpression *node);
+        void armBody(Node *body, const std::string &target);
+        std::string expression(Expression *exp);
+        void arguments(std::vector<Expression*> &expressions, const std::string &vector);
+    };
+
+    std::string Emitter::emitProgram(Program *program) {
+        body("program", *program->statements);
+        std::ostringstream tu;
+        tu << "// Generated by wfi --emit-cpp. Link against the wfi_runtime library.\n";
+        tu << "#include \"aot.hh\"\n\n";
+        tu << "static analysis::NameCounts names;\n";
+        for (auto &decl : declarations) {
+            tu << decl << "\n";
+        }
+        tu << "\n";
+        for (size_t i = 0; i < literals; i++) {
+            tu << "static object::Object* f" << i << "(object::Environment *env);\n";
+        }
+        for (auto &def : definitions) {
+            tu << "\n" << def;
+        }
+        tu << "\nstatic void init() {\n";
+        for (auto &init : inits) {
+            tu << "    " << init << "\n";
+        }
+        tu << "}\n\n";
+        tu << "int main() {\n";
+        tu << "    init();\n";
+        tu << "    return aot::run(program, names);\n";
+        tu << "}\n";
+        return tu.str();
+    }
+
+    // Globals are assigned in init() rather than by static initializers, so
+    // they never run before the runtime's own statics.
+    std::string Emitter::global(const std::string &prefix, size_t index, const std::string &type, const std::string &init) {
+        std::string name = prefix + std::to_string(index);
+        declarations.push_back("static " + type + " " + name + ";");
+        inits.push_back(name + " = " + init + ";");
+        return name;
+    }
+
+    std::string Emitter::symbol(const intern::Symbol *name) {
+        auto found = symbols.find(name);
+        if (found != symbols.end()) {
+            return found->second;
+        }
+        std::string var = global("s", symbols.size(), "const intern::Symbol*", "intern::symbol(" + quote(name->value) + ")");
+        symbols[name] = var;
+        return var;
+    }
+
+    std::string Emitter::builtin(const std::string &name) {
+        if (evaluator::builtins.count(name) == 0) {
+            return "nullptr";
+        }
+        auto found = builtins.find(name);
+        if (found != builtins.end()) {
+            return found->second;
+        }
+        std::string var = global("b", builtins.size(), "object::Object*", "aot::builtin(" + quote(name) + ")");
+        builtins[name] = var;
+        return var;
+    }
+
+    std::string Emitter::temp(const std::string &value) {
+        std::string name = "t" + std::to_string(temps++);
+        line("object::Object *" + name + " = " + value + ";");
+        return name;
+    }
+
+    void Emitter::line(const std::string &text) {
+        *out << indent << text << "\n";
+    }
+
+    void Emitter::check(const std::string &value) {
+        line("if (aot::isError(" + value + ")) {");
+        line("    return " + value + ";");
+        line("}");
+    }
+
+    std::string Emitter::function(FunctionLiteral *fn) {
+        analysis::analyseFunction(fn);
+        size_t index = literals++;
+        std::vector<std::string> parameters, freeVariables, locals;
+        for (auto param : fn->parameters) {
+            parameters.push_back(param->value);
+        }
+        for (auto name : fn->freeVariables) {
+            freeVariables.push_back(name->value);
+        }
+        for (auto name : fn->locals) {
+            locals.push_back(name->value);
+        }
+        std::string name = "f" + std::to_string(index);
+        std::string init = "aot::literal(" + quoteAll(parameters) + ", " + quoteAll(freeVariables) + ", " + quoteAll(locals) + ", " + quote(fn->body->string()) + ", " + name + ", " + (fn->generator ? "true" : "false") + ")";
+        std::string var = global("l", index, "FunctionLiteral*", init);
+        body(name, *fn->body->statements);
+        return var;
+    }
+
+    void Emitter::body(const std::string &name, std::vector<Statement*> &statements) {
+        std::ostringstream *outerOut = out;
+        std::string outerIndent = indent;
+        size_t outerTemps = temps;
+        std::ostringstream code;
+        out = &code;
+        indent = "    ";
+        temps = 0;
+        *out << "static object::Object* " << name << "(object::Environment *env) {\n";
+        line("object::Object *result = evaluator::NULLobj;");
+        block(statements, "result");
+        line("return result;");
+        *out << "}\n";
+        definitions.push_back(pruneTemps(code.str()));
+        out = outerOut;
+        indent = outerIndent;
+        temps = outerTemps;
+    }
+
+    void Emitter::block(std::vector<Statement*> &statements, const std::string &target) {
+        std::string value;
+        for (auto stmt : statements) {
+            value = statement(stmt);
+            if (value.empty()) {
+                // A return; anything after it is dead.
+                return;
+            }
+        }
+        if (!value.empty()) {
+            line(target + " = " + value + ";");
+        }
+    }
+
+    std::string Emitter::statement(Statement *stmt) {
+        std::string type = stmt->type();
+        if (type == "ExpressionStatement") {
+            return expression(dynamic_cast<ExpressionStatement*>(stmt)->expression);
+        } else if (type == "LetStatement") {
+            LetStatement *let = dynamic_cast<LetStatement*>(stmt);
+            std::string value = expression(let->value);
+            return temp("env->set(" + symbol(let->name->symbol) + ", " + value + ")");
+        } else if (type == "ReturnStatement") {
+            std::string value = expression(dynamic_cast<ReturnStatement*>(stmt)->returnValue);
+            line("return " + value + ";");
+            return "";
+        } else if (type == "YieldStatement") {
+            std::string value = expression(dynamic_cast<YieldStatement*>(stmt)->value);
+            std::string yielded = temp("generator::yield(" + value + ")");
+            check(yielded);
+            return yielded;
+        } else if (type == "BlockStatement") {
+            std::string result = temp("evaluator::NULLobj");
+            line("{");
+            indent += "    ";
+            block(*dynamic_cast<BlockStatement*>(stmt)->statements, result);
+            indent.resize(indent.size() - 4);
+            line("}");
+            return result;
+        } else if (type == "WhileStatement" || type == "ForStatement") {
+            return loop(stmt);
+        } else if (type == "BreakStatement" || type == "ContinueStatement") {
+            // Every enclosing construct up to the loop is a C++ if or block.
+            line(type == "BreakStatement" ? "break;" : "continue;");
+            return "";
+        }
+        return temp("new object::Error(" + quote("unknown node type: " + type) + ")");
+    }
+
+    // Loops become C++ loops. The body's code refers to its scope as env, so
+    // it is emitted in a nested block that shadows env with the loop scope.
+    std::string Emitter::loop(Statement *stmt) {
+        std::string discard = temp("evaluator::NULLobj");
+        std::string id = std::to_string(temps++);
+        std::string scope = "e" + id;
+        WhileStatement *ws = dynamic_cast<WhileStatement*>(stmt);
+        if (ws != nullptr) {
+            line("object::Environment *" + scope + " = env->newEnclosedEnvironment();");
+            line("while (true) {");
+            indent += "    ";
+            std::string condition = expression(ws->condition);
+            line("if (!evaluator::isTruthy(" + condition + ")) {");
+            line("    break;");
+            line("}");
+            line("evaluator::resetLoopScope(" + scope + ", nullptr, nullptr);");
+            loopBody(scope, ws->body, discard);
+            indent.resize(indent.size() - 4);
+            line("}");
+            return temp("evaluator::NULLobj");
+        }
+        ForStatement *fs = dynamic_cast<ForStatement*>(stmt);
+        std::string iterable = expression(fs->iterable);
+        std::string variable = symbol(fs->variable->symbol);
+        if (fs->end != nullptr) {
+            std::string end = expression(fs->end);
+            line("int64_t from" + id + ", to" + id + ";");
+            std::string invalid = temp("evaluator::evalRangeBounds(" + iterable + ", " + end + ", from" + id + ", to" + id + ")");
+            line("if (" + invalid + " != nullptr) {");
+            line("    return " + invalid + ";");
+            line("}");
+            line("object::Environment *" + scope + " = env->newEnclosedEnvironment();");
+            line("for (int64_t i" + id + " = from" + id + "; i" + id + " < to" + id + "; i" + id + "++) {");
+            indent += "    ";
+            line("evaluator::resetLoopScope(" + scope + ", " + variable + ", object::Integer::make(i" + id + "));");
+        } else {
+            std::string invalid = temp("evaluator::checkIterable(" + iterable + ")");
+            line("if (" + invalid + " != nullptr) {");
+            line("    return " + invalid + ";");
+            line("}");
+            line("object::Environment *" + scope + " = env->newEnclosedEnvironment();");
+            line("for (size_t i" + id + " = 0; ; i" + id + "++) {");
+            indent += "    ";
+            std::string element = temp("aot::element(" + iterable + ", i" + id + ")");
+            line("if (" + element + " == nullptr) {");
+            line("    break;");
+            line("}");
+            check(element);
+            line("evaluator::resetLoopScope(" + scope + ", " + variable + ", " + element + ");");
+        }
+        loopBody(scope, fs->body, discard);
+        indent.resize(indent.size() - 4);
+        line("}");
+        return temp("evaluator::NULLobj");
+    }
+
+    void Emitter::loopBody(const std::string &scope, BlockStatement *body, const std::string &target) {
+        line("{");
+        indent += "    ";
+        line("object::Environment *env = " + scope + ";");
+        block(*body->statements, target);
+        indent.resize(indent.size() - 4);
+        line("}");
+    }
+
+    // The arm is picked first and run afterwards, so a break or continue in
+    // its body still refers to the enclosing loop. Integer-only patterns pick
+    // the arm with a C++ switch; other patterns are compared in order.
+    std::string Emitter::match(MatchExpression *node) {
+        std::string result = temp("evaluator::NULLobj");
+        std::string subject = expression(node->subject);
+        std::string arm = "m" + std::to_string(temps++);
+        line("int " + arm + " = -1;");
+        MatchTable *table = evaluator::matchTable(node);
+        if (table != nullptr && table->strings.empty()) {
+            std::map<int64_t, size_t> cases(table->integers.begin(), table->integers.end());
+            for (size_t i = 0; i < table->dense.size(); i++) {
+                if (table->dense[i] >= 0) {
+                    cases[table->base + (int64_t) i] = table->dense[i];
+                }
+            }
+            std::string integer = "static_cast<object::Integer*>(" + subject + ")";
+            line("if (typeid(*" + subject + ") == typeid(object::Integer) && " + integer + "->big == nullptr) {");
+            line("    switch (" + integer + "->value) {");
+            for (auto &entry : cases) {
+                line("    case INT64_C(" + std::to_string(entry.first) + "): " + arm + " = " + std::to_string(entry.second) + "; break;");
+            }
+            line("    }");
+            line("}");
+        } else {
+            for (size_t i = 0; i < node->arms.size(); i++) {
+                line("if (" + arm + " < 0) {");
+                indent += "    ";
+                std::string pattern = expression(node->arms[i].pattern);
+                line("if (evaluator::matchEquals(" + subject + ", " + pattern + ")) {");
+                line("    " + arm + " = " + std::to_string(i) + ";");
+                line("}");
+                indent.resize(indent.size() - 4);
+                line("}");
+            }
+        }
+        for (size_t i = 0; i < node->arms.size(); i++) {
+            line(std::string(i == 0 ? "if" : "} else if") + " (" + arm + " == " + std::to_string(i) + ") {");
+            indent += "    ";
+            armBody(node->arms[i].body, result);
+            indent.resize(indent.size() - 4);
+        }
+        if (node->otherwise != nullptr) {
+            line(node->arms.empty() ? "{" : "} else {");
+            indent += "    ";
+            armBody(node->otherwise, result);
+            indent.resize(indent.size() - 4);
+        }
+        if (!node->arms.empty() || node->otherwise != nullptr) {
+            line("}");
+        }
+        return result;
+    }
+
+    void Emitter::armBody(Node *body, const std::string &target) {
+        BlockStatement *blk = dynamic_cast<BlockStatement*>(body);
+        if (blk != nullptr) {
+            block(*blk->statements, target);
+            return;
+        }
+        line(target + " = " + expression(dynamic_cast<Expression*>(body)) + ";");
+    }
+
+    std::string Emitter::expression(Expression *exp) {
+        std::string type = exp->type();
+        if (type == "IntegerLiteral") {
+            IntegerLiteral *literal = dynamic_cast<IntegerLiteral*>(exp);
+            std::string init = literal->big
+                ? "object::Integer::fromBig(bigint::BigInt::fromString(" + quote(literal->token_literal()) + "))"
+                : "object::Integer::make(INT64_C(" + std::to_string(literal->value) + "))";
+            return global("c", constants++, "object::Object*", init);
+        } else if (type == "FloatLiteral") {
+            std::string init = "new object::Float(" + exp->token_literal() + ")";
+            return global("c", constants++, "object::Object*", init);
+        } else if (type == "Boolean") {
+            return dynamic_cast<Boolean*>(exp)->value ? "evaluator::TRUE" : "evaluator::FALSE";
+        } else if (type == "StringLiteral") {
+            std::string init = "object::String::literal(intern::symbol(" + quote(dynamic_cast<StringLiteral*>(exp)->value) + "))";
+            return global("c", constants++, "object::Object*", init);
+        } else if (type == "Identifier") {
+            Identifier *ident = dynamic_cast<Identifier*>(exp);
+            std::string value = temp("aot::lookup(env, " + symbol(ident->symbol) + ", " + builtin(ident->value) + ")");
+            check(value);
+            return value;
+        } else if (type == "PrefixExpression") {
+            PrefixExpression *prefix = dynamic_cast<PrefixExpression*>(exp);
+            std::string right = expression(prefix->right);
+            std::string value;
+            if (prefix->op == "!") {
+                value = temp("evaluator::evalBangOperatorExpression(" + right + ")");
+            } else if (prefix->op == "-") {
+                value = temp("aot::negate(" + right + ")");
+            } else {
+                value = temp("evaluator::evalPrefixExpression(" + quote(prefix->op) + ", " + right + ")");
+            }
+            check(value);
+            return value;
+        } else if (type == "InfixExpression") {
+            InfixExpression *infix = dynamic_cast<InfixExpression*>(exp);
+            std::string left = expression(infix->left);
+            std::string right = expression(infix->right);
+            std::string value = temp("aot::infix(" + specialization(infix->op) + ", " + quote(infix->op) + ", " + left + ", " + right + ")");
+            check(value);
+            return value;
+        } else if (type == "IfExpression") {
+            IfExpression *ie = dynamic_cast<IfExpression*>(exp);
+            std::string result = temp("evaluator::NULLobj");
+            std::string condition = expression(ie->condition);
+            line("if (evaluator::isTruthy(" + condition + ")) {");
+            indent += "    ";
+            block(*ie->consequence->statements, result);
+            indent.resize(indent.size() - 4);
+            if (ie->alternative != nullptr) {
+                line("} else {");
+                indent += "    ";
+                block(*ie->alternative->statements, result);
+                indent.resize(indent.size() - 4);
+            }
+            line("}");
+            return result;
+        } else if (type == "MatchExpression") {
+            return match(dynamic_cast<MatchExpression*>(exp));
+        } else if (type == "FunctionLiteral") {
+            std::string literal = function(dynamic_cast<FunctionLiteral*>(exp));
+            return temp("evaluator::evalFunctionLiteral(" + literal + ", env)");
+        } else if (type == "ArrayLiteral") {
+            std::string elements = "e" + std::to_string(temps++);
+            arguments(dynamic_cast<ArrayLiteral*>(exp)->elements, elements);
+            return temp("new object::Array(" + elements + ")");
+        } else if (type == "HashLiteral") {
+            std::string pairs = "h" + std::to_string(temps++);
+            line("std::map<object::Object*, object::Object*> " + pairs + ";");
+            for (auto pair : dynamic_cast<HashLiteral*>(exp)->pairs) {
+                std::string key = expression(pair.first);
+                line("if (!" + key + "->hashable()) {");
+                line("    return new object::Error(\"unusable as hash key: \" + " + key + "->type());");
+                line("}");
+                std::string value = expression(pair.second);
+                line(pairs + "[" + key + "] = " + value + ";");
+            }
+            return temp("new object::Hash(" + pairs + ")");
+        } else if (type == "IndexExpression") {
+            IndexExpression *ie = dynamic_cast<IndexExpression*>(exp);
+            std::string left = expression(ie->left);
+            std::string index = expression(ie->index);
+            std::string value = temp("aot::index(" + left + ", " + index + ")");
+            check(value);
+            return value;
+        } else if (type == "AssignExpression") {
+            AssignExpression *assign = dynamic_cast<AssignExpression*>(exp);
+            std::string value;
+            if (assign->target->type() == "Identifier") {
+                std::string name = symbol(dynamic_cast<Identifier*>(assign->target)->symbol);
+                // Closures created at run time check which names are assigned.
+                inits.push_back("names.noteAssignment(" + name + ");");
+                std::string val = expression(assign->value);
+                value = temp("evaluator::evalAssignment(" + name + ", " + val + ", env)");
+            } else {
+                IndexExpression *target = dynamic_cast<IndexExpression*>(assign->target);
+                std::string left = expression(target->left);
+                std::string index = expression(target->index);
+                std::string val = expression(assign->value);
+                value = temp("evaluator::evalIndexAssignment(" + left + ", " + index + ", " + val + ")");
+            }
+            check(value);
+            return value;
+        } else if (type == "InlinedCall") {
+            InlinedCall *inlined = dynamic_cast<InlinedCall*>(exp);
+            return expression(inlined->valid ? inlined->body : inlined->call);
+        } else if (type == "CallExpression") {
+            CallExpression *call = dynamic_cast<CallExpression*>(exp);
+            std::string fn = expression(call->function);
+            std::string args = "a" + std::to_string(temps++);
+            arguments(call->arguments, args);
+            std::string value = temp("compiler::applyFunction(" + fn + ", " + args + ")");
+            check(value);
+            return value;
+        }
+        return temp("new object::Error(" + quote("unknown node type: " + type) + ")");
+    }
+
+    void Emitter::arguments(std::vector<Expression*> &expressions, const std::string &vector) {
+        line("std::vector<object::Object*> " + vector + ";");
+        line(vector + ".reserve(" + std::to_string(expressions.size()) + ");");
+        for (auto exp : expressions) {
+            std::string value = expression(exp);
+            line(vector + ".push_back(" + value + ");");
+        }
+    }
+} // namespace
+
+std::string aot::emitProgram(Program *program) {
+    Emitter emitter;
+    return emitter.emitProgram(program);
+}
+
+FunctionLiteral* aot::literal(const std::vector<std::string> &parameters, const std::vector<std::string> &freeVariables, const std::vector<std::string> &locals, const std::string &body, aot::body_t code, bool generator) {
+    FunctionLiteral *fn = new FunctionLiteral(Token(token::FUNCTION, "fn"));
+    for (auto &param : parameters) {
+        fn->parameters.push_back(new Identifier(Token(token::IDENT, param), param));
+    }
+    fn->body = new PrintedBlock(body);
+    for (auto &name : freeVariables) {
+        fn->freeVariables.push_back(intern::symbol(name));
+    }
+    for (auto &name : locals) {
+        fn->locals.insert(intern::symbol(name));
+    }
+    fn->analysed = true;
+    fn->generator = generator;
+    fn->compiled = new compiler::Code{code};
+    return fn;
+}
+
+object::Object* aot::builtin(const std::string &name) {
+    auto found = evaluator::builtins.find(name);
+    return found != evaluator::builtins.end() ? found->second : nullptr;
+}
+
+object::Object* aot::lookup(object::Environment *env, const intern::Symbol *name, object::Object *builtin) {
+    object::Object *val = env->get(name);
+    if (val != nullptr) {
+        return val;
+    }
+    if (builtin != nullptr) {
+        return builtin;
+    }
+    return new object::Error("identifier not found: " + name->value);
+}
+
+object::Object* aot::index(object::Object *left, object::Object *index) {
+    if (typeid(*left) == typeid(object::Array) && typeid(*index) == typeid(object::Integer)) {
+        return evaluator::evalArrayIndexExpression(static_cast<object::Array*>(left), static_cast<object::Integer*>(index));
+    }
+    return evaluator::evalIndexExpression(left, index);
+}
+
+int aot::run(aot::body_t program, const analysis::NameCounts &names) {
+    object::Environment *env = new object::Environment();
+    env->names = new analysis::NameCounts(names);
+    object::Object *result = program(env);
+    if (aot::isError(result)) {
+        std::cerr << result->inspect() << std::endl;
+        return 1;
+    }
+    return 0;
+}
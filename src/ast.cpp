@@ -1,4 +1,46 @@
 #include "ast.hh"
+#include "object.hh"
+
+std::string specializationName(Specialization specialization) {
+    switch (specialization) {
+    case Specialization::UNINITIALIZED: return "uninitialized";
+    case Specialization::GENERIC: return "generic";
+    case Specialization::INT_ADD: return "int + int";
+    case Specialization::INT_SUB: return "int - int";
+    case Specialization::INT_MUL: return "int * int";
+    case Specialization::INT_DIV: return "int / int";
+    case Specialization::INT_LT: return "int < int";
+    case Specialization::INT_GT: return "int > int";
+    case Specialization::INT_EQ: return "int == int";
+    case Specialization::INT_NOT_EQ: return "int != int";
+    case Specialization::BOOL_EQ: return "bool == bool";
+    case Specialization::BOOL_NOT_EQ: return "bool != bool";
+    case Specialization::STRING_CONCAT: return "string + string";
+    case Specialization::STRING_EQ: return "string == string";
+    case Specialization::STRING_NOT_EQ: return "string != string";
+    case Specialization::INT_NEGATE: return "-int";
+    case Specialization::BOOL_NOT: return "!bool";
+    case Specialization::ARRAY_INDEX: return "array[int]";
+    case Specialization::HASH_INDEX: return "hash[key]";
+    }
+    return "unknown";
+}
+
+// Known types use the same names as object::ObjectType, so messages built
+// from them match the evaluator's.
+std::string staticTypeName(StaticType type) {
+    switch (type) {
+    case StaticType::NONE: return "NONE";
+    case StaticType::UNKNOWN: return "UNKNOWN";
+    case StaticType::INTEGER: return "INTEGER";
+    case StaticType::BOOLEAN: return "BOOLEAN";
+    case StaticType::STRING: return "STRING";
+    case StaticType::ARRAY: return "ARRAY";
+    case StaticType::HASH: return "HASH";
+    case StaticType::FUNCTION: return "FUNCTION";
+    }
+    return "UNKNOWN";
+}
 
 std::string Program::token_literal() {
     if (this->statements->size() > 0) {
@@ -66,6 +108,24 @@ std::string ReturnStatement::string() {
     return out;
 }
 
+std::string YieldStatement::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string YieldStatement::statement_node() {
+    return "YieldStatement";
+}
+
+std::string YieldStatement::string() {
+    std::string out;
+    out += this->token.getLiteral() + " ";
+    if (this->value != nullptr) {
+        out += this->value->string();
+    }
+    out += ";";
+    return out;
+}
+
 std::string ExpressionStatement::token_literal() {
     return this->token.getLiteral();
 }
@@ -81,6 +141,10 @@ std::string ExpressionStatement::string() {
     return "";
 }
 
+IntegerLiteral::IntegerLiteral(Token token, int64_t value, bool big) : token(token), value(value), big(big) {
+    this->constant = big ? object::Integer::fromBig(bigint::BigInt::fromString(token.getLiteral())) : object::Integer::make(value);
+}
+
 std::string IntegerLiteral::token_literal() {
     return this->token.getLiteral();
 }
@@ -93,6 +157,20 @@ std::string IntegerLiteral::string() {
     return this->token.getLiteral();
 }
 
+std::string FloatLiteral::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string FloatLiteral::expression_node() {
+    return "FloatLiteral";
+}
+
+std::string FloatLiteral::string() {
+    return this->token.getLiteral();
+}
+
+StringLiteral::StringLiteral(Token token, std::string value) : token(token), value(value), symbol(intern::symbol(value)), constant(object::String::literal(symbol)) {}
+
 std::string StringLiteral::token_literal() {
     return this->token.getLiteral();
 }
@@ -140,6 +218,24 @@ std::string InfixExpression::string() {
     return out;
 }
 
+std::string AssignExpression::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string AssignExpression::expression_node() {
+    return "AssignExpression";
+}
+
+std::string AssignExpression::string() {
+    std::string out;
+    out += "(";
+    out += this->target->string();
+    out += " = ";
+    out += this->value->string();
+    out += ")";
+    return out;
+}
+
 std::string Boolean::token_literal() {
     return this->token.getLiteral();
 }
@@ -189,6 +285,70 @@ std::string BlockStatement::string() {
     return out;
 }
 
+std::string WhileStatement::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string WhileStatement::statement_node() {
+    return "WhileStatement";
+}
+
+std::string WhileStatement::string() {
+    std::string out;
+    out += "while";
+    out += this->condition->string();
+    out += " ";
+    out += this->body->string();
+    return out;
+}
+
+std::string ForStatement::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string ForStatement::statement_node() {
+    return "ForStatement";
+}
+
+std::string ForStatement::string() {
+    std::string out;
+    out += "for(";
+    out += this->variable->string();
+    out += " in ";
+    out += this->iterable->string();
+    if (this->end != nullptr) {
+        out += "..";
+        out += this->end->string();
+    }
+    out += ") ";
+    out += this->body->string();
+    return out;
+}
+
+std::string BreakStatement::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string BreakStatement::statement_node() {
+    return "BreakStatement";
+}
+
+std::string BreakStatement::string() {
+    return "break;";
+}
+
+std::string ContinueStatement::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string ContinueStatement::statement_node() {
+    return "ContinueStatement";
+}
+
+std::string ContinueStatement::string() {
+    return "continue;";
+}
+
 std::string FunctionLiteral::token_literal() {
     return this->token.getLiteral();
 }
@@ -234,6 +394,48 @@ std::string CallExpression::string() {
     return out;
 }
 
+std::string InlinedCall::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string InlinedCall::expression_node() {
+    return "InlinedCall";
+}
+
+std::string InlinedCall::string() {
+    return this->call->string();
+}
+
+std::string MatchExpression::token_literal() {
+    return this->token.getLiteral();
+}
+
+std::string MatchExpression::expression_node() {
+    return "MatchExpression";
+}
+
+static std::string armBody(Node *body) {
+    if (body->type() == "BlockStatement") {
+        return "{" + body->string() + "}";
+    }
+    return body->string();
+}
+
+std::string MatchExpression::string() {
+    std::string out;
+    out += "match(";
+    out += this->subject->string();
+    out += ") {";
+    for (size_t i = 0; i < this->arms.size(); i++) {
+        out += (i > 0 ? ", " : "") + this->arms[i].pattern->string() + " => " + armBody(this->arms[i].body);
+    }
+    if (this->otherwise != nullptr) {
+        out += (this->arms.empty() ? "" : ", ") + std::string("_ => ") + armBody(this->otherwise);
+    }
+    out += "}";
+    return out;
+}
+
 std::string ArrayLiteral::token_literal() {
     return this->token.getLiteral();
 }
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include "bigint.hh"
+
+typedef std::vector<uint32_t> limbs_t;
+
+static void trim(limbs_t &a) {
+    while (!a.empty() && a.back() == 0) {
+        a.pop_back();
+    }
+}
+
+static int compareMagnitude(const limbs_t &a, const limbs_t &b) {
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static limbs_t addMagnitude(const limbs_t &a, const limbs_t &b) {
+    const limbs_t &longer = a.size() >= b.size() ? a : b;
+    const limbs_t &shorter = a.size() >= b.size() ? b : a;
+    limbs_t out(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); i++) {
+        uint64_t sum = (uint64_t) longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+        out[i] = (uint32_t) sum;
+        carry = sum >> 32;
+    }
+    out[longer.size()] = (uint32_t) carry;
+    trim(out);
+    return out;
+}
+
+// Requires |a| >= |b|.
+static limbs_t subtractMagnitude(const limbs_t &a, const limbs_t &b) {
+    limbs_t out(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t diff = (int64_t) a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = diff < 0 ? 1 : 0;
+        out[i] = (uint32_t) (diff + (borrow << 32));
+    }
+    trim(out);
+    return out;
+}
+
+// Adds x << (32 * shift) into out, which must be long enough to hold the result.
+static void addShifted(limbs_t &out, const limbs_t &x, size_t shift) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < x.size(); i++) {
+        uint64_t sum = (uint64_t) out[i + shift] + x[i] + carry;
+        out[i + shift] = (uint32_t) sum;
+        carry = sum >> 32;
+    }
+    for (; carry != 0; i++) {
+        uint64_t sum = (uint64_t) out[i + shift] + carry;
+        out[i + shift] = (uint32_t) sum;
+        carry = sum >> 32;
+    }
+}
+
+limbs_t bigint::multiplySchoolbook(const limbs_t &a, const limbs_t &b) {
+    if (a.empty() || b.empty()) {
+        return limbs_t();
+    }
+    limbs_t out(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); j++) {
+            uint64_t product = (uint64_t) a[i] * b[j] + out[i + j] + carry;
+            out[i + j] = (uint32_t) product;
+            carry = product >> 32;
+        }
+        out[i + b.size()] = (uint32_t) carry;
+    }
+    trim(out);
+    return out;
+}
+
+limbs_t bigint::multiplyKaratsuba(const limbs_t &a, const limbs_t &b) {
+    if (a.size() < bigint::KARATSUBA_THRESHOLD || b.size() < bigint::KARATSUBA_THRESHOLD) {
+        return bigint::multiplySchoolbook(a, b);
+    }
+    size_t half = std::max(a.size(), b.size()) / 2;
+    limbs_t a0(a.begin(), a.begin() + std::min(half, a.size()));
+    limbs_t a1(a.begin() + std::min(half, a.size()), a.end());
+    limbs_t b0(b.begin(), b.begin() + std::min(half, b.size()));
+    limbs_t b1(b.begin() + std::min(half, b.size()), b.end());
+    trim(a0);
+    trim(b0);
+
+    limbs_t z0 = bigint::multiplyKaratsuba(a0, b0);
+    limbs_t z2 = bigint::multiplyKaratsuba(a1, b1);
+    limbs_t z1 = bigint::multiplyKaratsuba(addMagnitude(a0, a1), addMagnitude(b0, b1));
+    z1 = subtractMagnitude(subtractMagnitude(z1, z0), z2);
+
+    limbs_t out(a.size() + b.size() + 1);
+    addShifted(out, z0, 0);
+    addShifted(out, z1, half);
+    addShifted(out, z2, 2 * half);
+    trim(out);
+    return out;
+}
+
+static limbs_t divideSmall(const limbs_t &a, uint32_t divisor, uint32_t &remainder) {
+    limbs_t out(a.size());
+    uint64_t rem = 0;
+    for (size_t i = a.size(); i-- > 0;) {
+        uint64_t cur = (rem << 32) | a[i];
+        out[i] = (uint32_t) (cur / divisor);
+        rem = cur % divisor;
+    }
+    remainder = (uint32_t) rem;
+    trim(out);
+    return out;
+}
+
+// Knuth's algorithm D (TAOCP vol. 2, 4.3.1).
+static void divideMagnitude(const limbs_t &u, const limbs_t &v, limbs_t &quotient, limbs_t &remainder) {
+    if (compareMagnitude(u, v) < 0) {
+        quotient.clear();
+        remainder = u;
+        return;
+    }
+    if (v.size() == 1) {
+        uint32_t rem;
+        quotient = divideSmall(u, v[0], rem);
+        remainder = rem == 0 ? limbs_t() : limbs_t{rem};
+        return;
+    }
+    const uint64_t base = 1ULL << 32;
+    size_t n = v.size();
+    size_t m = u.size() - n;
+    int s = __builtin_clz(v[n - 1]);
+
+    limbs_t vn(n);
+    for (size_t i = n - 1; i > 0; i--) {
+        vn[i] = (v[i] << s) | (s ? v[i - 1] >> (32 - s) : 0);
+    }
+    vn[0] = v[0] << s;
+    limbs_t un(m + n + 1);
+    un[m + n] = s ? u[m + n - 1] >> (32 - s) : 0;
+    for (size_t i = m + n - 1; i > 0; i--) {
+        un[i] = (u[i] << s) | (s ? u[i - 1] >> (32 - s) : 0);
+    }
+    un[0] = u[0] << s;
+
+    quotient.assign(m + 1, 0);
+    for (size_t j = m + 1; j-- > 0;) {
+        uint64_t numerator = ((uint64_t) un[j + n] << 32) | un[j + n - 1];
+        uint64_t qhat = numerator / vn[n - 1];
+        uint64_t rhat = numerator % vn[n - 1];
+        while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= base) {
+                break;
+            }
+        }
+        int64_t borrow = 0;
+        int64_t t;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t product = qhat * vn[i];
+            t = (int64_t) un[i + j] - borrow - (int64_t) (product & 0xFFFFFFFFULL);
+            un[i + j] = (uint32_t) t;
+            borrow = (int64_t) (product >> 32) - (t >> 32);
+        }
+        t = (int64_t) un[j + n] - borrow;
+        un[j + n] = (uint32_t) t;
+        quotient[j] = (uint32_t) qhat;
+        if (t < 0) {
+            quotient[j]--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t sum = (uint64_t) un[i + j] + vn[i] + carry;
+                un[i + j] = (uint32_t) sum;
+                carry = sum >> 32;
+            }
+            un[j + n] += (uint32_t) carry;
+        }
+    }
+
+    remainder.assign(n, 0);
+    for (size_t i = 0; i < n - 1; i++) {
+        remainder[i] = (un[i] >> s) | (s ? un[i + 1] << (32 - s) : 0);
+    }
+    remainder[n - 1] = un[n - 1] >> s;
+    trim(quotient);
+    trim(remainder);
+}
+
+bigint::BigInt bigint::BigInt::fromInt64(int64_t value) {
+    bigint::BigInt out;
+    out.negative = value < 0;
+    // Negate in unsigned arithmetic so INT64_MIN does not overflow.
+    uint64_t magnitude = out.negative ? 0 - (uint64_t) value : (uint64_t) value;
+    while (magnitude != 0) {
+        out.limbs.push_back((uint32_t) magnitude);
+        magnitude >>= 32;
+    }
+    return out;
+}
+
+bigint::BigInt bigint::BigInt::fromString(const std::string &digits) {
+    bigint::BigInt out;
+    size_t i = 0;
+    bool negative = false;
+    if (!digits.empty() && digits[0] == '-') {
+        negative = true;
+        i = 1;
+    }
+    // Consume nine decimal digits at a time: out = out * 10^k + chunk.
+    while (i < digits.size()) {
+        size_t len = std::min((size_t) 9, digits.size() - i);
+        uint32_t chunk = std::stoul(digits.substr(i, len));
+        uint32_t scale = 1;
+        for (size_t k = 0; k < len; k++) {
+            scale *= 10;
+        }
+        uint64_t carry = chunk;
+        for (size_t k = 0; k < out.limbs.size(); k++) {
+            uint64_t cur = (uint64_t) out.limbs[k] * scale + carry;
+            out.limbs[k] = (uint32_t) cur;
+            carry = cur >> 32;
+        }
+        if (carry != 0) {
+            out.limbs.push_back((uint32_t) carry);
+        }
+        i += len;
+    }
+    trim(out.limbs);
+    out.negative = negative && !out.limbs.empty();
+    return out;
+}
+
+bool bigint::BigInt::isZero() const {
+    return this->limbs.empty();
+}
+
+bool bigint::BigInt::fitsInt64() const {
+    if (this->limbs.size() > 2) {
+        return false;
+    }
+    uint64_t magnitude = 0;
+    for (size_t i = this->limbs.size(); i-- > 0;) {
+        magnitude = (magnitude << 32) | this->limbs[i];
+    }
+    return this->negative ? magnitude <= (1ULL << 63) : magnitude < (1ULL << 63);
+}
+
+int64_t bigint::BigInt::toInt64() const {
+    uint64_t magnitude = 0;
+    for (size_t i = std::min(this->limbs.size(), (size_t) 2); i-- > 0;) {
+        magnitude = (magnitude << 32) | this->limbs[i];
+    }
+    return this->negative ? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+}
+
+std::string bigint::BigInt::toString() const {
+    if (this->isZero()) {
+        return "0";
+    }
+    std::vector<uint32_t> chunks;
+    limbs_t cur = this->limbs;
+    while (!cur.empty()) {
+        uint32_t rem;
+        cur = divideSmall(cur, 1000000000, rem);
+        chunks.push_back(rem);
+    }
+    std::string out = this->negative ? "-" : "";
+    out += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string part = std::to_string(chunks[i]);
+        out += std::string(9 - part.size(), '0') + part;
+    }
+    return out;
+}
+
+uint64_t bigint::BigInt::hash() const {
+    // FNV-1a over the limbs, folded with the sign.
+    uint64_t h = 14695981039346656037ULL;
+    for (auto limb : this->limbs) {
+        h = (h ^ limb) * 1099511628211ULL;
+    }
+    return this->negative ? ~h : h;
+}
+
+int bigint::BigInt::compare(const bigint::BigInt &other) const {
+    if (this->negative != other.negative) {
+        return this->negative ? -1 : 1;
+    }
+    int cmp = compareMagnitude(this->limbs, other.limbs);
+    return this->negative ? -cmp : cmp;
+}
+
+bigint::BigInt bigint::BigInt::operator-() const {
+    bigint::BigInt out = *this;
+    out.negative = !this->negative && !this->isZero();
+    return out;
+}
+
+bigint::BigInt bigint::BigInt::operator+(const bigint::BigInt &other) const {
+    bigint::BigInt out;
+    if (this->negative == other.negative) {
+        out.limbs = addMagnitude(this->limbs, other.limbs);
+        out.negative = this->negative;
+    } else if (compareMagnitude(this->limbs, other.limbs) >= 0) {
+        out.limbs = subtractMagnitude(this->limbs, other.limbs);
+        out.negative = this->negative;
+    } else {
+        out.limbs = subtractMagnitude(other.limbs, this->limbs);
+        out.negative = other.negative;
+    }
+    out.negative = out.negative && !out.isZero();
+    return out;
+}
+
+bigint::BigInt bigint::BigInt::operator-(const bigint::BigInt &other) const {
+    return *this + (-other);
+}
+
+bigint::BigInt bigint::BigInt::operator*(const bigint::BigInt &other) const {
+    bigint::BigInt out;
+    out.limbs = bigint::multiplyKaratsuba(this->limbs, other.limbs);
+    out.negative = (this->negative != other.negative) && !out.isZero();
+    return out;
+}
+
+bigint::BigInt bigint::BigInt::operator/(const bigint::BigInt &other) const {
+    bigint::BigInt quotient;
+    limbs_t remainder;
+    divideMagnitude(this->limbs, other.limbs, quotient.limbs, remainder);
+    quotient.negative = (this->negative != other.negative) && !quotient.isZero();
+    return quotient;
+}
+
+bigint::BigInt bigint::BigInt::operator%(const bigint::BigInt &other) const {
+    bigint::BigInt remainder;
+    limbs_t quotient;
+    divideMagnitude(this->limbs, other.limbs, quotient, remainder.limbs);
+    remainder.negative = this->negative && !remainder.isZero();
+    return remainder;
+}
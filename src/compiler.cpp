@@ -0,0 +1,576 @@
+#include <typeinfo>
+#include "compiler.hh"
+#include "evaluator.hh"
+#include "jit.hh"
+#include "iterator.hh"
+#include "scheduler.hh"
+#include "memo.hh"
+
+static inline bool isError(object::Object *obj) {
+    return obj != nullptr && typeid(*obj) == typeid(object::Error);
+}
+
+static inline bool isReturnValue(object::Object *obj) {
+    return obj != nullptr && typeid(*obj) == typeid(object::ReturnValue);
+}
+
+static std::vector<compiler::closure_t> compileAll(const std::vector<Statement*> &statements) {
+    std::vector<compiler::closure_t> out;
+    for (auto stmt : statements) {
+        out.push_back(compiler::compile(stmt));
+    }
+    return out;
+}
+
+static std::vector<compiler::closure_t> compileAll(const std::vector<Expression*> &expressions) {
+    std::vector<compiler::closure_t> out;
+    for (auto exp : expressions) {
+        out.push_back(compiler::compile(exp));
+    }
+    return out;
+}
+
+static compiler::closure_t compileInfix(InfixExpression *node) {
+    compiler::closure_t left = compiler::compile(node->left);
+    compiler::closure_t right = compiler::compile(node->right);
+    std::string op = node->op;
+    Specialization intOp = Specialization::GENERIC;
+    if (op == "+") {
+        intOp = Specialization::INT_ADD;
+    } else if (op == "-") {
+        intOp = Specialization::INT_SUB;
+    } else if (op == "*") {
+        intOp = Specialization::INT_MUL;
+    } else if (op == "/") {
+        intOp = Specialization::INT_DIV;
+    } else if (op == "<") {
+        intOp = Specialization::INT_LT;
+    } else if (op == ">") {
+        intOp = Specialization::INT_GT;
+    } else if (op == "==") {
+        intOp = Specialization::INT_EQ;
+    } else if (op == "!=") {
+        intOp = Specialization::INT_NOT_EQ;
+    }
+    // Proofs are read at run time: types::infer withdraws them when a later
+    // assignment invalidates them.
+    const NodeProfile *profile = &node->profile;
+    return [left, right, op, intOp, profile](object::Environment *env) -> object::Object* {
+        object::Object *l = left(env);
+        if (isError(l)) {
+            return l;
+        }
+        object::Object *r = right(env);
+        if (isError(r)) {
+            return r;
+        }
+        if (intOp != Specialization::GENERIC && ((profile->proven && profile->specialization == intOp) || (typeid(*l) == typeid(object::Integer) && typeid(*r) == typeid(object::Integer)))) {
+            object::Object *result = evaluator::evalSmallIntegerInfixExpression(intOp, static_cast<object::Integer*>(l), static_cast<object::Integer*>(r));
+            if (result != nullptr) {
+                return result;
+            }
+        }
+        return evaluator::evalInfixExpression(op, l, r);
+    };
+}
+
+static compiler::closure_t compilePrefix(PrefixExpression *node) {
+    compiler::closure_t right = compiler::compile(node->right);
+    std::string op = node->op;
+    if (op == "!") {
+        return [right](object::Environment *env) -> object::Object* {
+            object::Object *r = right(env);
+            if (isError(r)) {
+                return r;
+            }
+            return evaluator::evalBangOperatorExpression(r);
+        };
+    } else if (op == "-") {
+        return [right](object::Environment *env) -> object::Object* {
+            object::Object *r = right(env);
+            if (isError(r)) {
+                return r;
+            }
+            if (typeid(*r) == typeid(object::Integer)) {
+                object::Integer *integer = static_cast<object::Integer*>(r);
+                if (integer->big == nullptr && integer->value != INT64_MIN) {
+                    return object::Integer::make(-integer->value);
+                }
+            }
+            return evaluator::evalMinusPrefixOperatorExpression(r);
+        };
+    }
+    return [right, op](object::Environment *env) -> object::Object* {
+        object::Object *r = right(env);
+        if (isError(r)) {
+            return r;
+        }
+        return evaluator::evalPrefixExpression(op, r);
+    };
+}
+
+static compiler::closure_t compileWhile(WhileStatement *node) {
+    compiler::closure_t condition = compiler::compile(node->condition);
+    compiler::closure_t body = compiler::compile(node->body);
+    const Expression *test = node->condition;
+    return [condition, body, test](object::Environment *env) -> object::Object* {
+        object::Environment *scope = env->newEnclosedEnvironment();
+        while (true) {
+            object::Object *cond = condition(env);
+            if (isError(cond)) {
+                return cond;
+            }
+            if (!(test->staticType == StaticType::BOOLEAN ? cond == evaluator::TRUE : evaluator::isTruthy(cond))) {
+                break;
+            }
+            evaluator::resetLoopScope(scope, nullptr, nullptr);
+            object::Object *result = body(scope);
+            if (result == evaluator::BREAK) {
+                break;
+            } else if (isReturnValue(result) || isError(result)) {
+                return result;
+            }
+        }
+        return evaluator::NULLobj;
+    };
+}
+
+static compiler::closure_t compileFor(ForStatement *node) {
+    compiler::closure_t iterable = compiler::compile(node->iterable);
+    compiler::closure_t end = node->end != nullptr ? compiler::compile(node->end) : nullptr;
+    compiler::closure_t body = compiler::compile(node->body);
+    const intern::Symbol *variable = node->variable->symbol;
+    return [iterable, end, body, variable](object::Environment *env) -> object::Object* {
+        object::Object *start = iterable(env);
+        if (isError(start)) {
+            return start;
+        }
+        object::Environment *scope = env->newEnclosedEnvironment();
+        if (end) {
+            object::Object *last = end(env);
+            if (isError(last)) {
+                return last;
+            }
+            int64_t from, to;
+            object::Object *invalid = evaluator::evalRangeBounds(start, last, from, to);
+            if (invalid != nullptr) {
+                return invalid;
+            }
+            for (int64_t i = from; i < to; i++) {
+                evaluator::resetLoopScope(scope, variable, object::Integer::make(i));
+                object::Object *result = body(scope);
+                if (result == evaluator::BREAK) {
+                    break;
+                } else if (isReturnValue(result) || isError(result)) {
+                    return result;
+                }
+            }
+            return evaluator::NULLobj;
+        }
+        object::Object *invalid = evaluator::checkIterable(start);
+        if (invalid != nullptr) {
+            return invalid;
+        }
+        if (typeid(*start) != typeid(object::Array)) {
+            iterator::Iterator *it = iterator::of(start);
+            for (object::Object *value = it->pull(); value != nullptr; value = it->pull()) {
+                if (isError(value)) {
+                    return value;
+                }
+                evaluator::resetLoopScope(scope, variable, value);
+                object::Object *result = body(scope);
+                if (result == evaluator::BREAK) {
+                    break;
+                } else if (isReturnValue(result) || isError(result)) {
+                    return result;
+                }
+            }
+            return evaluator::NULLobj;
+        }
+        object::Array *array = static_cast<object::Array*>(start);
+        for (size_t i = 0; i < array->elements.size(); i++) {
+            evaluator::resetLoopScope(scope, variable, array->elements[i]);
+            object::Object *result = body(scope);
+            if (result == evaluator::BREAK) {
+                break;
+            } else if (isReturnValue(result) || isError(result)) {
+                return result;
+            }
+        }
+        return evaluator::NULLobj;
+    };
+}
+
+// The dispatch table is built here rather than on first execution, as
+// compiling is the closure engine's first sight of the node.
+static compiler::closure_t compileMatch(MatchExpression *node) {
+    compiler::closure_t subject = compiler::compile(node->subject);
+    std::vector<compiler::closure_t> patterns, bodies;
+    for (auto &arm : node->arms) {
+        patterns.push_back(compiler::compile(arm.pattern));
+        bodies.push_back(compiler::compile(arm.body));
+    }
+    compiler::closure_t otherwise = node->otherwise != nullptr ? compiler::compile(node->otherwise) : nullptr;
+    if (evaluator::matchTable(node) != nullptr) {
+        return [node, subject, bodies, otherwise](object::Environment *env) -> object::Object* {
+            object::Object *s = subject(env);
+            if (isError(s)) {
+                return s;
+            }
+            int arm = evaluator::selectArm(node, s);
+            if (arm >= 0) {
+                return bodies[arm](env);
+            }
+            return otherwise ? otherwise(env) : evaluator::NULLobj;
+        };
+    }
+    return [subject, patterns, bodies, otherwise](object::Environment *env) -> object::Object* {
+        object::Object *s = subject(env);
+        if (isError(s)) {
+            return s;
+        }
+        for (size_t i = 0; i < patterns.size(); i++) {
+            object::Object *pattern = patterns[i](env);
+            if (isError(pattern)) {
+                return pattern;
+            }
+            if (evaluator::matchEquals(s, pattern)) {
+                return bodies[i](env);
+            }
+        }
+        return otherwise ? otherwise(env) : evaluator::NULLobj;
+    };
+}
+
+static compiler::closure_t compileAssign(AssignExpression *node) {
+    compiler::closure_t value = compiler::compile(node->value);
+    if (node->target->type() == "Identifier") {
+        const intern::Symbol *name = dynamic_cast<Identifier*>(node->target)->symbol;
+        return [value, name](object::Environment *env) -> object::Object* {
+            object::Object *val = value(env);
+            if (isError(val)) {
+                return val;
+            }
+            return evaluator::evalAssignment(name, val, env);
+        };
+    }
+    IndexExpression *target = dynamic_cast<IndexExpression*>(node->target);
+    compiler::closure_t left = compiler::compile(target->left);
+    compiler::closure_t index = compiler::compile(target->index);
+    return [left, index, value](object::Environment *env) -> object::Object* {
+        object::Object *l = left(env);
+        if (isError(l)) {
+            return l;
+        }
+        object::Object *i = index(env);
+        if (isError(i)) {
+            return i;
+        }
+        object::Object *val = value(env);
+        if (isError(val)) {
+            return val;
+        }
+        return evaluator::evalIndexAssignment(l, i, val);
+    };
+}
+
+compiler::closure_t compiler::compile(Node *node) {
+    std::string type = node->type();
+    if (type == "Program") {
+        Program *program = dynamic_cast<Program*>(node);
+        std::vector<closure_t> statements = compileAll(*program->statements);
+        return [program, statements](object::Environment *env) -> object::Object* {
+            env->count(program);
+            object::Object *result = evaluator::NULLobj;
+            for (auto &statement : statements) {
+                result = statement(env);
+                if (isReturnValue(result)) {
+                    return static_cast<object::ReturnValue*>(result)->value;
+                } else if (isError(result)) {
+                    return result;
+                }
+            }
+            return result;
+        };
+    } else if (type == "ExpressionStatement") {
+        return compile(dynamic_cast<ExpressionStatement*>(node)->expression);
+    } else if (type == "BlockStatement") {
+        std::vector<closure_t> statements = compileAll(*dynamic_cast<BlockStatement*>(node)->statements);
+        return [statements](object::Environment *env) -> object::Object* {
+            object::Object *result = evaluator::NULLobj;
+            for (auto &statement : statements) {
+                result = statement(env);
+                if (isReturnValue(result) || isError(result) || evaluator::isLoopControl(result)) {
+                    return result;
+                }
+            }
+            return result;
+        };
+    } else if (type == "ReturnStatement") {
+        closure_t value = compile(dynamic_cast<ReturnStatement*>(node)->returnValue);
+        return [value](object::Environment *env) -> object::Object* {
+            object::Object *val = value(env);
+            if (isError(val)) {
+                return val;
+            }
+            return new object::ReturnValue(val);
+        };
+    } else if (type == "YieldStatement") {
+        closure_t value = compile(dynamic_cast<YieldStatement*>(node)->value);
+        return [value](object::Environment *env) -> object::Object* {
+            object::Object *val = value(env);
+            if (isError(val)) {
+                return val;
+            }
+            return generator::yield(val);
+        };
+    } else if (type == "LetStatement") {
+        closure_t value = compile(dynamic_cast<LetStatement*>(node)->value);
+        const intern::Symbol *name = dynamic_cast<LetStatement*>(node)->name->symbol;
+        return [value, name](object::Environment *env) -> object::Object* {
+            object::Object *val = value(env);
+            if (isError(val)) {
+                return val;
+            }
+            return env->set(name, memo::bind(name, val, env));
+        };
+    } else if (type == "IfExpression") {
+        IfExpression *ie = dynamic_cast<IfExpression*>(node);
+        closure_t condition = compile(ie->condition);
+        closure_t consequence = compile(ie->consequence);
+        closure_t alternative = ie->alternative != nullptr ? compile(ie->alternative) : nullptr;
+        const Expression *test = ie->condition;
+        return [condition, consequence, alternative, test](object::Environment *env) -> object::Object* {
+            object::Object *cond = condition(env);
+            if (isError(cond)) {
+                return cond;
+            }
+            if (test->staticType == StaticType::BOOLEAN ? cond == evaluator::TRUE : evaluator::isTruthy(cond)) {
+                return consequence(env);
+            } else if (alternative) {
+                return alternative(env);
+            }
+            return evaluator::NULLobj;
+        };
+    } else if (type == "MatchExpression") {
+        return compileMatch(dynamic_cast<MatchExpression*>(node));
+    } else if (type == "WhileStatement") {
+        return compileWhile(dynamic_cast<WhileStatement*>(node));
+    } else if (type == "ForStatement") {
+        return compileFor(dynamic_cast<ForStatement*>(node));
+    } else if (type == "BreakStatement") {
+        return [](object::Environment *) -> object::Object* {
+            return evaluator::BREAK;
+        };
+    } else if (type == "ContinueStatement") {
+        return [](object::Environment *) -> object::Object* {
+            return evaluator::CONTINUE;
+        };
+    } else if (type == "Identifier") {
+        Identifier *ident = dynamic_cast<Identifier*>(node);
+        std::string message = "identifier not found: " + ident->value;
+        return [ident, message](object::Environment *env) -> object::Object* {
+            object::Object *val = evaluator::lookup(ident, env);
+            if (val != nullptr) {
+                return val;
+            }
+            return new object::Error(message);
+        };
+    } else if (type == "IntegerLiteral") {
+        object::Integer *value = dynamic_cast<IntegerLiteral*>(node)->constant;
+        return [value](object::Environment *) -> object::Object* {
+            return value;
+        };
+    } else if (type == "FloatLiteral") {
+        object::Float *value = new object::Float(dynamic_cast<FloatLiteral*>(node)->value);
+        return [value](object::Environment *) -> object::Object* {
+            return value;
+        };
+    } else if (type == "Boolean") {
+        object::Object *value = evaluator::nativeBoolToBooleanObject(dynamic_cast<Boolean*>(node)->value);
+        return [value](object::Environment *) -> object::Object* {
+            return value;
+        };
+    } else if (type == "StringLiteral") {
+        object::String *value = dynamic_cast<StringLiteral*>(node)->constant;
+        return [value](object::Environment *) -> object::Object* {
+            return value;
+        };
+    } else if (type == "FunctionLiteral") {
+        FunctionLiteral *literal = dynamic_cast<FunctionLiteral*>(node);
+        compiledBody(literal);
+        return [literal](object::Environment *env) -> object::Object* {
+            return evaluator::evalFunctionLiteral(literal, env);
+        };
+    } else if (type == "ArrayLiteral") {
+        std::vector<closure_t> elements = compileAll(dynamic_cast<ArrayLiteral*>(node)->elements);
+        return [elements](object::Environment *env) -> object::Object* {
+            std::vector<object::Object*> values;
+            values.reserve(elements.size());
+            for (auto &element : elements) {
+                object::Object *val = element(env);
+                if (isError(val)) {
+                    return val;
+                }
+                values.push_back(val);
+            }
+            return new object::Array(values);
+        };
+    } else if (type == "HashLiteral") {
+        const object::Shape *shape = dynamic_cast<HashLiteral*>(node)->shape;
+        if (shape != nullptr) {
+            // Keys are constant, so only the values are left to evaluate,
+            // each straight into its slot.
+            std::vector<std::pair<size_t, closure_t>> slots;
+            for (auto pair : dynamic_cast<HashLiteral*>(node)->pairs) {
+                slots.push_back({static_cast<size_t>(shape->slot(dynamic_cast<StringLiteral*>(pair.first)->symbol->hash)), compile(pair.second)});
+            }
+            return [shape, slots](object::Environment *env) -> object::Object* {
+                std::vector<object::Object*> values(shape->keys.size());
+                for (auto &slot : slots) {
+                    object::Object *value = slot.second(env);
+                    if (isError(value)) {
+                        return value;
+                    }
+                    values[slot.first] = value;
+                }
+                return new object::Hash(shape, values);
+            };
+        }
+        std::vector<std::pair<closure_t, closure_t>> pairs;
+        for (auto pair : dynamic_cast<HashLiteral*>(node)->pairs) {
+            pairs.push_back({compile(pair.first), compile(pair.second)});
+        }
+        return [pairs](object::Environment *env) -> object::Object* {
+            std::map<object::Object*, object::Object*> values;
+            for (auto &pair : pairs) {
+                object::Object *key = pair.first(env);
+                if (isError(key)) {
+                    return key;
+                }
+                if (!key->hashable()) {
+                    return new object::Error("unusable as hash key: " + key->type());
+                }
+                object::Object *value = pair.second(env);
+                if (isError(value)) {
+                    return value;
+                }
+                values[key] = value;
+            }
+            return new object::Hash(values);
+        };
+    } else if (type == "IndexExpression") {
+        closure_t left = compile(dynamic_cast<IndexExpression*>(node)->left);
+        closure_t index = compile(dynamic_cast<IndexExpression*>(node)->index);
+        const NodeProfile *profile = &dynamic_cast<IndexExpression*>(node)->profile;
+        ShapeCache *cache = &dynamic_cast<IndexExpression*>(node)->cache;
+        return [left, index, profile, cache](object::Environment *env) -> object::Object* {
+            object::Object *l = left(env);
+            if (isError(l)) {
+                return l;
+            }
+            object::Object *i = index(env);
+            if (isError(i)) {
+                return i;
+            }
+            if ((profile->proven && profile->specialization == Specialization::ARRAY_INDEX) || (typeid(*l) == typeid(object::Array) && typeid(*i) == typeid(object::Integer))) {
+                return evaluator::evalArrayIndexExpression(static_cast<object::Array*>(l), static_cast<object::Integer*>(i));
+            }
+            if (typeid(*l) == typeid(object::Hash) && !scheduler::concurrent()) {
+                return evaluator::evalHashIndexExpression(*cache, static_cast<object::Hash*>(l), i);
+            }
+            return evaluator::evalIndexExpression(l, i);
+        };
+    } else if (type == "PrefixExpression") {
+        return compilePrefix(dynamic_cast<PrefixExpression*>(node));
+    } else if (type == "InfixExpression") {
+        return compileInfix(dynamic_cast<InfixExpression*>(node));
+    } else if (type == "AssignExpression") {
+        return compileAssign(dynamic_cast<AssignExpression*>(node));
+    } else if (type == "InlinedCall") {
+        InlinedCall *inlined = dynamic_cast<InlinedCall*>(node);
+        closure_t body = compile(inlined->body);
+        closure_t call = compile(inlined->call);
+        return [inlined, body, call](object::Environment *env) -> object::Object* {
+            return inlined->valid ? body(env) : call(env);
+        };
+    } else if (type == "CallExpression") {
+        CallExpression *call = dynamic_cast<CallExpression*>(node);
+        closure_t function = compile(call->function);
+        std::vector<closure_t> arguments = compileAll(call->arguments);
+        return [call, function, arguments](object::Environment *env) -> object::Object* {
+            object::Object *fn = function(env);
+            if (isError(fn)) {
+                return fn;
+            }
+            std::vector<object::Object*> args;
+            if (parallel::arguments && arguments.size() > 1) {
+                object::Object *error = parallel::evaluateArguments(call, env, [&arguments, env](size_t i) {
+                    return arguments[i](env);
+                }, args);
+                if (error != nullptr) {
+                    return error;
+                }
+                return compiler::applyFunction(fn, args);
+            }
+            args.reserve(arguments.size());
+            for (auto &argument : arguments) {
+                object::Object *val = argument(env);
+                if (isError(val)) {
+                    return val;
+                }
+                args.push_back(val);
+            }
+            return compiler::applyFunction(fn, args);
+        };
+    }
+    std::string message = "unknown node type: " + type;
+    return [message](object::Environment *) -> object::Object* {
+        return new object::Error(message);
+    };
+}
+
+compiler::Code* compiler::compiledBody(FunctionLiteral *fn) {
+    if (fn->compiled == nullptr) {
+        fn->compiled = new compiler::Code{compile(fn->body)};
+    }
+    return fn->compiled;
+}
+
+object::Object* compiler::applyFunction(object::Object *fn, std::vector<object::Object*> &args) {
+    if (typeid(*fn) == typeid(object::Function)) {
+        object::Function *function = static_cast<object::Function*>(fn);
+        if (function->literal == nullptr) {
+            return evaluator::applyFunction(fn, args);
+        }
+        if (function->literal->generator) {
+            compiler::Code *code = compiledBody(function->literal);
+            object::Environment *extendedEnv = evaluator::extendFunctionEnv(function, args);
+            return new generator::Generator([code, extendedEnv] {
+                object::Object *evaluated = code->run(extendedEnv);
+                return isReturnValue(evaluated) ? static_cast<object::ReturnValue*>(evaluated)->value : evaluated;
+            });
+        }
+        if (generator::overflowing()) {
+            return new object::Error("stack overflow in generator");
+        }
+        object::Object *native = jit::tryCall(function, args);
+        if (native != nullptr) {
+            return native;
+        }
+        compiler::Code *code = compiledBody(function->literal);
+        object::Environment *extendedEnv = evaluator::extendFunctionEnv(function, args);
+        object::Object *evaluated = code->run(extendedEnv);
+        if (isReturnValue(evaluated)) {
+            return static_cast<object::ReturnValue*>(evaluated)->value;
+        }
+        return evaluated;
+    } else if (typeid(*fn) == typeid(object::Builtin) || typeid(*fn) == typeid(memo::Memo)) {
+        return static_cast<object::Builtin*>(fn)->fn(args);
+    }
+    return new object::Error("not a function: " + fn->type());
+}
+
+object::Object* compiler::eval(Node *node, object::Environment *env) {
+    return compile(node)(env);
+}
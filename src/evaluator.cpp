@@ -1,4 +1,294 @@
+#include <typeinfo>
+#include <cstring>
 #include "evaluator.hh"
+#include "analysis.hh"
+#include "jit.hh"
+#include "scheduler.hh"
+
+object::Boolean *evaluator::TRUE = new object::Boolean(true);
+object::Boolean *evaluator::FALSE = new object::Boolean(false);
+object::Null *evaluator::NULLobj = new object::Null();
+object::LoopControl *evaluator::BREAK = new object::LoopControl(true);
+object::LoopControl *evaluator::CONTINUE = new object::LoopControl(false);
+
+std::map<std::string, object::Builtin*> evaluator::builtins = {
+    {"len", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 1) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if (args[0]->type() == object::STRING_OBJ) {
+            return object::Integer::make(dynamic_cast<object::String*>(args[0])->length);
+        } else if (args[0]->type() == object::ARRAY_OBJ) {
+            return object::Integer::make(dynamic_cast<object::Array*>(args[0])->elements.size());
+        } else if (typeid(*args[0]) == typeid(object::PackedArray)) {
+            return object::Integer::make(static_cast<object::PackedArray*>(args[0])->size());
+        }
+        return new object::Error("argument to `len` not supported, got " + args[0]->type());
+    })},
+    {"puts", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        for (auto arg : args) {
+            std::cout << arg->inspect() << std::endl;
+        }
+        return NULLobj;
+    }, true)},
+    {"first", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 1) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if (typeid(*args[0]) == typeid(object::PackedArray)) {
+            object::PackedArray *xs = static_cast<object::PackedArray*>(args[0]);
+            return xs->size() > 0 ? xs->at(0) : NULLobj;
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `first` must be ARRAY, got " + args[0]->type());
+        }
+        object::Array *arr = dynamic_cast<object::Array*>(args[0]);
+        if (arr->elements.size() > 0) {
+            return arr->elements[0];
+        }
+        return NULLobj;
+    })},
+    {"last", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 1) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if (typeid(*args[0]) == typeid(object::PackedArray)) {
+            object::PackedArray *xs = static_cast<object::PackedArray*>(args[0]);
+            return xs->size() > 0 ? xs->at(xs->size() - 1) : NULLobj;
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `last` must be ARRAY, got " + args[0]->type());
+        }
+        object::Array *arr = dynamic_cast<object::Array*>(args[0]);
+        if (arr->elements.size() > 0) {
+            return arr->elements[arr->elements.size() - 1];
+        }
+        return NULLobj;
+    })},
+    {"rest", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 1) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if (typeid(*args[0]) == typeid(object::PackedArray)) {
+            object::PackedArray *xs = static_cast<object::PackedArray*>(args[0]);
+            if (xs->size() == 0) {
+                return NULLobj;
+            }
+            if (xs->kind == object::PackedArray::INT64) {
+                return new object::PackedArray(std::vector<int64_t>(xs->ints.begin() + 1, xs->ints.end()));
+            }
+            return new object::PackedArray(std::vector<double>(xs->floats.begin() + 1, xs->floats.end()));
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `rest` must be ARRAY, got " + args[0]->type());
+        }
+        object::Array *arr = dynamic_cast<object::Array*>(args[0]);
+        if (arr->elements.size() > 0) {
+            return new object::Array(std::vector<object::Object*>(arr->elements.begin() + 1, arr->elements.end()));
+        }
+        return NULLobj;
+    })},
+    {"push", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+        if (typeid(*args[0]) == typeid(object::PackedArray)) {
+            // Stays packed when the kind can hold the new element.
+            object::PackedArray *xs = new object::PackedArray(*static_cast<object::PackedArray*>(args[0]));
+            if (!isError(xs->store(xs->size(), args[1]))) {
+                return xs;
+            }
+            std::vector<object::Object*> elements;
+            for (size_t i = 0; i < xs->size(); i++) {
+                elements.push_back(xs->at(i));
+            }
+            elements.push_back(args[1]);
+            return new object::Array(elements);
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `push` must be ARRAY, got " + args[0]->type());
+        }
+        object::Array *arr = dynamic_cast<object::Array*>(args[0]);
+        std::vector<object::Object*> elements = arr->elements;
+        elements.push_back(args[1]);
+        return new object::Array(elements);
+    })},
+    {"join", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 1 && args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `join` must be ARRAY, got " + args[0]->type());
+        }
+        std::string sep;
+        if (args.size() == 2) {
+            if (args[1]->type() != object::STRING_OBJ) {
+                return new object::Error("separator for `join` must be STRING, got " + args[1]->type());
+            }
+            sep = dynamic_cast<object::String*>(args[1])->value();
+        }
+        object::Array *arr = dynamic_cast<object::Array*>(args[0]);
+        size_t length = 0;
+        for (auto elem : arr->elements) {
+            if (elem->type() != object::STRING_OBJ) {
+                return new object::Error("elements of `join` must be STRING, got " + elem->type());
+            }
+            length += dynamic_cast<object::String*>(elem)->length + sep.size();
+        }
+        std::string out;
+        out.reserve(length);
+        for (size_t i = 0; i < arr->elements.size(); i++) {
+            if (i > 0) {
+                out += sep;
+            }
+            out += dynamic_cast<object::String*>(arr->elements[i])->value();
+        }
+        return new object::String(out);
+    })},
+    {"substr", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2 && args.size() != 3) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2 or 3");
+        }
+        if (args[0]->type() != object::STRING_OBJ) {
+            return new object::Error("argument to `substr` must be STRING, got " + args[0]->type());
+        }
+        for (size_t i = 1; i < args.size(); i++) {
+            if (args[i]->type() != object::INTEGER_OBJ) {
+                return new object::Error("argument to `substr` must be INTEGER, got " + args[i]->type());
+            }
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        int64_t start = dynamic_cast<object::Integer*>(args[1])->value;
+        int64_t length = args.size() == 3 ? dynamic_cast<object::Integer*>(args[2])->value : str->length;
+        start = std::max((int64_t) 0, std::min(start, (int64_t) str->length));
+        length = std::max((int64_t) 0, std::min(length, (int64_t) str->length - start));
+        return object::String::slice(str, start, length);
+    })},
+    {"split", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+        if (args[0]->type() != object::STRING_OBJ || args[1]->type() != object::STRING_OBJ) {
+            return new object::Error("arguments to `split` must be STRING, got " + args[0]->type() + ", " + args[1]->type());
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        object::String *sep = dynamic_cast<object::String*>(args[1]);
+        std::vector<object::Object*> parts;
+        if (sep->length == 0) {
+            for (size_t i = 0; i < str->length; i++) {
+                parts.push_back(object::String::slice(str, i, 1));
+            }
+            return new object::Array(parts);
+        }
+        const char *data = str->data();
+        size_t start = 0;
+        while (true) {
+            size_t found = strsearch::find(data + start, str->length - start, sep->data(), sep->length);
+            if (found == strsearch::npos) {
+                parts.push_back(object::String::slice(str, start, str->length - start));
+                break;
+            }
+            parts.push_back(object::String::slice(str, start, found));
+            start += found + sep->length;
+        }
+        return new object::Array(parts);
+    })},
+    {"indexOf", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+        if (args[0]->type() != object::STRING_OBJ || args[1]->type() != object::STRING_OBJ) {
+            return new object::Error("arguments to `indexOf` must be STRING, got " + args[0]->type() + ", " + args[1]->type());
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        object::String *sub = dynamic_cast<object::String*>(args[1]);
+        size_t found = strsearch::find(str->data(), str->length, sub->data(), sub->length);
+        return object::Integer::make(found == strsearch::npos ? -1 : (int64_t) found);
+    })},
+    {"contains", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+        if (args[0]->type() != object::STRING_OBJ || args[1]->type() != object::STRING_OBJ) {
+            return new object::Error("arguments to `contains` must be STRING, got " + args[0]->type() + ", " + args[1]->type());
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        object::String *sub = dynamic_cast<object::String*>(args[1]);
+        return strsearch::find(str->data(), str->length, sub->data(), sub->length) != strsearch::npos ? TRUE : FALSE;
+    })},
+    {"startsWith", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 2) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+        if (args[0]->type() != object::STRING_OBJ || args[1]->type() != object::STRING_OBJ) {
+            return new object::Error("arguments to `startsWith` must be STRING, got " + args[0]->type() + ", " + args[1]->type());
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        object::String *prefix = dynamic_cast<object::String*>(args[1]);
+        return strsearch::startsWith(str->data(), str->length, prefix->data(), prefix->length) ? TRUE : FALSE;
+    })},
+    {"replace", new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        if (args.size() != 3) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=3");
+        }
+        for (auto arg : args) {
+            if (arg->type() != object::STRING_OBJ) {
+                return new object::Error("arguments to `replace` must be STRING, got " + arg->type());
+            }
+        }
+        object::String *str = dynamic_cast<object::String*>(args[0]);
+        object::String *from = dynamic_cast<object::String*>(args[1]);
+        object::String *to = dynamic_cast<object::String*>(args[2]);
+        if (from->length == 0) {
+            return str;
+        }
+        const char *data = str->data();
+        size_t start = 0;
+        size_t found = strsearch::find(data, str->length, from->data(), from->length);
+        if (found == strsearch::npos) {
+            return str;
+        }
+        std::string out;
+        out.reserve(str->length);
+        while (found != strsearch::npos) {
+            out.append(data + start, found);
+            out.append(to->data(), to->length);
+            start += found + from->length;
+            found = strsearch::find(data + start, str->length - start, from->data(), from->length);
+        }
+        out.append(data + start, str->length - start);
+        return new object::String(out);
+    })},
+    {"pmap", new object::Builtin(parallel::pmap)},
+    {"pfilter", new object::Builtin(parallel::pfilter)},
+    {"preduce", new object::Builtin(parallel::preduce)},
+    {"spawn", new object::Builtin(parallel::spawn)},
+    {"await", new object::Builtin(parallel::await)},
+    {"channel", new object::Builtin(isolate::channel)},
+    {"send", new object::Builtin(isolate::send, true)},
+    {"receive", new object::Builtin(isolate::receive, true)},
+    {"close", new object::Builtin(isolate::close, true)},
+    {"isolate", new object::Builtin(isolate::start, true)},
+    {"range", new object::Builtin(iterator::range)},
+    {"map", new object::Builtin(iterator::map)},
+    {"filter", new object::Builtin(iterator::filter)},
+    {"take", new object::Builtin(iterator::take)},
+    {"zip", new object::Builtin(iterator::zip)},
+    {"fold", new object::Builtin(iterator::fold, true)},
+    {"collect", new object::Builtin(iterator::collect, true)},
+    {"next", new object::Builtin(iterator::next, true)},
+    {"pack", new object::Builtin(packed::pack)},
+    {"sum", new object::Builtin(packed::sum)},
+    {"min", new object::Builtin(packed::min)},
+    {"max", new object::Builtin(packed::max)},
+    {"dot", new object::Builtin(packed::dot)},
+    {"add", new object::Builtin(packed::add)},
+    {"mul", new object::Builtin(packed::mul)},
+    {"scale", new object::Builtin(packed::scale)},
+    {"prefixSum", new object::Builtin(packed::prefixSum)},
+    {"memo", new object::Builtin(memo::memoize)},
+    {"memoStats", new object::Builtin(memo::stats, true)},
+};
 
 object::Object* evaluator::eval(Node *node, object::Environment *env) {
     if(node->type() == "Program") {
@@ -13,24 +303,33 @@ object::Object* evaluator::eval(Node *node, object::Environment *env) {
             return val;
         }
         return new object::ReturnValue(val);
+    } else if (node->type() == "YieldStatement") {
+        object::Object *val = eval(dynamic_cast<YieldStatement*>(node)->value, env);
+        if (evaluator::isError(val)) {
+            return val;
+        }
+        return generator::yield(val);
     } else if (node->type() == "LetStatement") {
         object::Object *val = eval(dynamic_cast<LetStatement*>(node)->value, env);
         if (evaluator::isError(val)) {
             return val;
         }
-        return env->set(dynamic_cast<LetStatement*>(node)->name->value, val);
+        const intern::Symbol *name = dynamic_cast<LetStatement*>(node)->name->symbol;
+        return env->set(name, memo::bind(name, val, env));
     } else if (node->type() == "IfExpression") {
         return evalIfExpression(dynamic_cast<IfExpression*>(node), env);
     } else if (node->type() == "Identifier") {
         return evalIdentifier(dynamic_cast<Identifier*>(node), env);
     } else if (node->type() == "IntegerLiteral") {
-        return new object::Integer(dynamic_cast<IntegerLiteral*>(node)->value);
+        return dynamic_cast<IntegerLiteral*>(node)->constant;
+    } else if (node->type() == "FloatLiteral") {
+        return new object::Float(dynamic_cast<FloatLiteral*>(node)->value);
     } else if (node->type() == "Boolean") {
         return evaluator::nativeBoolToBooleanObject(dynamic_cast<Boolean*>(node)->value);
     } else if (node->type() == "StringLiteral") {
-        return new object::String(dynamic_cast<StringLiteral*>(node)->value);
+        return dynamic_cast<StringLiteral*>(node)->constant;
     } else if (node->type() == "FunctionLiteral") {
-        return new object::Function(&dynamic_cast<FunctionLiteral*>(node)->parameters, dynamic_cast<FunctionLiteral*>(node)->body, env);
+        return evalFunctionLiteral(dynamic_cast<FunctionLiteral*>(node), env);
     } else if (node->type() == "ArrayLiteral") {
         std::vector<object::Object*> elements = evalExpressions(dynamic_cast<ArrayLiteral*>(node)->elements, env);
         if (elements.size() == 1 && evaluator::isError(elements[0])) {
@@ -48,13 +347,13 @@ object::Object* evaluator::eval(Node *node, object::Environment *env) {
         if (evaluator::isError(index)) {
             return index;
         }
-        return evalIndexExpression(left, index);
+        return evalSpecializedIndexExpression(dynamic_cast<IndexExpression*>(node), left, index);
     } else if (node->type() == "PrefixExpression") {
         object::Object *right = eval(dynamic_cast<PrefixExpression*>(node)->right, env);
         if (evaluator::isError(right)) {
             return right;
         }
-        return evalPrefixExpression(dynamic_cast<PrefixExpression*>(node)->op, right);
+        return evalSpecializedPrefixExpression(dynamic_cast<PrefixExpression*>(node), right);
     } else if (node->type() == "InfixExpression") {
         object::Object *left = eval(dynamic_cast<InfixExpression*>(node)->left, env);
         if (evaluator::isError(left)) {
@@ -64,24 +363,51 @@ object::Object* evaluator::eval(Node *node, object::Environment *env) {
         if (evaluator::isError(right)) {
             return right;
         }
-        return evalInfixExpression(dynamic_cast<InfixExpression*>(node)->op, left, right);
+        return evalSpecializedInfixExpression(dynamic_cast<InfixExpression*>(node), left, right);
+    } else if (node->type() == "AssignExpression") {
+        return evalAssignExpression(dynamic_cast<AssignExpression*>(node), env);
+    } else if (node->type() == "InlinedCall") {
+        InlinedCall *inlined = dynamic_cast<InlinedCall*>(node);
+        return eval(inlined->valid ? inlined->body : inlined->call, env);
     } else if (node->type() == "CallExpression") {
-        auto function = eval(dynamic_cast<CallExpression*>(node)->function, env);
+        CallExpression *call = dynamic_cast<CallExpression*>(node);
+        auto function = eval(call->function, env);
         if(evaluator::isError(function)) {
             return function;
         }
-        std::vector<object::Object*> args = evalExpressions(dynamic_cast<CallExpression*>(node)->arguments, env);
+        if (parallel::arguments && call->arguments.size() > 1) {
+            std::vector<object::Object*> args;
+            object::Object *error = parallel::evaluateArguments(call, env, [call, env](size_t i) {
+                return eval(call->arguments[i], env);
+            }, args);
+            if (error != nullptr) {
+                return error;
+            }
+            return applyFunction(function, args);
+        }
+        std::vector<object::Object*> args = evalExpressions(call->arguments, env);
         if (args.size() == 1 && evaluator::isError(args[0])) {
             return args[0];
         }
         return applyFunction(function, args);
+    } else if (node->type() == "MatchExpression") {
+        return evalMatchExpression(dynamic_cast<MatchExpression*>(node), env);
+    } else if (node->type() == "WhileStatement") {
+        return evalWhileStatement(dynamic_cast<WhileStatement*>(node), env);
+    } else if (node->type() == "ForStatement") {
+        return evalForStatement(dynamic_cast<ForStatement*>(node), env);
+    } else if (node->type() == "BreakStatement") {
+        return evaluator::BREAK;
+    } else if (node->type() == "ContinueStatement") {
+        return evaluator::CONTINUE;
     } else {
         return new object::Error("unknown node type: " + node->type());
     }
 }
 
 object::Object* evaluator::evalProgram(Program *program, object::Environment *env) {
-    object::Object *result;
+    env->count(program);
+    object::Object *result = evaluator::NULLobj;
     for (auto &statement : *program->statements) {
         result = evaluator::eval(statement, env);
         if (result->type() == object::RETURN_VALUE_OBJ) {
@@ -107,10 +433,10 @@ std::vector<object::Object*> evaluator::evalExpressions(std::vector<Expression*>
 }
 
 object::Object* evaluator::evalBlockStatement(BlockStatement *block, object::Environment *env) {
-    object::Object *result;
+    object::Object *result = evaluator::NULLobj;
     for (auto &statement : *block->statements) {
         result = evaluator::eval(statement, env);
-        if (result != nullptr && (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ)) {
+        if (result != nullptr && (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ || evaluator::isLoopControl(result))) {
             return result;
         }
     }
@@ -142,10 +468,18 @@ object::Object* evaluator::evalBangOperatorExpression(object::Object *right) {
 }
 
 object::Object* evaluator::evalMinusPrefixOperatorExpression(object::Object *right) {
+    if (right->type() == object::FLOAT_OBJ) {
+        return new object::Float(-dynamic_cast<object::Float*>(right)->value);
+    }
     if (right->type() != object::INTEGER_OBJ) {
         return new object::Error("unknown operator: -" + right->type());
     }
-    return new object::Integer(-dynamic_cast<object::Integer*>(right)->value);
+    object::Integer *integer = dynamic_cast<object::Integer*>(right);
+    int64_t result;
+    if (integer->big != nullptr || __builtin_sub_overflow((int64_t) 0, integer->value, &result)) {
+        return object::Integer::fromBig(-integer->toBig());
+    }
+    return object::Integer::make(result);
 }
 
 object::Object* evaluator::evalInfixExpression(std::string op, object::Object *left, object::Object *right) {
@@ -155,6 +489,8 @@ object::Object* evaluator::evalInfixExpression(std::string op, object::Object *l
         return evalBooleanInfixExpression(op, dynamic_cast<object::Boolean*>(left), dynamic_cast<object::Boolean*>(right));
     } else if (left->type() == object::STRING_OBJ && right->type() == object::STRING_OBJ) {
         return evalStringInfixExpression(op, dynamic_cast<object::String*>(left), dynamic_cast<object::String*>(right));
+    } else if ((left->type() == object::FLOAT_OBJ || left->type() == object::INTEGER_OBJ) && (right->type() == object::FLOAT_OBJ || right->type() == object::INTEGER_OBJ)) {
+        return evalFloatInfixExpression(op, left, right);
     } else if (left->type() != right->type()) {
         return new object::Error("type mismatch: " + left->type() + " " + op + " " + right->type());
     } else {
@@ -163,16 +499,91 @@ object::Object* evaluator::evalInfixExpression(std::string op, object::Object *l
 }
 
 object::Object* evaluator::evalIntegerInfixExpression(std::string op, object::Integer *left, object::Integer *right) {
-    int leftVal = left->value;
-    int rightVal = right->value;
+    if (left->big != nullptr || right->big != nullptr) {
+        return evalBigIntegerInfixExpression(op, left, right);
+    }
+    int64_t leftVal = left->value;
+    int64_t rightVal = right->value;
+    int64_t result;
     if (op == "+") {
-        return new object::Integer(leftVal + rightVal);
+        if (__builtin_add_overflow(leftVal, rightVal, &result)) {
+            return evalBigIntegerInfixExpression(op, left, right);
+        }
+        return object::Integer::make(result);
     } else if (op == "-") {
-        return new object::Integer(leftVal - rightVal);
+        if (__builtin_sub_overflow(leftVal, rightVal, &result)) {
+            return evalBigIntegerInfixExpression(op, left, right);
+        }
+        return object::Integer::make(result);
     } else if (op == "*") {
-        return new object::Integer(leftVal * rightVal);
+        if (__builtin_mul_overflow(leftVal, rightVal, &result)) {
+            return evalBigIntegerInfixExpression(op, left, right);
+        }
+        return object::Integer::make(result);
     } else if (op == "/") {
-        return new object::Integer(leftVal / rightVal);
+        if (rightVal == 0) {
+            return new object::Error("division by zero");
+        }
+        if (leftVal == INT64_MIN && rightVal == -1) {
+            return evalBigIntegerInfixExpression(op, left, right);
+        }
+        return object::Integer::make(leftVal / rightVal);
+    } else if (op == "<") {
+        return evaluator::nativeBoolToBooleanObject(leftVal < rightVal);
+    } else if (op == ">") {
+        return evaluator::nativeBoolToBooleanObject(leftVal > rightVal);
+    } else if (op == "==") {
+        return evaluator::nativeBoolToBooleanObject(leftVal == rightVal);
+    } else if (op == "!=") {
+        return evaluator::nativeBoolToBooleanObject(leftVal != rightVal);
+    } else {
+        return new object::Error("unknown operator: " + left->type() + " " + op + " " + right->type());
+    }
+}
+
+object::Object* evaluator::evalBigIntegerInfixExpression(std::string op, object::Integer *left, object::Integer *right) {
+    bigint::BigInt leftVal = left->toBig();
+    bigint::BigInt rightVal = right->toBig();
+    if (op == "+") {
+        return object::Integer::fromBig(leftVal + rightVal);
+    } else if (op == "-") {
+        return object::Integer::fromBig(leftVal - rightVal);
+    } else if (op == "*") {
+        return object::Integer::fromBig(leftVal * rightVal);
+    } else if (op == "/") {
+        if (rightVal.isZero()) {
+            return new object::Error("division by zero");
+        }
+        return object::Integer::fromBig(leftVal / rightVal);
+    } else if (op == "<") {
+        return evaluator::nativeBoolToBooleanObject(leftVal.compare(rightVal) < 0);
+    } else if (op == ">") {
+        return evaluator::nativeBoolToBooleanObject(leftVal.compare(rightVal) > 0);
+    } else if (op == "==") {
+        return evaluator::nativeBoolToBooleanObject(leftVal.compare(rightVal) == 0);
+    } else if (op == "!=") {
+        return evaluator::nativeBoolToBooleanObject(leftVal.compare(rightVal) != 0);
+    } else {
+        return new object::Error("unknown operator: " + left->type() + " " + op + " " + right->type());
+    }
+}
+
+object::Object* evaluator::evalFloatInfixExpression(std::string op, object::Object *left, object::Object *right) {
+    object::Float *leftFloat = dynamic_cast<object::Float*>(left);
+    object::Float *rightFloat = dynamic_cast<object::Float*>(right);
+    double leftVal = leftFloat != nullptr ? leftFloat->value : dynamic_cast<object::Integer*>(left)->toDouble();
+    double rightVal = rightFloat != nullptr ? rightFloat->value : dynamic_cast<object::Integer*>(right)->toDouble();
+    if (op == "+") {
+        return new object::Float(leftVal + rightVal);
+    } else if (op == "-") {
+        return new object::Float(leftVal - rightVal);
+    } else if (op == "*") {
+        return new object::Float(leftVal * rightVal);
+    } else if (op == "/") {
+        if (rightVal == 0) {
+            return new object::Error("division by zero");
+        }
+        return new object::Float(leftVal / rightVal);
     } else if (op == "<") {
         return evaluator::nativeBoolToBooleanObject(leftVal < rightVal);
     } else if (op == ">") {
@@ -199,10 +610,249 @@ object::Object* evaluator::evalBooleanInfixExpression(std::string op, object::Bo
 }
 
 object::Object* evaluator::evalStringInfixExpression(std::string op, object::String *left, object::String *right) {
-    if (op != "+") {
+    if (op == "+") {
+        return object::String::concat(left, right);
+    } else if (op == "==") {
+        return evaluator::nativeBoolToBooleanObject(left->equals(right));
+    } else if (op == "!=") {
+        return evaluator::nativeBoolToBooleanObject(!left->equals(right));
+    } else {
         return new object::Error("unknown operator: " + left->type() + " " + op + " " + right->type());
     }
-    return new object::String(left->value + right->value);
+}
+
+Specialization evaluator::specializeInfixExpression(const std::string &op, object::Object *left, object::Object *right) {
+    if (typeid(*left) != typeid(*right)) {
+        return Specialization::GENERIC;
+    }
+    if (typeid(*left) == typeid(object::Integer)) {
+        if (op == "+") {
+            return Specialization::INT_ADD;
+        } else if (op == "-") {
+            return Specialization::INT_SUB;
+        } else if (op == "*") {
+            return Specialization::INT_MUL;
+        } else if (op == "/") {
+            return Specialization::INT_DIV;
+        } else if (op == "<") {
+            return Specialization::INT_LT;
+        } else if (op == ">") {
+            return Specialization::INT_GT;
+        } else if (op == "==") {
+            return Specialization::INT_EQ;
+        } else if (op == "!=") {
+            return Specialization::INT_NOT_EQ;
+        }
+    } else if (typeid(*left) == typeid(object::Boolean)) {
+        if (op == "==") {
+            return Specialization::BOOL_EQ;
+        } else if (op == "!=") {
+            return Specialization::BOOL_NOT_EQ;
+        }
+    } else if (typeid(*left) == typeid(object::String)) {
+        if (op == "+") {
+            return Specialization::STRING_CONCAT;
+        } else if (op == "==") {
+            return Specialization::STRING_EQ;
+        } else if (op == "!=") {
+            return Specialization::STRING_NOT_EQ;
+        }
+    }
+    return Specialization::GENERIC;
+}
+
+object::Object* evaluator::evalSmallIntegerInfixExpression(Specialization specialization, object::Integer *left, object::Integer *right) {
+    if (left->big != nullptr || right->big != nullptr) {
+        return nullptr;
+    }
+    int64_t leftVal = left->value;
+    int64_t rightVal = right->value;
+    int64_t result;
+    switch (specialization) {
+    case Specialization::INT_ADD:
+        return __builtin_add_overflow(leftVal, rightVal, &result) ? nullptr : object::Integer::make(result);
+    case Specialization::INT_SUB:
+        return __builtin_sub_overflow(leftVal, rightVal, &result) ? nullptr : object::Integer::make(result);
+    case Specialization::INT_MUL:
+        return __builtin_mul_overflow(leftVal, rightVal, &result) ? nullptr : object::Integer::make(result);
+    case Specialization::INT_DIV:
+        if (rightVal == 0 || (leftVal == INT64_MIN && rightVal == -1)) {
+            return nullptr;
+        }
+        return object::Integer::make(leftVal / rightVal);
+    case Specialization::INT_LT:
+        return evaluator::nativeBoolToBooleanObject(leftVal < rightVal);
+    case Specialization::INT_GT:
+        return evaluator::nativeBoolToBooleanObject(leftVal > rightVal);
+    case Specialization::INT_EQ:
+        return evaluator::nativeBoolToBooleanObject(leftVal == rightVal);
+    case Specialization::INT_NOT_EQ:
+        return evaluator::nativeBoolToBooleanObject(leftVal != rightVal);
+    default:
+        return nullptr;
+    }
+}
+
+object::Object* evaluator::evalSpecializedInfixExpression(InfixExpression *node, object::Object *left, object::Object *right) {
+    if (scheduler::concurrent()) {
+        // Profiles are shared by every thread running the node; leave them be.
+        return evalInfixExpression(node->op, left, right);
+    }
+    NodeProfile &profile = node->profile;
+    if (profile.specialization == Specialization::UNINITIALIZED) {
+        profile.specialization = specializeInfixExpression(node->op, left, right);
+    }
+    switch (profile.specialization) {
+    case Specialization::GENERIC:
+        return evalInfixExpression(node->op, left, right);
+    case Specialization::INT_ADD:
+    case Specialization::INT_SUB:
+    case Specialization::INT_MUL:
+    case Specialization::INT_DIV:
+    case Specialization::INT_LT:
+    case Specialization::INT_GT:
+    case Specialization::INT_EQ:
+    case Specialization::INT_NOT_EQ:
+        if (profile.proven || (typeid(*left) == typeid(object::Integer) && typeid(*right) == typeid(object::Integer))) {
+            object::Object *result = evalSmallIntegerInfixExpression(profile.specialization, static_cast<object::Integer*>(left), static_cast<object::Integer*>(right));
+            if (result != nullptr) {
+                profile.hits++;
+                return result;
+            }
+            // Still integers, but big, overflowing or dividing by zero: take the slow path this once.
+            profile.misses++;
+            return evalInfixExpression(node->op, left, right);
+        }
+        break;
+    case Specialization::BOOL_EQ:
+    case Specialization::BOOL_NOT_EQ:
+        if (profile.proven || (typeid(*left) == typeid(object::Boolean) && typeid(*right) == typeid(object::Boolean))) {
+            profile.hits++;
+            bool equal = static_cast<object::Boolean*>(left)->value == static_cast<object::Boolean*>(right)->value;
+            return evaluator::nativeBoolToBooleanObject(profile.specialization == Specialization::BOOL_EQ ? equal : !equal);
+        }
+        break;
+    case Specialization::STRING_CONCAT:
+    case Specialization::STRING_EQ:
+    case Specialization::STRING_NOT_EQ:
+        if (profile.proven || (typeid(*left) == typeid(object::String) && typeid(*right) == typeid(object::String))) {
+            profile.hits++;
+            object::String *leftStr = static_cast<object::String*>(left);
+            object::String *rightStr = static_cast<object::String*>(right);
+            if (profile.specialization == Specialization::STRING_CONCAT) {
+                return object::String::concat(leftStr, rightStr);
+            }
+            bool equal = leftStr->equals(rightStr);
+            return evaluator::nativeBoolToBooleanObject(profile.specialization == Specialization::STRING_EQ ? equal : !equal);
+        }
+        break;
+    default:
+        break;
+    }
+    // A guard failed: this node has seen more than one operand type, so stop specializing it.
+    profile.specialization = Specialization::GENERIC;
+    profile.misses++;
+    return evalInfixExpression(node->op, left, right);
+}
+
+object::Object* evaluator::evalSpecializedPrefixExpression(PrefixExpression *node, object::Object *right) {
+    if (scheduler::concurrent()) {
+        return evalPrefixExpression(node->op, right);
+    }
+    NodeProfile &profile = node->profile;
+    if (profile.specialization == Specialization::UNINITIALIZED) {
+        if (node->op == "-" && typeid(*right) == typeid(object::Integer)) {
+            profile.specialization = Specialization::INT_NEGATE;
+        } else if (node->op == "!" && typeid(*right) == typeid(object::Boolean)) {
+            profile.specialization = Specialization::BOOL_NOT;
+        } else {
+            profile.specialization = Specialization::GENERIC;
+        }
+    }
+    switch (profile.specialization) {
+    case Specialization::GENERIC:
+        return evalPrefixExpression(node->op, right);
+    case Specialization::INT_NEGATE:
+        if (profile.proven || typeid(*right) == typeid(object::Integer)) {
+            object::Integer *integer = static_cast<object::Integer*>(right);
+            if (integer->big == nullptr && integer->value != INT64_MIN) {
+                profile.hits++;
+                return object::Integer::make(-integer->value);
+            }
+            profile.misses++;
+            return evalPrefixExpression(node->op, right);
+        }
+        break;
+    case Specialization::BOOL_NOT:
+        if (profile.proven || typeid(*right) == typeid(object::Boolean)) {
+            profile.hits++;
+            return static_cast<object::Boolean*>(right)->value ? evaluator::FALSE : evaluator::TRUE;
+        }
+        break;
+    default:
+        break;
+    }
+    profile.specialization = Specialization::GENERIC;
+    profile.misses++;
+    return evalPrefixExpression(node->op, right);
+}
+
+object::Object* evaluator::evalSpecializedIndexExpression(IndexExpression *node, object::Object *left, object::Object *index) {
+    if (scheduler::concurrent()) {
+        return evalIndexExpression(left, index);
+    }
+    NodeProfile &profile = node->profile;
+    if (profile.specialization == Specialization::UNINITIALIZED) {
+        if (typeid(*left) == typeid(object::Array) && typeid(*index) == typeid(object::Integer)) {
+            profile.specialization = Specialization::ARRAY_INDEX;
+        } else if (typeid(*left) == typeid(object::Hash)) {
+            profile.specialization = Specialization::HASH_INDEX;
+        } else {
+            profile.specialization = Specialization::GENERIC;
+        }
+    }
+    switch (profile.specialization) {
+    case Specialization::GENERIC:
+        return evalIndexExpression(left, index);
+    case Specialization::ARRAY_INDEX:
+        if (profile.proven || (typeid(*left) == typeid(object::Array) && typeid(*index) == typeid(object::Integer))) {
+            profile.hits++;
+            return evalArrayIndexExpression(static_cast<object::Array*>(left), static_cast<object::Integer*>(index));
+        }
+        break;
+    case Specialization::HASH_INDEX:
+        if (profile.proven || typeid(*left) == typeid(object::Hash)) {
+            profile.hits++;
+            return evalHashIndexExpression(node->cache, static_cast<object::Hash*>(left), index);
+        }
+        break;
+    default:
+        break;
+    }
+    profile.specialization = Specialization::GENERIC;
+    profile.misses++;
+    return evalIndexExpression(left, index);
+}
+
+std::string evaluator::dumpSpecializations(Node *root) {
+    std::string out;
+    analysis::walk(root, [&](Node *node) {
+        NodeProfile *profile = nullptr;
+        std::string type = node->type();
+        if (type == "InfixExpression") {
+            profile = &dynamic_cast<InfixExpression*>(node)->profile;
+        } else if (type == "PrefixExpression") {
+            profile = &dynamic_cast<PrefixExpression*>(node)->profile;
+        } else if (type == "IndexExpression") {
+            profile = &dynamic_cast<IndexExpression*>(node)->profile;
+        }
+        if (profile != nullptr && profile->specialization != Specialization::UNINITIALIZED) {
+            out += node->string() + ": " + specializationName(profile->specialization);
+            out += " hits=" + std::to_string(profile->hits) + " misses=" + std::to_string(profile->misses) + "\n";
+        }
+        return true;
+    });
+    return out;
 }
 
 object::Object* evaluator::evalIfExpression(IfExpression *ie, object::Environment *env) {
@@ -210,7 +860,9 @@ object::Object* evaluator::evalIfExpression(IfExpression *ie, object::Environmen
     if (condition->type() == object::ERROR_OBJ) {
         return condition;
     }
-    if (evaluator::isTruthy(condition)) {
+    // A condition proven boolean is one of the two singletons.
+    bool truthy = ie->condition->staticType == StaticType::BOOLEAN ? condition == evaluator::TRUE : evaluator::isTruthy(condition);
+    if (truthy) {
         return evaluator::eval(ie->consequence, env);
     } else if (ie->alternative != nullptr) {
         return evaluator::eval(ie->alternative, env);
@@ -219,9 +871,280 @@ object::Object* evaluator::evalIfExpression(IfExpression *ie, object::Environmen
     }
 }
 
+object::Object* evaluator::evalMatchExpression(MatchExpression *node, object::Environment *env) {
+    object::Object *subject = eval(node->subject, env);
+    if (evaluator::isError(subject)) {
+        return subject;
+    }
+    Node *body = node->otherwise;
+    if (matchTable(node) != nullptr) {
+        int arm = selectArm(node, subject);
+        if (arm >= 0) {
+            body = node->arms[arm].body;
+        }
+    } else {
+        for (auto &arm : node->arms) {
+            object::Object *pattern = eval(arm.pattern, env);
+            if (evaluator::isError(pattern)) {
+                return pattern;
+            }
+            if (matchEquals(subject, pattern)) {
+                body = arm.body;
+                break;
+            }
+        }
+    }
+    if (body == nullptr) {
+        return evaluator::NULLobj;
+    }
+    return eval(body, env);
+}
+
+// Literal patterns have no side effects, so skipping straight to the arm
+// that matches cannot change what the program observes.
+static bool integerPattern(Expression *pattern, int64_t &value) {
+    IntegerLiteral *literal = dynamic_cast<IntegerLiteral*>(pattern);
+    if (literal != nullptr) {
+        value = literal->value;
+        return !literal->big;
+    }
+    PrefixExpression *prefix = dynamic_cast<PrefixExpression*>(pattern);
+    if (prefix != nullptr && prefix->op == "-" && integerPattern(prefix->right, value) && value != INT64_MIN) {
+        value = -value;
+        return true;
+    }
+    return false;
+}
+
+MatchTable* evaluator::matchTable(MatchExpression *node) {
+    if (node->tableBuilt) {
+        return node->table;
+    }
+    if (scheduler::concurrent()) {
+        // Compare in order until a single-threaded run builds the table.
+        return nullptr;
+    }
+    node->tableBuilt = true;
+    MatchTable *table = new MatchTable();
+    int64_t min = INT64_MAX, max = INT64_MIN;
+    for (size_t i = 0; i < node->arms.size(); i++) {
+        int64_t value;
+        StringLiteral *str = dynamic_cast<StringLiteral*>(node->arms[i].pattern);
+        if (integerPattern(node->arms[i].pattern, value)) {
+            table->integers.insert({value, i});
+            min = std::min(min, value);
+            max = std::max(max, value);
+        } else if (str != nullptr) {
+            auto found = table->strings.find(str->symbol->hash);
+            if (found != table->strings.end() && dynamic_cast<StringLiteral*>(node->arms[found->second].pattern)->symbol != str->symbol) {
+                // Two patterns share a hash; compare them in order instead.
+                delete table;
+                return nullptr;
+            }
+            table->strings.insert({str->symbol->hash, i});
+        } else {
+            delete table;
+            return nullptr;
+        }
+    }
+    // A dense table wastes at most three empty slots per pattern.
+    if (!table->integers.empty() && (uint64_t) max - (uint64_t) min < 4 * table->integers.size()) {
+        table->base = min;
+        table->dense.assign(max - min + 1, -1);
+        for (auto &entry : table->integers) {
+            table->dense[entry.first - min] = entry.second;
+        }
+        table->integers.clear();
+    }
+    node->table = table;
+    return table;
+}
+
+int evaluator::selectArm(MatchExpression *node, object::Object *subject) {
+    MatchTable *table = node->table;
+    const std::type_info &type = typeid(*subject);
+    if (type == typeid(object::Integer)) {
+        object::Integer *integer = static_cast<object::Integer*>(subject);
+        if (integer->big != nullptr) {
+            return -1;
+        }
+        if (!table->dense.empty()) {
+            uint64_t offset = (uint64_t) integer->value - (uint64_t) table->base;
+            return offset < table->dense.size() ? table->dense[offset] : -1;
+        }
+        auto found = table->integers.find(integer->value);
+        return found != table->integers.end() ? (int) found->second : -1;
+    } else if (type == typeid(object::String) && !table->strings.empty()) {
+        object::String *str = static_cast<object::String*>(subject);
+        auto found = table->strings.find(str->hash_value());
+        if (found == table->strings.end()) {
+            return -1;
+        }
+        const intern::Symbol *pattern = dynamic_cast<StringLiteral*>(node->arms[found->second].pattern)->symbol;
+        if (str->symbol == pattern || (str->symbol == nullptr && str->length == pattern->value.size() && memcmp(str->data(), pattern->value.data(), str->length) == 0)) {
+            return found->second;
+        }
+    }
+    return -1;
+}
+
+bool evaluator::matchEquals(object::Object *subject, object::Object *pattern) {
+    if (subject == pattern) {
+        return true;
+    }
+    const std::type_info &type = typeid(*subject);
+    if (type != typeid(*pattern)) {
+        return false;
+    }
+    if (type == typeid(object::Integer)) {
+        object::Integer *left = static_cast<object::Integer*>(subject);
+        object::Integer *right = static_cast<object::Integer*>(pattern);
+        if (left->big == nullptr && right->big == nullptr) {
+            return left->value == right->value;
+        }
+        return left->toBig().compare(right->toBig()) == 0;
+    } else if (type == typeid(object::Float)) {
+        return static_cast<object::Float*>(subject)->value == static_cast<object::Float*>(pattern)->value;
+    } else if (type == typeid(object::String)) {
+        return static_cast<object::String*>(subject)->equals(static_cast<object::String*>(pattern));
+    }
+    return false;
+}
+
+object::Object* evaluator::evalWhileStatement(WhileStatement *node, object::Environment *env) {
+    object::Environment *scope = env->newEnclosedEnvironment();
+    bool boolean = node->condition->staticType == StaticType::BOOLEAN;
+    while (true) {
+        object::Object *condition = evaluator::eval(node->condition, env);
+        if (evaluator::isError(condition)) {
+            return condition;
+        }
+        if (!(boolean ? condition == evaluator::TRUE : evaluator::isTruthy(condition))) {
+            break;
+        }
+        evaluator::resetLoopScope(scope, nullptr, nullptr);
+        object::Object *result = evaluator::eval(node->body, scope);
+        if (result == evaluator::BREAK) {
+            break;
+        } else if (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ) {
+            return result;
+        }
+    }
+    return evaluator::NULLobj;
+}
+
+object::Object* evaluator::evalForStatement(ForStatement *node, object::Environment *env) {
+    object::Object *iterable = evaluator::eval(node->iterable, env);
+    if (evaluator::isError(iterable)) {
+        return iterable;
+    }
+    object::Environment *scope = env->newEnclosedEnvironment();
+    const intern::Symbol *variable = node->variable->symbol;
+    if (node->end != nullptr) {
+        object::Object *end = evaluator::eval(node->end, env);
+        if (evaluator::isError(end)) {
+            return end;
+        }
+        int64_t from, to;
+        object::Object *invalid = evaluator::evalRangeBounds(iterable, end, from, to);
+        if (invalid != nullptr) {
+            return invalid;
+        }
+        for (int64_t i = from; i < to; i++) {
+            evaluator::resetLoopScope(scope, variable, object::Integer::make(i));
+            object::Object *result = evaluator::eval(node->body, scope);
+            if (result == evaluator::BREAK) {
+                break;
+            } else if (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ) {
+                return result;
+            }
+        }
+        return evaluator::NULLobj;
+    }
+    object::Object *invalid = evaluator::checkIterable(iterable);
+    if (invalid != nullptr) {
+        return invalid;
+    }
+    if (typeid(*iterable) != typeid(object::Array)) {
+        iterator::Iterator *it = iterator::of(iterable);
+        for (object::Object *value = it->pull(); value != nullptr; value = it->pull()) {
+            if (evaluator::isError(value)) {
+                return value;
+            }
+            evaluator::resetLoopScope(scope, variable, value);
+            object::Object *result = evaluator::eval(node->body, scope);
+            if (result == evaluator::BREAK) {
+                break;
+            } else if (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ) {
+                return result;
+            }
+        }
+        return evaluator::NULLobj;
+    }
+    // Indexed rather than through iterators, so the loop stays valid if the
+    // body grows the array.
+    object::Array *array = static_cast<object::Array*>(iterable);
+    for (size_t i = 0; i < array->elements.size(); i++) {
+        evaluator::resetLoopScope(scope, variable, array->elements[i]);
+        object::Object *result = evaluator::eval(node->body, scope);
+        if (result == evaluator::BREAK) {
+            break;
+        } else if (result->type() == object::RETURN_VALUE_OBJ || result->type() == object::ERROR_OBJ) {
+            return result;
+        }
+    }
+    return evaluator::NULLobj;
+}
+
+void evaluator::resetLoopScope(object::Environment *&scope, const intern::Symbol *variable, object::Object *value) {
+    if (scope->escaped) {
+        scope = scope->outer->newEnclosedEnvironment();
+        if (variable != nullptr) {
+            scope->store->insert({variable, value});
+        }
+        return;
+    }
+    std::map<const intern::Symbol*, object::Object*> *store = scope->store;
+    if (variable == nullptr) {
+        if (!store->empty()) {
+            store->clear();
+        }
+    } else if (store->size() == 1) {
+        // Only the loop variable: a let of the same name never replaces it.
+        store->begin()->second = value;
+    } else {
+        store->clear();
+        store->insert({variable, value});
+    }
+}
+
+object::Object* evaluator::evalRangeBounds(object::Object *start, object::Object *end, int64_t &from, int64_t &to) {
+    if (typeid(*start) != typeid(object::Integer) || typeid(*end) != typeid(object::Integer)) {
+        return new object::Error("range bounds must be INTEGER, got " + start->type() + ".." + end->type());
+    }
+    object::Integer *first = static_cast<object::Integer*>(start);
+    object::Integer *last = static_cast<object::Integer*>(end);
+    if (first->big != nullptr || last->big != nullptr) {
+        return new object::Error("range bounds out of range: " + first->inspect() + ".." + last->inspect());
+    }
+    from = first->value;
+    to = last->value;
+    return nullptr;
+}
+
+object::Object* evaluator::checkIterable(object::Object *iterable) {
+    const std::type_info &type = typeid(*iterable);
+    if (type != typeid(object::Array) && type != typeid(object::PackedArray) && type != typeid(generator::Generator) && type != typeid(iterator::Iterator)) {
+        return new object::Error("cannot iterate over " + iterable->type());
+    }
+    return nullptr;
+}
+
 object::Object* evaluator::evalIndexExpression(object::Object *left, object::Object *index) {
     if (left->type() == object::ARRAY_OBJ && index->type() == object::INTEGER_OBJ) {
         return evalArrayIndexExpression(dynamic_cast<object::Array*>(left), dynamic_cast<object::Integer*>(index));
+    } else if (typeid(*left) == typeid(object::PackedArray) && index->type() == object::INTEGER_OBJ) {
+        return evalArrayIndexExpression(static_cast<object::PackedArray*>(left), dynamic_cast<object::Integer*>(index));
     } else if (left->type() == object::HASH_OBJ) {
         return evalHashIndexExpression(dynamic_cast<object::Hash*>(left), index);
     } else {
@@ -230,39 +1153,224 @@ object::Object* evaluator::evalIndexExpression(object::Object *left, object::Obj
 }
 
 object::Object* evaluator::evalArrayIndexExpression(object::Array *array, object::Integer *index) {
-    int idx = index->value;
-    int max = array->elements.size() - 1;
+    int64_t idx = index->value;
+    int64_t max = array->elements.size() - 1;
     if (idx < 0 || idx > max) {
         return evaluator::NULLobj;
     }
     return array->elements[idx];
 }
 
+object::Object* evaluator::evalArrayIndexExpression(object::PackedArray *array, object::Integer *index) {
+    int64_t idx = index->value;
+    int64_t max = array->size() - 1;
+    if (idx < 0 || idx > max) {
+        return evaluator::NULLobj;
+    }
+    return array->at(idx);
+}
+
 object::Object* evaluator::evalHashIndexExpression(object::Hash *hash, object::Object *index) {
     if (!index->hashable()) {
         return new object::Error("unusable as hash key: " + index->type());
     }
-    auto pair = hash->pairs.find(index->hash_key());
-    if (pair == hash->pairs.end()) {
-        return evaluator::NULLobj;
+    object::Object *value = hash->get(index);
+    return value != nullptr ? value : evaluator::NULLobj;
+}
+
+object::Object* evaluator::evalHashIndexExpression(ShapeCache &cache, object::Hash *hash, object::Object *index) {
+    if (hash->shape != nullptr && hash->shape == cache.shape && index == cache.key) {
+        return hash->values[cache.slot];
+    }
+    object::String *key = dynamic_cast<object::String*>(index);
+    if (hash->shape != nullptr && key != nullptr && key->symbol != nullptr) {
+        int64_t slot = hash->shape->slot(key->hash_value());
+        if (slot >= 0) {
+            cache = {hash->shape, key, static_cast<size_t>(slot)};
+            return hash->values[slot];
+        }
+    }
+    return evalHashIndexExpression(hash, index);
+}
+
+object::Object* evaluator::evalAssignExpression(AssignExpression *node, object::Environment *env) {
+    if (node->target->type() == "Identifier") {
+        object::Object *value = eval(node->value, env);
+        if (evaluator::isError(value)) {
+            return value;
+        }
+        return evalAssignment(dynamic_cast<Identifier*>(node->target)->symbol, value, env);
+    }
+    IndexExpression *target = dynamic_cast<IndexExpression*>(node->target);
+    object::Object *left = eval(target->left, env);
+    if (evaluator::isError(left)) {
+        return left;
+    }
+    object::Object *index = eval(target->index, env);
+    if (evaluator::isError(index)) {
+        return index;
+    }
+    object::Object *value = eval(node->value, env);
+    if (evaluator::isError(value)) {
+        return value;
+    }
+    return evalIndexAssignment(left, index, value);
+}
+
+object::Object* evaluator::evalAssignment(const intern::Symbol *name, object::Object *value, object::Environment *env) {
+    if (env->assign(name, value) == nullptr) {
+        return new object::Error("identifier not found: " + name->value);
+    }
+    return value;
+}
+
+object::Object* evaluator::evalIndexAssignment(object::Object *left, object::Object *index, object::Object *value) {
+    if (typeid(*left) == typeid(object::Array)) {
+        object::Array *array = dynamic_cast<object::Array*>(left);
+        if (typeid(*index) != typeid(object::Integer)) {
+            return new object::Error("array index must be INTEGER, got " + index->type());
+        }
+        object::Integer *idx = dynamic_cast<object::Integer*>(index);
+        int64_t size = array->elements.size();
+        if (idx->big != nullptr || idx->value < 0 || idx->value > size) {
+            return new object::Error("index out of range: " + idx->inspect() + " (length " + std::to_string(size) + ")");
+        }
+        if (idx->value == size) {
+            array->elements.push_back(value);
+        } else {
+            array->elements[idx->value] = value;
+        }
+        return value;
+    } else if (typeid(*left) == typeid(object::PackedArray)) {
+        object::PackedArray *array = static_cast<object::PackedArray*>(left);
+        if (typeid(*index) != typeid(object::Integer)) {
+            return new object::Error("array index must be INTEGER, got " + index->type());
+        }
+        object::Integer *idx = static_cast<object::Integer*>(index);
+        int64_t size = array->size();
+        if (idx->big != nullptr || idx->value < 0 || idx->value > size) {
+            return new object::Error("index out of range: " + idx->inspect() + " (length " + std::to_string(size) + ")");
+        }
+        return array->store(idx->value, value);
+    } else if (typeid(*left) == typeid(object::Hash)) {
+        if (!index->hashable()) {
+            return new object::Error("unusable as hash key: " + index->type());
+        }
+        static_cast<object::Hash*>(left)->set(index, value);
+        return value;
     }
-    return pair->second->value;
+    return new object::Error("index assignment not supported: " + left->type());
 }
 
 object::Object* evaluator::evalIdentifier(Identifier *node, object::Environment *env) {
-    object::Object *val = env->get(node->value);
+    object::Object *val = lookup(node, env);
     if (val != nullptr) {
         return val;
     }
-    if (evaluator::builtins.find(node->value) != evaluator::builtins.end()) {
-        return evaluator::builtins[node->value];
-    }
     return new object::Error("identifier not found: " + node->value);
 }
 
+object::Object* evaluator::lookup(Identifier *node, object::Environment *env) {
+    object::Environment *globals = env->globals();
+    if (!scheduler::concurrent()) {
+        // Only names that no scope but the global one can bind are cached.
+        // A node's own program was counted before it ran, and local
+        // bindings in later programs cannot shadow it.
+        GlobalCache &cache = node->cache;
+        if (cache.globals == globals && cache.version == globals->version) {
+            return cache.value;
+        }
+    }
+    if (globals->counts().localBindings(node->symbol) > 0 || scheduler::concurrent()) {
+        object::Object *val = env->get(node->symbol);
+        if (val != nullptr) {
+            return val;
+        }
+        auto builtin = evaluator::builtins.find(node->value);
+        return builtin != evaluator::builtins.end() ? builtin->second : nullptr;
+    }
+    // No scope but the global one can bind the name, so only that one is
+    // searched, and only when it has changed since the last time.
+    GlobalCache &cache = node->cache;
+    object::Object *val = nullptr;
+    auto found = globals->store->find(node->symbol);
+    if (found != globals->store->end()) {
+        val = found->second;
+    } else {
+        auto builtin = evaluator::builtins.find(node->value);
+        val = builtin != evaluator::builtins.end() ? builtin->second : nullptr;
+    }
+    if (val != nullptr) {
+        cache = {globals, globals->version, val};
+    }
+    return val;
+}
+
+object::Object* evaluator::evalFunctionLiteral(FunctionLiteral *node, object::Environment *env) {
+    analysis::analyseFunction(node);
+    object::Environment *globals = env->globals();
+    object::Environment *captured = new object::Environment();
+    captured->captured = true;
+    captured->outer = globals;
+    for (auto name : node->freeVariables) {
+        // Find the scope that binds name. Captured scopes never change, and a call
+        // scope can only gain names its function lets, so anything found before
+        // reaching a scope that might still bind name can be copied now.
+        for (object::Environment *scope = env; scope != globals; scope = scope->outer) {
+            auto found = scope->store->find(name);
+            if (found != scope->store->end()) {
+                if (globals->counts().assignments(name) > 0) {
+                    // The binding may still be assigned, so read it through the
+                    // defining scope rather than copying its current value.
+                    captured->outer = env;
+                } else {
+                    captured->set(name, found->second);
+                }
+                break;
+            }
+            if (!scope->captured && (scope->function == nullptr || scope->function->locals.count(name) > 0)) {
+                // Not bound yet: fall back to resolving through the defining scope at call time.
+                captured->outer = env;
+                break;
+            }
+        }
+    }
+    if (captured->outer != globals) {
+        // Loops must give later iterations a scope of their own.
+        for (object::Environment *scope = env; scope != globals && !scope->escaped; scope = scope->outer) {
+            scope->escaped = true;
+        }
+    }
+    if (captured->store->empty() && captured->outer == globals) {
+        if (node->hoisted == nullptr || node->hoistedGlobals != globals) {
+            object::Function *fn = new object::Function(&node->parameters, node->body, globals, node);
+            if (scheduler::concurrent()) {
+                return fn;
+            }
+            node->hoisted = fn;
+            node->hoistedGlobals = globals;
+        }
+        return node->hoisted;
+    }
+    return new object::Function(&node->parameters, node->body, captured, node);
+}
+
 object::Object* evaluator::applyFunction(object::Object *fn, std::vector<object::Object*> args) {
     if (fn->type() == object::FUNCTION_OBJ) {
         object::Function *function = dynamic_cast<object::Function*>(fn);
+        if (function->literal != nullptr && function->literal->generator) {
+            object::Environment *extendedEnv = extendFunctionEnv(function, args);
+            return new generator::Generator([function, extendedEnv] {
+                return unwrapReturnValue(evaluator::eval(function->body, extendedEnv));
+            });
+        }
+        if (generator::overflowing()) {
+            return new object::Error("stack overflow in generator");
+        }
+        object::Object *native = jit::tryCall(function, args);
+        if (native != nullptr) {
+            return native;
+        }
         object::Environment *extendedEnv = extendFunctionEnv(function, args);
         object::Object *evaluated = evaluator::eval(function->body, extendedEnv);
         return unwrapReturnValue(evaluated);
@@ -275,8 +1383,9 @@ object::Object* evaluator::applyFunction(object::Object *fn, std::vector<object:
 
 object::Environment* evaluator::extendFunctionEnv(object::Function *fn, std::vector<object::Object*> args) {
     object::Environment *env = fn->env->newEnclosedEnvironment();
+    env->function = fn->literal;
     for (int i = 0; i < fn->parameters->size(); i++) {
-        env->set(fn->parameters->at(i)->value, args[i]);
+        env->set(fn->parameters->at(i)->symbol, args[i]);
     }
     return env;
 }
@@ -289,6 +1398,17 @@ object::Object* evaluator::unwrapReturnValue(object::Object *obj) {
 }
 
 object::Object* evaluator::evalHashLiteral(HashLiteral *node, object::Environment *env) {
+    if (node->shape != nullptr) {
+        std::vector<object::Object*> values(node->shape->keys.size());
+        for (auto pair : node->pairs) {
+            object::Object *value = evaluator::eval(pair.second, env);
+            if (evaluator::isError(value)) {
+                return value;
+            }
+            values[node->shape->slot(static_cast<StringLiteral*>(pair.first)->symbol->hash)] = value;
+        }
+        return new object::Hash(node->shape, values);
+    }
     std::map<object::Object*, object::Object*> pairs;
     for (auto pair : node->pairs) {
         object::Object *key = evaluator::eval(pair.first, env);
@@ -307,6 +1427,10 @@ object::Object* evaluator::evalHashLiteral(HashLiteral *node, object::Environmen
     return new object::Hash(pairs);
 }
 
+bool evaluator::isLoopControl(object::Object *obj) {
+    return obj == evaluator::BREAK || obj == evaluator::CONTINUE;
+}
+
 bool evaluator::isTruthy(object::Object *obj) {
     if (obj == evaluator::NULLobj) {
         return false;
@@ -0,0 +1,181 @@
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "generator.hh"
+#include "evaluator.hh"
+
+// ThreadSanitizer tracks each stack as a fiber; without telling it about the
+// switches it takes the coroutine's accesses for another thread's.
+#if defined(__SANITIZE_THREAD__)
+#define WFI_TSAN_FIBERS 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define WFI_TSAN_FIBERS 1
+#endif
+#endif
+
+#ifdef WFI_TSAN_FIBERS
+extern "C" {
+    void* __tsan_get_current_fiber();
+    void* __tsan_create_fiber(unsigned flags);
+    void __tsan_destroy_fiber(void *fiber);
+    void __tsan_switch_to_fiber(void *fiber, unsigned flags);
+}
+#endif
+
+namespace {
+    // The generator whose body this thread is running, innermost first.
+    thread_local generator::Generator *current = nullptr;
+
+    // Stacks of generators whose bodies have ended or that were freed, and
+    // those of new arenas not handed out yet.
+    std::mutex stacksLock;
+    std::vector<char*> freeStacks;
+    size_t mapped = 0;
+
+    // Returns a stack from an arena, mapping a new arena when none is free.
+    // A guard page per stack would split the arena into a mapping per
+    // stack, so only the arena's lowest stack has one; overflows are caught
+    // by the engines' checks instead.
+    char* takeStack() {
+        std::lock_guard<std::mutex> guard(stacksLock);
+        if (freeStacks.empty()) {
+            size_t page = sysconf(_SC_PAGESIZE);
+            void *memory = mmap(nullptr, page + generator::STACK_SIZE * generator::ARENA_STACKS, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (memory == MAP_FAILED) {
+                return nullptr;
+            }
+            mprotect(memory, page, PROT_NONE);
+            char *arena = static_cast<char*>(memory) + page;
+            mapped += generator::ARENA_STACKS;
+            for (size_t i = generator::ARENA_STACKS; i > 0; i--) {
+                freeStacks.push_back(arena + (i - 1) * generator::STACK_SIZE);
+            }
+        }
+        char *stack = freeStacks.back();
+        freeStacks.pop_back();
+        return stack;
+    }
+
+    // Pages below the margin were only touched by deep calls, so they go back
+    // to the system rather than staying with the stack while it is free.
+    void giveStack(char *stack) {
+        madvise(stack, generator::STACK_SIZE - generator::STACK_MARGIN, MADV_DONTNEED);
+        std::lock_guard<std::mutex> guard(stacksLock);
+        freeStacks.push_back(stack);
+    }
+
+#ifdef WFI_TSAN_FIBERS
+    void switchFiber(void *fiber) {
+        __tsan_switch_to_fiber(fiber, 0);
+    }
+#else
+    void switchFiber(void *) {}
+#endif
+} // namespace
+
+generator::Generator::Generator(std::function<object::Object*()> body) : body(body), stack(nullptr), fiber(nullptr), callerFiber(nullptr), running(false), finished(false), value(nullptr) {}
+
+generator::Generator::~Generator() {
+    if (stack != nullptr) {
+        giveStack(stack);
+#ifdef WFI_TSAN_FIBERS
+        __tsan_destroy_fiber(fiber);
+#endif
+    }
+}
+
+ObjectType generator::Generator::type() {
+    return object::GENERATOR_OBJ;
+}
+
+std::string generator::Generator::inspect() {
+    return finished ? "generator(done)" : "generator";
+}
+
+bool generator::Generator::done() {
+    return finished;
+}
+
+// Entry point of every body; runs on the generator's own stack.
+void generator::Generator::start() {
+    Generator *self = current;
+    object::Object *result = self->body();
+    self->value = evaluator::isError(result) ? result : nullptr;
+    self->finished = true;
+    switchFiber(self->callerFiber);
+    swapcontext(&self->context, &self->caller);
+}
+
+object::Object* generator::Generator::resume() {
+    if (running.exchange(true)) {
+        return new object::Error("generator is already running");
+    }
+    if (finished) {
+        running = false;
+        return nullptr;
+    }
+    if (stack == nullptr) {
+        stack = takeStack();
+        if (stack == nullptr) {
+            running = false;
+            return new object::Error("cannot allocate a generator stack");
+        }
+        getcontext(&context);
+        context.uc_stack.ss_sp = stack;
+        context.uc_stack.ss_size = STACK_SIZE;
+        context.uc_link = nullptr;
+        makecontext(&context, &Generator::start, 0);
+#ifdef WFI_TSAN_FIBERS
+        fiber = __tsan_create_fiber(0);
+#endif
+    }
+    Generator *outer = current;
+    current = this;
+#ifdef WFI_TSAN_FIBERS
+    callerFiber = __tsan_get_current_fiber();
+#endif
+    switchFiber(fiber);
+    swapcontext(&caller, &context);
+    current = outer;
+    object::Object *result = value;
+    value = nullptr;
+    if (finished) {
+        giveStack(stack);
+        stack = nullptr;
+#ifdef WFI_TSAN_FIBERS
+        __tsan_destroy_fiber(fiber);
+#endif
+        fiber = nullptr;
+    }
+    running = false;
+    return result;
+}
+
+object::Object* generator::yield(object::Object *value) {
+    Generator *self = current;
+    if (self == nullptr) {
+        return new object::Error("yield outside of a generator");
+    }
+    self->value = value;
+    // Whoever resumes next may be on another thread, so nothing read from
+    // thread-local storage before the switch is used after it.
+    switchFiber(self->callerFiber);
+    swapcontext(&self->context, &self->caller);
+    return evaluator::NULLobj;
+}
+
+bool generator::running() {
+    return current != nullptr;
+}
+
+bool generator::overflowing() {
+    Generator *self = current;
+    char here;
+    return self != nullptr && &here < self->stack + STACK_MARGIN;
+}
+
+size_t generator::mappedStacks() {
+    std::lock_guard<std::mutex> guard(stacksLock);
+    return mapped;
+}
@@ -0,0 +1,448 @@
+#include <map>
+#include <set>
+#include "inliner.hh"
+#include "analysis.hh"
+#include "evaluator.hh"
+
+bool inliner::enabled = true;
+
+namespace {
+    typedef std::map<const intern::Symbol*, Expression*> substitution_t;
+
+    struct Candidate {
+        FunctionLiteral *literal;
+        Expression *body;
+        // Names the body reads other than its parameters.
+        std::set<const intern::Symbol*> freeNames;
+    };
+
+    // Names a call site can see and how they are bound there.
+    struct Scope {
+        // Names that always resolve without an error.
+        std::set<const intern::Symbol*> bound;
+        // Parameters and lets of the enclosing functions.
+        std::set<const intern::Symbol*> shadowed;
+    };
+
+    // Every InlinedCall created for the programs of one global scope, and the
+    // scope's count of assignments when they were last checked against it.
+    struct Sites {
+        std::vector<InlinedCall*> calls;
+        size_t checkedAssignments = 0;
+    };
+    // Per global scope, run by one thread like the programs of an isolate.
+    thread_local std::map<object::Environment*, Sites> recorded;
+
+    // Whether exp may appear in an inlined body. Anything that binds or
+    // assigns a name (lets, assignments, parameters of a nested literal, loop
+    // scopes) or leaves the function early (return) would behave differently
+    // in the caller. Matches are left alone as clone cannot copy them.
+    bool inlinable(Node *node) {
+        bool ok = true;
+        analysis::walk(node, [&](Node *n) {
+            std::string type = n->type();
+            if (type == "FunctionLiteral" || type == "LetStatement" || type == "ReturnStatement" || type == "WhileStatement" || type == "ForStatement" || type == "AssignExpression" || type == "MatchExpression") {
+                ok = false;
+            }
+            return ok;
+        });
+        return ok;
+    }
+
+    size_t countNodes(Node *node) {
+        size_t count = 0;
+        analysis::walk(node, [&](Node *) {
+            count++;
+            return true;
+        });
+        return count;
+    }
+
+    Expression* clone(Expression *exp, const substitution_t &substitution, Sites &sites);
+
+    BlockStatement* cloneBlock(BlockStatement *block, const substitution_t &substitution, Sites &sites) {
+        if (block == nullptr) {
+            return nullptr;
+        }
+        BlockStatement *out = new BlockStatement(block->token);
+        for (auto stmt : *block->statements) {
+            ExpressionStatement *es = dynamic_cast<ExpressionStatement*>(stmt);
+            out->statements->push_back(new ExpressionStatement(es->token, clone(es->expression, substitution, sites)));
+        }
+        return out;
+    }
+
+    Expression* clone(Expression *exp, const substitution_t &substitution, Sites &sites) {
+        std::string type = exp->type();
+        if (type == "Identifier") {
+            auto found = substitution.find(dynamic_cast<Identifier*>(exp)->symbol);
+            if (found != substitution.end()) {
+                return clone(found->second, {}, sites);
+            }
+            Identifier *ident = dynamic_cast<Identifier*>(exp);
+            return new Identifier(ident->token, ident->value);
+        } else if (type == "IntegerLiteral") {
+            IntegerLiteral *literal = dynamic_cast<IntegerLiteral*>(exp);
+            return new IntegerLiteral(literal->token, literal->value, literal->big);
+        } else if (type == "FloatLiteral") {
+            FloatLiteral *literal = dynamic_cast<FloatLiteral*>(exp);
+            return new FloatLiteral(literal->token, literal->value);
+        } else if (type == "Boolean") {
+            Boolean *boolean = dynamic_cast<Boolean*>(exp);
+            return new Boolean(boolean->token, boolean->value);
+        } else if (type == "StringLiteral") {
+            StringLiteral *str = dynamic_cast<StringLiteral*>(exp);
+            return new StringLiteral(str->token, str->value);
+        } else if (type == "PrefixExpression") {
+            PrefixExpression *prefix = dynamic_cast<PrefixExpression*>(exp);
+            PrefixExpression *out = new PrefixExpression(prefix->token, prefix->op);
+            out->right = clone(prefix->right, substitution, sites);
+            return out;
+        } else if (type == "InfixExpression") {
+            InfixExpression *infix = dynamic_cast<InfixExpression*>(exp);
+            InfixExpression *out = new InfixExpression(infix->token, infix->op, clone(infix->left, substitution, sites));
+            out->right = clone(infix->right, substitution, sites);
+            return out;
+        } else if (type == "IfExpression") {
+            IfExpression *ie = dynamic_cast<IfExpression*>(exp);
+            IfExpression *out = new IfExpression(ie->token);
+            out->condition = clone(ie->condition, substitution, sites);
+            out->consequence = cloneBlock(ie->consequence, substitution, sites);
+            out->alternative = cloneBlock(ie->alternative, substitution, sites);
+            return out;
+        } else if (type == "CallExpression") {
+            CallExpression *call = dynamic_cast<CallExpression*>(exp);
+            CallExpression *out = new CallExpression(call->token, clone(call->function, substitution, sites));
+            for (auto arg : call->arguments) {
+                out->arguments.push_back(clone(arg, substitution, sites));
+            }
+            return out;
+        } else if (type == "InlinedCall") {
+            InlinedCall *inlined = dynamic_cast<InlinedCall*>(exp);
+            InlinedCall *out = new InlinedCall(dynamic_cast<CallExpression*>(clone(inlined->call, substitution, sites)), clone(inlined->body, substitution, sites));
+            out->valid = inlined->valid;
+            sites.calls.push_back(out);
+            return out;
+        } else if (type == "ArrayLiteral") {
+            ArrayLiteral *array = dynamic_cast<ArrayLiteral*>(exp);
+            ArrayLiteral *out = new ArrayLiteral(array->token);
+            for (auto element : array->elements) {
+                out->elements.push_back(clone(element, substitution, sites));
+            }
+            return out;
+        } else if (type == "HashLiteral") {
+            HashLiteral *hash = dynamic_cast<HashLiteral*>(exp);
+            HashLiteral *out = new HashLiteral(hash->token);
+            out->shape = hash->shape;
+            for (auto pair : hash->pairs) {
+                out->pairs[clone(pair.first, substitution, sites)] = clone(pair.second, substitution, sites);
+            }
+            return out;
+        } else if (type == "IndexExpression") {
+            IndexExpression *ie = dynamic_cast<IndexExpression*>(exp);
+            IndexExpression *out = new IndexExpression(ie->token, clone(ie->left, substitution, sites));
+            out->index = clone(ie->index, substitution, sites);
+            return out;
+        }
+        return exp;
+    }
+
+    class Inliner {
+    public:
+        Inliner(const analysis::NameCounts &names, Sites &sites) : names(names), sites(sites) {};
+        const analysis::NameCounts &names;
+        Sites &sites;
+        std::map<const intern::Symbol*, Candidate> candidates;
+        size_t inlined = 0;
+
+        void statement(Statement *stmt, Scope &scope);
+        void expression(Expression *&exp, Scope &scope);
+        void block(BlockStatement *block, Scope &scope);
+        void loop(Statement *stmt, Scope &scope);
+        void arm(Node *&body, Scope &scope);
+        bool safe(Expression *arg, Scope &scope);
+    };
+
+    void Inliner::statement(Statement *stmt, Scope &scope) {
+        std::string type = stmt->type();
+        if (type == "ExpressionStatement") {
+            expression(dynamic_cast<ExpressionStatement*>(stmt)->expression, scope);
+        } else if (type == "LetStatement") {
+            expression(dynamic_cast<LetStatement*>(stmt)->value, scope);
+        } else if (type == "ReturnStatement") {
+            expression(dynamic_cast<ReturnStatement*>(stmt)->returnValue, scope);
+        } else if (type == "YieldStatement") {
+            expression(dynamic_cast<YieldStatement*>(stmt)->value, scope);
+        } else if (type == "BlockStatement") {
+            block(dynamic_cast<BlockStatement*>(stmt), scope);
+        } else if (type == "WhileStatement" || type == "ForStatement") {
+            loop(stmt, scope);
+        }
+    }
+
+    // A loop body sees the loop variable and its own lets over the caller's names.
+    void Inliner::loop(Statement *stmt, Scope &scope) {
+        Scope inner = scope;
+        BlockStatement *body;
+        WhileStatement *ws = dynamic_cast<WhileStatement*>(stmt);
+        if (ws != nullptr) {
+            expression(ws->condition, scope);
+            body = ws->body;
+        } else {
+            ForStatement *fs = dynamic_cast<ForStatement*>(stmt);
+            expression(fs->iterable, scope);
+            expression(fs->end, scope);
+            inner.bound.insert(fs->variable->symbol);
+            inner.shadowed.insert(fs->variable->symbol);
+            body = fs->body;
+        }
+        analysis::walk(body, [&](Node *node) {
+            if (node->type() == "LetStatement") {
+                inner.shadowed.insert(dynamic_cast<LetStatement*>(node)->name->symbol);
+            }
+            return node->type() != "FunctionLiteral";
+        });
+        block(body, inner);
+    }
+
+    // A match arm's body is an expression or a block.
+    void Inliner::arm(Node *&body, Scope &scope) {
+        Expression *exp = dynamic_cast<Expression*>(body);
+        if (exp == nullptr) {
+            block(dynamic_cast<BlockStatement*>(body), scope);
+            return;
+        }
+        expression(exp, scope);
+        body = exp;
+    }
+
+    void Inliner::block(BlockStatement *block, Scope &scope) {
+        if (block == nullptr) {
+            return;
+        }
+        for (auto stmt : *block->statements) {
+            statement(stmt, scope);
+        }
+    }
+
+    // Literals and certainly-bound names evaluate without side effects or
+    // errors, so moving them into the body cannot change what the caller sees.
+    // A name that is ever assigned could change before the body reads it.
+    bool Inliner::safe(Expression *arg, Scope &scope) {
+        std::string type = arg->type();
+        if (type == "IntegerLiteral" || type == "FloatLiteral" || type == "StringLiteral" || type == "Boolean") {
+            return true;
+        }
+        if (type == "Identifier") {
+            Identifier *ident = dynamic_cast<Identifier*>(arg);
+            if (names.assignments(ident->symbol) > 0) {
+                return false;
+            }
+            return scope.bound.count(ident->symbol) > 0 || evaluator::builtins.count(ident->value) > 0;
+        }
+        return false;
+    }
+
+    void Inliner::expression(Expression *&exp, Scope &scope) {
+        if (exp == nullptr) {
+            return;
+        }
+        std::string type = exp->type();
+        if (type == "PrefixExpression") {
+            expression(dynamic_cast<PrefixExpression*>(exp)->right, scope);
+        } else if (type == "InfixExpression") {
+            expression(dynamic_cast<InfixExpression*>(exp)->left, scope);
+            expression(dynamic_cast<InfixExpression*>(exp)->right, scope);
+        } else if (type == "IfExpression") {
+            IfExpression *ie = dynamic_cast<IfExpression*>(exp);
+            expression(ie->condition, scope);
+            block(ie->consequence, scope);
+            block(ie->alternative, scope);
+        } else if (type == "MatchExpression") {
+            MatchExpression *match = dynamic_cast<MatchExpression*>(exp);
+            expression(match->subject, scope);
+            for (auto &arm : match->arms) {
+                expression(arm.pattern, scope);
+                this->arm(arm.body, scope);
+            }
+            this->arm(match->otherwise, scope);
+        } else if (type == "FunctionLiteral") {
+            FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(exp);
+            Scope inner = scope;
+            for (auto param : fn->parameters) {
+                inner.bound.insert(param->symbol);
+                inner.shadowed.insert(param->symbol);
+            }
+            analysis::walk(fn->body, [&](Node *node) {
+                if (node->type() == "LetStatement") {
+                    inner.shadowed.insert(dynamic_cast<LetStatement*>(node)->name->symbol);
+                }
+                return node->type() != "FunctionLiteral";
+            });
+            block(fn->body, inner);
+        } else if (type == "ArrayLiteral") {
+            for (auto &element : dynamic_cast<ArrayLiteral*>(exp)->elements) {
+                expression(element, scope);
+            }
+        } else if (type == "HashLiteral") {
+            HashLiteral *hash = dynamic_cast<HashLiteral*>(exp);
+            std::map<Expression*, Expression*> pairs;
+            for (auto pair : hash->pairs) {
+                Expression *key = pair.first;
+                Expression *value = pair.second;
+                expression(key, scope);
+                expression(value, scope);
+                pairs[key] = value;
+            }
+            hash->pairs = pairs;
+        } else if (type == "IndexExpression") {
+            expression(dynamic_cast<IndexExpression*>(exp)->left, scope);
+            expression(dynamic_cast<IndexExpression*>(exp)->index, scope);
+        } else if (type == "AssignExpression") {
+            AssignExpression *assign = dynamic_cast<AssignExpression*>(exp);
+            IndexExpression *target = dynamic_cast<IndexExpression*>(assign->target);
+            if (target != nullptr) {
+                expression(target->left, scope);
+                expression(target->index, scope);
+            }
+            expression(assign->value, scope);
+        } else if (type == "CallExpression") {
+            CallExpression *call = dynamic_cast<CallExpression*>(exp);
+            expression(call->function, scope);
+            for (auto &arg : call->arguments) {
+                expression(arg, scope);
+            }
+            Identifier *name = dynamic_cast<Identifier*>(call->function);
+            if (name == nullptr || scope.shadowed.count(name->symbol) > 0) {
+                return;
+            }
+            auto found = candidates.find(name->symbol);
+            if (found == candidates.end()) {
+                return;
+            }
+            Candidate &candidate = found->second;
+            if (call->arguments.size() != candidate.literal->parameters.size()) {
+                return;
+            }
+            for (auto free : candidate.freeNames) {
+                if (scope.shadowed.count(free) > 0) {
+                    return;
+                }
+            }
+            substitution_t substitution;
+            for (size_t i = 0; i < call->arguments.size(); i++) {
+                if (!safe(call->arguments[i], scope)) {
+                    return;
+                }
+                substitution[candidate.literal->parameters[i]->symbol] = call->arguments[i];
+            }
+            InlinedCall *site = new InlinedCall(call, clone(candidate.body, substitution, sites));
+            sites.calls.push_back(site);
+            exp = site;
+            inlined++;
+        }
+    }
+
+    // Returns the function's single body expression if it can be inlined. A
+    // name that is ever assigned may stop referring to fn, and a generator's
+    // body only runs once the generator is resumed.
+    Expression* inlineBody(const intern::Symbol *name, FunctionLiteral *fn, const analysis::NameCounts &names, std::set<const intern::Symbol*> &freeNames) {
+        if (names.assignments(name) > 0 || fn->generator || fn->body == nullptr || fn->body->statements->size() != 1 || fn->body->statements->at(0)->type() != "ExpressionStatement") {
+            return nullptr;
+        }
+        Expression *body = dynamic_cast<ExpressionStatement*>(fn->body->statements->at(0))->expression;
+        if (body == nullptr || !inlinable(body) || countNodes(body) > inliner::MAX_INLINE_NODES) {
+            return nullptr;
+        }
+        std::set<const intern::Symbol*> params;
+        for (auto param : fn->parameters) {
+            if (!params.insert(param->symbol).second) {
+                return nullptr;
+            }
+        }
+        analysis::walk(body, [&](Node *node) {
+            if (node->type() == "Identifier") {
+                const intern::Symbol *symbol = dynamic_cast<Identifier*>(node)->symbol;
+                if (params.count(symbol) == 0) {
+                    freeNames.insert(symbol);
+                }
+            }
+            return true;
+        });
+        if (freeNames.count(name) > 0) {
+            return nullptr;
+        }
+        return body;
+    }
+
+    // Names assigned by a program parsed after a call site was inlined may be
+    // the callee or one of its substituted arguments; such sites go back to
+    // making the call.
+    void invalidateSites(const analysis::NameCounts &names, Sites &sites) {
+        if (sites.checkedAssignments == names.total) {
+            return;
+        }
+        sites.checkedAssignments = names.total;
+        for (auto site : sites.calls) {
+            std::vector<Expression*> used = site->call->arguments;
+            used.push_back(site->call->function);
+            for (auto name : used) {
+                Identifier *ident = dynamic_cast<Identifier*>(name);
+                if (ident != nullptr && names.assignments(ident->symbol) > 0) {
+                    site->valid = false;
+                }
+            }
+        }
+    }
+} // namespace
+
+size_t inliner::inlineCalls(Program *program, object::Environment *globals) {
+    globals->count(program);
+    const analysis::NameCounts &names = globals->counts();
+    invalidateSites(names, recorded[globals]);
+    if (!enabled) {
+        return 0;
+    }
+    Inliner inliner(names, recorded[globals]);
+    Scope scope;
+    for (auto &binding : *globals->store) {
+        scope.bound.insert(binding.first);
+        object::Function *fn = dynamic_cast<object::Function*>(binding.second);
+        if (fn != nullptr && fn->literal != nullptr && fn->env == globals) {
+            Candidate candidate = {fn->literal, nullptr, {}};
+            candidate.body = inlineBody(binding.first, fn->literal, names, candidate.freeNames);
+            if (candidate.body != nullptr) {
+                inliner.candidates[binding.first] = candidate;
+            }
+        }
+    }
+    // Top-level lets, including ones nested in if blocks, bind globals; only a
+    // name's first and only such let is sure to be the binding calls see.
+    std::map<const intern::Symbol*, size_t> lets;
+    for (auto stmt : *program->statements) {
+        analysis::walk(stmt, [&](Node *node) {
+            if (node->type() == "LetStatement") {
+                lets[dynamic_cast<LetStatement*>(node)->name->symbol]++;
+            }
+            return node->type() != "FunctionLiteral";
+        });
+    }
+    for (auto stmt : *program->statements) {
+        inliner.statement(stmt, scope);
+        // Later statements only run once this one has, so its let is bound by then.
+        LetStatement *let = dynamic_cast<LetStatement*>(stmt);
+        if (let == nullptr || globals->store->count(let->name->symbol) > 0) {
+            continue;
+        }
+        scope.bound.insert(let->name->symbol);
+        FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(let->value);
+        if (fn != nullptr && lets[let->name->symbol] == 1) {
+            Candidate candidate = {fn, nullptr, {}};
+            candidate.body = inlineBody(let->name->symbol, fn, names, candidate.freeNames);
+            if (candidate.body != nullptr) {
+                inliner.candidates[let->name->symbol] = candidate;
+            }
+        }
+    }
+    return inliner.inlined;
+}
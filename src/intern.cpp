@@ -0,0 +1,33 @@
+#include <atomic>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include "intern.hh"
+
+static std::unordered_map<std::string, intern::Symbol*>& table() {
+    static std::unordered_map<std::string, intern::Symbol*> symbols;
+    return symbols;
+}
+
+// Guards the table: isolates lex and parse on their own threads.
+static std::mutex& tableLock() {
+    static std::mutex lock;
+    return lock;
+}
+
+const intern::Symbol* intern::symbol(const std::string &str) {
+    std::lock_guard<std::mutex> guard(tableLock());
+    auto found = table().find(str);
+    if (found != table().end()) {
+        return found->second;
+    }
+    std::hash<std::string> hash_fn;
+    intern::Symbol *sym = new intern::Symbol(str, hash_fn(str));
+    table().insert({str, sym});
+    return sym;
+}
+
+size_t intern::size() {
+    std::lock_guard<std::mutex> guard(tableLock());
+    return table().size();
+}
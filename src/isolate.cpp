@@ -0,0 +1,310 @@
+#include <iostream>
+#include <thread>
+#include "isolate.hh"
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "inliner.hh"
+#include "types.hh"
+
+isolate::engine_t isolate::engine = evaluator::eval;
+
+namespace {
+    object::Object* share(object::Object *obj, std::map<object::Object*, object::Object*> &copies) {
+        ObjectType type = obj->type();
+        if (type == object::ARRAY_OBJ) {
+            auto found = copies.find(obj);
+            if (found != copies.end()) {
+                return found->second;
+            }
+            object::Array *copy = new object::Array({});
+            copies[obj] = copy;
+            for (auto element : dynamic_cast<object::Array*>(obj)->elements) {
+                object::Object *shared = share(element, copies);
+                if (shared->type() == object::ERROR_OBJ && element->type() != object::ERROR_OBJ) {
+                    return shared;
+                }
+                copy->elements.push_back(shared);
+            }
+            return copy;
+        } else if (type == object::INT64_ARRAY_OBJ || type == object::FLOAT64_ARRAY_OBJ) {
+            return new object::PackedArray(*dynamic_cast<object::PackedArray*>(obj));
+        } else if (type == object::HASH_OBJ) {
+            auto found = copies.find(obj);
+            if (found != copies.end()) {
+                return found->second;
+            }
+            object::Hash *hash = dynamic_cast<object::Hash*>(obj);
+            object::Hash *copy = new object::Hash();
+            copies[obj] = copy;
+            // Shapes are immutable, so the copy keeps the original's.
+            if (hash->shape != nullptr) {
+                copy->shape = hash->shape;
+                for (auto value : hash->values) {
+                    object::Object *shared = share(value, copies);
+                    if (shared->type() == object::ERROR_OBJ && value->type() != object::ERROR_OBJ) {
+                        return shared;
+                    }
+                    copy->values.push_back(shared);
+                }
+                return copy;
+            }
+            for (auto pair : hash->pairs) {
+                object::Object *shared = share(pair.second->value, copies);
+                if (shared->type() == object::ERROR_OBJ && pair.second->value->type() != object::ERROR_OBJ) {
+                    return shared;
+                }
+                copy->pairs[pair.first] = new object::HashPair(pair.second->key, shared);
+            }
+            return copy;
+        } else if (type == object::FUNCTION_OBJ || type == object::FUTURE_OBJ || type == object::ISOLATE_OBJ || type == object::GENERATOR_OBJ || type == object::ITERATOR_OBJ) {
+            return new object::Error("cannot share " + type + " between isolates");
+        }
+        return obj;
+    }
+
+    // Runs source the way wfi runs a script, in a fresh global scope.
+    object::Object* runProgram(const std::string &source, const std::map<std::string, object::Object*> &bindings, isolate::engine_t run) {
+        Lexer l = Lexer(source);
+        Parser p = Parser(&l);
+        Program *program = p.parseProgram();
+        if (p.getErrors().size() > 0) {
+            return new object::Error("parser errors in isolate: " + p.getErrors()[0]);
+        }
+        object::Environment *env = new object::Environment();
+        for (auto binding : bindings) {
+            env->set(binding.first, binding.second);
+        }
+        inliner::inlineCalls(program, env);
+        for (auto error : types::infer(program, env).errors) {
+            std::cerr << "type error: " << error << std::endl;
+        }
+        object::Object *result = run(program, env);
+        return result != nullptr ? result : evaluator::NULLobj;
+    }
+
+    // Waits for ready() without taking a lock, letting other threads run.
+    template <typename F>
+    void spin(F ready) {
+        while (!ready()) {
+            std::this_thread::yield();
+        }
+    }
+} // namespace
+
+object::Object* isolate::share(object::Object *obj) {
+    std::map<object::Object*, object::Object*> copies;
+    return ::share(obj, copies);
+}
+
+isolate::Channel::Channel(size_t capacity) : sendAt(0), receiveAt(0), done(false) {
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    cells = new Cell[size];
+    for (size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+        cells[i].value = nullptr;
+    }
+    mask = size - 1;
+}
+
+isolate::Channel::~Channel() {
+    delete[] cells;
+}
+
+ObjectType isolate::Channel::type() {
+    return object::CHANNEL_OBJ;
+}
+
+std::string isolate::Channel::inspect() {
+    return "channel(" + std::to_string(capacity()) + ")";
+}
+
+size_t isolate::Channel::capacity() {
+    return mask + 1;
+}
+
+bool isolate::Channel::trySend(object::Object *value) {
+    size_t at = sendAt.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[at & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t lap = (intptr_t) sequence - (intptr_t) at;
+        if (lap == 0) {
+            if (sendAt.compare_exchange_weak(at, at + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lap < 0) {
+            // The cell still holds a value from the previous lap: full.
+            return false;
+        } else {
+            at = sendAt.load(std::memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    cell->sequence.store(at + 1, std::memory_order_release);
+    return true;
+}
+
+bool isolate::Channel::tryReceive(object::Object *&value) {
+    size_t at = receiveAt.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[at & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t lap = (intptr_t) sequence - (intptr_t) (at + 1);
+        if (lap == 0) {
+            if (receiveAt.compare_exchange_weak(at, at + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lap < 0) {
+            // Nothing has been sent into the cell in this lap yet: empty.
+            return false;
+        } else {
+            at = receiveAt.load(std::memory_order_relaxed);
+        }
+    }
+    value = cell->value;
+    cell->sequence.store(at + mask + 1, std::memory_order_release);
+    return true;
+}
+
+void isolate::Channel::close() {
+    done = true;
+}
+
+bool isolate::Channel::closed() {
+    return done;
+}
+
+isolate::Isolate::Isolate(const std::string &source, const std::map<std::string, object::Object*> &bindings, isolate::engine_t run) : joined(false), error(false), result(nullptr) {
+    thread = std::thread([this, source, bindings, run] {
+        object::Object *value = runProgram(source, bindings, run);
+        error = value->type() == object::ERROR_OBJ;
+        result = isolate::share(value);
+    });
+}
+
+isolate::Isolate::~Isolate() {
+    join();
+}
+
+ObjectType isolate::Isolate::type() {
+    return object::ISOLATE_OBJ;
+}
+
+std::string isolate::Isolate::inspect() {
+    return "isolate";
+}
+
+object::Object* isolate::Isolate::join() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!joined) {
+        thread.join();
+        joined = true;
+    }
+    return result;
+}
+
+bool isolate::Isolate::failed() {
+    return error;
+}
+
+object::Object* isolate::channel(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    object::Integer *capacity = dynamic_cast<object::Integer*>(args[0]);
+    if (capacity == nullptr) {
+        return new object::Error("argument to `channel` must be INTEGER, got " + args[0]->type());
+    }
+    if (capacity->value < 1 || capacity->value > (1 << 20)) {
+        return new object::Error("channel capacity must be between 1 and 1048576, got " + capacity->inspect());
+    }
+    return new isolate::Channel(capacity->value);
+}
+
+object::Object* isolate::send(std::vector<object::Object*> args) {
+    if (args.size() != 2) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+    }
+    isolate::Channel *channel = dynamic_cast<isolate::Channel*>(args[0]);
+    if (channel == nullptr) {
+        return new object::Error("argument to `send` must be CHANNEL, got " + args[0]->type());
+    }
+    object::Object *value = isolate::share(args[1]);
+    if (value->type() == object::ERROR_OBJ && args[1]->type() != object::ERROR_OBJ) {
+        return value;
+    }
+    bool sent = false;
+    spin([&] {
+        if (channel->closed()) {
+            return true;
+        }
+        sent = channel->trySend(value);
+        return sent;
+    });
+    if (!sent) {
+        return new object::Error("send on closed channel");
+    }
+    return evaluator::NULLobj;
+}
+
+object::Object* isolate::receive(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    isolate::Channel *channel = dynamic_cast<isolate::Channel*>(args[0]);
+    if (channel == nullptr) {
+        return new object::Error("argument to `receive` must be CHANNEL, got " + args[0]->type());
+    }
+    object::Object *value = nullptr;
+    spin([&] {
+        // Check closed first: a value sent before the close is still received.
+        bool closed = channel->closed();
+        return channel->tryReceive(value) || closed;
+    });
+    return value != nullptr ? value : evaluator::NULLobj;
+}
+
+object::Object* isolate::close(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    isolate::Channel *channel = dynamic_cast<isolate::Channel*>(args[0]);
+    if (channel == nullptr) {
+        return new object::Error("argument to `close` must be CHANNEL, got " + args[0]->type());
+    }
+    channel->close();
+    return evaluator::NULLobj;
+}
+
+object::Object* isolate::start(std::vector<object::Object*> args) {
+    if (args.size() != 2) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+    }
+    object::String *source = dynamic_cast<object::String*>(args[0]);
+    if (source == nullptr) {
+        return new object::Error("argument to `isolate` must be STRING, got " + args[0]->type());
+    }
+    object::Hash *hash = dynamic_cast<object::Hash*>(args[1]);
+    if (hash == nullptr) {
+        return new object::Error("argument to `isolate` must be HASH, got " + args[1]->type());
+    }
+    std::map<std::string, object::Object*> bindings;
+    for (auto pair : hash->entries()) {
+        object::String *name = dynamic_cast<object::String*>(pair.first);
+        if (name == nullptr) {
+            return new object::Error("isolate bindings must be named by STRING, got " + pair.first->type());
+        }
+        object::Object *value = isolate::share(pair.second);
+        if (value->type() == object::ERROR_OBJ && pair.second->type() != object::ERROR_OBJ) {
+            return value;
+        }
+        bindings[name->value()] = value;
+    }
+    return new isolate::Isolate(source->value(), bindings, isolate::engine);
+}
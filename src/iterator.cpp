@@ -0,0 +1,308 @@
+#include <typeinfo>
+#include "iterator.hh"
+#include "evaluator.hh"
+#include "parallel.hh"
+
+namespace {
+    object::Object* wrongArguments(size_t got, const std::string &want) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(got) + ", want=" + want);
+    }
+
+    // Checks that args[at] is something map, filter or fold can call with
+    // arity arguments.
+    object::Object* checkFunction(const std::string &name, std::vector<object::Object*> &args, size_t at, size_t arity) {
+        object::Object *fn = args[at];
+        if (fn->type() != object::FUNCTION_OBJ && fn->type() != object::BUILTIN_OBJ) {
+            return new object::Error("argument to `" + name + "` must be FUNCTION, got " + fn->type());
+        }
+        object::Function *function = dynamic_cast<object::Function*>(fn);
+        if (function != nullptr && function->parameters->size() != arity) {
+            return new object::Error("function passed to `" + name + "` must take " + std::to_string(arity) + (arity == 1 ? " argument" : " arguments") + ", got " + std::to_string(function->parameters->size()));
+        }
+        return nullptr;
+    }
+
+    iterator::Iterator* iterable(const std::string &name, object::Object *value, object::Object *&error) {
+        iterator::Iterator *it = iterator::of(value);
+        if (it == nullptr) {
+            error = new object::Error("argument to `" + name + "` must be ARRAY, GENERATOR or ITERATOR, got " + value->type());
+        }
+        return it;
+    }
+
+    // map and filter: an iterable and a function of one argument.
+    object::Object* stage(const std::string &name, iterator::Iterator::StageKind kind, std::vector<object::Object*> &args) {
+        if (args.size() != 2) {
+            return wrongArguments(args.size(), "2");
+        }
+        object::Object *error = nullptr;
+        iterator::Iterator *upstream = iterable(name, args[0], error);
+        if (upstream == nullptr) {
+            return error;
+        }
+        error = checkFunction(name, args, 1, 1);
+        if (error != nullptr) {
+            return error;
+        }
+        return new iterator::Iterator(upstream, kind, args[1], 0);
+    }
+
+    object::Object* integer(const std::string &name, object::Object *value, int64_t &out) {
+        if (typeid(*value) != typeid(object::Integer)) {
+            return new object::Error("argument to `" + name + "` must be INTEGER, got " + value->type());
+        }
+        object::Integer *integer = static_cast<object::Integer*>(value);
+        if (integer->big != nullptr) {
+            return new object::Error("argument to `" + name + "` out of range: " + integer->inspect());
+        }
+        out = integer->value;
+        return nullptr;
+    }
+} // namespace
+
+iterator::Iterator::Iterator(int64_t from, int64_t to, int64_t step) : root(this), kind(RANGE), at(from), to(to), step(step), array(nullptr), packed(nullptr), gen(nullptr), left(0), ended(false) {}
+
+iterator::Iterator::Iterator(object::Array *array) : root(this), kind(ARRAY), at(0), to(0), step(1), array(array), packed(nullptr), gen(nullptr), left(0), ended(false) {}
+
+iterator::Iterator::Iterator(object::PackedArray *packed) : root(this), kind(PACKED), at(0), to(0), step(1), array(nullptr), packed(packed), gen(nullptr), left(0), ended(false) {}
+
+iterator::Iterator::Iterator(generator::Generator *gen) : root(this), kind(GENERATOR), at(0), to(0), step(0), array(nullptr), packed(nullptr), gen(gen), left(0), ended(false) {}
+
+iterator::Iterator::Iterator(std::vector<Iterator*> zipped) : root(this), kind(ZIP), at(0), to(0), step(0), array(nullptr), packed(nullptr), gen(nullptr), zipped(zipped), left(0), ended(false) {}
+
+iterator::Iterator::Iterator(Iterator *upstream, StageKind stageKind, object::Object *fn, int64_t left) : root(upstream->root), stages(upstream->stages), kind(upstream->kind), at(0), to(0), step(0), array(nullptr), packed(nullptr), gen(nullptr), left(left), ended(false) {
+    stages.push_back({stageKind, fn, this});
+}
+
+ObjectType iterator::Iterator::type() {
+    return object::ITERATOR_OBJ;
+}
+
+std::string iterator::Iterator::inspect() {
+    return "iterator";
+}
+
+// Only ever called on a root.
+object::Object* iterator::Iterator::produce() {
+    if (ended) {
+        return nullptr;
+    }
+    object::Object *value = nullptr;
+    switch (kind) {
+    case RANGE:
+        if (step > 0 ? at < to : at > to) {
+            value = object::Integer::make(at);
+            if (__builtin_add_overflow(at, step, &at)) {
+                at = to;
+            }
+        }
+        break;
+    case ARRAY:
+        if (static_cast<size_t>(at) < array->elements.size()) {
+            value = array->elements[at++];
+        }
+        break;
+    case PACKED:
+        if (static_cast<size_t>(at) < packed->size()) {
+            value = packed->at(at++);
+        }
+        break;
+    case GENERATOR:
+        value = gen->resume();
+        break;
+    case ZIP: {
+        std::vector<object::Object*> row;
+        for (auto it : zipped) {
+            object::Object *element = it->pull();
+            if (element == nullptr || evaluator::isError(element)) {
+                value = element;
+                break;
+            }
+            row.push_back(element);
+        }
+        if (row.size() == zipped.size()) {
+            value = new object::Array(row);
+        }
+        break;
+    }
+    }
+    if (value == nullptr) {
+        ended = true;
+    }
+    return value;
+}
+
+object::Object* iterator::Iterator::pull() {
+    for (;;) {
+        // Checked before pulling, so an exhausted take stops its source.
+        for (auto &stage : stages) {
+            if (stage.kind == TAKE && stage.owner->left == 0) {
+                return nullptr;
+            }
+        }
+        object::Object *value = root->produce();
+        if (value == nullptr || evaluator::isError(value)) {
+            return value;
+        }
+        bool kept = true;
+        for (auto &stage : stages) {
+            if (stage.kind == MAP) {
+                value = parallel::call(stage.fn, {value});
+                if (evaluator::isError(value)) {
+                    return value;
+                }
+            } else if (stage.kind == FILTER) {
+                object::Object *keep = parallel::call(stage.fn, {value});
+                if (evaluator::isError(keep)) {
+                    return keep;
+                }
+                if (!evaluator::isTruthy(keep)) {
+                    kept = false;
+                    break;
+                }
+            } else {
+                stage.owner->left--;
+            }
+        }
+        if (kept) {
+            return value;
+        }
+    }
+}
+
+iterator::Iterator* iterator::of(object::Object *iterable) {
+    if (typeid(*iterable) == typeid(Iterator)) {
+        return static_cast<Iterator*>(iterable);
+    } else if (typeid(*iterable) == typeid(object::Array)) {
+        return new Iterator(static_cast<object::Array*>(iterable));
+    } else if (typeid(*iterable) == typeid(object::PackedArray)) {
+        return new Iterator(static_cast<object::PackedArray*>(iterable));
+    } else if (typeid(*iterable) == typeid(generator::Generator)) {
+        return new Iterator(static_cast<generator::Generator*>(iterable));
+    }
+    return nullptr;
+}
+
+object::Object* iterator::advance(object::Object *iterable) {
+    if (typeid(*iterable) == typeid(generator::Generator)) {
+        return static_cast<generator::Generator*>(iterable)->resume();
+    }
+    return static_cast<Iterator*>(iterable)->pull();
+}
+
+object::Object* iterator::range(std::vector<object::Object*> args) {
+    if (args.empty() || args.size() > 3) {
+        return wrongArguments(args.size(), "1, 2 or 3");
+    }
+    int64_t bounds[3] = {0, 0, 1};
+    for (size_t i = 0; i < args.size(); i++) {
+        object::Object *error = integer("range", args[i], bounds[args.size() == 1 ? 1 : i]);
+        if (error != nullptr) {
+            return error;
+        }
+    }
+    if (bounds[2] == 0) {
+        return new object::Error("range step must not be 0");
+    }
+    return new Iterator(bounds[0], bounds[1], bounds[2]);
+}
+
+object::Object* iterator::map(std::vector<object::Object*> args) {
+    return stage("map", Iterator::MAP, args);
+}
+
+object::Object* iterator::filter(std::vector<object::Object*> args) {
+    return stage("filter", Iterator::FILTER, args);
+}
+
+object::Object* iterator::take(std::vector<object::Object*> args) {
+    if (args.size() != 2) {
+        return wrongArguments(args.size(), "2");
+    }
+    object::Object *error = nullptr;
+    Iterator *upstream = iterable("take", args[0], error);
+    if (upstream == nullptr) {
+        return error;
+    }
+    int64_t n;
+    error = integer("take", args[1], n);
+    if (error != nullptr) {
+        return error;
+    }
+    if (n < 0) {
+        return new object::Error("argument to `take` must not be negative, got " + std::to_string(n));
+    }
+    return new Iterator(upstream, Iterator::TAKE, nullptr, n);
+}
+
+object::Object* iterator::zip(std::vector<object::Object*> args) {
+    if (args.size() < 2) {
+        return wrongArguments(args.size(), "2 or more");
+    }
+    std::vector<Iterator*> zipped;
+    for (auto arg : args) {
+        object::Object *error = nullptr;
+        Iterator *it = iterable("zip", arg, error);
+        if (it == nullptr) {
+            return error;
+        }
+        zipped.push_back(it);
+    }
+    return new Iterator(zipped);
+}
+
+object::Object* iterator::fold(std::vector<object::Object*> args) {
+    if (args.size() != 3) {
+        return wrongArguments(args.size(), "3");
+    }
+    object::Object *error = nullptr;
+    Iterator *it = iterable("fold", args[0], error);
+    if (it == nullptr) {
+        return error;
+    }
+    error = checkFunction("fold", args, 2, 2);
+    if (error != nullptr) {
+        return error;
+    }
+    object::Object *acc = args[1];
+    for (object::Object *value = it->pull(); value != nullptr; value = it->pull()) {
+        if (evaluator::isError(value)) {
+            return value;
+        }
+        acc = parallel::call(args[2], {acc, value});
+        if (evaluator::isError(acc)) {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+object::Object* iterator::collect(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return wrongArguments(args.size(), "1");
+    }
+    object::Object *error = nullptr;
+    Iterator *it = iterable("collect", args[0], error);
+    if (it == nullptr) {
+        return error;
+    }
+    std::vector<object::Object*> elements;
+    for (object::Object *value = it->pull(); value != nullptr; value = it->pull()) {
+        if (evaluator::isError(value)) {
+            return value;
+        }
+        elements.push_back(value);
+    }
+    return new object::Array(elements);
+}
+
+object::Object* iterator::next(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return wrongArguments(args.size(), "1");
+    }
+    if (typeid(*args[0]) != typeid(generator::Generator) && typeid(*args[0]) != typeid(Iterator)) {
+        return new object::Error("argument to `next` must be GENERATOR or ITERATOR, got " + args[0]->type());
+    }
+    object::Object *value = advance(args[0]);
+    return value != nullptr ? value : evaluator::NULLobj;
+}
@@ -0,0 +1,708 @@
+#include <cstring>
+#include <map>
+#include <typeinfo>
+#include "jit.hh"
+#include "scheduler.hh"
+#include "generator.hh"
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define WFI_JIT_SUPPORTED
+#endif
+
+bool jit::enabled = true;
+size_t jit::threshold = 100;
+std::atomic<size_t> jit::compiled(0);
+std::atomic<size_t> jit::bailouts(0);
+std::atomic<size_t> jit::mapped(0);
+
+#ifdef WFI_JIT_SUPPORTED
+
+// Jitted functions use the System V calling convention for their arguments and
+// return a jit::Result in rax:rdx. The code is a simple stack machine: every
+// expression leaves its value in rax, and the left operand of a binary
+// operator waits on the native stack while the right one is computed.
+// Parameters and lets live in fixed slots below rbp. Any guard failure jumps
+// to a shared bailout stub that returns failed = 1, and callers pass that
+// straight up, so one failure unwinds the whole native call chain.
+namespace {
+    enum Register : uint8_t { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7, R8 = 8, R9 = 9 };
+    const Register ARGUMENT_REGISTERS[] = {RDI, RSI, RDX, RCX, R8, R9};
+    const size_t MAX_PARAMETERS = 6;
+
+    // Second opcode byte of the 0F 8x rel32 conditional jumps.
+    enum Condition : uint8_t {
+        OVERFLOW = 0x80,
+        EQUAL = 0x84,
+        NOT_EQUAL = 0x85,
+        LESS = 0x8C,
+        GREATER_EQUAL = 0x8D,
+        LESS_EQUAL = 0x8E,
+        GREATER = 0x8F,
+    };
+
+    class Assembler {
+    public:
+        std::vector<uint8_t> bytes;
+        void emit(std::initializer_list<uint8_t> code) {
+            bytes.insert(bytes.end(), code);
+        }
+        void emit32(int32_t value) {
+            append(&value, sizeof(value));
+        }
+        void emit64(int64_t value) {
+            append(&value, sizeof(value));
+        }
+        // Jumps return the offset of their rel32 so it can be bound later.
+        size_t jump() {
+            emit({0xE9});
+            return placeholder();
+        }
+        size_t jumpIf(Condition cc) {
+            emit({0x0F, cc});
+            return placeholder();
+        }
+        void bind(size_t at, size_t target) {
+            int32_t rel = (int32_t)(target - (at + 4));
+            memcpy(&bytes[at], &rel, sizeof(rel));
+        }
+        size_t here() {
+            return bytes.size();
+        }
+    private:
+        size_t placeholder() {
+            size_t at = bytes.size();
+            emit32(0);
+            return at;
+        }
+        void append(const void *data, size_t size) {
+            const uint8_t *p = static_cast<const uint8_t*>(data);
+            bytes.insert(bytes.end(), p, p + size);
+        }
+    };
+
+    class Session;
+
+    class FunctionCompiler {
+    public:
+        FunctionCompiler(Session &session, FunctionLiteral *literal) : session(session), literal(literal), depth(0) {};
+        bool compile();
+        Assembler a;
+    private:
+        Session &session;
+        FunctionLiteral *literal;
+        std::map<const intern::Symbol*, int32_t> slots;
+        // Values pushed on the native stack since the prologue, to keep calls 16-byte aligned.
+        size_t depth;
+        std::vector<size_t> bailouts;
+        std::vector<size_t> returns;
+
+        bool block(BlockStatement *block, bool value, bool top);
+        bool statement(Statement *stmt, bool value, bool top);
+        bool expression(Expression *exp);
+        bool ifExpression(IfExpression *exp, bool value);
+        bool match(MatchExpression *exp, bool value);
+        bool arm(Node *body, bool value);
+        bool condition(Expression *exp, std::vector<size_t> &otherwise);
+        bool operands(Expression *left, Expression *right);
+        bool call(CallExpression *exp);
+        void load(int32_t offset);
+        void store(Register reg, int32_t offset);
+        void push();
+        void pop(Register reg);
+        void bailOutIf(Condition cc);
+    };
+
+    // Compiles a function together with everything it calls. Nothing is
+    // installed unless every function in the session compiles, because a
+    // finished function may already call into one that later fails.
+    class Session {
+    public:
+        object::Environment *globals;
+        Session(object::Environment *globals) : globals(globals), installed(false) {};
+        // Frees the code of every function the session did not install.
+        ~Session();
+        jit::Code* function(object::Function *fn);
+        void install();
+    private:
+        struct Output {
+            FunctionLiteral *literal;
+            jit::Code *code;
+            std::vector<uint8_t> bytes;
+        };
+        // nullptr marks a literal that failed to compile in this session.
+        std::map<FunctionLiteral*, jit::Code*> pending;
+        std::vector<Output> outputs;
+        bool installed;
+    };
+
+    // Unmaps code's pages and frees it. Only called on code no installed
+    // function calls any more: it was never installed, or the global scope
+    // was assigned since, so every function compiled against it is dropped
+    // before it runs again.
+    void release(jit::Code *code) {
+        if (code->mapped > 0) {
+            munmap(code->entry, code->mapped);
+            jit::mapped -= code->mapped;
+        }
+        delete code;
+    }
+
+    // Drops literal's native code once an assignment to its global scope has
+    // made it stale, so a recompile does not leak the old pages.
+    void dropStale(FunctionLiteral *literal, size_t assignments) {
+        if (literal->native != nullptr && literal->native->assignments != assignments) {
+            release(literal->native);
+            literal->native = nullptr;
+        }
+    }
+
+    Session::~Session() {
+        if (installed) {
+            return;
+        }
+        for (auto &output : outputs) {
+            release(output.code);
+        }
+    }
+
+    jit::Code* Session::function(object::Function *fn) {
+        FunctionLiteral *literal = fn->literal;
+        if (literal == nullptr || fn->env != globals) {
+            return nullptr;
+        }
+        dropStale(literal, globals->counts().total);
+        if (literal->native != nullptr) {
+            return literal->native->globals == globals ? literal->native : nullptr;
+        }
+        if (literal->nativeFailed) {
+            return nullptr;
+        }
+        auto found = pending.find(literal);
+        if (found != pending.end()) {
+            return found->second;
+        }
+        if (literal->parameters.size() > MAX_PARAMETERS) {
+            return nullptr;
+        }
+        jit::Code *code = new jit::Code{nullptr, 0, literal->parameters.size(), globals, globals->counts().total};
+        pending[literal] = code;
+        FunctionCompiler compiler(*this, literal);
+        if (!compiler.compile()) {
+            pending[literal] = nullptr;
+            delete code;
+            return nullptr;
+        }
+        outputs.push_back({literal, code, compiler.a.bytes});
+        return code;
+    }
+
+    void Session::install() {
+        size_t page = sysconf(_SC_PAGESIZE);
+        for (auto &output : outputs) {
+            size_t size = (output.bytes.size() + page - 1) / page * page;
+            void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                // Leave the literal interpreted; callers compiled this session
+                // are not installed either, so nothing points at it.
+                return;
+            }
+            memcpy(memory, output.bytes.data(), output.bytes.size());
+            mprotect(memory, size, PROT_READ | PROT_EXEC);
+            output.code->entry = memory;
+            output.code->mapped = size;
+            jit::mapped += size;
+        }
+        installed = true;
+        for (auto &output : outputs) {
+            output.literal->native = output.code;
+            jit::compiled++;
+        }
+    }
+
+    bool FunctionCompiler::compile() {
+        std::set<const intern::Symbol*> names;
+        for (auto param : literal->parameters) {
+            if (!names.insert(param->symbol).second) {
+                return false;
+            }
+        }
+        size_t lets = 0;
+        for (auto stmt : *literal->body->statements) {
+            if (stmt->type() == "LetStatement") {
+                lets++;
+            }
+        }
+        size_t frame = (literal->parameters.size() + lets) * 8;
+        frame = (frame + 15) / 16 * 16;
+        // push rbp; mov rbp, rsp; sub rsp, frame
+        a.emit({0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC});
+        a.emit32((int32_t)frame);
+        for (size_t i = 0; i < literal->parameters.size(); i++) {
+            int32_t offset = -8 * (int32_t)(slots.size() + 1);
+            slots[literal->parameters[i]->symbol] = offset;
+            store(ARGUMENT_REGISTERS[i], offset);
+        }
+        if (!block(literal->body, true, true)) {
+            return false;
+        }
+        size_t epilogue = a.here();
+        // xor edx, edx; leave; ret
+        a.emit({0x31, 0xD2, 0xC9, 0xC3});
+        size_t bailout = a.here();
+        // mov edx, 1; leave; ret
+        a.emit({0xBA, 0x01, 0x00, 0x00, 0x00, 0xC9, 0xC3});
+        for (auto at : returns) {
+            a.bind(at, epilogue);
+        }
+        for (auto at : bailouts) {
+            a.bind(at, bailout);
+        }
+        return true;
+    }
+
+    // value: the block's result is used, so it must end in something that
+    // leaves an integer in rax. top: the block is the function body, the only
+    // place lets are allowed, so every slot is written before it can be read.
+    bool FunctionCompiler::block(BlockStatement *block, bool value, bool top) {
+        std::vector<Statement*> &statements = *block->statements;
+        if (value && statements.empty()) {
+            return false;
+        }
+        for (size_t i = 0; i < statements.size(); i++) {
+            if (!statement(statements[i], value && i + 1 == statements.size(), top)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool FunctionCompiler::statement(Statement *stmt, bool value, bool top) {
+        std::string type = stmt->type();
+        if (type == "LetStatement") {
+            LetStatement *let = dynamic_cast<LetStatement*>(stmt);
+            // Environment::set never rebinds a name, so a let shadowing a
+            // parameter or an earlier let would be a no-op; leave those alone.
+            if (!top || slots.count(let->name->symbol) > 0 || !expression(let->value)) {
+                return false;
+            }
+            int32_t offset = -8 * (int32_t)(slots.size() + 1);
+            slots[let->name->symbol] = offset;
+            store(RAX, offset);
+            return true;
+        } else if (type == "ReturnStatement") {
+            if (!expression(dynamic_cast<ReturnStatement*>(stmt)->returnValue)) {
+                return false;
+            }
+            returns.push_back(a.jump());
+            return true;
+        } else if (type == "ExpressionStatement") {
+            Expression *exp = dynamic_cast<ExpressionStatement*>(stmt)->expression;
+            if (exp == nullptr) {
+                return false;
+            }
+            if (!value && exp->type() == "IfExpression") {
+                return ifExpression(dynamic_cast<IfExpression*>(exp), false);
+            }
+            if (!value && exp->type() == "MatchExpression") {
+                return match(dynamic_cast<MatchExpression*>(exp), false);
+            }
+            return expression(exp);
+        }
+        return false;
+    }
+
+    bool FunctionCompiler::expression(Expression *exp) {
+        if (exp == nullptr) {
+            return false;
+        }
+        std::string type = exp->type();
+        if (type == "IntegerLiteral") {
+            IntegerLiteral *literal = dynamic_cast<IntegerLiteral*>(exp);
+            if (literal->big) {
+                return false;
+            }
+            // mov rax, imm64
+            a.emit({0x48, 0xB8});
+            a.emit64(literal->value);
+            return true;
+        } else if (type == "Identifier") {
+            const intern::Symbol *symbol = dynamic_cast<Identifier*>(exp)->symbol;
+            auto slot = slots.find(symbol);
+            if (slot != slots.end()) {
+                load(slot->second);
+                return true;
+            }
+            // Global bindings of names that are never assigned do not change,
+            // so integer constants can be baked in.
+            auto found = session.globals->store->find(symbol);
+            if (session.globals->counts().assignments(symbol) > 0 || found == session.globals->store->end() || typeid(*found->second) != typeid(object::Integer)) {
+                return false;
+            }
+            object::Integer *constant = static_cast<object::Integer*>(found->second);
+            if (constant->big != nullptr) {
+                return false;
+            }
+            a.emit({0x48, 0xB8});
+            a.emit64(constant->value);
+            return true;
+        } else if (type == "PrefixExpression") {
+            PrefixExpression *prefix = dynamic_cast<PrefixExpression*>(exp);
+            if (prefix->op != "-" || !expression(prefix->right)) {
+                return false;
+            }
+            // neg rax
+            a.emit({0x48, 0xF7, 0xD8});
+            bailOutIf(OVERFLOW);
+            return true;
+        } else if (type == "InfixExpression") {
+            InfixExpression *infix = dynamic_cast<InfixExpression*>(exp);
+            std::string op = infix->op;
+            if (op != "+" && op != "-" && op != "*" && op != "/") {
+                return false;
+            }
+            if (!operands(infix->left, infix->right)) {
+                return false;
+            }
+            if (op == "+") {
+                // add rax, rcx
+                a.emit({0x48, 0x01, 0xC8});
+                bailOutIf(OVERFLOW);
+            } else if (op == "-") {
+                // sub rax, rcx
+                a.emit({0x48, 0x29, 0xC8});
+                bailOutIf(OVERFLOW);
+            } else if (op == "*") {
+                // imul rax, rcx
+                a.emit({0x48, 0x0F, 0xAF, 0xC1});
+                bailOutIf(OVERFLOW);
+            } else {
+                // The interpreter reports division by zero and promotes
+                // INT64_MIN / -1, so both leave native code.
+                // test rcx, rcx
+                a.emit({0x48, 0x85, 0xC9});
+                bailOutIf(EQUAL);
+                // cmp rcx, -1
+                a.emit({0x48, 0x83, 0xF9, 0xFF});
+                size_t divide = a.jumpIf(NOT_EQUAL);
+                // mov rdx, INT64_MIN; cmp rax, rdx
+                a.emit({0x48, 0xBA});
+                a.emit64(INT64_MIN);
+                a.emit({0x48, 0x39, 0xD0});
+                bailOutIf(EQUAL);
+                a.bind(divide, a.here());
+                // cqo; idiv rcx
+                a.emit({0x48, 0x99, 0x48, 0xF7, 0xF9});
+            }
+            return true;
+        } else if (type == "IfExpression") {
+            return ifExpression(dynamic_cast<IfExpression*>(exp), true);
+        } else if (type == "MatchExpression") {
+            return match(dynamic_cast<MatchExpression*>(exp), true);
+        } else if (type == "InlinedCall") {
+            InlinedCall *inlined = dynamic_cast<InlinedCall*>(exp);
+            return inlined->valid ? expression(inlined->body) : call(inlined->call);
+        } else if (type == "CallExpression") {
+            return call(dynamic_cast<CallExpression*>(exp));
+        }
+        return false;
+    }
+
+    bool FunctionCompiler::ifExpression(IfExpression *exp, bool value) {
+        std::vector<size_t> otherwise;
+        if (!condition(exp->condition, otherwise) || !block(exp->consequence, value, false)) {
+            return false;
+        }
+        if (exp->alternative == nullptr) {
+            // Without an else the expression can be null, which is not an integer.
+            if (value) {
+                return false;
+            }
+            for (auto at : otherwise) {
+                a.bind(at, a.here());
+            }
+            return true;
+        }
+        size_t end = a.jump();
+        for (auto at : otherwise) {
+            a.bind(at, a.here());
+        }
+        if (!block(exp->alternative, value, false)) {
+            return false;
+        }
+        a.bind(end, a.here());
+        return true;
+    }
+    // Only matches on integer literals are compiled, as a chain of compares
+    // against the subject in rax. Any other pattern could match a non-integer
+    // value, which never reaches native code.
+    bool FunctionCompiler::match(MatchExpression *exp, bool value) {
+        // Without a _ arm the expression can be null, which is not an integer.
+        if (value && exp->otherwise == nullptr) {
+            return false;
+        }
+        std::vector<int64_t> patterns;
+        for (auto &arm : exp->arms) {
+            Expression *pattern = arm.pattern;
+            bool negative = false;
+            PrefixExpression *prefix = dynamic_cast<PrefixExpression*>(pattern);
+            if (prefix != nullptr && prefix->op == "-") {
+                pattern = prefix->right;
+                negative = true;
+            }
+            IntegerLiteral *literal = dynamic_cast<IntegerLiteral*>(pattern);
+            if (literal == nullptr || literal->big) {
+                return false;
+            }
+            patterns.push_back(negative ? -literal->value : literal->value);
+        }
+        if (!expression(exp->subject)) {
+            return false;
+        }
+        std::vector<size_t> arms;
+        for (auto pattern : patterns) {
+            if (pattern >= INT32_MIN && pattern <= INT32_MAX) {
+                // cmp rax, imm32
+                a.emit({0x48, 0x3D});
+                a.emit32((int32_t)pattern);
+            } else {
+                // mov rcx, imm64; cmp rax, rcx
+                a.emit({0x48, 0xB9});
+                a.emit64(pattern);
+                a.emit({0x48, 0x39, 0xC8});
+            }
+            arms.push_back(a.jumpIf(EQUAL));
+        }
+        std::vector<size_t> ends;
+        if (exp->otherwise != nullptr && !arm(exp->otherwise, value)) {
+            return false;
+        }
+        ends.push_back(a.jump());
+        for (size_t i = 0; i < arms.size(); i++) {
+            a.bind(arms[i], a.here());
+            if (!arm(exp->arms[i].body, value)) {
+                return false;
+            }
+            ends.push_back(a.jump());
+        }
+        for (auto at : ends) {
+            a.bind(at, a.here());
+        }
+        return true;
+    }
+
+    bool FunctionCompiler::arm(Node *body, bool value) {
+        BlockStatement *statements = dynamic_cast<BlockStatement*>(body);
+        if (statements != nullptr) {
+            return block(statements, value, false);
+        }
+        return expression(dynamic_cast<Expression*>(body));
+    }
+
+    // Comparisons are only compiled as if conditions, straight into a jump, so
+    // no boolean ever has to be materialised.
+    bool FunctionCompiler::condition(Expression *exp, std::vector<size_t> &otherwise) {
+        if (exp == nullptr) {
+            return false;
+        }
+        if (exp->type() == "Boolean") {
+            if (!dynamic_cast<Boolean*>(exp)->value) {
+                otherwise.push_back(a.jump());
+            }
+            return true;
+        }
+        if (exp->type() != "InfixExpression") {
+            return false;
+        }
+        InfixExpression *infix = dynamic_cast<InfixExpression*>(exp);
+        Condition inverse;
+        if (infix->op == "<") {
+            inverse = GREATER_EQUAL;
+        } else if (infix->op == ">") {
+            inverse = LESS_EQUAL;
+        } else if (infix->op == "==") {
+            inverse = NOT_EQUAL;
+        } else if (infix->op == "!=") {
+            inverse = EQUAL;
+        } else {
+            return false;
+        }
+        if (!operands(infix->left, infix->right)) {
+            return false;
+        }
+        // cmp rax, rcx
+        a.emit({0x48, 0x39, 0xC8});
+        otherwise.push_back(a.jumpIf(inverse));
+        return true;
+    }
+
+    // Leaves left in rax and right in rcx.
+    bool FunctionCompiler::operands(Expression *left, Expression *right) {
+        if (!expression(left)) {
+            return false;
+        }
+        push();
+        if (!expression(right)) {
+            return false;
+        }
+        // mov rcx, rax
+        a.emit({0x48, 0x89, 0xC1});
+        pop(RAX);
+        return true;
+    }
+
+    bool FunctionCompiler::call(CallExpression *exp) {
+        Identifier *name = dynamic_cast<Identifier*>(exp->function);
+        if (name == nullptr || slots.count(name->symbol) > 0 || session.globals->counts().assignments(name->symbol) > 0) {
+            return false;
+        }
+        auto found = session.globals->store->find(name->symbol);
+        if (found == session.globals->store->end() || typeid(*found->second) != typeid(object::Function)) {
+            return false;
+        }
+        object::Function *callee = static_cast<object::Function*>(found->second);
+        if (exp->arguments.size() != callee->parameters->size()) {
+            return false;
+        }
+        jit::Code *code = session.function(callee);
+        if (code == nullptr) {
+            return false;
+        }
+        for (auto arg : exp->arguments) {
+            if (!expression(arg)) {
+                return false;
+            }
+            push();
+        }
+        for (size_t i = exp->arguments.size(); i > 0; i--) {
+            pop(ARGUMENT_REGISTERS[i - 1]);
+        }
+        bool pad = depth % 2 != 0;
+        if (pad) {
+            // sub rsp, 8
+            a.emit({0x48, 0x83, 0xEC, 0x08});
+        }
+        // mov rax, &code->entry; call [rax]
+        a.emit({0x48, 0xB8});
+        a.emit64((int64_t)&code->entry);
+        a.emit({0xFF, 0x10});
+        if (pad) {
+            // add rsp, 8
+            a.emit({0x48, 0x83, 0xC4, 0x08});
+        }
+        // test rdx, rdx
+        a.emit({0x48, 0x85, 0xD2});
+        bailOutIf(NOT_EQUAL);
+        return true;
+    }
+
+    void FunctionCompiler::load(int32_t offset) {
+        // mov rax, [rbp + offset]
+        a.emit({0x48, 0x8B, 0x85});
+        a.emit32(offset);
+    }
+
+    void FunctionCompiler::store(Register reg, int32_t offset) {
+        // mov [rbp + offset], reg
+        a.emit({(uint8_t)(reg >= 8 ? 0x4C : 0x48), 0x89, (uint8_t)(0x85 | ((reg & 7) << 3))});
+        a.emit32(offset);
+    }
+
+    void FunctionCompiler::push() {
+        // push rax
+        a.emit({0x50});
+        depth++;
+    }
+
+    void FunctionCompiler::pop(Register reg) {
+        if (reg >= 8) {
+            a.emit({0x41});
+        }
+        a.emit({(uint8_t)(0x58 + (reg & 7))});
+        depth--;
+    }
+
+    void FunctionCompiler::bailOutIf(Condition cc) {
+        bailouts.push_back(a.jumpIf(cc));
+    }
+} // namespace
+
+jit::Code* jit::compile(object::Function *fn) {
+    if (fn->env->outer != nullptr || fn->env->copiedFrom != nullptr) {
+        return nullptr;
+    }
+    Session session(fn->env);
+    jit::Code *code = session.function(fn);
+    if (code == nullptr) {
+        return nullptr;
+    }
+    session.install();
+    return fn->literal->native;
+}
+
+object::Object* jit::tryCall(object::Function *fn, std::vector<object::Object*> &args) {
+    FunctionLiteral *literal = fn->literal;
+    // Native code does not check its stack, and generator stacks have no
+    // guard page to stop it, so generator bodies interpret every call.
+    if (!enabled || literal == nullptr || generator::running()) {
+        return nullptr;
+    }
+    jit::Code *code = literal->native;
+    size_t assignments = fn->env->counts().total;
+    if (scheduler::concurrent() && (code == nullptr || code->assignments != assignments)) {
+        return nullptr;
+    }
+    if (code != nullptr && code->assignments != assignments) {
+        dropStale(literal, assignments);
+        literal->calls = 0;
+        code = nullptr;
+    }
+    if (code == nullptr) {
+        if (literal->nativeFailed || ++literal->calls < threshold) {
+            return nullptr;
+        }
+        code = compile(fn);
+        if (code == nullptr) {
+            literal->nativeFailed = true;
+            return nullptr;
+        }
+    }
+    object::Environment *globals = fn->env->copiedFrom != nullptr ? fn->env->copiedFrom : fn->env;
+    if (code->globals != globals || args.size() != code->parameters) {
+        return nullptr;
+    }
+    int64_t a[MAX_PARAMETERS];
+    for (size_t i = 0; i < args.size(); i++) {
+        if (typeid(*args[i]) != typeid(object::Integer) || static_cast<object::Integer*>(args[i])->big != nullptr) {
+            return nullptr;
+        }
+        a[i] = static_cast<object::Integer*>(args[i])->value;
+    }
+    jit::Result result;
+    switch (code->parameters) {
+        case 0: result = reinterpret_cast<jit::Result (*)()>(code->entry)(); break;
+        case 1: result = reinterpret_cast<jit::Result (*)(int64_t)>(code->entry)(a[0]); break;
+        case 2: result = reinterpret_cast<jit::Result (*)(int64_t, int64_t)>(code->entry)(a[0], a[1]); break;
+        case 3: result = reinterpret_cast<jit::Result (*)(int64_t, int64_t, int64_t)>(code->entry)(a[0], a[1], a[2]); break;
+        case 4: result = reinterpret_cast<jit::Result (*)(int64_t, int64_t, int64_t, int64_t)>(code->entry)(a[0], a[1], a[2], a[3]); break;
+        case 5: result = reinterpret_cast<jit::Result (*)(int64_t, int64_t, int64_t, int64_t, int64_t)>(code->entry)(a[0], a[1], a[2], a[3], a[4]); break;
+        default: result = reinterpret_cast<jit::Result (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t)>(code->entry)(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    }
+    if (result.failed) {
+        jit::bailouts++;
+        return nullptr;
+    }
+    return object::Integer::make(result.value);
+}
+
+#else
+
+jit::Code* jit::compile(object::Function *fn) {
+    return nullptr;
+}
+
+object::Object* jit::tryCall(object::Function *fn, std::vector<object::Object*> &args) {
+    return nullptr;
+}
+
+#endif
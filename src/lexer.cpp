@@ -30,6 +30,10 @@ Token Lexer::nextToken() {
             char ch = this->ch;
             this->readChar();
             tok = Token(token::EQ, {ch, this->ch});
+        } else if (this->peekChar() == '>') {
+            char ch = this->ch;
+            this->readChar();
+            tok = Token(token::ARROW, {ch, this->ch});
         } else {
             tok = Token(token::ASSIGN, {this->ch});
         }
@@ -88,6 +92,15 @@ Token Lexer::nextToken() {
     case ']':
         tok = Token(token::RBRACKET, {this->ch});
         break;
+    case '.':
+        if (this->peekChar() == '.') {
+            char ch = this->ch;
+            this->readChar();
+            tok = Token(token::DOTDOT, {ch, this->ch});
+        } else {
+            tok = Token(token::ILLEGAL, {this->ch});
+        }
+        break;
     case '"':
         tok = Token(token::STRING, this->readString());
         break;
@@ -102,7 +115,7 @@ Token Lexer::nextToken() {
             return tok;
         } else if (isdigit(this->ch)) {
             std::string literal = this->readNumber();
-            tok = Token(token::INT, literal);
+            tok = Token(literal.find('.') != std::string::npos ? token::FLOAT : token::INT, literal);
             return tok;
         } else {
             tok = Token(token::ILLEGAL, {this->ch});
@@ -128,11 +141,19 @@ std::string Lexer::readIdentifier() {
     return this->input.substr(position, this->position - position);
 }
 
+// Digits, then a fraction if a point is followed by a digit; a point
+// followed by another point is the start of a range instead.
 std::string Lexer::readNumber() {
     int position = this->position;
     while (isDigit(this->ch)) {
         this->readChar();
     }
+    if (this->ch == '.' && isDigit(this->peekChar())) {
+        this->readChar();
+        while (isDigit(this->ch)) {
+            this->readChar();
+        }
+    }
     return this->input.substr(position, this->position - position);
 }
 
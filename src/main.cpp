@@ -1,9 +1,107 @@
 #include <iostream>
+#include <string>
+#include <vector>
 #include "repl.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "jit.hh"
+#include "inliner.hh"
+#include "types.hh"
+#include "scheduler.hh"
+#include "isolate.hh"
+#include "parallel.hh"
+#include "packed.hh"
+#include "memo.hh"
 
-int main() {
+static const char *usage = "usage: wfi [--engine=tree|closure] [--no-jit] [--no-inline] [--no-types] [--no-simd] [--memo] [--threads=N] [--parallel-args] [--scheduler-stats] [--emit-cpp[=out.cpp]] [script...]";
+
+// Whether text is a thread count wfi takes: digits only, at most 4096.
+static bool parseThreads(const std::string &text, size_t &out) {
+    if (text.empty() || text.size() > 4 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    out = std::stoul(text);
+    return out <= 4096;
+}
+
+int main(int argc, char *argv[]) {
+    repl::engine_t engine = evaluator::eval;
+    std::string script;
+    std::vector<std::string> more;
+    bool emit = false;
+    bool stats = false;
+    std::string output;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--engine=tree") {
+            engine = evaluator::eval;
+        } else if (arg == "--engine=closure") {
+            engine = compiler::eval;
+        } else if (arg == "--no-jit") {
+            jit::enabled = false;
+        } else if (arg == "--no-inline") {
+            inliner::enabled = false;
+        } else if (arg == "--no-types") {
+            types::enabled = false;
+        } else if (arg == "--no-simd") {
+            packed::vectorize = false;
+        } else if (arg == "--memo") {
+            memo::automatic = true;
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            if (!parseThreads(arg.substr(10), scheduler::threads)) {
+                std::cerr << "invalid thread count: " << arg.substr(10) << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+        } else if (arg == "--parallel-args") {
+            parallel::arguments = true;
+        } else if (arg == "--scheduler-stats") {
+            stats = true;
+        } else if (arg == "--emit-cpp") {
+            emit = true;
+        } else if (arg.compare(0, 11, "--emit-cpp=") == 0) {
+            emit = true;
+            output = arg.substr(11);
+        } else if (arg[0] != '-' && script.empty()) {
+            script = arg;
+        } else if (arg[0] != '-') {
+            more.push_back(arg);
+        } else {
+            std::cerr << "unknown option: " << arg << std::endl;
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+    }
+    isolate::engine = engine;
+    if (emit) {
+        if (script.empty()) {
+            std::cerr << "--emit-cpp needs a script" << std::endl;
+            return 1;
+        }
+        if (!more.empty()) {
+            std::cerr << "--emit-cpp takes one script" << std::endl;
+            return 1;
+        }
+        return repl::EmitCpp(script, output);
+    }
+    if (!script.empty()) {
+        int status;
+        if (more.empty()) {
+            status = repl::Run(script, engine);
+        } else {
+            more.insert(more.begin(), script);
+            status = repl::RunIsolated(more, engine);
+        }
+        if (stats) {
+            std::vector<scheduler::Counters> counters = scheduler::counters();
+            for (size_t i = 0; i < counters.size(); i++) {
+                std::cerr << (i + 1 < counters.size() ? "worker " + std::to_string(i) : std::string("outside")) << ": steals=" << counters[i].steals << " idles=" << counters[i].idles << std::endl;
+            }
+        }
+        return status;
+    }
     std::cout << "Hello! This is the Fletchlang programming language!" << std::endl;
     std::cout << "Feel free to type in commands" << std::endl;
-    repl::Start();
+    repl::Start(engine);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <set>
+#include <typeinfo>
+#include "memo.hh"
+#include "evaluator.hh"
+#include "parallel.hh"
+
+bool memo::automatic = false;
+size_t memo::capacity = 4096;
+
+namespace {
+    // Tells values of different types with the same hash_key apart, such
+    // as 1 and true.
+    uint64_t typeTag(object::Object *value) {
+        if (typeid(*value) == typeid(object::Integer)) {
+            return 0;
+        } else if (typeid(*value) == typeid(object::String)) {
+            return 1;
+        }
+        return 2;
+    }
+
+    // Whether hashable a and b are the same value.
+    bool same(object::Object *a, object::Object *b) {
+        if (typeid(*a) != typeid(*b)) {
+            return false;
+        } else if (typeid(*a) == typeid(object::Integer)) {
+            object::Integer *x = static_cast<object::Integer*>(a);
+            object::Integer *y = static_cast<object::Integer*>(b);
+            if (x->big != nullptr || y->big != nullptr) {
+                return x->big != nullptr && y->big != nullptr && x->big->compare(*y->big) == 0;
+            }
+            return x->value == y->value;
+        } else if (typeid(*a) == typeid(object::String)) {
+            return static_cast<object::String*>(a)->equals(static_cast<object::String*>(b));
+        }
+        return static_cast<object::Boolean*>(a)->value == static_cast<object::Boolean*>(b)->value;
+    }
+
+    bool pureValue(const intern::Symbol *name, object::Object *value, const analysis::NameCounts &names, const intern::Symbol *self, std::set<object::Function*> &seen);
+
+    bool pureFunction(object::Function *fn, const intern::Symbol *self, std::set<object::Function*> &seen) {
+        if (!seen.insert(fn).second) {
+            return true;
+        }
+        if (fn->literal == nullptr || fn->literal->generator) {
+            return false;
+        }
+        for (auto name : fn->literal->freeVariables) {
+            if (!pureValue(name, fn->env->get(name), fn->env->counts(), self, seen)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool pureValue(const intern::Symbol *name, object::Object *value, const analysis::NameCounts &names, const intern::Symbol *self, std::set<object::Function*> &seen) {
+        if (name == self) {
+            return true;
+        }
+        if (names.assignments(name) > 0) {
+            return false;
+        }
+        if (value == nullptr) {
+            return evaluator::builtins.count(name->value) > 0;
+        }
+        const std::type_info &type = typeid(*value);
+        if (type == typeid(object::Integer) || type == typeid(object::String) || type == typeid(object::Boolean) || type == typeid(object::Float)) {
+            return true;
+        } else if (type == typeid(object::Function)) {
+            return pureFunction(static_cast<object::Function*>(value), self, seen);
+        }
+        // Builtins with effects are ruled out by parallel::isolated.
+        return dynamic_cast<object::Builtin*>(value) != nullptr;
+    }
+} // namespace
+
+memo::Memo::Memo(object::Object *fn, size_t capacity, const intern::Symbol *self) : object::Builtin(nullptr), callee(fn), limit(capacity), hits(0), misses(0), self(self), checked(0), withdrawn(false) {
+    this->fn = [this](std::vector<object::Object*> args) {
+        return call(args);
+    };
+    // Calls may run in parallel exactly when calls to fn may.
+    object::Function *function = dynamic_cast<object::Function*>(fn);
+    object::Builtin *builtin = dynamic_cast<object::Builtin*>(fn);
+    this->effects = function != nullptr ? !parallel::isolated(function) : builtin->effects;
+    if (self != nullptr) {
+        this->checked = function->env->counts().total;
+    }
+}
+
+bool memo::Memo::current() {
+    if (this->self == nullptr || this->withdrawn) {
+        return !this->withdrawn;
+    }
+    object::Function *function = static_cast<object::Function*>(this->callee);
+    size_t total = function->env->counts().total;
+    if (total != this->checked) {
+        this->checked = total;
+        // A global fn reads may have been assigned, so what cached results
+        // were computed from may have changed.
+        if (!pure(function, this->self)) {
+            this->withdrawn = true;
+            this->entries.clear();
+            this->recent.clear();
+        }
+    }
+    return !this->withdrawn;
+}
+
+std::string memo::Memo::inspect() {
+    return "memo(" + this->callee->inspect() + ")";
+}
+
+size_t memo::Memo::KeyHash::operator()(const Key &key) const {
+    return key.hash;
+}
+
+bool memo::Memo::KeyEqual::operator()(const Key &a, const Key &b) const {
+    if (a.hash != b.hash || a.args.size() != b.args.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.args.size(); i++) {
+        if (!same(a.args[i], b.args[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+object::Object* memo::Memo::call(std::vector<object::Object*> &args) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto arg : args) {
+        if (!arg->hashable()) {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->misses++;
+            }
+            return parallel::call(this->callee, args);
+        }
+        hash = (hash ^ typeTag(arg)) * 1099511628211ULL;
+        hash = (hash ^ arg->hash_key()) * 1099511628211ULL;
+    }
+    Key key{args, hash};
+    bool caching;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        caching = this->current();
+        if (caching) {
+            auto found = this->entries.find(key);
+            if (found != this->entries.end()) {
+                this->hits++;
+                this->recent.splice(this->recent.begin(), this->recent, found->second);
+                return found->second->second;
+            }
+        }
+        this->misses++;
+    }
+    object::Object *result = parallel::call(this->callee, args);
+    if (!caching || evaluator::isError(result)) {
+        return result;
+    }
+    std::lock_guard<std::mutex> guard(this->lock);
+    // A recursive or concurrent call may have stored it meanwhile.
+    if (!this->withdrawn && this->entries.count(key) == 0) {
+        this->recent.push_front({key, result});
+        this->entries[key] = this->recent.begin();
+        if (this->recent.size() > this->limit) {
+            this->entries.erase(this->recent.back().first);
+            this->recent.pop_back();
+        }
+    }
+    return result;
+}
+
+void memo::Memo::counts(size_t &hits, size_t &misses, size_t &size) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    hits = this->hits;
+    misses = this->misses;
+    size = this->recent.size();
+}
+
+bool memo::pure(object::Function *fn, const intern::Symbol *name) {
+    if (fn->literal == nullptr || fn->env->counts().assignments(name) > 0 || !parallel::isolated(fn)) {
+        return false;
+    }
+    auto &free = fn->literal->freeVariables;
+    if (std::find(free.begin(), free.end(), name) == free.end()) {
+        return false;
+    }
+    std::set<object::Function*> seen;
+    return pureFunction(fn, name, seen);
+}
+
+object::Object* memo::bind(const intern::Symbol *name, object::Object *value, object::Environment *env) {
+    if (!memo::automatic || env->outer != nullptr || typeid(*value) != typeid(object::Function)) {
+        return value;
+    }
+    if (!pure(static_cast<object::Function*>(value), name)) {
+        return value;
+    }
+    return new Memo(value, memo::capacity, name);
+}
+
+object::Object* memo::memoize(std::vector<object::Object*> args) {
+    if (args.empty() || args.size() > 2) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+    }
+    object::Object *fn = args[0];
+    if (fn->type() != object::FUNCTION_OBJ && fn->type() != object::BUILTIN_OBJ) {
+        return new object::Error("argument to `memo` must be FUNCTION, got " + fn->type());
+    }
+    object::Function *function = dynamic_cast<object::Function*>(fn);
+    if (function != nullptr && function->literal != nullptr && function->literal->generator) {
+        return new object::Error("cannot memoize a generator function");
+    }
+    size_t size = memo::capacity;
+    if (args.size() == 2) {
+        object::Integer *n = dynamic_cast<object::Integer*>(args[1]);
+        if (n == nullptr) {
+            return new object::Error("argument to `memo` must be INTEGER, got " + args[1]->type());
+        }
+        if (n->big != nullptr || n->value < 1) {
+            return new object::Error("memo capacity must be positive, got " + n->inspect());
+        }
+        size = n->value;
+    }
+    return new Memo(fn, size);
+}
+
+object::Object* memo::stats(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    Memo *memoized = dynamic_cast<Memo*>(args[0]);
+    if (memoized == nullptr) {
+        return new object::Error("argument to `memoStats` must be a memoized function, got " + args[0]->type());
+    }
+    size_t hits, misses, size;
+    memoized->counts(hits, misses, size);
+    return new object::Hash(std::map<object::Object*, object::Object*>{
+        {object::String::literal(intern::symbol("hits")), object::Integer::make(hits)},
+        {object::String::literal(intern::symbol("misses")), object::Integer::make(misses)},
+        {object::String::literal(intern::symbol("size")), object::Integer::make(size)},
+    });
+}
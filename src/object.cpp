@@ -1,3 +1,10 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <typeinfo>
+#include <mutex>
 #include "object.hh"
 
 ObjectType object::Integer::type() {
@@ -5,9 +12,80 @@ ObjectType object::Integer::type() {
 }
 
 std::string object::Integer::inspect() {
+    if (this->big != nullptr) {
+        return this->big->toString();
+    }
     return std::to_string(this->value);
 }
 
+double object::Integer::toDouble() {
+    if (this->big != nullptr) {
+        return strtod(this->big->toString().c_str(), nullptr);
+    }
+    return static_cast<double>(this->value);
+}
+
+bigint::BigInt object::Integer::toBig() {
+    if (this->big != nullptr) {
+        return *this->big;
+    }
+    return bigint::BigInt::fromInt64(this->value);
+}
+
+static thread_local size_t smallIntHits = 0;
+
+object::Integer* object::Integer::make(int64_t value) {
+    static object::Integer **cache = []() {
+        object::Integer **table = new object::Integer*[WFI_SMALL_INT_MAX - WFI_SMALL_INT_MIN + 1];
+        for (int64_t i = WFI_SMALL_INT_MIN; i <= WFI_SMALL_INT_MAX; i++) {
+            table[i - WFI_SMALL_INT_MIN] = new object::Integer(i);
+        }
+        return table;
+    }();
+    if (value >= WFI_SMALL_INT_MIN && value <= WFI_SMALL_INT_MAX) {
+        smallIntHits++;
+        return cache[value - WFI_SMALL_INT_MIN];
+    }
+    return new object::Integer(value);
+}
+
+size_t object::Integer::cacheHits() {
+    return smallIntHits;
+}
+
+object::Integer* object::Integer::fromBig(const bigint::BigInt &value) {
+    if (value.fitsInt64()) {
+        return object::Integer::make(value.toInt64());
+    }
+    object::Integer *out = new object::Integer(value.negative ? INT64_MIN : INT64_MAX);
+    out->big = new bigint::BigInt(value);
+    return out;
+}
+
+ObjectType object::Float::type() {
+    return object::FLOAT_OBJ;
+}
+
+std::string object::Float::inspect() {
+    if (std::isnan(this->value)) {
+        return "nan";
+    } else if (std::isinf(this->value)) {
+        return this->value < 0 ? "-inf" : "inf";
+    }
+    char digits[32];
+    for (int precision = 15; precision <= 17; precision++) {
+        snprintf(digits, sizeof(digits), "%.*g", precision, this->value);
+        if (strtod(digits, nullptr) == this->value) {
+            break;
+        }
+    }
+    std::string out = digits;
+    if (out.find_first_of(".e") == std::string::npos) {
+        out += ".0";
+    }
+    return out;
+}
+
 ObjectType object::Boolean::type() {
     return object::BOOLEAN_OBJ;
 }
@@ -21,7 +99,128 @@ ObjectType object::String::type() {
 }
 
 std::string object::String::inspect() {
-    return this->value;
+    return this->value();
+}
+
+// Guards the one-time work on shared strings. Recursive because flattening
+// reads the data of children and slice parents, which may need it too.
+static std::recursive_mutex& stringLock() {
+    static std::recursive_mutex lock;
+    return lock;
+}
+
+const std::string& object::String::value() {
+    if (this->left != nullptr) {
+        this->flatten();
+    } else if (this->parent != nullptr && !this->copied) {
+        std::lock_guard<std::recursive_mutex> guard(stringLock());
+        if (!this->copied) {
+            this->flat.assign(this->data(), this->length);
+            this->copied = true;
+        }
+    }
+    return this->flat;
+}
+
+const char* object::String::data() {
+    if (this->left != nullptr) {
+        this->flatten();
+    }
+    if (this->parent != nullptr) {
+        return this->parent->data() + this->offset;
+    }
+    return this->flat.data();
+}
+
+void object::String::flatten() {
+    std::lock_guard<std::recursive_mutex> guard(stringLock());
+    if (this->left == nullptr) {
+        return;
+    }
+    // Walk the rope iteratively; a long chain of appends would overflow the native stack.
+    std::string out;
+    out.reserve(this->length);
+    std::vector<object::String*> stack = {this->right, this->left};
+    while (!stack.empty()) {
+        object::String *node = stack.back();
+        stack.pop_back();
+        if (node->left == nullptr) {
+            out.append(node->data(), node->length);
+        } else {
+            stack.push_back(node->right);
+            stack.push_back(node->left);
+        }
+    }
+    this->flat = std::move(out);
+    this->right = nullptr;
+    this->left = nullptr;
+}
+
+object::String* object::String::concat(object::String *left, object::String *right) {
+    // Copying is cheaper than a rope node for short results.
+    static const size_t ROPE_THRESHOLD = 64;
+    if (left->length + right->length < ROPE_THRESHOLD) {
+        return new object::String(left->value() + right->value());
+    }
+    if (left->length == 0) {
+        return right;
+    }
+    if (right->length == 0) {
+        return left;
+    }
+    return new object::String(left, right);
+}
+
+object::String* object::String::slice(object::String *str, size_t offset, size_t length) {
+    if (offset == 0 && length == str->length) {
+        return str;
+    }
+    // Always point at the string that owns the buffer so slices never chain.
+    if (str->parent != nullptr) {
+        offset += str->offset;
+        str = str->parent;
+    }
+    return new object::String(str, offset, length);
+}
+
+uint64_t object::String::hash_value() {
+    if (!this->hashed) {
+        std::hash<std::string> hash_fn;
+        uint64_t hash = hash_fn(this->value());
+        std::lock_guard<std::recursive_mutex> guard(stringLock());
+        if (!this->hashed) {
+            this->hash = hash;
+            this->hashed = true;
+        }
+    }
+    return this->hash;
+}
+
+bool object::String::equals(object::String *other) {
+    if (this->symbol != nullptr && other->symbol != nullptr) {
+        return this->symbol == other->symbol;
+    }
+    if (this->length != other->length) {
+        return false;
+    }
+    if (this->hashed && other->hashed && this->hash != other->hash) {
+        return false;
+    }
+    return memcmp(this->data(), other->data(), this->length) == 0;
+}
+
+object::String* object::String::literal(const intern::Symbol *symbol) {
+    // Strings are immutable, so every evaluation of the same literal can share one object.
+    static std::map<const intern::Symbol*, object::String*> literals;
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = literals.find(symbol);
+    if (found != literals.end()) {
+        return found->second;
+    }
+    object::String *str = new object::String(symbol);
+    literals.insert({symbol, str});
+    return str;
 }
 
 ObjectType object::Null::type() {
@@ -40,6 +239,14 @@ std::string object::ReturnValue::inspect() {
     return this->value->inspect();
 }
 
+ObjectType object::LoopControl::type() {
+    return isBreak ? object::BREAK_OBJ : object::CONTINUE_OBJ;
+}
+
+std::string object::LoopControl::inspect() {
+    return isBreak ? "break" : "continue";
+}
+
 ObjectType object::Function::type() {
     return object::FUNCTION_OBJ;
 }
@@ -76,6 +283,82 @@ std::string object::Array::inspect() {
     return out;
 }
 
+ObjectType object::PackedArray::type() {
+    return this->kind == INT64 ? object::INT64_ARRAY_OBJ : object::FLOAT64_ARRAY_OBJ;
+}
+
+std::string object::PackedArray::inspect() {
+    std::string out = "[";
+    for (size_t i = 0; i < this->size(); i++) {
+        out += this->at(i)->inspect() + ", ";
+    }
+    out += "]";
+    return out;
+}
+
+size_t object::PackedArray::size() {
+    return this->kind == INT64 ? this->ints.size() : this->floats.size();
+}
+
+object::Object* object::PackedArray::at(size_t index) {
+    if (this->kind == INT64) {
+        return object::Integer::make(this->ints[index]);
+    }
+    return new object::Float(this->floats[index]);
+}
+
+object::Object* object::PackedArray::store(size_t index, object::Object *value) {
+    object::Integer *integer = dynamic_cast<object::Integer*>(value);
+    object::Float *number = dynamic_cast<object::Float*>(value);
+    if (this->kind == INT64) {
+        if (integer == nullptr || integer->big != nullptr) {
+            return new object::Error("cannot store " + value->type() + " in " + this->type());
+        }
+        if (index == this->ints.size()) {
+            this->ints.push_back(integer->value);
+        } else {
+            this->ints[index] = integer->value;
+        }
+        return value;
+    }
+    if (integer == nullptr && number == nullptr) {
+        return new object::Error("cannot store " + value->type() + " in " + this->type());
+    }
+    double d = number != nullptr ? number->value : integer->toDouble();
+    if (index == this->floats.size()) {
+        this->floats.push_back(d);
+    } else {
+        this->floats[index] = d;
+    }
+    return value;
+}
+
+object::PackedArray* object::PackedArray::pack(object::Array *array) {
+    bool floats = false;
+    for (auto element : array->elements) {
+        if (typeid(*element) == typeid(object::Float)) {
+            floats = true;
+        } else if (typeid(*element) != typeid(object::Integer) || static_cast<object::Integer*>(element)->big != nullptr) {
+            return nullptr;
+        }
+    }
+    if (!floats) {
+        std::vector<int64_t> ints;
+        ints.reserve(array->elements.size());
+        for (auto element : array->elements) {
+            ints.push_back(static_cast<object::Integer*>(element)->value);
+        }
+        return new object::PackedArray(ints);
+    }
+    std::vector<double> values;
+    values.reserve(array->elements.size());
+    for (auto element : array->elements) {
+        object::Float *number = dynamic_cast<object::Float*>(element);
+        values.push_back(number != nullptr ? number->value : static_cast<object::Integer*>(element)->toDouble());
+    }
+    return new object::PackedArray(values);
+}
+
 ObjectType object::Error::type() {
     return object::ERROR_OBJ;
 }
@@ -85,11 +368,48 @@ std::string object::Error::inspect() {
 }
 
 object::Environment::Environment() {
-    store = new std::map<std::string, object::Object*>();
+    store = new std::map<const intern::Symbol*, object::Object*>();
     outer = nullptr;
+    function = nullptr;
+    captured = false;
+    escaped = false;
+    copiedFrom = nullptr;
+    version = 0;
+    names = nullptr;
+}
+
+object::Environment* object::Environment::globals() {
+    object::Environment *env = this;
+    while (env->outer != nullptr) {
+        env = env->outer;
+    }
+    return env;
+}
+
+const analysis::NameCounts& object::Environment::counts() {
+    static const analysis::NameCounts none;
+    object::Environment *globals = this->globals();
+    return globals->names != nullptr ? *globals->names : none;
+}
+
+void object::Environment::count(Program *program) {
+    if (program->counted == this) {
+        return;
+    }
+    program->counted = this;
+    if (this->names == nullptr) {
+        this->names = new analysis::NameCounts();
+    }
+    if (program->names != nullptr) {
+        this->names->add(*program->names);
+    }
 }
 
 object::Object* object::Environment::get(std::string name) {
+    return get(intern::symbol(name));
+}
+
+object::Object* object::Environment::get(const intern::Symbol *name) {
     auto found = store->find(name);
     if (found == store->end()) {
         if (outer == nullptr) {
@@ -101,10 +421,27 @@ object::Object* object::Environment::get(std::string name) {
 }
 
 object::Object* object::Environment::set(std::string name, object::Object *value) {
+    return set(intern::symbol(name), value);
+}
+
+object::Object* object::Environment::set(const intern::Symbol *name, object::Object *value) {
     store->insert({name, value});
+    version++;
     return value;
 }
 
+object::Object* object::Environment::assign(const intern::Symbol *name, object::Object *value) {
+    for (object::Environment *env = this; env != nullptr; env = env->outer) {
+        auto found = env->store->find(name);
+        if (found != env->store->end()) {
+            found->second = value;
+            env->version++;
+            return value;
+        }
+    }
+    return nullptr;
+}
+
 object::Environment* object::Environment::newEnclosedEnvironment() {
     object::Environment *env = new object::Environment();
     env->outer = this;
@@ -113,13 +450,12 @@ object::Environment* object::Environment::newEnclosedEnvironment() {
 
 
 uint64_t object::Object::hash_key() {
-    std::hash<std::string> hash_fn;
     if(this->type() == object::STRING_OBJ) {
         auto str = dynamic_cast<object::String*>(this);
-        return hash_fn(str->value);
+        return str->hash_value();
     } else if (this->type() == object::INTEGER_OBJ) {
         auto i = dynamic_cast<object::Integer*>(this);
-        return i->value;
+        return i->big != nullptr ? i->big->hash() : i->value;
     } else if (this->type() == object::BOOLEAN_OBJ) {
         auto b = dynamic_cast<object::Boolean*>(this);
         return b->value ? 1 : 0;
@@ -131,7 +467,38 @@ bool object::Object::hashable() {
     return this->type() == object::STRING_OBJ || this->type() == object::INTEGER_OBJ || this->type() == object::BOOLEAN_OBJ;
 }
 
-object::Hash::Hash(std::map<object::Object*, object::Object*> pairs) {
+int64_t object::Shape::slot(uint64_t hash) const {
+    auto found = std::lower_bound(this->hashes.begin(), this->hashes.end(), hash);
+    if (found == this->hashes.end() || *found != hash) {
+        return -1;
+    }
+    return found - this->hashes.begin();
+}
+
+const object::Shape* object::Shape::of(std::vector<const intern::Symbol*> keys) {
+    std::sort(keys.begin(), keys.end(), [](const intern::Symbol *a, const intern::Symbol *b) {
+        return a->hash < b->hash;
+    });
+    keys.erase(std::unique(keys.begin(), keys.end(), [](const intern::Symbol *a, const intern::Symbol *b) {
+        return a->hash == b->hash;
+    }), keys.end());
+    static std::map<std::vector<const intern::Symbol*>, object::Shape*> shapes;
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = shapes.find(keys);
+    if (found != shapes.end()) {
+        return found->second;
+    }
+    object::Shape *shape = new object::Shape();
+    for (auto key : keys) {
+        shape->keys.push_back(object::String::literal(key));
+        shape->hashes.push_back(key->hash);
+    }
+    shapes.insert({keys, shape});
+    return shape;
+}
+
+object::Hash::Hash(std::map<object::Object*, object::Object*> pairs) : shape(nullptr) {
     for(auto pair : pairs) {
         this->pairs[pair.first->hash_key()] = new HashPair(pair.first, pair.second);
     }
@@ -143,14 +510,70 @@ ObjectType object::Hash::type() {
 
 std::string object::Hash::inspect() {
     std::string out = "{";
-    int i = 0;
-    for (auto pair : this->pairs) {
-        object::HashPair hashPair = *pair.second;
-        out += hashPair.key->inspect() + ": " + hashPair.value->inspect();
-        if (i++ != this->pairs.size() - 1) {
+    auto pairs = this->entries();
+    for (size_t i = 0; i < pairs.size(); i++) {
+        out += pairs[i].first->inspect() + ": " + pairs[i].second->inspect();
+        if (i != pairs.size() - 1) {
             out += ", ";
         }
     }
     out += "}";
     return out;
 }
+
+object::Object* object::Hash::get(object::Object *key) {
+    uint64_t hash = key->hash_key();
+    if (this->shape != nullptr) {
+        int64_t slot = this->shape->slot(hash);
+        return slot < 0 ? nullptr : this->values[slot];
+    }
+    auto found = this->pairs.find(hash);
+    return found == this->pairs.end() ? nullptr : found->second->value;
+}
+
+void object::Hash::set(object::Object *key, object::Object *value) {
+    uint64_t hash = key->hash_key();
+    if (this->shape != nullptr) {
+        int64_t slot = this->shape->slot(hash);
+        if (slot >= 0) {
+            this->values[slot] = value;
+            return;
+        }
+        for (size_t i = 0; i < this->values.size(); i++) {
+            this->pairs[this->shape->hashes[i]] = new HashPair(this->shape->keys[i], this->values[i]);
+        }
+        this->shape = nullptr;
+        this->values.clear();
+    }
+    auto found = this->pairs.find(hash);
+    if (found != this->pairs.end()) {
+        found->second->value = value;
+    } else {
+        this->pairs.insert({hash, new HashPair(key, value)});
+    }
+}
+
+std::vector<std::pair<object::Object*, object::Object*>> object::Hash::entries() {
+    std::vector<std::pair<object::Object*, object::Object*>> out;
+    if (this->shape != nullptr) {
+        for (size_t i = 0; i < this->values.size(); i++) {
+            out.push_back({this->shape->keys[i], this->values[i]});
+        }
+        return out;
+    }
+    for (auto pair : this->pairs) {
+        out.push_back({pair.second->key, pair.second->value});
+    }
+    return out;
+}
+
+ObjectType object::Future::type() {
+    return object::FUTURE_OBJ;
+}
+
+std::string object::Future::inspect() {
+    if (!done) {
+        return "future(pending)";
+    }
+    return "future(" + value->inspect() + ")";
+}
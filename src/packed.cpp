@@ -0,0 +1,623 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <typeinfo>
+#include "packed.hh"
+#include "evaluator.hh"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PACKED_X86 1
+#endif
+
+bool packed::vectorize = true;
+
+namespace {
+    bool useAVX2() {
+#ifdef PACKED_X86
+        static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+        return packed::vectorize && hasAVX2;
+#else
+        return false;
+#endif
+    }
+
+    bool sumScalar(const int64_t *xs, size_t n, int64_t &out) {
+        int64_t total = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (__builtin_add_overflow(total, xs[i], &total)) {
+                return false;
+            }
+        }
+        out = total;
+        return true;
+    }
+
+    bool addScalar(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            if (__builtin_add_overflow(a[i], b[i], &out[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#ifdef PACKED_X86
+    // The integer kernels add four lanes at once and collect signed
+    // overflow as they go: a lane overflowed when the result's sign differs
+    // from the signs of both operands. A lane may overflow on the way to a
+    // total that would fit; that only costs the exact boxed fallback.
+
+    __attribute__((target("avx2")))
+    __m256i overflows(__m256i a, __m256i b, __m256i r) {
+        return _mm256_and_si256(_mm256_xor_si256(a, r), _mm256_xor_si256(b, r));
+    }
+
+    __attribute__((target("avx2")))
+    bool anySign(__m256i flags) {
+        return _mm256_movemask_pd(_mm256_castsi256_pd(flags)) != 0;
+    }
+
+    __attribute__((target("avx2")))
+    bool sumAVX2(const int64_t *xs, size_t n, int64_t &out) {
+        __m256i acc = _mm256_setzero_si256();
+        __m256i flags = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+            __m256i r = _mm256_add_epi64(acc, x);
+            flags = _mm256_or_si256(flags, overflows(acc, x, r));
+            acc = r;
+        }
+        if (anySign(flags)) {
+            return false;
+        }
+        int64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        int64_t total;
+        if (!sumScalar(lanes, 4, total) || !sumScalar(xs + i, n - i, out)) {
+            return false;
+        }
+        return !__builtin_add_overflow(total, out, &out);
+    }
+
+    __attribute__((target("avx2")))
+    int64_t minAVX2(const int64_t *xs, size_t n, bool max) {
+        __m256i best = _mm256_set1_epi64x(xs[0]);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+            __m256i take = max ? _mm256_cmpgt_epi64(x, best) : _mm256_cmpgt_epi64(best, x);
+            best = _mm256_blendv_epi8(best, x, take);
+        }
+        int64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), best);
+        int64_t result = lanes[0];
+        for (int lane = 1; lane < 4; lane++) {
+            result = max ? std::max(result, lanes[lane]) : std::min(result, lanes[lane]);
+        }
+        for (; i < n; i++) {
+            result = max ? std::max(result, xs[i]) : std::min(result, xs[i]);
+        }
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    bool addAVX2(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+        __m256i flags = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i r = _mm256_add_epi64(x, y);
+            flags = _mm256_or_si256(flags, overflows(x, y, r));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+        }
+        return !anySign(flags) && addScalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    double horizontal(__m256d acc) {
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    __attribute__((target("avx2")))
+    double sumAVX2(const double *xs, size_t n) {
+        __m256d acc = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc = _mm256_add_pd(acc, _mm256_loadu_pd(xs + i));
+        }
+        double total = horizontal(acc);
+        for (; i < n; i++) {
+            total += xs[i];
+        }
+        return total;
+    }
+
+    __attribute__((target("avx2")))
+    double minAVX2(const double *xs, size_t n, bool max) {
+        __m256d best = _mm256_set1_pd(xs[0]);
+        // _mm256_min_pd and _mm256_max_pd drop a NaN in best, so NaNs are
+        // tracked apart.
+        __m256d unordered = _mm256_cmp_pd(best, best, _CMP_UNORD_Q);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d x = _mm256_loadu_pd(xs + i);
+            unordered = _mm256_or_pd(unordered, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+            best = max ? _mm256_max_pd(best, x) : _mm256_min_pd(best, x);
+        }
+        if (_mm256_movemask_pd(unordered) != 0) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, best);
+        double result = lanes[0];
+        for (int lane = 1; lane < 4; lane++) {
+            result = max ? std::max(result, lanes[lane]) : std::min(result, lanes[lane]);
+        }
+        for (; i < n; i++) {
+            if (std::isnan(xs[i])) {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            result = max ? std::max(result, xs[i]) : std::min(result, xs[i]);
+        }
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    double dotAVX2(const double *a, const double *b, size_t n) {
+        __m256d acc = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        }
+        double total = horizontal(acc);
+        for (; i < n; i++) {
+            total += a[i] * b[i];
+        }
+        return total;
+    }
+
+    // out = a op b for add and mul, or a op k when b is nullptr, for scale.
+    __attribute__((target("avx2")))
+    void elementwiseAVX2(const double *a, const double *b, double k, double *out, size_t n, bool multiply) {
+        __m256d constant = _mm256_set1_pd(k);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d x = _mm256_loadu_pd(a + i);
+            __m256d y = b != nullptr ? _mm256_loadu_pd(b + i) : constant;
+            _mm256_storeu_pd(out + i, multiply ? _mm256_mul_pd(x, y) : _mm256_add_pd(x, y));
+        }
+        for (; i < n; i++) {
+            double y = b != nullptr ? b[i] : k;
+            out[i] = multiply ? a[i] * y : a[i] + y;
+        }
+    }
+#endif
+
+    object::Object* wrongArguments(size_t got, size_t want) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(got) + ", want=" + std::to_string(want));
+    }
+
+    // value as a packed array: packed arrays as they are, boxed ones packed.
+    object::PackedArray* operand(const std::string &name, object::Object *value, object::Object *&error) {
+        if (typeid(*value) == typeid(object::PackedArray)) {
+            return static_cast<object::PackedArray*>(value);
+        }
+        if (typeid(*value) != typeid(object::Array)) {
+            error = new object::Error("argument to `" + name + "` must be ARRAY, got " + value->type());
+            return nullptr;
+        }
+        object::PackedArray *array = object::PackedArray::pack(static_cast<object::Array*>(value));
+        if (array == nullptr) {
+            error = new object::Error("argument to `" + name + "` must hold only INTEGER and FLOAT elements, within 64 bits");
+        }
+        return array;
+    }
+
+    // Both arguments of a binary builtin, the same length, with int64 widened
+    // to float64 if the other is float64.
+    object::Object* operands(const std::string &name, std::vector<object::Object*> &args, object::PackedArray *&a, object::PackedArray *&b) {
+        if (args.size() != 2) {
+            return wrongArguments(args.size(), 2);
+        }
+        object::Object *error = nullptr;
+        a = operand(name, args[0], error);
+        if (a == nullptr) {
+            return error;
+        }
+        b = operand(name, args[1], error);
+        if (b == nullptr) {
+            return error;
+        }
+        if (a->size() != b->size()) {
+            return new object::Error("arrays passed to `" + name + "` must have the same length, got " + std::to_string(a->size()) + " and " + std::to_string(b->size()));
+        }
+        if (a->kind != b->kind) {
+            a = a->kind == object::PackedArray::FLOAT64 ? a : new object::PackedArray(std::vector<double>(a->ints.begin(), a->ints.end()));
+            b = b->kind == object::PackedArray::FLOAT64 ? b : new object::PackedArray(std::vector<double>(b->ints.begin(), b->ints.end()));
+        }
+        return nullptr;
+    }
+
+    // Works an integer operation out again element by element on boxed
+    // integers, which grow past 64 bits instead of overflowing.
+    object::Object* boxed(const std::string &op, object::PackedArray *a, const std::function<object::Object*(size_t)> &right) {
+        std::vector<object::Object*> elements;
+        for (size_t i = 0; i < a->size(); i++) {
+            elements.push_back(evaluator::evalInfixExpression(op, a->at(i), right(i)));
+        }
+        return new object::Array(elements);
+    }
+
+    // The same, folding the elements into a total with +.
+    object::Object* boxedTotal(object::PackedArray *a, const std::function<object::Object*(size_t)> &term) {
+        object::Object *total = object::Integer::make(0);
+        for (size_t i = 0; i < a->size(); i++) {
+            total = evaluator::evalInfixExpression("+", total, term(i));
+        }
+        return total;
+    }
+
+    object::Object* extreme(const std::string &name, std::vector<object::Object*> &args, bool max) {
+        if (args.size() != 1) {
+            return wrongArguments(args.size(), 1);
+        }
+        object::Object *error = nullptr;
+        object::PackedArray *xs = operand(name, args[0], error);
+        if (xs == nullptr) {
+            return error;
+        }
+        if (xs->size() == 0) {
+            return evaluator::NULLobj;
+        }
+        if (xs->kind == object::PackedArray::INT64) {
+            return object::Integer::make(max ? packed::kernel::max(xs->ints.data(), xs->size()) : packed::kernel::min(xs->ints.data(), xs->size()));
+        }
+        return new object::Float(max ? packed::kernel::max(xs->floats.data(), xs->size()) : packed::kernel::min(xs->floats.data(), xs->size()));
+    }
+} // namespace
+
+bool packed::kernel::sum(const int64_t *xs, size_t n, int64_t &out) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return sumAVX2(xs, n, out);
+    }
+#endif
+    return sumScalar(xs, n, out);
+}
+
+double packed::kernel::sum(const double *xs, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return sumAVX2(xs, n);
+    }
+#endif
+    double total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += xs[i];
+    }
+    return total;
+}
+
+int64_t packed::kernel::min(const int64_t *xs, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return minAVX2(xs, n, false);
+    }
+#endif
+    int64_t result = xs[0];
+    for (size_t i = 1; i < n; i++) {
+        result = std::min(result, xs[i]);
+    }
+    return result;
+}
+
+double packed::kernel::min(const double *xs, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return minAVX2(xs, n, false);
+    }
+#endif
+    double result = xs[0];
+    for (size_t i = 0; i < n; i++) {
+        if (std::isnan(xs[i])) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        result = std::min(result, xs[i]);
+    }
+    return result;
+}
+
+int64_t packed::kernel::max(const int64_t *xs, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return minAVX2(xs, n, true);
+    }
+#endif
+    int64_t result = xs[0];
+    for (size_t i = 1; i < n; i++) {
+        result = std::max(result, xs[i]);
+    }
+    return result;
+}
+
+double packed::kernel::max(const double *xs, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return minAVX2(xs, n, true);
+    }
+#endif
+    double result = xs[0];
+    for (size_t i = 0; i < n; i++) {
+        if (std::isnan(xs[i])) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        result = std::max(result, xs[i]);
+    }
+    return result;
+}
+
+bool packed::kernel::dot(const int64_t *a, const int64_t *b, size_t n, int64_t &out) {
+    int64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t product;
+        if (__builtin_mul_overflow(a[i], b[i], &product) || __builtin_add_overflow(total, product, &total)) {
+            return false;
+        }
+    }
+    out = total;
+    return true;
+}
+
+double packed::kernel::dot(const double *a, const double *b, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return dotAVX2(a, b, n);
+    }
+#endif
+    double total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+bool packed::kernel::add(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        return addAVX2(a, b, out, n);
+    }
+#endif
+    return addScalar(a, b, out, n);
+}
+
+void packed::kernel::add(const double *a, const double *b, double *out, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        elementwiseAVX2(a, b, 0, out, n, false);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+bool packed::kernel::mul(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_mul_overflow(a[i], b[i], &out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void packed::kernel::mul(const double *a, const double *b, double *out, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        elementwiseAVX2(a, b, 0, out, n, true);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+bool packed::kernel::scale(const int64_t *xs, int64_t k, int64_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_mul_overflow(xs[i], k, &out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void packed::kernel::scale(const double *xs, double k, double *out, size_t n) {
+#ifdef PACKED_X86
+    if (useAVX2()) {
+        elementwiseAVX2(xs, nullptr, k, out, n, true);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        out[i] = xs[i] * k;
+    }
+}
+
+bool packed::kernel::prefixSum(const int64_t *xs, int64_t *out, size_t n) {
+    int64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_add_overflow(total, xs[i], &total)) {
+            return false;
+        }
+        out[i] = total;
+    }
+    return true;
+}
+
+void packed::kernel::prefixSum(const double *xs, double *out, size_t n) {
+    double total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += xs[i];
+        out[i] = total;
+    }
+}
+
+object::Object* packed::pack(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return wrongArguments(args.size(), 1);
+    }
+    object::Object *error = nullptr;
+    object::PackedArray *xs = operand("pack", args[0], error);
+    return xs != nullptr ? xs : error;
+}
+
+object::Object* packed::sum(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return wrongArguments(args.size(), 1);
+    }
+    object::Object *error = nullptr;
+    object::PackedArray *xs = operand("sum", args[0], error);
+    if (xs == nullptr) {
+        return error;
+    }
+    if (xs->kind == object::PackedArray::FLOAT64) {
+        return new object::Float(packed::kernel::sum(xs->floats.data(), xs->size()));
+    }
+    int64_t total;
+    if (packed::kernel::sum(xs->ints.data(), xs->size(), total)) {
+        return object::Integer::make(total);
+    }
+    return boxedTotal(xs, [xs](size_t i) {
+        return xs->at(i);
+    });
+}
+
+object::Object* packed::min(std::vector<object::Object*> args) {
+    return extreme("min", args, false);
+}
+
+object::Object* packed::max(std::vector<object::Object*> args) {
+    return extreme("max", args, true);
+}
+
+object::Object* packed::dot(std::vector<object::Object*> args) {
+    object::PackedArray *a, *b;
+    object::Object *error = operands("dot", args, a, b);
+    if (error != nullptr) {
+        return error;
+    }
+    if (a->kind == object::PackedArray::FLOAT64) {
+        return new object::Float(packed::kernel::dot(a->floats.data(), b->floats.data(), a->size()));
+    }
+    int64_t total;
+    if (packed::kernel::dot(a->ints.data(), b->ints.data(), a->size(), total)) {
+        return object::Integer::make(total);
+    }
+    return boxedTotal(a, [a, b](size_t i) {
+        return evaluator::evalInfixExpression("*", a->at(i), b->at(i));
+    });
+}
+
+object::Object* packed::add(std::vector<object::Object*> args) {
+    object::PackedArray *a, *b;
+    object::Object *error = operands("add", args, a, b);
+    if (error != nullptr) {
+        return error;
+    }
+    if (a->kind == object::PackedArray::FLOAT64) {
+        std::vector<double> out(a->size());
+        packed::kernel::add(a->floats.data(), b->floats.data(), out.data(), out.size());
+        return new object::PackedArray(out);
+    }
+    std::vector<int64_t> out(a->size());
+    if (packed::kernel::add(a->ints.data(), b->ints.data(), out.data(), out.size())) {
+        return new object::PackedArray(out);
+    }
+    return boxed("+", a, [b](size_t i) {
+        return b->at(i);
+    });
+}
+
+object::Object* packed::mul(std::vector<object::Object*> args) {
+    object::PackedArray *a, *b;
+    object::Object *error = operands("mul", args, a, b);
+    if (error != nullptr) {
+        return error;
+    }
+    if (a->kind == object::PackedArray::FLOAT64) {
+        std::vector<double> out(a->size());
+        packed::kernel::mul(a->floats.data(), b->floats.data(), out.data(), out.size());
+        return new object::PackedArray(out);
+    }
+    std::vector<int64_t> out(a->size());
+    if (packed::kernel::mul(a->ints.data(), b->ints.data(), out.data(), out.size())) {
+        return new object::PackedArray(out);
+    }
+    return boxed("*", a, [b](size_t i) {
+        return b->at(i);
+    });
+}
+
+object::Object* packed::scale(std::vector<object::Object*> args) {
+    if (args.size() != 2) {
+        return wrongArguments(args.size(), 2);
+    }
+    object::Object *error = nullptr;
+    object::PackedArray *xs = operand("scale", args[0], error);
+    if (xs == nullptr) {
+        return error;
+    }
+    object::Object *k = args[1];
+    if (typeid(*k) != typeid(object::Integer) && typeid(*k) != typeid(object::Float)) {
+        return new object::Error("argument to `scale` must be INTEGER or FLOAT, got " + k->type());
+    }
+    object::Integer *integer = dynamic_cast<object::Integer*>(k);
+    if (xs->kind == object::PackedArray::INT64 && integer != nullptr) {
+        std::vector<int64_t> out(xs->size());
+        if (integer->big == nullptr && packed::kernel::scale(xs->ints.data(), integer->value, out.data(), out.size())) {
+            return new object::PackedArray(out);
+        }
+        return boxed("*", xs, [k](size_t) {
+            return k;
+        });
+    }
+    std::vector<double> floats = xs->kind == object::PackedArray::FLOAT64 ? xs->floats : std::vector<double>(xs->ints.begin(), xs->ints.end());
+    double factor = integer != nullptr ? integer->toDouble() : static_cast<object::Float*>(k)->value;
+    std::vector<double> out(floats.size());
+    packed::kernel::scale(floats.data(), factor, out.data(), out.size());
+    return new object::PackedArray(out);
+}
+
+object::Object* packed::prefixSum(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return wrongArguments(args.size(), 1);
+    }
+    object::Object *error = nullptr;
+    object::PackedArray *xs = operand("prefixSum", args[0], error);
+    if (xs == nullptr) {
+        return error;
+    }
+    if (xs->kind == object::PackedArray::FLOAT64) {
+        std::vector<double> out(xs->size());
+        packed::kernel::prefixSum(xs->floats.data(), out.data(), out.size());
+        return new object::PackedArray(out);
+    }
+    std::vector<int64_t> out(xs->size());
+    if (packed::kernel::prefixSum(xs->ints.data(), out.data(), out.size())) {
+        return new object::PackedArray(out);
+    }
+    std::vector<object::Object*> totals;
+    object::Object *total = object::Integer::make(0);
+    for (size_t i = 0; i < xs->size(); i++) {
+        total = evaluator::evalInfixExpression("+", total, xs->at(i));
+        totals.push_back(total);
+    }
+    return new object::Array(totals);
+}
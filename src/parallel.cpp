@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <typeinfo>
+#include "parallel.hh"
+#include "analysis.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "isolate.hh"
+#include "iterator.hh"
+#include "scheduler.hh"
+
+size_t parallel::threshold = 1024;
+bool parallel::arguments = false;
+uint64_t parallel::argumentNanos = 50000;
+
+namespace {
+    // Several chunks per thread even out elements of uneven cost.
+    const size_t CHUNKS_PER_THREAD = 8;
+    // preduce folds chunks of this many elements, whatever the number of
+    // threads, so its result only depends on its arguments.
+    const size_t REDUCE_CHUNK = 256;
+    // Timed sequential evaluations before a call site is decided.
+    const size_t ARGUMENT_SAMPLES = 4;
+
+    // Whether node assigns, or names a builtin with effects. Names are
+    // checked even where a local shadows the builtin.
+    bool writes(Node *node) {
+        bool effects = false;
+        analysis::walk(node, [&](Node *n) {
+            if (n->type() == "AssignExpression") {
+                effects = true;
+            } else if (n->type() == "Identifier") {
+                auto builtin = evaluator::builtins.find(dynamic_cast<Identifier*>(n)->value);
+                if (builtin != evaluator::builtins.end() && builtin->second->effects) {
+                    effects = true;
+                }
+            }
+            return !effects;
+        });
+        return effects;
+    }
+
+    bool isolated(object::Function *fn, std::set<object::Function*> &seen);
+
+    // Whether value may be used by calls running at the same time.
+    bool isolatedValue(object::Object *value, std::set<object::Function*> &seen) {
+        if (value == nullptr) {
+            return true;
+        }
+        if (typeid(*value) == typeid(object::Function)) {
+            return isolated(static_cast<object::Function*>(value), seen);
+        }
+        if (typeid(*value) == typeid(generator::Generator) || typeid(*value) == typeid(iterator::Iterator)) {
+            // Looping over it resumes it, which runs one call at a time.
+            return false;
+        }
+        object::Builtin *builtin = dynamic_cast<object::Builtin*>(value);
+        return builtin == nullptr || !builtin->effects;
+    }
+
+    bool isolated(object::Function *fn, std::set<object::Function*> &seen) {
+        if (fn->literal == nullptr || typeid(*fn->body) != typeid(BlockStatement)) {
+            return false;
+        }
+        if (!seen.insert(fn).second) {
+            return true;
+        }
+        if (writes(fn->body)) {
+            return false;
+        }
+        for (auto name : fn->literal->freeVariables) {
+            if (!isolatedValue(fn->env->get(name), seen)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Checks the arguments shared by every builtin here: an array, then a
+    // function taking arity arguments at position fnAt.
+    object::Object* checkArguments(const std::string &name, std::vector<object::Object*> &args, size_t want, size_t fnAt, size_t arity) {
+        if (args.size() != want) {
+            return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=" + std::to_string(want));
+        }
+        if (args[0]->type() != object::ARRAY_OBJ) {
+            return new object::Error("argument to `" + name + "` must be ARRAY, got " + args[0]->type());
+        }
+        object::Object *fn = args[fnAt];
+        if (fn->type() != object::FUNCTION_OBJ && fn->type() != object::BUILTIN_OBJ) {
+            return new object::Error("argument to `" + name + "` must be FUNCTION, got " + fn->type());
+        }
+        object::Function *function = dynamic_cast<object::Function*>(fn);
+        if (function != nullptr && function->parameters->size() != arity) {
+            return new object::Error("function passed to `" + name + "` must take " + std::to_string(arity) + (arity == 1 ? " argument" : " arguments") + ", got " + std::to_string(function->parameters->size()));
+        }
+        return nullptr;
+    }
+
+    object::Object* snapshot(object::Object *value, std::map<object::Object*, object::Object*> &copies);
+
+    // Copies fn so that it only reads scopes no other thread writes: a new
+    // global scope holding a snapshot of each of fn's free variables.
+    object::Function* copy(object::Function *fn, std::map<object::Object*, object::Object*> &copies) {
+        object::Environment *env = new object::Environment();
+        env->names = fn->env->globals()->names;
+        if (fn->env->outer == nullptr) {
+            env->copiedFrom = fn->env->copiedFrom != nullptr ? fn->env->copiedFrom : fn->env;
+        }
+        object::Function *copied = new object::Function(fn->parameters, fn->body, env, fn->literal);
+        copies[fn] = copied;
+        for (auto name : fn->literal->freeVariables) {
+            object::Object *value = fn->env->get(name);
+            if (value != nullptr) {
+                env->set(name, snapshot(value, copies));
+            }
+        }
+        return copied;
+    }
+
+    // Returns value as a spawned task may hold it while the spawning thread
+    // goes on. Functions are copied, and arrays and hashes, which assignments
+    // change in place, are copied deeply, as isolate::share copies them.
+    // Everything else never changes once made.
+    object::Object* snapshot(object::Object *value, std::map<object::Object*, object::Object*> &copies) {
+        const std::type_info &type = typeid(*value);
+        if (type != typeid(object::Function) && type != typeid(object::Array) && type != typeid(object::PackedArray) && type != typeid(object::Hash)) {
+            return value;
+        }
+        if (type == typeid(object::Function) && static_cast<object::Function*>(value)->literal == nullptr) {
+            return value;
+        }
+        auto found = copies.find(value);
+        if (found != copies.end()) {
+            return found->second;
+        }
+        if (type == typeid(object::Function)) {
+            return copy(static_cast<object::Function*>(value), copies);
+        } else if (type == typeid(object::PackedArray)) {
+            object::PackedArray *packed = new object::PackedArray(*static_cast<object::PackedArray*>(value));
+            copies[value] = packed;
+            return packed;
+        } else if (type == typeid(object::Array)) {
+            object::Array *array = new object::Array({});
+            copies[value] = array;
+            for (auto element : static_cast<object::Array*>(value)->elements) {
+                array->elements.push_back(snapshot(element, copies));
+            }
+            return array;
+        }
+        object::Hash *hash = static_cast<object::Hash*>(value);
+        object::Hash *copied = new object::Hash();
+        copies[value] = copied;
+        // Shapes are immutable, so the copy keeps the original's.
+        copied->shape = hash->shape;
+        for (auto element : hash->values) {
+            copied->values.push_back(snapshot(element, copies));
+        }
+        for (auto pair : hash->pairs) {
+            copied->pairs[pair.first] = new object::HashPair(pair.second->key, snapshot(pair.second->value, copies));
+        }
+        return copied;
+    }
+
+    bool independent(ArgumentProfile &profile, object::Environment *env);
+
+    void decide(CallExpression *call, object::Environment *env) {
+        ArgumentProfile &profile = call->argumentProfile;
+        size_t slow = 0;
+        for (auto nanos : profile.nanos) {
+            if (nanos / profile.samples >= parallel::argumentNanos) {
+                slow++;
+            }
+        }
+        bool effects = false;
+        std::set<const intern::Symbol*> seen;
+        for (auto argument : call->arguments) {
+            effects = effects || writes(argument);
+            analysis::walk(argument, [&](Node *node) {
+                if (node->type() == "Identifier" && seen.insert(dynamic_cast<Identifier*>(node)->symbol).second) {
+                    profile.names.push_back(dynamic_cast<Identifier*>(node)->symbol);
+                }
+                return true;
+            });
+        }
+        bool parallel = slow >= 2 && !effects && scheduler::workers() > 0 && independent(profile, env);
+        profile.decision = parallel ? ArgumentProfile::PARALLEL : ArgumentProfile::SEQUENTIAL;
+    }
+
+    // Whether everything the arguments of a parallel call site name in env
+    // can be used by calls running at the same time.
+    bool independent(ArgumentProfile &profile, object::Environment *env) {
+        std::set<object::Function*> seen;
+        for (auto name : profile.names) {
+            if (!isolatedValue(env->get(name), seen)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Chunks {
+        size_t size;
+        size_t count;
+        size_t begin(size_t chunk) const {
+            return chunk * size;
+        }
+        size_t end(size_t chunk, size_t n) const {
+            return std::min(chunk * size + size, n);
+        }
+    };
+
+    // Whether fn can run in parallel over n elements.
+    bool spreads(size_t n, object::Object *fn) {
+        return n >= parallel::threshold && typeid(*fn) == typeid(object::Function) && parallel::isolated(static_cast<object::Function*>(fn));
+    }
+
+    // One chunk for everything unless fn can run in parallel over n elements.
+    Chunks split(size_t n, object::Object *fn) {
+        size_t size = std::max(n, (size_t) 1);
+        if (spreads(n, fn)) {
+            size = std::max(n / ((scheduler::workers() + 1) * CHUNKS_PER_THREAD), (size_t) 1);
+        }
+        return {size, (n + size - 1) / size};
+    }
+
+    // Calls body(chunk) for every chunk, which returns the Error that ended
+    // it or nullptr. Chunk 0 runs first, on this thread, and the rest go to
+    // the pool. Chunks after a failed one are skipped, and the error of the
+    // first failed chunk is returned, so it is the one a sequential run meets.
+    object::Object* run(const Chunks &chunks, const std::function<object::Object*(size_t)> &body) {
+        if (chunks.count == 0) {
+            return nullptr;
+        }
+        object::Object *error = body(0);
+        if (error != nullptr) {
+            return error;
+        }
+        std::vector<object::Object*> errors(chunks.count, nullptr);
+        std::atomic<size_t> failed(chunks.count);
+        scheduler::forEach(chunks.count - 1, [&](size_t i) {
+            size_t chunk = i + 1;
+            if (chunk > failed) {
+                return;
+            }
+            errors[chunk] = body(chunk);
+            if (errors[chunk] != nullptr) {
+                size_t seen = failed;
+                while (chunk < seen && !failed.compare_exchange_weak(seen, chunk)) {
+                }
+            }
+        });
+        return failed < chunks.count ? errors[failed] : nullptr;
+    }
+
+    // The same, with every chunk run in order on this thread.
+    object::Object* runInOrder(const Chunks &chunks, const std::function<object::Object*(size_t)> &body) {
+        for (size_t chunk = 0; chunk < chunks.count; chunk++) {
+            object::Object *error = body(chunk);
+            if (error != nullptr) {
+                return error;
+            }
+        }
+        return nullptr;
+    }
+} // namespace
+
+bool parallel::isolated(object::Function *fn) {
+    std::set<object::Function*> seen;
+    return ::isolated(fn, seen);
+}
+
+object::Object* parallel::evaluateArguments(CallExpression *call, object::Environment *env, const std::function<object::Object*(size_t)> &evaluate, std::vector<object::Object*> &args) {
+    size_t n = call->arguments.size();
+    ArgumentProfile &profile = call->argumentProfile;
+    bool concurrent = scheduler::concurrent();
+    if (profile.decision == ArgumentProfile::PARALLEL && !concurrent && independent(profile, env)) {
+        args.resize(n);
+        scheduler::forEach(n, [&](size_t i) {
+            args[i] = evaluate(i);
+        });
+        for (auto arg : args) {
+            if (evaluator::isError(arg)) {
+                return arg;
+            }
+        }
+        return nullptr;
+    }
+    // Profiles live on shared AST nodes, so pool threads leave them alone.
+    bool timing = profile.decision == ArgumentProfile::UNDECIDED && !concurrent;
+    if (timing) {
+        profile.nanos.resize(n);
+    }
+    args.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        std::chrono::steady_clock::time_point start;
+        if (timing) {
+            start = std::chrono::steady_clock::now();
+        }
+        object::Object *arg = evaluate(i);
+        if (evaluator::isError(arg)) {
+            return arg;
+        }
+        if (timing) {
+            profile.nanos[i] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+        args.push_back(arg);
+    }
+    if (timing && ++profile.samples == ARGUMENT_SAMPLES) {
+        decide(call, env);
+    }
+    return nullptr;
+}
+
+object::Object* parallel::call(object::Object *fn, std::vector<object::Object*> args) {
+    object::Function *function = dynamic_cast<object::Function*>(fn);
+    if (function != nullptr && function->literal != nullptr && function->literal->compiled != nullptr) {
+        return compiler::applyFunction(fn, args);
+    }
+    return evaluator::applyFunction(fn, args);
+}
+
+object::Object* parallel::pmap(std::vector<object::Object*> args) {
+    object::Object *error = checkArguments("pmap", args, 2, 1, 1);
+    if (error != nullptr) {
+        return error;
+    }
+    std::vector<object::Object*> &elements = dynamic_cast<object::Array*>(args[0])->elements;
+    size_t n = elements.size();
+    std::vector<object::Object*> results(n);
+    Chunks chunks = split(n, args[1]);
+    error = run(chunks, [&](size_t chunk) -> object::Object* {
+        for (size_t i = chunks.begin(chunk); i < chunks.end(chunk, n); i++) {
+            results[i] = call(args[1], {elements[i]});
+            if (evaluator::isError(results[i])) {
+                return results[i];
+            }
+        }
+        return nullptr;
+    });
+    if (error != nullptr) {
+        return error;
+    }
+    return new object::Array(results);
+}
+
+object::Object* parallel::pfilter(std::vector<object::Object*> args) {
+    object::Object *error = checkArguments("pfilter", args, 2, 1, 1);
+    if (error != nullptr) {
+        return error;
+    }
+    std::vector<object::Object*> &elements = dynamic_cast<object::Array*>(args[0])->elements;
+    size_t n = elements.size();
+    std::vector<char> keep(n);
+    Chunks chunks = split(n, args[1]);
+    error = run(chunks, [&](size_t chunk) -> object::Object* {
+        for (size_t i = chunks.begin(chunk); i < chunks.end(chunk, n); i++) {
+            object::Object *result = call(args[1], {elements[i]});
+            if (evaluator::isError(result)) {
+                return result;
+            }
+            keep[i] = evaluator::isTruthy(result);
+        }
+        return nullptr;
+    });
+    if (error != nullptr) {
+        return error;
+    }
+    std::vector<object::Object*> kept;
+    for (size_t i = 0; i < n; i++) {
+        if (keep[i]) {
+            kept.push_back(elements[i]);
+        }
+    }
+    return new object::Array(kept);
+}
+
+object::Object* parallel::preduce(std::vector<object::Object*> args) {
+    object::Object *error = checkArguments("preduce", args, 3, 2, 2);
+    if (error != nullptr) {
+        return error;
+    }
+    std::vector<object::Object*> &elements = dynamic_cast<object::Array*>(args[0])->elements;
+    size_t n = elements.size();
+    Chunks chunks = {REDUCE_CHUNK, (n + REDUCE_CHUNK - 1) / REDUCE_CHUNK};
+    std::vector<object::Object*> partials(chunks.count);
+    // Chunk 0 folds onto initial, so a single chunk is exactly a sequential
+    // left fold; every other chunk starts from its own first element.
+    auto fold = [&](size_t chunk) -> object::Object* {
+        size_t begin = chunks.begin(chunk);
+        object::Object *acc = chunk == 0 ? args[1] : elements[begin++];
+        for (size_t i = begin; i < chunks.end(chunk, n); i++) {
+            acc = call(args[2], {acc, elements[i]});
+            if (evaluator::isError(acc)) {
+                return acc;
+            }
+        }
+        partials[chunk] = acc;
+        return nullptr;
+    };
+    error = spreads(n, args[2]) ? run(chunks, fold) : runInOrder(chunks, fold);
+    if (error != nullptr) {
+        return error;
+    }
+    if (n == 0) {
+        return args[1];
+    }
+    object::Object *acc = partials[0];
+    for (size_t chunk = 1; chunk < chunks.count; chunk++) {
+        acc = call(args[2], {acc, partials[chunk]});
+        if (evaluator::isError(acc)) {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+object::Object* parallel::spawn(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    if (args[0]->type() != object::FUNCTION_OBJ) {
+        return new object::Error("argument to `spawn` must be FUNCTION, got " + args[0]->type());
+    }
+    object::Function *fn = dynamic_cast<object::Function*>(args[0]);
+    if (fn->parameters->size() != 0) {
+        return new object::Error("function passed to `spawn` must take 0 arguments, got " + std::to_string(fn->parameters->size()));
+    }
+    object::Future *future = new object::Future();
+    if (scheduler::workers() == 0 || !parallel::isolated(fn)) {
+        future->value = call(fn, {});
+        future->done = true;
+        return future;
+    }
+    std::map<object::Object*, object::Object*> copies;
+    object::Function *copied = copy(fn, copies);
+    scheduler::spawn([future, copied] {
+        future->value = call(copied, {});
+        future->done = true;
+    });
+    return future;
+}
+
+object::Object* parallel::await(std::vector<object::Object*> args) {
+    if (args.size() != 1) {
+        return new object::Error("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+    }
+    if (args[0]->type() == object::ISOLATE_OBJ) {
+        return dynamic_cast<isolate::Isolate*>(args[0])->join();
+    }
+    if (args[0]->type() != object::FUTURE_OBJ) {
+        return new object::Error("argument to `await` must be FUTURE or ISOLATE, got " + args[0]->type());
+    }
+    object::Future *future = dynamic_cast<object::Future*>(args[0]);
+    scheduler::await([future] {
+        return future->done.load();
+    });
+    return future->value;
+}
@@ -1,13 +1,18 @@
 #include "parser.hh"
-
-Lexer* Parser::l = NULL;
-Token Parser::curToken = Token();
-Token Parser::peekToken = Token();
-std::vector<std::string> Parser::errors = std::vector<std::string>();
-std::map<token_t, prefixParseFn_t*> Parser::prefixParseFns = std::map<token_t, prefixParseFn_t*>();
-std::map<token_t, infixParseFn_t*> Parser::infixParseFns = std::map<token_t, infixParseFn_t*>();
+#include "object.hh"
+
+thread_local Lexer* Parser::l = NULL;
+thread_local Token Parser::curToken = Token();
+thread_local Token Parser::peekToken = Token();
+thread_local std::vector<std::string> Parser::errors = std::vector<std::string>();
+thread_local std::map<token_t, prefixParseFn_t*> Parser::prefixParseFns = std::map<token_t, prefixParseFn_t*>();
+thread_local std::map<token_t, infixParseFn_t*> Parser::infixParseFns = std::map<token_t, infixParseFn_t*>();
+thread_local int Parser::loopDepth = 0;
+thread_local FunctionLiteral* Parser::function = nullptr;
+thread_local analysis::NameCounts Parser::names = analysis::NameCounts();
 
 const std::map<token_t, precedence_t> Parser::precedences = {
+    {token::ASSIGN, ASSIGNMENT},
     {token::EQ, EQUALS},
     {token::NOT_EQ, EQUALS},
     {token::LT, LESSGREATER},
@@ -23,17 +28,23 @@ const std::map<token_t, precedence_t> Parser::precedences = {
 
 Parser::Parser(Lexer* l) {
     this->l = l;
+    errors.clear();
+    loopDepth = 0;
+    function = nullptr;
+    names = analysis::NameCounts();
     this->nextToken();
     this->nextToken();
 
     this->registerPrefix(token::IDENT, Parser::parseIdentifier);
     this->registerPrefix(token::INT, Parser::parseIntegerLiteral);
+    this->registerPrefix(token::FLOAT, Parser::parseFloatLiteral);
     this->registerPrefix(token::BANG, Parser::parsePrefixExpression);
     this->registerPrefix(token::MINUS, Parser::parsePrefixExpression);
     this->registerPrefix(token::TRUE, Parser::parseBoolean);
     this->registerPrefix(token::FALSE, Parser::parseBoolean); 
     this->registerPrefix(token::LPAREN, Parser::parseGroupedExpression);
     this->registerPrefix(token::IF, Parser::parseIfExpression);
+    this->registerPrefix(token::MATCH, Parser::parseMatchExpression);
     this->registerPrefix(token::FUNCTION, Parser::parseFunctionLiteral);
     this->registerPrefix(token::STRING, Parser::parseStringLiteral);
     this->registerPrefix(token::LBRACKET, Parser::parseArrayLiteral);
@@ -47,6 +58,7 @@ Parser::Parser(Lexer* l) {
     this->registerInfix(token::NOT_EQ, Parser::parseInfixExpression);
     this->registerInfix(token::LT, Parser::parseInfixExpression);
     this->registerInfix(token::GT, Parser::parseInfixExpression);
+    this->registerInfix(token::ASSIGN, Parser::parseAssignExpression);
     this->registerInfix(token::LPAREN, Parser::parseCallExpression);
     this->registerInfix(token::LBRACKET, Parser::parseIndexExpression);
 }
@@ -69,6 +81,7 @@ Program* Parser::parseProgram() {
         }
         nextToken();
     }
+    program->names = new analysis::NameCounts(names);
     return program;
 }
 
@@ -77,6 +90,14 @@ Statement* Parser::parseStatement() {
         return parseLetStatement();
     } else if (curToken.getType() == token::RETURN) {
         return parseReturnStatement();
+    } else if (curToken.getType() == token::YIELD) {
+        return parseYieldStatement();
+    } else if (curToken.getType() == token::WHILE) {
+        return parseWhileStatement();
+    } else if (curToken.getType() == token::FOR) {
+        return parseForStatement();
+    } else if (curToken.getType() == token::BREAK || curToken.getType() == token::CONTINUE) {
+        return parseLoopControl();
     } else {
         return parseExpressionStatement();
     }
@@ -89,6 +110,9 @@ LetStatement* Parser::parseLetStatement() {
         return nullptr;
     }
     stmt->name = new Identifier(curToken, curToken.getLiteral());
+    if (function != nullptr || loopDepth > 0) {
+        names.noteLocalBinding(stmt->name->symbol);
+    }
     if (!expectPeek(token::ASSIGN)) {
         return nullptr;
     }
@@ -111,14 +135,101 @@ ReturnStatement* Parser::parseReturnStatement() {
     return stmt;
 }
 
+YieldStatement* Parser::parseYieldStatement() {
+    YieldStatement* stmt = new YieldStatement(curToken);
+    if (function == nullptr) {
+        errors.push_back("yield outside of a function");
+    } else {
+        function->generator = true;
+    }
+    nextToken();
+    stmt->value = parseExpression(LOWEST);
+    if (peekTokenIs(token::SEMICOLON)) {
+        nextToken();
+    }
+    return stmt;
+}
+
 ExpressionStatement* Parser::parseExpressionStatement() {
-    ExpressionStatement* stmt = new ExpressionStatement(curToken, parseExpression(LOWEST));
+    Token tok = curToken;
+    ExpressionStatement* stmt = new ExpressionStatement(tok, parseExpression(LOWEST));
     if (peekTokenIs(token::SEMICOLON)) {
         nextToken();
     }
     return stmt;
 }
 
+WhileStatement* Parser::parseWhileStatement() {
+    WhileStatement* stmt = new WhileStatement(curToken);
+    if (!expectPeek(token::LPAREN)) {
+        return nullptr;
+    }
+    nextToken();
+    stmt->condition = parseExpression(LOWEST);
+    if (!expectPeek(token::RPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::LBRACE)) {
+        return nullptr;
+    }
+    stmt->body = parseLoopBody();
+    return stmt;
+}
+
+ForStatement* Parser::parseForStatement() {
+    ForStatement* stmt = new ForStatement(curToken);
+    if (!expectPeek(token::LPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::IDENT)) {
+        return nullptr;
+    }
+    stmt->variable = new Identifier(curToken, curToken.getLiteral());
+    names.noteLocalBinding(stmt->variable->symbol);
+    if (!expectPeek(token::IN)) {
+        return nullptr;
+    }
+    nextToken();
+    stmt->iterable = parseExpression(LOWEST);
+    if (peekTokenIs(token::DOTDOT)) {
+        nextToken();
+        nextToken();
+        stmt->end = parseExpression(LOWEST);
+    }
+    if (!expectPeek(token::RPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::LBRACE)) {
+        return nullptr;
+    }
+    stmt->body = parseLoopBody();
+    return stmt;
+}
+
+BlockStatement* Parser::parseLoopBody() {
+    loopDepth++;
+    BlockStatement* body = parseBlockStatement();
+    loopDepth--;
+    if (peekTokenIs(token::SEMICOLON)) {
+        nextToken();
+    }
+    return body;
+}
+
+Statement* Parser::parseLoopControl() {
+    Token tok = curToken;
+    if (loopDepth == 0) {
+        errors.push_back(tok.getLiteral() + " outside of a loop");
+    }
+    if (peekTokenIs(token::SEMICOLON)) {
+        nextToken();
+    }
+    if (tok.getType() == token::BREAK) {
+        return new BreakStatement(tok);
+    }
+    return new ContinueStatement(tok);
+}
+
 Expression* Parser::parseExpression(precedence_t precedence) {
     prefixParseFn_t* prefix = prefixParseFns[curToken.getType()];
     if (prefix == nullptr) {
@@ -146,12 +257,23 @@ Expression* Parser::parseIdentifier() {
 
 Expression* Parser::parseIntegerLiteral() {
     try {
-        return new IntegerLiteral(curToken, std::stoi(curToken.getLiteral()));
-    } catch (std::invalid_argument e) {
+        return new IntegerLiteral(curToken, std::stoll(curToken.getLiteral()));
+    } catch (const std::invalid_argument &) {
         errors.push_back("could not parse " + curToken.getLiteral() + " as integer");
         return nullptr;
-    } catch (std::out_of_range e) {
-        errors.push_back("could not parse " + curToken.getLiteral() + " as integer (out of range)");
+    } catch (const std::out_of_range &) {
+        return new IntegerLiteral(curToken, INT64_MAX, true);
+    }
+}
+
+Expression* Parser::parseFloatLiteral() {
+    try {
+        return new FloatLiteral(curToken, std::stod(curToken.getLiteral()));
+    } catch (const std::invalid_argument &) {
+        errors.push_back("could not parse " + curToken.getLiteral() + " as float");
+        return nullptr;
+    } catch (const std::out_of_range &) {
+        errors.push_back("float literal out of range: " + curToken.getLiteral());
         return nullptr;
     }
 }
@@ -175,6 +297,28 @@ Expression* Parser::parseInfixExpression(Expression* left) {
     return exp;
 }
 
+// Assignment is right-associative, so a = b = c assigns c to both.
+Expression* Parser::parseAssignExpression(Expression* target) {
+    if (target == nullptr) {
+        return nullptr;
+    }
+    std::string type = target->type();
+    if (type != "Identifier" && type != "IndexExpression") {
+        errors.push_back("cannot assign to " + target->string());
+        return nullptr;
+    }
+    AssignExpression* exp = new AssignExpression(curToken, target);
+    nextToken();
+    exp->value = parseExpression(LOWEST);
+    if (exp->value == nullptr) {
+        return nullptr;
+    }
+    if (type == "Identifier") {
+        names.noteAssignment(dynamic_cast<Identifier*>(target)->symbol);
+    }
+    return exp;
+}
+
 Expression* Parser::parseGroupedExpression() {
     nextToken();
     Expression* exp = parseExpression(LOWEST);
@@ -188,6 +332,47 @@ Expression* Parser::parseBoolean() {
     return new Boolean(curToken, curTokenIs(token::TRUE));
 }
 
+// Arms are separated by commas, and a trailing comma is allowed. An arm body
+// starting with a brace is a block, so a hash literal result needs parentheses.
+Expression* Parser::parseMatchExpression() {
+    MatchExpression* exp = new MatchExpression(curToken);
+    if (!expectPeek(token::LPAREN)) {
+        return nullptr;
+    }
+    nextToken();
+    exp->subject = parseExpression(LOWEST);
+    if (exp->subject == nullptr || !expectPeek(token::RPAREN) || !expectPeek(token::LBRACE)) {
+        return nullptr;
+    }
+    while (!peekTokenIs(token::RBRACE)) {
+        nextToken();
+        if (exp->otherwise != nullptr) {
+            errors.push_back("match arm after _ is unreachable");
+            return nullptr;
+        }
+        bool wildcard = curTokenIs(token::IDENT) && curToken.getLiteral() == "_";
+        Expression* pattern = wildcard ? nullptr : parseExpression(LOWEST);
+        if ((!wildcard && pattern == nullptr) || !expectPeek(token::ARROW)) {
+            return nullptr;
+        }
+        nextToken();
+        Node* body = curTokenIs(token::LBRACE) ? (Node*) parseBlockStatement() : (Node*) parseExpression(LOWEST);
+        if (body == nullptr) {
+            return nullptr;
+        }
+        if (wildcard) {
+            exp->otherwise = body;
+        } else {
+            exp->arms.push_back({pattern, body});
+        }
+        if (!peekTokenIs(token::RBRACE) && !expectPeek(token::COMMA)) {
+            return nullptr;
+        }
+    }
+    nextToken();
+    return exp;
+}
+
 Expression* Parser::parseIfExpression() {
     IfExpression* exp = new IfExpression(curToken);
     if (!expectPeek(token::LPAREN)) {
@@ -236,7 +421,14 @@ Expression* Parser::parseFunctionLiteral() {
     if (!expectPeek(token::LBRACE)) {
         return nullptr;
     }
+    // A function body starts outside any loop, even when the literal is inside one.
+    int outerDepth = loopDepth;
+    FunctionLiteral* outerFunction = function;
+    loopDepth = 0;
+    function = lit;
     lit->body = parseBlockStatement();
+    loopDepth = outerDepth;
+    function = outerFunction;
     return lit;
 }
 
@@ -259,6 +451,9 @@ std::vector<Identifier*> Parser::parseFunctionParameters() {
         //NULL
         return std::vector<Identifier*>();
     }
+    for (auto param : params) {
+        names.noteLocalBinding(param->symbol);
+    }
     return params;
 }
 
@@ -341,6 +536,17 @@ Expression* Parser::parseHashLiteral() {
     if (!expectPeek(token::RBRACE)) {
         return nullptr;
     }
+    std::vector<const intern::Symbol*> keys;
+    for (auto pair : hash->pairs) {
+        StringLiteral *key = dynamic_cast<StringLiteral*>(pair.first);
+        if (key == nullptr) {
+            return hash;
+        }
+        keys.push_back(key->symbol);
+    }
+    if (!keys.empty()) {
+        hash->shape = object::Shape::of(keys);
+    }
     return hash;
 }
 
@@ -0,0 +1,66 @@
+#include <new>
+#include "pool.hh"
+
+namespace {
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct ThreadPool {
+        FreeBlock *freeLists[pool::SIZE_CLASSES];
+        char *bump[pool::SIZE_CLASSES];
+        char *bumpEnd[pool::SIZE_CLASSES];
+        pool::Stats stats;
+    };
+
+    thread_local ThreadPool local = {};
+}
+
+void* pool::allocate(size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    size_t cls = (size - 1) / pool::SIZE_CLASS_STEP;
+    if (cls >= pool::SIZE_CLASSES) {
+        local.stats.large++;
+        return ::operator new(size);
+    }
+    local.stats.allocations[cls]++;
+    FreeBlock *block = local.freeLists[cls];
+    if (block != nullptr) {
+        local.freeLists[cls] = block->next;
+        local.stats.reused++;
+        return block;
+    }
+    size_t blockSize = (cls + 1) * pool::SIZE_CLASS_STEP;
+    if (local.bump[cls] == nullptr || local.bump[cls] + blockSize > local.bumpEnd[cls]) {
+        local.bump[cls] = static_cast<char*>(::operator new(pool::SLAB_SIZE));
+        local.bumpEnd[cls] = local.bump[cls] + pool::SLAB_SIZE;
+        local.stats.slabs++;
+    }
+    void *ptr = local.bump[cls];
+    local.bump[cls] += blockSize;
+    return ptr;
+}
+
+void pool::deallocate(void *ptr, size_t size) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+    size_t cls = (size - 1) / pool::SIZE_CLASS_STEP;
+    if (cls >= pool::SIZE_CLASSES) {
+        ::operator delete(ptr);
+        return;
+    }
+    local.stats.frees++;
+    FreeBlock *block = static_cast<FreeBlock*>(ptr);
+    block->next = local.freeLists[cls];
+    local.freeLists[cls] = block;
+}
+
+pool::Stats pool::stats() {
+    return local.stats;
+}
@@ -1,12 +1,22 @@
 #include <iostream>
 #include <string>
+#include <fstream>
+#include <sstream>
 #include "repl.hh"
 #include "lexer.hh"
 #include "parser.hh"
 #include "evaluator.hh"
+#include "pool.hh"
+#include "aot.hh"
+#include "inliner.hh"
+#include "types.hh"
+#include "isolate.hh"
 
-void repl::Start() {
+void repl::Start(repl::engine_t engine) {
     object::Environment *env = new object::Environment();
+    std::vector<Program*> programs;
+    size_t inlined = 0;
+    types::Report typed;
 
     while(true) {
         std::string input;
@@ -16,6 +26,22 @@ void repl::Start() {
         if (input == "exit") {
             break;
         }
+        if (input == ":stats") {
+            printAllocatorStats();
+            continue;
+        }
+        if (input == ":specializations") {
+            printSpecializations(programs);
+            continue;
+        }
+        if (input == ":inlined") {
+            std::cout << "inlined call sites: " << inlined << std::endl;
+            continue;
+        }
+        if (input == ":types") {
+            std::cout << typed.summary() << std::endl;
+            continue;
+        }
 
         Lexer* l = new Lexer(input);
         Parser* p = new Parser(l);
@@ -26,17 +52,129 @@ void repl::Start() {
             continue;
         }
 
-        object::Object *evaluated = evaluator::eval(program, env);
+        programs.push_back(program);
+        inlined += inliner::inlineCalls(program, env);
+        types::Report report = types::infer(program, env);
+        printTypeErrors(report.errors);
+        typed.operations += report.operations;
+        typed.monomorphic += report.monomorphic;
+        object::Object *evaluated = engine(program, env);
         if (evaluated != nullptr) {
             std::cout << evaluated->inspect() << std::endl;
         }
     }
 }
 
+static bool readFile(const std::string &path, std::string &source) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    source = contents.str();
+    return true;
+}
+
+static Program* parseFile(const std::string &path) {
+    std::string source;
+    if (!readFile(path, source)) {
+        return nullptr;
+    }
+    Lexer l = Lexer(source);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    if (p.getErrors().size() > 0) {
+        repl::printParserErrors(p.getErrors());
+        return nullptr;
+    }
+    return program;
+}
+
+int repl::Run(const std::string &path, repl::engine_t engine) {
+    Program *program = parseFile(path);
+    if (program == nullptr) {
+        return 1;
+    }
+    object::Environment *env = new object::Environment();
+    inliner::inlineCalls(program, env);
+    printTypeErrors(types::infer(program, env).errors);
+    object::Object *evaluated = engine(program, env);
+    if (evaluated != nullptr && evaluated->type() == object::ERROR_OBJ) {
+        std::cerr << evaluated->inspect() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int repl::RunIsolated(const std::vector<std::string> &paths, repl::engine_t engine) {
+    std::vector<isolate::Isolate*> isolates;
+    for (auto path : paths) {
+        std::string source;
+        if (!readFile(path, source)) {
+            return 1;
+        }
+        isolates.push_back(new isolate::Isolate(source, {}, engine));
+    }
+    int status = 0;
+    for (size_t i = 0; i < isolates.size(); i++) {
+        object::Object *evaluated = isolates[i]->join();
+        if (isolates[i]->failed()) {
+            std::cerr << paths[i] << ": " << evaluated->inspect() << std::endl;
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int repl::EmitCpp(const std::string &path, const std::string &output) {
+    Program *program = parseFile(path);
+    if (program == nullptr) {
+        return 1;
+    }
+    inliner::inlineCalls(program, new object::Environment());
+    std::string code = aot::emitProgram(program);
+    if (output.empty()) {
+        std::cout << code;
+        return 0;
+    }
+    std::ofstream file(output);
+    file << code;
+    return file ? 0 : 1;
+}
+
 void repl::printParserErrors(std::vector<std::string> errors) {
     std::cout << "Woops! We ran into some monkey business here!" << std::endl;
     std::cout << " parser errors:" << std::endl;
     for (auto err : errors) {
         std::cout << err << std::endl;
     }
+}
+
+void repl::printTypeErrors(std::vector<std::string> errors) {
+    for (auto err : errors) {
+        std::cerr << "type error: " << err << std::endl;
+    }
+}
+
+void repl::printAllocatorStats() {
+    pool::Stats stats = pool::stats();
+    std::cout << "allocator stats:" << std::endl;
+    for (size_t i = 0; i < pool::SIZE_CLASSES; i++) {
+        if (stats.allocations[i] > 0) {
+            std::cout << "  " << (i + 1) * pool::SIZE_CLASS_STEP << " bytes: " << stats.allocations[i] << " allocations" << std::endl;
+        }
+    }
+    std::cout << "  large: " << stats.large << " allocations" << std::endl;
+    std::cout << "  slabs: " << stats.slabs << " x " << pool::SLAB_SIZE << " bytes" << std::endl;
+    std::cout << "  reused: " << stats.reused << ", freed: " << stats.frees << std::endl;
+    std::cout << "  small integer cache hits: " << object::Integer::cacheHits() << std::endl;
+}
+
+void repl::printSpecializations(std::vector<Program*> programs) {
+    std::cout << "node specializations:" << std::endl;
+    for (auto program : programs) {
+        std::cout << evaluator::dumpSpecializations(program);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "scheduler.hh"
+
+size_t scheduler::threads = 0;
+
+namespace {
+    typedef std::function<void()> Task;
+
+    // Tasks pushed by one thread. The owner takes the newest, thieves the oldest.
+    struct Deque {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::atomic<size_t> steals{0};
+        std::atomic<size_t> idles{0};
+    };
+
+    // The deque of a pool thread, or SIZE_MAX on threads outside the pool.
+    thread_local size_t self = SIZE_MAX;
+    // forEach calls this thread is inside of.
+    thread_local size_t running = 0;
+    // Spawned tasks that have not finished yet, on any thread.
+    std::atomic<size_t> outstanding(0);
+
+    class Pool {
+    public:
+        Pool(size_t workers);
+        ~Pool();
+        size_t size() {
+            return count;
+        }
+        void push(Task task);
+        // Runs one queued task, this thread's own newest if it has any, else
+        // the oldest of another deque. Returns false if there was none.
+        bool runOne();
+        // Runs queued tasks until ready() returns true.
+        void helpUntil(const std::function<bool()> &ready);
+        std::vector<scheduler::Counters> counters();
+    private:
+        // Workers, fixed before any of them starts.
+        const size_t count;
+        // One deque per worker, then one shared by threads outside the pool.
+        std::vector<Deque*> deques;
+        std::vector<std::thread> threads;
+        // Tasks pushed and not yet taken, so sleeping workers know when to wake.
+        std::atomic<size_t> queued;
+        std::atomic<bool> stopping;
+        std::mutex sleepLock;
+        std::condition_variable wake;
+        void work(size_t index);
+        bool take(Deque *deque, bool newest, Task &task);
+    };
+
+    Pool::Pool(size_t workers) : count(workers), queued(0), stopping(false) {
+        for (size_t i = 0; i <= workers; i++) {
+            deques.push_back(new Deque());
+        }
+        for (size_t i = 0; i < workers; i++) {
+            threads.emplace_back(&Pool::work, this, i);
+        }
+    }
+
+    Pool::~Pool() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (auto deque : deques) {
+            delete deque;
+        }
+    }
+
+    void Pool::push(Task task) {
+        Deque *deque = deques[std::min(self, count)];
+        // Count first: a worker that sees the count before the task is in
+        // place just looks again.
+        queued++;
+        {
+            std::lock_guard<std::mutex> guard(deque->lock);
+            deque->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    bool Pool::take(Deque *deque, bool newest, Task &task) {
+        std::lock_guard<std::mutex> guard(deque->lock);
+        if (deque->tasks.empty()) {
+            return false;
+        }
+        if (newest) {
+            task = std::move(deque->tasks.back());
+            deque->tasks.pop_back();
+        } else {
+            task = std::move(deque->tasks.front());
+            deque->tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+
+    bool Pool::runOne() {
+        size_t own = std::min(self, count);
+        Task task;
+        if (!take(deques[own], true, task)) {
+            size_t i = 1;
+            while (i <= count && !take(deques[(own + i) % (count + 1)], false, task)) {
+                i++;
+            }
+            if (i > count) {
+                return false;
+            }
+            deques[own]->steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        task();
+        return true;
+    }
+
+    void Pool::helpUntil(const std::function<bool()> &ready) {
+        while (!ready()) {
+            if (!runOne()) {
+                deques[std::min(self, count)]->idles.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::vector<scheduler::Counters> Pool::counters() {
+        std::vector<scheduler::Counters> counters;
+        for (auto deque : deques) {
+            counters.push_back({deque->steals.load(), deque->idles.load()});
+        }
+        return counters;
+    }
+
+    void Pool::work(size_t index) {
+        self = index;
+        while (true) {
+            if (runOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleepLock);
+            if (!stopping && queued == 0) {
+                deques[index]->idles.fetch_add(1, std::memory_order_relaxed);
+            }
+            wake.wait(guard, [this] { return stopping || queued > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    Pool& pool() {
+        static Pool instance(scheduler::threads != 0 ? scheduler::threads : std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return instance;
+    }
+
+    // Runs body over [begin, end), pushing the upper half of the range until
+    // one index is left. Every index counts down remaining exactly once, after
+    // which nothing here touches body or remaining again.
+    void runRange(Pool &p, const std::function<void(size_t)> &body, std::atomic<size_t> &remaining, size_t begin, size_t end) {
+        while (end - begin > 1) {
+            size_t middle = begin + (end - begin) / 2;
+            p.push([&p, &body, &remaining, middle, end] {
+                runRange(p, body, remaining, middle, end);
+            });
+            end = middle;
+        }
+        body(begin);
+        remaining--;
+    }
+} // namespace
+
+void scheduler::forEach(size_t count, const std::function<void(size_t)> &body) {
+    Pool &p = pool();
+    if (p.size() == 0 || count < 2) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    running++;
+    std::atomic<size_t> remaining(count);
+    runRange(p, body, remaining, 0, count);
+    // Help with whatever is queued, ours or not, instead of blocking.
+    p.helpUntil([&remaining] {
+        return remaining == 0;
+    });
+    running--;
+}
+
+void scheduler::spawn(std::function<void()> task) {
+    Pool &p = pool();
+    if (p.size() == 0) {
+        task();
+        return;
+    }
+    outstanding++;
+    p.push([task] {
+        task();
+        outstanding--;
+    });
+}
+
+void scheduler::await(const std::function<bool()> &ready) {
+    pool().helpUntil(ready);
+}
+
+size_t scheduler::workers() {
+    return pool().size();
+}
+
+std::vector<scheduler::Counters> scheduler::counters() {
+    return pool().counters();
+}
+
+bool scheduler::concurrent() {
+    return self != SIZE_MAX || running > 0 || outstanding > 0;
+}
@@ -0,0 +1,104 @@
+#include <cstring>
+#include <cstdint>
+#include "strsearch.hh"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define STRSEARCH_X86 1
+#endif
+
+size_t strsearch::findScalar(const char *haystack, size_t n, const char *needle, size_t m) {
+    if (m == 0) {
+        return 0;
+    }
+    if (m > n) {
+        return strsearch::npos;
+    }
+    const char *end = haystack + n - m + 1;
+    const char *p = haystack;
+    while (p < end) {
+        p = static_cast<const char*>(memchr(p, needle[0], end - p));
+        if (p == nullptr) {
+            return strsearch::npos;
+        }
+        if (memcmp(p + 1, needle + 1, m - 1) == 0) {
+            return p - haystack;
+        }
+        p++;
+    }
+    return strsearch::npos;
+}
+
+#ifdef STRSEARCH_X86
+// Both vector kernels compare the first and last byte of the needle against
+// a whole block of candidate positions at once, and only run memcmp on the
+// positions where both match.
+
+__attribute__((target("avx2")))
+static size_t findAVX2(const char *haystack, size_t n, const char *needle, size_t m) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + m - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+        while (mask != 0) {
+            size_t bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = strsearch::findScalar(haystack + i, n - i, needle, m);
+    return rest == strsearch::npos ? rest : i + rest;
+}
+
+static size_t findSSE2(const char *haystack, size_t n, const char *needle, size_t m) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + m - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+        while (mask != 0) {
+            size_t bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = strsearch::findScalar(haystack + i, n - i, needle, m);
+    return rest == strsearch::npos ? rest : i + rest;
+}
+#endif
+
+size_t strsearch::find(const char *haystack, size_t n, const char *needle, size_t m) {
+    if (m == 0) {
+        return 0;
+    }
+    if (m > n) {
+        return strsearch::npos;
+    }
+    // memchr is already vectorised by libc and wins for single bytes.
+    if (m == 1) {
+        const char *p = static_cast<const char*>(memchr(haystack, needle[0], n));
+        return p == nullptr ? strsearch::npos : p - haystack;
+    }
+#ifdef STRSEARCH_X86
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if (hasAVX2) {
+        return findAVX2(haystack, n, needle, m);
+    }
+    return findSSE2(haystack, n, needle, m);
+#else
+    return strsearch::findScalar(haystack, n, needle, m);
+#endif
+}
+
+bool strsearch::startsWith(const char *haystack, size_t n, const char *prefix, size_t m) {
+    return m <= n && memcmp(haystack, prefix, m) == 0;
+}
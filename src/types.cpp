@@ -0,0 +1,617 @@
+#include <map>
+#include <set>
+#include <typeinfo>
+#include "types.hh"
+#include "analysis.hh"
+#include "evaluator.hh"
+
+bool types::enabled = true;
+
+std::string types::Report::summary() {
+    std::string out = std::to_string(monomorphic) + " of " + std::to_string(operations) + " operations proven monomorphic";
+    if (operations > 0) {
+        out += " (" + std::to_string(monomorphic * 100 / operations) + "%)";
+    }
+    return out;
+}
+
+namespace {
+    bool known(StaticType type) {
+        return type != StaticType::NONE && type != StaticType::UNKNOWN;
+    }
+
+    StaticType join(StaticType a, StaticType b) {
+        if (a == StaticType::NONE) {
+            return b;
+        }
+        if (b == StaticType::NONE || a == b) {
+            return a;
+        }
+        return StaticType::UNKNOWN;
+    }
+
+    StaticType typeOf(object::Object *obj) {
+        const std::type_info &type = typeid(*obj);
+        if (type == typeid(object::Integer)) {
+            return StaticType::INTEGER;
+        } else if (type == typeid(object::Boolean)) {
+            return StaticType::BOOLEAN;
+        } else if (type == typeid(object::String)) {
+            return StaticType::STRING;
+        } else if (type == typeid(object::Array)) {
+            return StaticType::ARRAY;
+        } else if (type == typeid(object::Hash)) {
+            return StaticType::HASH;
+        } else if (type == typeid(object::Function)) {
+            return StaticType::FUNCTION;
+        }
+        return StaticType::UNKNOWN;
+    }
+
+    // Builtins whose result is always the same type when they do not fail.
+    // push is not one: pushed onto a packed array, it returns a packed one.
+    StaticType builtinResult(const std::string &name) {
+        static const std::map<std::string, StaticType> results = {
+            {"len", StaticType::INTEGER},
+            {"indexOf", StaticType::INTEGER},
+            {"split", StaticType::ARRAY},
+            {"pmap", StaticType::ARRAY},
+            {"pfilter", StaticType::ARRAY},
+            {"join", StaticType::STRING},
+            {"substr", StaticType::STRING},
+            {"replace", StaticType::STRING},
+            {"contains", StaticType::BOOLEAN},
+            {"startsWith", StaticType::BOOLEAN},
+        };
+        auto found = results.find(name);
+        return found != results.end() ? found->second : StaticType::UNKNOWN;
+    }
+
+    struct Assignments {
+        size_t sites = 0;
+        StaticType type = StaticType::NONE;
+    };
+
+    // What inference has recorded for the programs of one global scope: every
+    // assignment to a name it has seen, and every proof and known type, with
+    // the scope's count of assignments when they were last checked against
+    // it. A program that assigns a name can break proofs earlier programs
+    // made about it, so they are withdrawn whenever the count moves. So can
+    // one that binds a global earlier programs only let where it never ran,
+    // such as in an if branch not taken, so proofs are also withdrawn while
+    // a global they took from such a let is still unbound. Proofs that took
+    // a builtin's result type are withdrawn once a program lets its name in
+    // the global scope, which shadows the builtin.
+    struct Facts {
+        std::map<const intern::Symbol*, Assignments> assigned;
+        std::vector<NodeProfile*> proofs;
+        std::vector<Expression*> typed;
+        std::set<const intern::Symbol*> unbound;
+        std::set<const intern::Symbol*> builtins;
+        size_t checkedAssignments = 0;
+    };
+    // Per global scope, run by one thread like the programs of an isolate.
+    thread_local std::map<object::Environment*, Facts> facts;
+
+    void clearProofs(Facts &facts) {
+        // Only inference ever specialized an operation the closure compiler
+        // runs, so the specialization goes too; the evaluator sets it again
+        // from the operands it sees.
+        for (auto profile : facts.proofs) {
+            profile->proven = false;
+            profile->specialization = Specialization::UNINITIALIZED;
+        }
+        for (auto exp : facts.typed) {
+            exp->staticType = StaticType::UNKNOWN;
+        }
+        facts.proofs.clear();
+        facts.typed.clear();
+        facts.builtins.clear();
+    }
+
+    void withdrawProofs(Facts &facts, object::Environment *globals) {
+        bool stale = false;
+        for (auto name : facts.unbound) {
+            if (globals->store->count(name) == 0) {
+                stale = true;
+            }
+        }
+        facts.unbound.clear();
+        for (auto name : facts.builtins) {
+            if (globals->store->count(name) > 0) {
+                stale = true;
+            }
+        }
+        const analysis::NameCounts &names = globals->counts();
+        if (facts.checkedAssignments == names.total && !stale) {
+            return;
+        }
+        facts.checkedAssignments = names.total;
+        clearProofs(facts);
+    }
+
+    struct Scope {
+        Scope *parent;
+        // Parameters, and loop variables with the type of every value they take.
+        std::map<const intern::Symbol*, StaticType> params;
+        // Join of the types of every let of a name in this scope.
+        std::map<const intern::Symbol*, StaticType> lets;
+    };
+
+    class Inferrer {
+    public:
+        Inferrer(object::Environment *globals, Facts &facts) : globals(globals), facts(facts), names(globals->counts()), global{nullptr, {}, {}} {};
+        void run(Program *program);
+        types::Report report;
+    private:
+        object::Environment *globals;
+        Facts &facts;
+        const analysis::NameCounts &names;
+        Scope global;
+        std::map<Node*, Scope*> scopes;
+        bool changed = false;
+        // Annotations, counts and errors are only recorded once the let types
+        // have reached a fixed point.
+        bool final = false;
+
+        StaticType statement(Statement *stmt, Scope *scope);
+        StaticType block(BlockStatement *block, Scope *scope);
+        StaticType expression(Expression *exp, Scope *scope);
+        StaticType infix(InfixExpression *node, Scope *scope);
+        StaticType prefix(PrefixExpression *node, Scope *scope);
+        StaticType index(IndexExpression *node, Scope *scope);
+        StaticType assign(AssignExpression *node, Scope *scope);
+        void prove(NodeProfile &profile, Specialization specialization);
+        StaticType resolve(const intern::Symbol *name, Scope *scope);
+        StaticType lookup(const intern::Symbol *name, Scope *scope);
+        Scope* enclosed(Node *owner, Scope *scope);
+        StaticType loop(Statement *stmt, Scope *scope);
+        StaticType match(MatchExpression *node, Scope *scope);
+        bool builtin(Identifier *name, Scope *scope);
+        void bind(const intern::Symbol *name, StaticType type, Scope *scope);
+        void operation(bool monomorphic);
+        void error(const std::string &message);
+    };
+
+    void Inferrer::run(Program *program) {
+        for (auto stmt : *program->statements) {
+            analysis::walk(stmt, [&](Node *node) {
+                AssignExpression *assign = dynamic_cast<AssignExpression*>(node);
+                if (assign != nullptr && assign->target->type() == "Identifier") {
+                    facts.assigned[dynamic_cast<Identifier*>(assign->target)->symbol].sites++;
+                }
+                return true;
+            });
+        }
+        for (int i = 0; i < 16; i++) {
+            changed = false;
+            for (auto stmt : *program->statements) {
+                statement(stmt, &global);
+            }
+            if (!changed) {
+                break;
+            }
+        }
+        // A builtin this program shadows may already be running under the
+        // proofs of earlier programs, before the next one withdraws them.
+        for (auto name : facts.builtins) {
+            if (global.lets.count(name) > 0) {
+                clearProofs(facts);
+                break;
+            }
+        }
+        final = true;
+        for (auto stmt : *program->statements) {
+            statement(stmt, &global);
+        }
+    }
+
+    void Inferrer::operation(bool monomorphic) {
+        if (final) {
+            report.operations++;
+            if (monomorphic) {
+                report.monomorphic++;
+            }
+        }
+    }
+
+    void Inferrer::error(const std::string &message) {
+        if (final) {
+            report.errors.push_back(message);
+        }
+    }
+
+    void Inferrer::bind(const intern::Symbol *name, StaticType type, Scope *scope) {
+        // Binding a parameter's name, or a global that already exists, is a
+        // no-op, as Environment::set never replaces a binding.
+        if (scope->params.count(name) > 0 || (scope == &global && globals->store->count(name) > 0)) {
+            return;
+        }
+        auto found = scope->lets.find(name);
+        StaticType before = found != scope->lets.end() ? found->second : StaticType::NONE;
+        StaticType after = join(before, type);
+        if (found == scope->lets.end() || after != before) {
+            scope->lets[name] = after;
+            changed = true;
+        }
+    }
+
+    // A name that is ever assigned also has the type of every value assigned
+    // to it. If the parser has seen assignments inference has not (in a
+    // program that failed to parse, or ran without inference), nothing is
+    // known about it.
+    StaticType Inferrer::lookup(const intern::Symbol *name, Scope *scope) {
+        StaticType type = resolve(name, scope);
+        size_t assignments = names.assignments(name);
+        if (assignments == 0) {
+            return type;
+        }
+        auto found = facts.assigned.find(name);
+        if (found == facts.assigned.end() || found->second.sites != assignments) {
+            return StaticType::UNKNOWN;
+        }
+        return join(type, found->second.type);
+    }
+
+    StaticType Inferrer::resolve(const intern::Symbol *name, Scope *scope) {
+        StaticType type = StaticType::NONE;
+        for (Scope *s = scope; s != nullptr; s = s->parent) {
+            auto param = s->params.find(name);
+            if (param != s->params.end()) {
+                return join(type, param->second);
+            }
+            if (s == &global) {
+                auto bound = globals->store->find(name);
+                if (bound != globals->store->end()) {
+                    return join(type, typeOf(bound->second));
+                }
+            }
+            auto found = s->lets.find(name);
+            if (found != s->lets.end()) {
+                type = join(type, found->second);
+                if (s == &global && final) {
+                    facts.unbound.insert(name);
+                }
+            }
+        }
+        if (evaluator::builtins.count(name->value) > 0) {
+            return join(type, StaticType::UNKNOWN);
+        }
+        // Only the lets seen so far, or nothing: a lookup that finds nothing
+        // is an error, and errors never reach an operator.
+        return type;
+    }
+
+    bool Inferrer::builtin(Identifier *name, Scope *scope) {
+        if (evaluator::builtins.count(name->value) == 0 || globals->store->count(name->symbol) > 0) {
+            return false;
+        }
+        for (Scope *s = scope; s != nullptr; s = s->parent) {
+            if (s->params.count(name->symbol) > 0 || s->lets.count(name->symbol) > 0) {
+                return false;
+            }
+        }
+        if (final) {
+            facts.builtins.insert(name->symbol);
+        }
+        return true;
+    }
+
+    StaticType Inferrer::statement(Statement *stmt, Scope *scope) {
+        std::string type = stmt->type();
+        if (type == "ExpressionStatement") {
+            return expression(dynamic_cast<ExpressionStatement*>(stmt)->expression, scope);
+        } else if (type == "LetStatement") {
+            LetStatement *let = dynamic_cast<LetStatement*>(stmt);
+            StaticType value = expression(let->value, scope);
+            bind(let->name->symbol, value, scope);
+            return value;
+        } else if (type == "ReturnStatement") {
+            expression(dynamic_cast<ReturnStatement*>(stmt)->returnValue, scope);
+            return StaticType::UNKNOWN;
+        } else if (type == "YieldStatement") {
+            expression(dynamic_cast<YieldStatement*>(stmt)->value, scope);
+            return StaticType::UNKNOWN;
+        } else if (type == "BlockStatement") {
+            return block(dynamic_cast<BlockStatement*>(stmt), scope);
+        } else if (type == "WhileStatement" || type == "ForStatement") {
+            return loop(stmt, scope);
+        }
+        return StaticType::UNKNOWN;
+    }
+
+    Scope* Inferrer::enclosed(Node *owner, Scope *scope) {
+        Scope *&inner = scopes[owner];
+        if (inner == nullptr) {
+            inner = new Scope{scope, {}, {}};
+        }
+        return inner;
+    }
+
+    // A loop's body runs in a scope of its own, so its lets and variable
+    // shadow the enclosing scope only inside the body.
+    StaticType Inferrer::loop(Statement *stmt, Scope *scope) {
+        Scope *inner = enclosed(stmt, scope);
+        WhileStatement *ws = dynamic_cast<WhileStatement*>(stmt);
+        if (ws != nullptr) {
+            StaticType condition = expression(ws->condition, scope);
+            operation(known(condition));
+            block(ws->body, inner);
+            return StaticType::UNKNOWN;
+        }
+        ForStatement *fs = dynamic_cast<ForStatement*>(stmt);
+        StaticType iterable = expression(fs->iterable, scope);
+        StaticType variable = StaticType::UNKNOWN;
+        if (fs->end != nullptr) {
+            StaticType end = expression(fs->end, scope);
+            if ((known(iterable) && iterable != StaticType::INTEGER) || (known(end) && end != StaticType::INTEGER)) {
+                error("range bounds must be INTEGER, got " + staticTypeName(iterable) + ".." + staticTypeName(end));
+            }
+            variable = StaticType::INTEGER;
+        } else if (known(iterable) && iterable != StaticType::ARRAY) {
+            error("cannot iterate over " + staticTypeName(iterable));
+        }
+        inner->params[fs->variable->symbol] = variable;
+        block(fs->body, inner);
+        return StaticType::UNKNOWN;
+    }
+
+    // Arms run in the enclosing scope, like if blocks. Without a _ arm the
+    // match may evaluate to null.
+    StaticType Inferrer::match(MatchExpression *node, Scope *scope) {
+        expression(node->subject, scope);
+        StaticType result = StaticType::NONE;
+        std::vector<Node*> bodies;
+        for (auto &arm : node->arms) {
+            expression(arm.pattern, scope);
+            bodies.push_back(arm.body);
+        }
+        bodies.push_back(node->otherwise);
+        for (auto body : bodies) {
+            if (body == nullptr) {
+                result = StaticType::UNKNOWN;
+            } else if (body->type() == "BlockStatement") {
+                result = join(result, block(dynamic_cast<BlockStatement*>(body), scope));
+            } else {
+                result = join(result, expression(dynamic_cast<Expression*>(body), scope));
+            }
+        }
+        return result;
+    }
+
+    StaticType Inferrer::block(BlockStatement *block, Scope *scope) {
+        if (block == nullptr) {
+            return StaticType::UNKNOWN;
+        }
+        StaticType type = StaticType::UNKNOWN;
+        bool returns = false;
+        for (auto stmt : *block->statements) {
+            type = statement(stmt, scope);
+            analysis::walk(stmt, [&](Node *node) {
+                std::string type = node->type();
+                returns = returns || type == "ReturnStatement" || type == "BreakStatement" || type == "ContinueStatement";
+                return type != "FunctionLiteral";
+            });
+        }
+        // A block holding a return, break or continue can evaluate to a
+        // ReturnValue or LoopControl instead.
+        return returns ? StaticType::UNKNOWN : type;
+    }
+
+    StaticType Inferrer::expression(Expression *exp, Scope *scope) {
+        if (exp == nullptr) {
+            return StaticType::UNKNOWN;
+        }
+        StaticType result = StaticType::UNKNOWN;
+        std::string type = exp->type();
+        if (type == "IntegerLiteral") {
+            result = StaticType::INTEGER;
+        } else if (type == "Boolean") {
+            result = StaticType::BOOLEAN;
+        } else if (type == "StringLiteral") {
+            result = StaticType::STRING;
+        } else if (type == "Identifier") {
+            result = lookup(dynamic_cast<Identifier*>(exp)->symbol, scope);
+        } else if (type == "PrefixExpression") {
+            result = prefix(dynamic_cast<PrefixExpression*>(exp), scope);
+        } else if (type == "InfixExpression") {
+            result = infix(dynamic_cast<InfixExpression*>(exp), scope);
+        } else if (type == "IndexExpression") {
+            result = index(dynamic_cast<IndexExpression*>(exp), scope);
+        } else if (type == "IfExpression") {
+            IfExpression *ie = dynamic_cast<IfExpression*>(exp);
+            StaticType condition = expression(ie->condition, scope);
+            operation(known(condition));
+            StaticType consequence = block(ie->consequence, scope);
+            StaticType alternative = block(ie->alternative, scope);
+            result = ie->alternative != nullptr ? join(consequence, alternative) : StaticType::UNKNOWN;
+        } else if (type == "FunctionLiteral") {
+            FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(exp);
+            Scope *inner = enclosed(fn, scope);
+            for (auto param : fn->parameters) {
+                inner->params[param->symbol] = StaticType::UNKNOWN;
+            }
+            block(fn->body, inner);
+            result = StaticType::FUNCTION;
+        } else if (type == "CallExpression") {
+            CallExpression *call = dynamic_cast<CallExpression*>(exp);
+            expression(call->function, scope);
+            for (auto arg : call->arguments) {
+                expression(arg, scope);
+            }
+            Identifier *name = dynamic_cast<Identifier*>(call->function);
+            if (name != nullptr && builtin(name, scope)) {
+                result = builtinResult(name->value);
+            }
+        } else if (type == "MatchExpression") {
+            result = match(dynamic_cast<MatchExpression*>(exp), scope);
+        } else if (type == "AssignExpression") {
+            result = assign(dynamic_cast<AssignExpression*>(exp), scope);
+        } else if (type == "InlinedCall") {
+            result = expression(dynamic_cast<InlinedCall*>(exp)->body, scope);
+        } else if (type == "ArrayLiteral") {
+            for (auto element : dynamic_cast<ArrayLiteral*>(exp)->elements) {
+                expression(element, scope);
+            }
+            result = StaticType::ARRAY;
+        } else if (type == "HashLiteral") {
+            for (auto pair : dynamic_cast<HashLiteral*>(exp)->pairs) {
+                StaticType key = expression(pair.first, scope);
+                if (key == StaticType::ARRAY || key == StaticType::HASH || key == StaticType::FUNCTION) {
+                    error("unusable as hash key: " + staticTypeName(key));
+                }
+                expression(pair.second, scope);
+            }
+            result = StaticType::HASH;
+        }
+        if (final) {
+            exp->staticType = result == StaticType::NONE ? StaticType::UNKNOWN : result;
+            if (known(result)) {
+                facts.typed.push_back(exp);
+            }
+        }
+        return result;
+    }
+
+    void Inferrer::prove(NodeProfile &profile, Specialization specialization) {
+        if (final) {
+            profile.specialization = specialization;
+            profile.proven = true;
+            facts.proofs.push_back(&profile);
+        }
+    }
+
+    StaticType Inferrer::assign(AssignExpression *node, Scope *scope) {
+        IndexExpression *target = dynamic_cast<IndexExpression*>(node->target);
+        StaticType left = StaticType::NONE;
+        StaticType idx = StaticType::NONE;
+        if (target != nullptr) {
+            left = expression(target->left, scope);
+            idx = expression(target->index, scope);
+        }
+        StaticType value = expression(node->value, scope);
+        if (target == nullptr) {
+            Assignments &assignments = facts.assigned[dynamic_cast<Identifier*>(node->target)->symbol];
+            StaticType after = join(assignments.type, value);
+            if (after != assignments.type) {
+                assignments.type = after;
+                changed = true;
+            }
+        } else if (left == StaticType::ARRAY) {
+            if (known(idx) && idx != StaticType::INTEGER) {
+                error("array index must be INTEGER, got " + staticTypeName(idx));
+            }
+        } else if (left == StaticType::HASH) {
+            if (idx == StaticType::ARRAY || idx == StaticType::HASH || idx == StaticType::FUNCTION) {
+                error("unusable as hash key: " + staticTypeName(idx));
+            }
+        } else if (known(left)) {
+            error("index assignment not supported: " + staticTypeName(left));
+        }
+        return value;
+    }
+
+    StaticType Inferrer::prefix(PrefixExpression *node, Scope *scope) {
+        StaticType right = expression(node->right, scope);
+        operation(known(right));
+        if (node->op == "!") {
+            if (right == StaticType::BOOLEAN) {
+                prove(node->profile, Specialization::BOOL_NOT);
+            }
+            return StaticType::BOOLEAN;
+        }
+        if (right == StaticType::INTEGER && node->op == "-") {
+            prove(node->profile, Specialization::INT_NEGATE);
+            return StaticType::INTEGER;
+        }
+        if (known(right)) {
+            error("unknown operator: " + node->op + staticTypeName(right));
+        }
+        return right == StaticType::NONE ? StaticType::NONE : StaticType::UNKNOWN;
+    }
+
+    StaticType Inferrer::infix(InfixExpression *node, Scope *scope) {
+        StaticType left = expression(node->left, scope);
+        StaticType right = expression(node->right, scope);
+        operation(known(left) && known(right));
+        if (left == StaticType::NONE || right == StaticType::NONE) {
+            return StaticType::NONE;
+        }
+        if (!known(left) || !known(right)) {
+            return StaticType::UNKNOWN;
+        }
+        const std::string &op = node->op;
+        Specialization specialization = Specialization::GENERIC;
+        StaticType result = StaticType::UNKNOWN;
+        if (left != right) {
+            error("type mismatch: " + staticTypeName(left) + " " + op + " " + staticTypeName(right));
+            return StaticType::UNKNOWN;
+        } else if (left == StaticType::INTEGER) {
+            static const std::map<std::string, Specialization> ops = {
+                {"+", Specialization::INT_ADD}, {"-", Specialization::INT_SUB},
+                {"*", Specialization::INT_MUL}, {"/", Specialization::INT_DIV},
+                {"<", Specialization::INT_LT}, {">", Specialization::INT_GT},
+                {"==", Specialization::INT_EQ}, {"!=", Specialization::INT_NOT_EQ},
+            };
+            auto found = ops.find(op);
+            if (found != ops.end()) {
+                specialization = found->second;
+                result = (op == "+" || op == "-" || op == "*" || op == "/") ? StaticType::INTEGER : StaticType::BOOLEAN;
+            }
+        } else if (left == StaticType::BOOLEAN) {
+            if (op == "==") {
+                specialization = Specialization::BOOL_EQ;
+            } else if (op == "!=") {
+                specialization = Specialization::BOOL_NOT_EQ;
+            }
+            result = StaticType::BOOLEAN;
+        } else if (left == StaticType::STRING) {
+            if (op == "+") {
+                specialization = Specialization::STRING_CONCAT;
+                result = StaticType::STRING;
+            } else if (op == "==") {
+                specialization = Specialization::STRING_EQ;
+                result = StaticType::BOOLEAN;
+            } else if (op == "!=") {
+                specialization = Specialization::STRING_NOT_EQ;
+                result = StaticType::BOOLEAN;
+            }
+        }
+        if (specialization == Specialization::GENERIC) {
+            error("unknown operator: " + staticTypeName(left) + " " + op + " " + staticTypeName(right));
+            return StaticType::UNKNOWN;
+        }
+        prove(node->profile, specialization);
+        return result;
+    }
+
+    StaticType Inferrer::index(IndexExpression *node, Scope *scope) {
+        StaticType left = expression(node->left, scope);
+        StaticType idx = expression(node->index, scope);
+        operation(known(left) && known(idx));
+        if (left == StaticType::ARRAY && idx == StaticType::INTEGER) {
+            prove(node->profile, Specialization::ARRAY_INDEX);
+        } else if (left == StaticType::HASH) {
+            if (idx == StaticType::ARRAY || idx == StaticType::HASH || idx == StaticType::FUNCTION) {
+                error("unusable as hash key: " + staticTypeName(idx));
+            } else {
+                prove(node->profile, Specialization::HASH_INDEX);
+            }
+        } else if (known(left) && (left != StaticType::ARRAY || known(idx))) {
+            error("index operator not supported: " + staticTypeName(left));
+        }
+        return StaticType::UNKNOWN;
+    }
+} // namespace
+
+types::Report types::infer(Program *program, object::Environment *globals) {
+    globals->count(program);
+    Facts &recorded = facts[globals];
+    withdrawProofs(recorded, globals);
+    if (!enabled) {
+        return types::Report();
+    }
+    Inferrer inferrer(globals, recorded);
+    inferrer.run(program);
+    return inferrer.report;
+}
@@ -0,0 +1,54 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "analysis.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+FunctionLiteral *parseFunction(const std::string &input) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    ExpressionStatement *stmt = dynamic_cast<ExpressionStatement*>(program->statements->at(0));
+    return dynamic_cast<FunctionLiteral*>(stmt->expression);
+}
+
+std::vector<std::string> names(const std::vector<const intern::Symbol*> &symbols) {
+    std::vector<std::string> out;
+    for (auto symbol : symbols) {
+        out.push_back(symbol->value);
+    }
+    return out;
+}
+
+TEST(analysis, test_free_variables) {
+    struct FreeVariableTest {
+        std::string input;
+        std::vector<std::string> expected;
+    };
+
+    std::vector<FreeVariableTest> tests = {
+        {"fn(x) { x + 1 }", {}},
+        {"fn(x) { x + y }", {"y"}},
+        {"fn(x) { len(x) + y * z }", {"len", "y", "z"}},
+        {"fn(x) { fn(y) { x + y + z } }", {"z"}},
+        {"fn(x) { let a = 1; a + b }", {"a", "b"}},
+        {"fn() { if (c) { d } else { [e, {f: g}[h]] } }", {"c", "d", "e", "f", "g", "h"}},
+    };
+
+    for(auto test : tests) {
+        FunctionLiteral *fn = parseFunction(test.input);
+        ASSERT_TRUE(fn != nullptr) << "could not parse " << test.input << std::endl;
+        analysis::analyseFunction(fn);
+        EXPECT_EQ(names(fn->freeVariables), test.expected) << "wrong free variables for " << test.input << std::endl;
+    }
+}
+
+TEST(analysis, test_locals) {
+    FunctionLiteral *fn = parseFunction("fn(x) { let a = 1; if (x) { let b = 2; } fn() { let c = 3; } }");
+    analysis::analyseFunction(fn);
+    ASSERT_EQ(fn->locals.size(), 2);
+    ASSERT_EQ(fn->locals.count(intern::symbol("a")), 1);
+    ASSERT_EQ(fn->locals.count(intern::symbol("b")), 1);
+    ASSERT_EQ(fn->locals.count(intern::symbol("c")), 0);
+}
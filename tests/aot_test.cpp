@@ -0,0 +1,64 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "aot.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+std::string emitCpp(const std::string &input) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    return aot::emitProgram(p.parseProgram());
+}
+
+size_t occurrences(const std::string &haystack, const std::string &needle) {
+    size_t count = 0;
+    for (size_t at = haystack.find(needle); at != std::string::npos; at = haystack.find(needle, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+TEST(aot, test_one_function_per_literal) {
+    std::string code = emitCpp("let f = fn(a) { fn(b) { a + b } }; let g = fn() { 1 }; f(1)(2) + g()");
+    EXPECT_EQ(occurrences(code, "static object::Object* f0(object::Environment *env) {"), 1);
+    EXPECT_EQ(occurrences(code, "static object::Object* f1(object::Environment *env) {"), 1);
+    EXPECT_EQ(occurrences(code, "static object::Object* f2(object::Environment *env) {"), 1);
+    EXPECT_EQ(occurrences(code, "static object::Object* f3("), 0);
+    EXPECT_EQ(occurrences(code, "static object::Object* program(object::Environment *env) {"), 1);
+    EXPECT_EQ(occurrences(code, "int main() {"), 1);
+}
+
+TEST(aot, test_literals_and_symbols_are_shared) {
+    std::string code = emitCpp("let x = 1; x + x + x + len(\"a\tb\") + len(\"c\")");
+    EXPECT_EQ(occurrences(code, "intern::symbol(\"x\")"), 1);
+    EXPECT_EQ(occurrences(code, "aot::builtin(\"len\")"), 1);
+    EXPECT_EQ(occurrences(code, "\"a\\tb\""), 1);
+    EXPECT_EQ(occurrences(code, "Specialization::INT_ADD"), 4);
+}
+
+TEST(aot, test_unread_temporaries_are_dropped) {
+    std::string code = emitCpp("let x = 1; if (x) { 2 }; x");
+    // The let's value and the discarded if's result are never read.
+    EXPECT_EQ(occurrences(code, "    env->set("), 1);
+    EXPECT_EQ(occurrences(code, "= env->set("), 0);
+    EXPECT_EQ(occurrences(code, "= evaluator::NULLobj;"), 1);
+    EXPECT_EQ(occurrences(code, " result = "), 1);
+}
+
+object::Object* returnSeven(object::Environment *) {
+    return object::Integer::make(7);
+}
+
+TEST(aot, test_runtime_literal) {
+    FunctionLiteral *literal = aot::literal({"x", "y"}, {"z"}, {"w"}, "(x + y)", returnSeven);
+    object::Environment *env = new object::Environment();
+    env->set("z", object::Integer::make(1));
+    object::Object *fn = evaluator::evalFunctionLiteral(literal, env);
+    EXPECT_EQ(fn->inspect(), "fn(x, y, ) {\n(x + y)\n}");
+    std::vector<object::Object*> args = {object::Integer::make(1), object::Integer::make(2)};
+    EXPECT_EQ(compiler::applyFunction(fn, args)->inspect(), "7");
+    EXPECT_TRUE(literal->analysed);
+    ASSERT_EQ(literal->freeVariables.size(), 1);
+    EXPECT_EQ(literal->freeVariables[0]->value, "z");
+}
@@ -0,0 +1,94 @@
+#include "bigint.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+TEST(bigint, test_string_round_trip) {
+    std::vector<std::string> tests = {
+        "0",
+        "1",
+        "-1",
+        "4294967296",
+        "9223372036854775807",
+        "-9223372036854775808",
+        "123456789012345678901234567890",
+        "-1000000000000000000000000000000000000000",
+    };
+
+    for(auto test : tests) {
+        std::string got = bigint::BigInt::fromString(test).toString();
+        EXPECT_EQ(got, test) << "round trip wrong. got=" << got << ", want=" << test << std::endl;
+    }
+}
+
+TEST(bigint, test_int64_conversion) {
+    std::vector<int64_t> tests = {0, 1, -1, INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN};
+
+    for(auto test : tests) {
+        bigint::BigInt big = bigint::BigInt::fromInt64(test);
+        ASSERT_TRUE(big.fitsInt64()) << test << " does not fit in int64" << std::endl;
+        EXPECT_EQ(big.toInt64(), test);
+        EXPECT_EQ(big.toString(), std::to_string(test));
+    }
+    ASSERT_FALSE(bigint::BigInt::fromString("9223372036854775808").fitsInt64());
+    ASSERT_FALSE(bigint::BigInt::fromString("-9223372036854775809").fitsInt64());
+}
+
+TEST(bigint, test_arithmetic) {
+    struct ArithmeticTest {
+        std::string left;
+        char op;
+        std::string right;
+        std::string expected;
+    };
+
+    std::vector<ArithmeticTest> tests = {
+        {"9223372036854775807", '+', "1", "9223372036854775808"},
+        {"-9223372036854775808", '-', "1", "-9223372036854775809"},
+        {"100000000000000000000", '-', "100000000000000000001", "-1"},
+        {"4294967296", '*', "4294967296", "18446744073709551616"},
+        {"-123456789123456789", '*', "987654321987654321", "-121932631356500531347203169112635269"},
+        {"121932631356500531347203169112635269", '/', "987654321987654321", "123456789123456789"},
+        {"-100000000000000000000", '/', "7", "-14285714285714285714"},
+        {"-100000000000000000000", '%', "7", "-2"},
+        {"18446744073709551616", '/', "18446744073709551617", "0"},
+    };
+
+    for(auto test : tests) {
+        bigint::BigInt left = bigint::BigInt::fromString(test.left);
+        bigint::BigInt right = bigint::BigInt::fromString(test.right);
+        bigint::BigInt result;
+        switch (test.op) {
+        case '+': result = left + right; break;
+        case '-': result = left - right; break;
+        case '*': result = left * right; break;
+        case '/': result = left / right; break;
+        case '%': result = left % right; break;
+        }
+        EXPECT_EQ(result.toString(), test.expected) << test.left << " " << test.op << " " << test.right << std::endl;
+    }
+}
+
+TEST(bigint, test_karatsuba_matches_schoolbook) {
+    std::vector<uint32_t> a, b;
+    uint32_t seed = 12345;
+    for (int i = 0; i < 300; i++) {
+        seed = seed * 1103515245 + 12345;
+        a.push_back(seed);
+        seed = seed * 1103515245 + 12345;
+        if (i < 170) {
+            b.push_back(seed);
+        }
+    }
+    ASSERT_EQ(bigint::multiplyKaratsuba(a, b), bigint::multiplySchoolbook(a, b));
+    ASSERT_EQ(bigint::multiplyKaratsuba(a, a), bigint::multiplySchoolbook(a, a));
+
+    bigint::BigInt big;
+    big.limbs = a;
+    bigint::BigInt divisor;
+    divisor.limbs = b;
+    bigint::BigInt product = big * divisor;
+    ASSERT_EQ((product / divisor).compare(big), 0);
+    ASSERT_TRUE((product % divisor).isZero());
+    ASSERT_EQ(((product + divisor) % big).compare(divisor), 0);
+}
@@ -0,0 +1,30 @@
+#include <string>
+#include <gtest/gtest.h>
+#include "lexer.hh"
+#include "parser.hh"
+#include "object.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#pragma once
+
+// Parses input, which must parse cleanly, and runs it on engine in a fresh
+// global scope.
+inline object::Object *testEvalWith(const std::string &input, object::Object* (*engine)(Node*, object::Environment*)) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    EXPECT_EQ(p.getErrors().size(), 0) << input;
+    object::Environment *env = new object::Environment();
+
+    return engine(program, env);
+}
+
+// Runs input on both the tree-walking evaluator and the closure compiler, checks
+// they agree, and returns the evaluator's result.
+inline object::Object *testEval(const std::string &input) {
+    object::Object *evaluated = testEvalWith(input, evaluator::eval);
+    object::Object *compiled = testEvalWith(input, compiler::eval);
+    EXPECT_EQ(compiled->type(), evaluated->type()) << "engines disagree on type for " << input << std::endl;
+    EXPECT_EQ(compiled->inspect(), evaluated->inspect()) << "engines disagree on value for " << input << std::endl;
+    return evaluated;
+}
@@ -2,19 +2,12 @@
 #include "object.hh"
 #include "parser.hh"
 #include "evaluator.hh"
+#include "compiler.hh"
+#include "engines.hh"
 #include <gtest/gtest.h>
 #include <iostream>
 #include <string>
 
-object::Object *testEval(const std::string &input) {
-    Lexer l = Lexer(input);
-    Parser p = Parser(&l);
-    Program *program = p.parseProgram();
-    object::Environment *env = new object::Environment();
-
-    return evaluator::eval(program, env);
-}
-
 void testIntegerObject(object::Object *obj, int expected) {
     object::Integer *result = dynamic_cast<object::Integer*>(obj);
     ASSERT_TRUE(result != nullptr) << "object is not Integer. got=" << obj->type() << std::endl;
@@ -62,6 +55,46 @@ TEST(evaluator, test_eval_integer_expression) {
     }
 }
 
+TEST(evaluator, test_eval_big_integer_expression) {
+    struct EvalBigIntegerTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<EvalBigIntegerTest> tests = {
+        {"2147483647 + 1", "2147483648"},
+        {"9223372036854775807 + 1", "9223372036854775808"},
+        {"-9223372036854775807 - 2", "-9223372036854775809"},
+        {"99999999999999999999999", "99999999999999999999999"},
+        {"-99999999999999999999999", "-99999999999999999999999"},
+        {"4294967296 * 4294967296 * 4294967296", "79228162514264337593543950336"},
+        {"(9223372036854775807 + 10) - 20", "9223372036854775797"},
+        {"(4294967296 * 4294967296) / 4294967296", "4294967296"},
+        {
+            "let fact = fn(n) { if (n == 0) { 1 } else { n * fact(n - 1) } }; fact(30);",
+            "265252859812191058636308480000000"
+        },
+    };
+
+    for(auto test : tests) {
+        object::Object *evaluated = testEval(test.input);
+        object::Integer *result = dynamic_cast<object::Integer*>(evaluated);
+        ASSERT_TRUE(result != nullptr) << "object is not Integer. got=" << evaluated->type() << " for " << test.input << std::endl;
+        ASSERT_EQ(result->inspect(), test.expected) << "object has wrong value. got=" << result->inspect() << ", want=" << test.expected << std::endl;
+    }
+
+    testBooleanObject(testEval("(9223372036854775807 + 1) - 1 == 9223372036854775807"), true);
+    object::Integer *demoted = dynamic_cast<object::Integer*>(testEval("(9223372036854775807 + 1) - 1"));
+    ASSERT_TRUE(demoted != nullptr && demoted->big == nullptr) << "result was not demoted to a small integer" << std::endl;
+
+    // A big literal is parsed into its Integer once, not on every evaluation.
+    for (auto engine : {evaluator::eval, compiler::eval}) {
+        object::Array *twice = dynamic_cast<object::Array*>(testEvalWith("let xs = []; for (k in 0..2) { xs[k] = 99999999999999999999999; } xs", engine));
+        ASSERT_TRUE(twice != nullptr && twice->elements.size() == 2) << "loop did not fill the array" << std::endl;
+        EXPECT_EQ(twice->elements[0], twice->elements[1]) << "big literal was built again" << std::endl;
+    }
+}
+
 TEST(evaluator, test_eval_boolean_expression) {
     struct EvalBooleanTest {
         std::string input;
@@ -202,6 +235,8 @@ TEST(evaluator, test_error_handeling) {
         {"len(1)", "argument to `len` not supported, got INTEGER"},
         {"len(\"one\", \"two\")", "wrong number of arguments. got=2, want=1"},
         {"{\"name\": \"Monkey\"}[fn(x) { x }];", "unusable as hash key: FUNCTION"},
+        {"1 / 0", "division by zero"},
+        {"99999999999999999999 / 0", "division by zero"},
     };
 
     for(auto test : tests) {
@@ -278,12 +313,76 @@ TEST(evaluator, test_closures) {
     testIntegerObject(evaluated, 4);
 }
 
+TEST(evaluator, test_closure_captures) {
+    struct ClosureTest {
+        std::string input;
+        int expected;
+    };
+
+    std::vector<ClosureTest> tests = {
+        {"let f = fn(a, b) { let big = [1, 2, 3]; fn(x) { x + a } }; f(1, 2)(10)", 11},
+        {"let f = fn(a) { fn(b) { fn(c) { a + b + c } } }; f(1)(2)(3)", 6},
+        {"let f = fn() { let g = fn() { h() }; let h = fn() { 7 }; g() }; f()", 7},
+        {"let f = fn(n) { let fact = fn(n) { if (n == 0) { 1 } else { n * fact(n - 1) } }; fact(n) }; f(5)", 120},
+        {"let x = 1; let f = fn() { let g = fn() { x }; let x = 5; g() }; f()", 5},
+        {"let later = fn() { missing }; let missing = 3; later()", 3},
+    };
+
+    for(auto test : tests) {
+        object::Object *evaluated = testEval(test.input);
+        testIntegerObject(evaluated, test.expected);
+    }
+}
+
+TEST(evaluator, test_closure_hoisting) {
+    std::string input = "let make = fn(a) { fn(x) { len(x) } }; [make(1), make(2), make(3)(\"ab\")]";
+    object::Array *result = dynamic_cast<object::Array*>(testEval(input));
+    ASSERT_TRUE(result != nullptr) << "object is not Array" << std::endl;
+    ASSERT_EQ(result->elements[0], result->elements[1]) << "closure without captures was not shared" << std::endl;
+    testIntegerObject(result->elements[2], 2);
+
+    input = "let make = fn(a) { fn(x) { x + a } }; [make(1), make(2)]";
+    result = dynamic_cast<object::Array*>(testEval(input));
+    ASSERT_TRUE(result != nullptr) << "object is not Array" << std::endl;
+    ASSERT_NE(result->elements[0], result->elements[1]) << "closures with captures were shared" << std::endl;
+    object::Function *fn = dynamic_cast<object::Function*>(result->elements[0]);
+    ASSERT_EQ(fn->env->store->size(), 1) << "closure captured more than its free variables" << std::endl;
+}
+
+TEST(evaluator, test_node_specialization) {
+    std::string input = R"(
+        let add = fn(a, b) { a + b };
+        let sum = fn(n) { if (n < 1) { 0 } else { add(n, sum(n - 1)) } };
+        let total = sum(10);
+        let words = add("foo", "bar");
+        [total, words, -total, [1, 2, 3][1], {"k": 4}["k"]];
+    )";
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    object::Environment *env = new object::Environment();
+    object::Array *result = dynamic_cast<object::Array*>(evaluator::eval(program, env));
+    ASSERT_TRUE(result != nullptr) << "object is not Array" << std::endl;
+    testIntegerObject(result->elements[0], 55);
+    ASSERT_EQ(result->elements[1]->inspect(), "foobar");
+    testIntegerObject(result->elements[2], -55);
+    testIntegerObject(result->elements[3], 2);
+    testIntegerObject(result->elements[4], 4);
+
+    std::string dump = evaluator::dumpSpecializations(program);
+    EXPECT_NE(dump.find("(a + b): generic hits=10 misses=1"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("(n < 1): int < int hits=11 misses=0"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("(-total): -int hits=1"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("([1, 2, 3][1]): array[int] hits=1"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("hash[key] hits=1"), std::string::npos) << dump;
+}
+
 TEST(evaluator, test_string_literal) {
     std::string input = R"("Hello World!")";
     object::Object *evaluated = testEval(input);
     object::String *str = dynamic_cast<object::String*>(evaluated);
     ASSERT_TRUE(str != nullptr) << "object is not String. got=" << evaluated->type() << std::endl;
-    ASSERT_EQ(str->value, "Hello World!") << "String has wrong value. got=" << str->value << std::endl;
+    ASSERT_EQ(str->value(), "Hello World!") << "String has wrong value. got=" << str->value() << std::endl;
 }
 
 TEST(evaluator, test_string_concatination) {
@@ -291,7 +390,42 @@ TEST(evaluator, test_string_concatination) {
     object::Object *evaluated = testEval(input);
     object::String *str = dynamic_cast<object::String*>(evaluated);
     ASSERT_TRUE(str != nullptr) << "object is not String. got=" << evaluated->type() << std::endl;
-    ASSERT_EQ(str->value, "Hello World!") << "String has wrong value. got=" << str->value << std::endl;
+    ASSERT_EQ(str->value(), "Hello World!") << "String has wrong value. got=" << str->value() << std::endl;
+}
+
+TEST(evaluator, test_repeated_string_concatination) {
+    std::string input = R"(
+        let repeat = fn(s, n) {
+            if (n == 0) { return ""; }
+            repeat(s, n - 1) + s;
+        };
+        repeat("abcdefghij", 500);
+    )";
+    object::Object *evaluated = testEval(input);
+    object::String *str = dynamic_cast<object::String*>(evaluated);
+    ASSERT_TRUE(str != nullptr) << "object is not String. got=" << evaluated->type() << std::endl;
+    ASSERT_EQ(str->length, 5000) << "String has wrong length. got=" << str->length << std::endl;
+    ASSERT_EQ(str->value().substr(4990), "abcdefghij") << "String has wrong value. got=" << str->value().substr(4990) << std::endl;
+}
+
+TEST(evaluator, test_string_comparison) {
+    struct StringComparisonTest {
+        std::string input;
+        bool expected;
+    };
+
+    std::vector<StringComparisonTest> tests = {
+        {R"("a" == "a")", true},
+        {R"("a" == "b")", false},
+        {R"("a" != "b")", true},
+        {R"("ab" == "a" + "b")", true},
+        {R"(let s = "key"; s == "key")", true},
+    };
+
+    for(auto test : tests) {
+        object::Object *evaluated = testEval(test.input);
+        testBooleanObject(evaluated, test.expected);
+    }
 }
 
 TEST(evaluator, test_builtin_functions) {
@@ -312,6 +446,10 @@ TEST(evaluator, test_builtin_functions) {
         {"len(1)", {.str = "argument to `len` not supported, got INTEGER"}},
         {"len(\"one\", \"two\")", {.str = "wrong number of arguments. got=2, want=1"}},
         {"first([1, 2, 3])", {.integer = 1}},
+        {"len(\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\" + \"!\")", {.integer = 79}},
+        {"len(join([\"a\", \"bc\", \"def\"], \", \"))", {.integer = 10}},
+        {"join(1)", {.str = "argument to `join` must be ARRAY, got INTEGER"}},
+        {"join([1])", {.str = "elements of `join` must be STRING, got INTEGER"}},
     };
     
     for(auto test : tests) {
@@ -326,6 +464,42 @@ TEST(evaluator, test_builtin_functions) {
     }
 }
 
+TEST(evaluator, test_string_builtins) {
+    struct StringBuiltinTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<StringBuiltinTest> tests = {
+        {R"(substr("hello world", 6))", "world"},
+        {R"(substr("hello world", 0, 5))", "hello"},
+        {R"(substr(substr("hello world", 2, 7), 2, 3))", "o w"},
+        {R"(substr("hello", 3, 100))", "lo"},
+        {R"(substr("hello", 10))", ""},
+        {R"(join(split("a,b,,c", ","), "|"))", "a|b||c"},
+        {R"(join(split("abc", ""), "-"))", "a-b-c"},
+        {R"(replace("GET /a GET /b", "GET", "POST"))", "POST /a POST /b"},
+        {R"(replace("hello", "x", "y"))", "hello"},
+    };
+
+    for(auto test : tests) {
+        object::Object *evaluated = testEval(test.input);
+        object::String *str = dynamic_cast<object::String*>(evaluated);
+        ASSERT_TRUE(str != nullptr) << "object is not String. got=" << evaluated->type() << " for " << test.input << std::endl;
+        ASSERT_EQ(str->value(), test.expected) << "String has wrong value. got=" << str->value() << std::endl;
+    }
+
+    testIntegerObject(testEval(R"(indexOf("hello world", "world"))"), 6);
+    testIntegerObject(testEval(R"(indexOf("hello world", "xyz"))"), -1);
+    testIntegerObject(testEval(R"(len(split("a b c d", " ")))"), 4);
+    testBooleanObject(testEval(R"(contains("hello world", "lo w"))"), true);
+    testBooleanObject(testEval(R"(contains("hello world", "low"))"), false);
+    testBooleanObject(testEval(R"(startsWith("hello world", "hell"))"), true);
+    testBooleanObject(testEval(R"(startsWith("hello world", "world"))"), false);
+    testBooleanObject(testEval(R"(substr("a key b", 2, 3) == "key")"), true);
+    testIntegerObject(testEval(R"({"key": 7}[substr("a key b", 2, 3)])"), 7);
+}
+
 TEST(evaluator, test_array_literals) {
     std::string input = "[1, 2 * 2, 3 + 3]";
     object::Object *evaluated = testEval(input);
@@ -372,16 +546,15 @@ TEST(evaluator, test_hash_literals) {
         {"three", 13},
     };
 
-    ASSERT_EQ(result->pairs.size(), expected.size()) << "hash has wrong number of pairs. got=" << result->pairs.size() << std::endl;
+    auto entries = result->entries();
+    ASSERT_EQ(entries.size(), expected.size()) << "hash has wrong number of pairs. got=" << entries.size() << std::endl;
 
-    for (auto expectedPair : expected) {
-        auto expectedKey = new object::String(expectedPair.first);
-        auto pair = result->pairs[expectedKey->hash_key()];
-        
-        ASSERT_TRUE(pair != nullptr) << "no pair for given key in pairs" << std::endl;
-        ASSERT_TRUE(pair->key->inspect() == expectedPair.first) << "pair has no key" << std::endl;
+    for (auto entry : entries) {
+        auto expectedPair = expected.find(entry.first->inspect());
+        ASSERT_TRUE(expectedPair != expected.end()) << "unexpected key " << entry.first->inspect() << std::endl;
 
-        testIntegerObject(pair->value, expectedPair.second);
+        testIntegerObject(entry.second, expectedPair->second);
+        testIntegerObject(result->get(new object::String(expectedPair->first)), expectedPair->second);
     }
 }
 
@@ -406,4 +579,208 @@ TEST(evaluator, test_hash_index_expressions) {
         object::Object *evaluated = testEval(test.input);
         testIntegerObject(evaluated, test.expected);
     }
-}
\ No newline at end of file
+}
+
+TEST(evaluator, test_shaped_hashes) {
+    struct ShapeTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<ShapeTest> tests = {
+        // One site sees hashes of several shapes, and keys that are not
+        // literals.
+        {R"(let score = fn(h) { h["score"] }; [score({"id": 1, "score": 5}), score({"score": 7, "name": "x"}), score({"id": 2, "score": 9}), score({1: 2}), score({"id": 3})])", "[5, 7, 9, null, null, ]"},
+        {R"(let get = fn(h, k) { h[k] }; let h = {"a": 1, "b": 2}; [get(h, "a"), get(h, "b"), get(h, "a" + ""), get(h, 1)])", "[1, 2, 1, null, ]"},
+        // A record given a new key keeps every value, and cached sites
+        // still find them.
+        {R"(let h = {"a": 1, "b": 2}; let b = fn() { h["b"] }; let before = b(); h["c"] = 3; h["a"] = 4; [before, b(), h["a"], h["c"]])", "[2, 2, 4, 3, ]"},
+        {R"(let rows = []; for (i in 0..3) { rows[i] = {"id": i, "sq": i * i}; } let total = [0]; for (r in rows) { total[0] = total[0] + r["id"] + r["sq"]; } total[0])", "8"},
+        {R"({"k": 1, "k": 1}["k"])", "1"},
+        {R"({"a": 1 + true})", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+}
+
+TEST(evaluator, test_global_lookup_caches) {
+    struct LookupTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<LookupTest> tests = {
+        {R"(let depth = fn(n) { if (n == 0) { len("abc") } else { depth(n - 1) } }; depth(500))", "3"},
+        // Redefining or assigning a global is seen by sites that cached it.
+        {R"(let measure = fn() { len("ab") }; let before = measure(); let len = fn(x) { 42 }; [before, measure()])", "[2, 42, ]"},
+        {"let level = 1; let read = fn() { level }; let before = read(); level = 2; [before, read()]", "[1, 2, ]"},
+        // Names bound anywhere but the global scope are looked up in full.
+        {"let shadowed = 1; let f = fn(shadowed) { shadowed }; [f(5), shadowed]", "[5, 1, ]"},
+        {"let idx = 7; let seen = []; for (idx in 0..2) { seen[len(seen)] = idx; } [seen, idx]", "[[0, 1, ], 7, ]"},
+        {"let g = fn() { let inner = 3; inner }; [g(), g()]", "[3, 3, ]"},
+        {"let h = fn() { undefinedName }; h(); h()", "ERROR: identifier not found: undefinedName"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+
+    // A parameter named like a global only stops caching that name in the
+    // global scope whose programs bind it.
+    testEval("let id = fn(item) { item }; id(1)");
+    Lexer cached = Lexer("let item = 2; let readItem = fn() { item }; readItem()");
+    Parser cachedParser = Parser(&cached);
+    Program *reading = cachedParser.parseProgram();
+    object::Environment *session = new object::Environment();
+    testIntegerObject(evaluator::eval(reading, session), 2);
+    FunctionLiteral *readItem = dynamic_cast<FunctionLiteral*>(dynamic_cast<LetStatement*>(reading->statements->at(1))->value);
+    Identifier *item = dynamic_cast<Identifier*>(dynamic_cast<ExpressionStatement*>(readItem->body->statements->at(0))->expression);
+    EXPECT_EQ(item->cache.globals, session);
+
+    // One program run against two global scopes reads each one's binding.
+    Lexer l = Lexer("let readBase = fn() { base }; readBase()");
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    for (auto engine : {evaluator::eval, compiler::eval}) {
+        for (int64_t base : {1, 2, 1}) {
+            object::Environment *env = new object::Environment();
+            env->set("base", object::Integer::make(base));
+            testIntegerObject(engine(program, env), base);
+        }
+    }
+}
+
+TEST(evaluator, test_loops) {
+    struct LoopTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<LoopTest> tests = {
+        {"let xs = [1, 2, 3]; let sum = fn() { let t = [0]; for (x in xs) { let t = [t[0] + x]; } t[0] }; sum()", "0"},
+        {"let f = fn(n) { for (i in 0..n) { if (i * i > 50) { return i; } } }; f(100)", "8"},
+        {"let f = fn(n) { for (i in 0..n) { if (i * i > 50) { return i; } } }; f(3)", "null"},
+        {"let f = fn(xs) { for (x in xs) { if (x > 2) { return x; } } -1 }; f([1, 5, 3])", "5"},
+        {"let f = fn(xs) { for (x in xs) { if (x > 2) { return x; } } -1 }; f([])", "-1"},
+        {"let f = fn() { for (i in 0..10) { if (i < 7) { continue; } return i; } }; f()", "7"},
+        {"let f = fn() { for (i in 0..10) { if (i == 3) { break; } } \"done\" }; f()", "done"},
+        {"let f = fn() { while (true) { return 42; } }; f()", "42"},
+        {"let f = fn() { while (true) { break; } 1 }; f()", "1"},
+        {"let f = fn() { while (false) { return 1; } 2 }; f()", "2"},
+        {"let f = fn() { for (i in 0..3) { let sq = i * i; if (i == 2) { return sq; } } }; f()", "4"},
+        {"let f = fn() { for (i in 0..3) { for (j in 0..3) { if (j == 1) { break; } if (i == 2) { return i * 10 + j; } } } }; f()", "20"},
+        {"let fs = fn() { for (i in 5..2) { return i; } 0 }; fs()", "0"},
+        {"let i = 99; for (i in 0..3) { i } i", "99"},
+        {"let g = fn() { for (i in 0..3) { if (i == 2) { return fn() { i }; } } }; g()()", "2"},
+        {"for (i in 0..3) { let later = 1; } later", "ERROR: identifier not found: later"},
+        {"for (x in 5) { x }", "ERROR: cannot iterate over INTEGER"},
+        {"for (i in 0..\"ten\") { i }", "ERROR: range bounds must be INTEGER, got INTEGER..STRING"},
+        {"for (i in 0..99999999999999999999) { i }", "ERROR: range bounds out of range: 0..99999999999999999999"},
+        {"for (i in 0..3) { i + true }", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+}
+
+// A closure made in a loop keeps the variables of its own iteration, even
+// ones that are assigned.
+TEST(evaluator, test_loop_closures) {
+    struct LoopTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<LoopTest> tests = {
+        {"let fs = []; let i = 0; while (i < 3) { let v = i; v = v * 10; fs = push(fs, fn() { v }); i = i + 1; }; [fs[0](), fs[1](), fs[2]()]", "[0, 10, 20, ]"},
+        {"let fs = []; for (x in [1, 2, 3]) { fs = push(fs, fn() { x = x + 100; x }) }; [fs[0](), fs[0](), fs[1](), fs[2]()]", "[101, 201, 102, 103, ]"},
+        {"let fs = []; for (i in 0..3) { let v = i; fs = push(fs, fn() { v = v + 1; v }) }; [fs[0](), fs[1](), fs[2]()]", "[1, 2, 3, ]"},
+        {"let fs = []; for (i in 0..2) { for (j in 0..2) { let k = i * 2 + j; k = k + 1; fs = push(fs, fn() { [i, k] }) } }; fs[1]()", "[0, 2, ]"},
+        {"let f = fn() { let n = 0; for (i in 0..3) { n = n + i; } n }; f()", "3"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+}
+
+TEST(evaluator, test_assignments) {
+    struct AssignTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<AssignTest> tests = {
+        {"let tally = 0; for (k in 1..5) { tally = tally + k; } tally", "10"},
+        {"let steps = 0; while (steps < 5) { steps = steps + 1; } steps", "5"},
+        {"let tally = 0; for (k in 0..3) { let tally = 10; tally = tally + k; } tally", "0"},
+        {"let lo = 0; let hi = 0; lo = hi = 4; lo + hi", "8"},
+        {"let f = fn(v) { v = v * 2; v }; f(21)", "42"},
+        {"let cursor = 1; let peek = fn() { cursor }; cursor = 2; peek()", "2"},
+        {"let wrap = fn() { let cursor = 1; let get = fn() { cursor }; cursor = 5; get() }; wrap()", "5"},
+        {"let counter = fn() { let clicks = 0; fn() { clicks = clicks + 1; clicks } }; let tick = counter(); tick(); tick(); tick()", "3"},
+        {"let grid = [0, 0, 0]; grid[1] = 7; grid[1] + len(grid)", "10"},
+        {"let grid = []; for (k in 0..4) { grid[k] = k * k; } grid[3] + len(grid)", "13"},
+        {"let grid = [1]; let alias = grid; alias[0] = 5; grid[0]", "5"},
+        {"let seen = {}; seen[\"a\"] = 1; seen[\"a\"] = seen[\"a\"] + 1; seen[true] = 5; seen[\"a\"] + seen[true]", "7"},
+        {"let grid = [[0]]; grid[0][0] = \"in place\"; grid[0][0]", "in place"},
+        {"undefinedName = 1", "ERROR: identifier not found: undefinedName"},
+        {"len = 5", "ERROR: identifier not found: len"},
+        {"let grid = [1]; grid[3] = 1", "ERROR: index out of range: 3 (length 1)"},
+        {"let grid = [1]; grid[-1] = 1", "ERROR: index out of range: -1 (length 1)"},
+        {"let grid = [1]; grid[\"a\"] = 1", "ERROR: array index must be INTEGER, got STRING"},
+        {"let seen = {}; seen[[1]] = 1", "ERROR: unusable as hash key: ARRAY"},
+        {"let word = \"ab\"; word[0] = \"c\"", "ERROR: index assignment not supported: STRING"},
+        {"let grid = [1]; grid[0] = missing; grid[0]", "ERROR: identifier not found: missing"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+}
+
+TEST(evaluator, test_match_expressions) {
+    struct MatchTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::string classify = "let classify = fn(n) { match (n) { 0 => \"zero\", 1 => \"one\", 2 => \"two\", -3 => \"minus three\", _ => \"many\" } }; ";
+    std::string sparse = "let code = fn(n) { match (n) { 200 => 1, 404 => 2, 500000 => 3, -7 => 4, _ => 0 } }; ";
+    std::string route = "let route = fn(m) { match (m) { \"GET\" => 1, \"POST\" => 2, \"PUT\" => { let x = 3; x * 10 } } }; ";
+    std::vector<MatchTest> tests = {
+        {classify + "[classify(0), classify(2), classify(-3), classify(3), classify(\"0\")]", "[zero, two, minus three, many, many, ]"},
+        {sparse + "[code(200), code(404), code(500000), code(-7), code(201), code(true)]", "[1, 2, 3, 4, 0, 0, ]"},
+        {route + "[route(\"GET\"), route(\"PUT\"), route(\"GE\" + \"T\"), route(\"DELETE\"), route(1)]", "[1, 30, 1, null, null, ]"},
+        {"let k = 2; match (2) { 1 + 1 => \"sum\", k => \"k\", _ => \"no\" }", "sum"},
+        {"match (\"a\") { 1 => 1, \"a\" => 2 }", "2"},
+        {"match (true) { false => 0, true => 1 }", "1"},
+        {"match (99999999999999999999) { 1 => 0, 99999999999999999999 => 1, _ => 2 }", "1"},
+        {"match (99999999999999999999) { 1 => 0, 2 => 1, _ => 2 }", "2"},
+        {"match (5) { }", "null"},
+        {"match (5) { _ => 1 }", "1"},
+        {"let f = fn() { for (i in 0..6) { match (i) { 1 => { continue; }, 4 => { break; }, _ => { puts(i); } } } \"done\" }; f()", "done"},
+        {"let f = fn(n) { match (n) { 1 => { return 10; }, _ => 0 }; 5 }; f(1) + f(2)", "15"},
+        {"match (missing) { 1 => 1 }", "ERROR: identifier not found: missing"},
+        {"match (1) { 1 => 1 + true }", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {"match (2) { 1 => 1, missing => 2 }", "ERROR: identifier not found: missing"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.input)->inspect(), test.expected) << test.input;
+    }
+
+    // A dispatch table is built once, for literal-only matches.
+    Lexer l = Lexer("let f = fn(n) { match (n) { 1 => 10, 3 => 30, _ => 0 } }; f(1) + f(3) + f(2)");
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    testIntegerObject(evaluator::eval(program, new object::Environment()), 40);
+    FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(dynamic_cast<LetStatement*>(program->statements->at(0))->value);
+    MatchExpression *exp = dynamic_cast<MatchExpression*>(dynamic_cast<ExpressionStatement*>(fn->body->statements->at(0))->expression);
+    EXPECT_TRUE(exp->tableBuilt);
+    ASSERT_FALSE(exp->table == nullptr);
+    EXPECT_EQ(exp->table->dense.size(), 3);
+}
@@ -0,0 +1,120 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "engines.hh"
+#include "generator.hh"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(generator, test_generators_yield_lazily) {
+    std::string upTo = "let upTo = fn(n) { for (k in 0..n) { yield k; } }; ";
+    std::string naturals = "let naturals = fn() { let produced = [0]; while (true) { yield produced[0]; produced[0] = produced[0] + 1; } }; ";
+    std::string collect = "let collect = fn(gen, n) { let out = []; for (x in gen) { if (len(out) == n) { break; } out[len(out)] = x; } out }; ";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {upTo + "let g = upTo(3); [next(g), next(g), next(g), next(g), next(g)]", "[0, 1, 2, null, null, ]"},
+        {upTo + "[upTo(1)]", "[generator, ]"},
+        {upTo + "let g = upTo(1); next(g); next(g); g", "generator(done)"},
+        // Nothing in the body runs before the first next.
+        {"let trace = []; let g = fn() { trace[len(trace)] = 1; yield 5; trace[len(trace)] = 2; }; let it = g(); let before = len(trace); let first = next(it); [before, first, len(trace)]", "[0, 5, 1, ]"},
+        // Infinite producers are fine, as only what is consumed is produced.
+        {naturals + collect + "collect(naturals(), 5)", "[0, 1, 2, 3, 4, ]"},
+        {naturals + collect + "let squares = fn(gen) { for (x in gen) { yield x * x; } }; let evens = fn(gen) { for (x in gen) { if (x / 2 * 2 == x) { yield x; } } }; collect(squares(evens(naturals())), 4)", "[0, 4, 16, 36, ]"},
+        {"let countdown = fn(n) { if (n > 0) { yield n; for (x in countdown(n - 1)) { yield x; } } }; let out = []; for (x in countdown(4)) { out[len(out)] = x; } out", "[4, 3, 2, 1, ]"},
+        // A loop that breaks leaves the generator where it stopped.
+        {upTo + "let g = upTo(5); for (x in g) { if (x == 1) { break; } } [next(g), next(g)]", "[2, 3, ]"},
+        {"let g = fn(a, b) { yield a; yield b; }; let it = g(\"x\", [1]); [next(it), next(it)]", "[x, [1, ], ]"},
+        {"let g = fn() { yield 1; return 2; yield 3; }; let it = g(); [next(it), next(it), next(it)]", "[1, null, null, ]"},
+        {"let g = fn() { yield 1; 1 + true; }; let it = g(); next(it); next(it)", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {"let g = fn() { yield 1; missing; }; let out = []; for (x in g()) { out[len(out)] = x; } out", "ERROR: identifier not found: missing"},
+        {"let holder = []; let g = fn() { yield next(holder[0]); }; holder[0] = g(); next(holder[0])", "ERROR: generator is already running"},
+        {"next(1)", "ERROR: argument to `next` must be GENERATOR or ITERATOR, got INTEGER"},
+        {"next()", "ERROR: wrong number of arguments. got=0, want=1"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(generator, test_suspended_generators_hold_no_thread) {
+    // Each suspended body is a stack and saved registers, so thousands of them
+    // coexist on the one thread running the program.
+    std::string input = "let upTo = fn(n) { for (k in 0..n) { yield k; } }; let gens = []; for (k in 0..2000) { let g = upTo(3); next(g); gens[k] = g; } let sum = [0]; for (g in gens) { sum[0] = sum[0] + next(g) + next(g); } sum[0]";
+    EXPECT_EQ(testEval(input)->inspect(), "6000");
+
+    // Bodies that end hand their stacks back, so running generators one after
+    // another reuses the same few.
+    EXPECT_EQ(testEval("let upTo = fn(n) { for (k in 0..n) { yield k; } }; let sum = [0]; for (k in 0..5000) { for (x in upTo(2)) { sum[0] = sum[0] + x; } } sum[0]")->inspect(), "5000");
+}
+
+TEST(generator, test_resume_from_outside_the_language) {
+    int calls = 0;
+    generator::Generator gen([&calls] {
+        calls++;
+        generator::yield(object::Integer::make(1));
+        generator::yield(object::Integer::make(2));
+        return evaluator::NULLobj;
+    });
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(gen.resume()->inspect(), "1");
+    EXPECT_EQ(gen.resume()->inspect(), "2");
+    EXPECT_FALSE(gen.done());
+    EXPECT_EQ(gen.resume(), nullptr);
+    EXPECT_TRUE(gen.done());
+    EXPECT_EQ(gen.resume(), nullptr);
+    EXPECT_EQ(calls, 1);
+
+    // An Error ends the body; the next resume after it finds nothing left.
+    generator::Generator failing([] {
+        return new object::Error("stopped");
+    });
+    EXPECT_EQ(failing.resume()->inspect(), "ERROR: stopped");
+    EXPECT_EQ(failing.resume(), nullptr);
+    EXPECT_EQ(generator::yield(evaluator::NULLobj)->inspect(), "ERROR: yield outside of a generator");
+}
+
+TEST(generator, test_freed_generators_hand_back_their_stacks) {
+    // Far more suspended bodies than the process could map a stack each for;
+    // freeing one puts its stack back for the next.
+    size_t before = generator::mappedStacks();
+    std::vector<generator::Generator*> live;
+    size_t yielded = 0;
+    for (int k = 0; k < 150000; k++) {
+        auto *gen = new generator::Generator([] {
+            generator::yield(object::Integer::make(1));
+            return evaluator::NULLobj;
+        });
+        object::Object *value = gen->resume();
+        ASSERT_NE(value, nullptr);
+        ASSERT_EQ(value->inspect(), "1") << "generator " << k;
+        yielded++;
+        live.push_back(gen);
+        // Keep a few arenas' worth suspended at once.
+        if (live.size() == 100) {
+            for (auto *old : live) {
+                delete old;
+            }
+            live.clear();
+        }
+    }
+    for (auto *old : live) {
+        delete old;
+    }
+    EXPECT_EQ(yielded, 150000);
+    EXPECT_LE(generator::mappedStacks() - before, 4 * generator::ARENA_STACKS);
+}
+
+TEST(generator, test_deep_recursion_in_a_generator_is_an_error) {
+#if defined(__SANITIZE_THREAD__)
+    GTEST_SKIP() << "deep closure-engine recursion runs out of memory under ThreadSanitizer";
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+    GTEST_SKIP() << "deep closure-engine recursion runs out of memory under ThreadSanitizer";
+#endif
+#endif
+    std::string deep = "let deep = fn(n) { if (n == 0) { 0 } else { 1 + deep(n - 1) } }; ";
+    EXPECT_EQ(testEval(deep + "let g = fn() { yield deep(100); }; next(g())")->inspect(), "100");
+    EXPECT_EQ(testEval(deep + "let g = fn() { yield deep(1000000); }; next(g())")->inspect(), "ERROR: stack overflow in generator");
+}
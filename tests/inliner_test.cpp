@@ -0,0 +1,119 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "inliner.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+Program *parseInline(const std::string &input) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    return p.parseProgram();
+}
+
+// Evaluates input with and without inlining on both engines, checks all
+// results agree, and returns the number of call sites inlined.
+size_t compareInlined(const std::string &input) {
+    object::Object *expected = evaluator::eval(parseInline(input), new object::Environment());
+    Program *program = parseInline(input);
+    object::Environment *env = new object::Environment();
+    size_t inlined = inliner::inlineCalls(program, env);
+    object::Object *tree = evaluator::eval(program, env);
+    EXPECT_EQ(tree->type(), expected->type()) << input;
+    EXPECT_EQ(tree->inspect(), expected->inspect()) << input;
+    program = parseInline(input);
+    env = new object::Environment();
+    inliner::inlineCalls(program, env);
+    object::Object *closure = compiler::eval(program, env);
+    EXPECT_EQ(closure->type(), expected->type()) << input;
+    EXPECT_EQ(closure->inspect(), expected->inspect()) << input;
+    return inlined;
+}
+
+TEST(inliner, test_inlined_call_sites) {
+    struct InlineTest {
+        std::string input;
+        size_t expected;
+    };
+
+    std::vector<InlineTest> tests = {
+        {"let add = fn(a, b) { a + b }; add(1, 2)", 1},
+        {"let isZero = fn(x) { x == 0 }; let f = fn(n) { if (isZero(n)) { 1 } else { n } }; f(0) + f(5)", 3},
+        {"let add = fn(a, b) { a + b }; let x = 10; add(x, add(1, 2))", 1},
+        {"let sq = fn(x) { x * x }; let f = fn(n) { sq(n) + sq(n + 1) }; f(3)", 2},
+        {"let k = 7; let addK = fn(x) { x + k }; let f = fn(y) { addK(y) }; f(1)", 2},
+        {"let pick = fn(c, a, b) { if (c) { a } else { b } }; pick(true, 1, 2) + pick(false, 1, 2)", 2},
+        {"let second = fn(xs) { xs[1] }; let xs = [1, 2, 3]; second(xs) + second([4, 5])", 1},
+        {"let size = fn(s) { len(s) }; size(\"four\") + size(len)", 2},
+        {"let f = fn(x) { x }; let g = fn() { f(1) }; let f = 5; g()", 1},
+        {"let fact = fn(n) { if (n == 0) { 1 } else { n * fact(n - 1) } }; fact(5)", 0},
+        {"let k = 7; let addK = fn(x) { x + k }; let f = fn(k) { addK(k) }; f(1)", 1},
+        {"let add = fn(a, b) { let c = a + b; c }; add(1, 2)", 0},
+        {"let early = fn(a) { add(1, 2) }; let add = fn(a, b) { a + b }; early(0)", 1},
+        {"let add = fn(a, b) { a + b }; let g = fn(add) { add(1, 2) }; g(fn(a, b) { a * b })", 0},
+        {"let add = fn(a, b) { a + b }; add(1)", 0},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(compareInlined(test.input), test.expected) << test.input;
+    }
+}
+
+TEST(inliner, test_errors_match) {
+    std::vector<std::string> tests = {
+        "let add = fn(a, b) { a + b }; add(1, true)",
+        "let add = fn(a, b) { a + b }; add(missing, other)",
+        "let add = fn(a, b) { b + a }; add(missing, other)",
+        "let first = fn(a, b) { a }; first(1, missing)",
+        "let div = fn(a, b) { a / b }; div(1, 0)",
+        "let f = fn(x) { x + k }; f(1); let k = 2;",
+        "let neg = fn(x) { -x }; neg(\"a\")",
+    };
+
+    for (auto test : tests) {
+        compareInlined(test);
+    }
+}
+
+TEST(inliner, test_inspect_shows_original_call) {
+    Program *program = parseInline("let add = fn(a, b) { a + b }; let f = fn(x) { add(x, 1) }; f");
+    object::Environment *env = new object::Environment();
+    EXPECT_EQ(inliner::inlineCalls(program, env), 1);
+    EXPECT_EQ(evaluator::eval(program, env)->inspect(), "fn(x, ) {\nadd(x, 1)\n}");
+}
+
+TEST(inliner, test_functions_from_earlier_programs) {
+    object::Environment *env = new object::Environment();
+    Program *first = parseInline("let add = fn(a, b) { a + b };");
+    EXPECT_EQ(inliner::inlineCalls(first, env), 0);
+    evaluator::eval(first, env);
+    Program *second = parseInline("add(2, 3) * add(4, 5)");
+    EXPECT_EQ(inliner::inlineCalls(second, env), 2);
+    EXPECT_EQ(evaluator::eval(second, env)->inspect(), "45");
+}
+
+TEST(inliner, test_assigned_names) {
+    // A callee or argument that is assigned anywhere is never inlined.
+    EXPECT_EQ(compareInlined("let scaleBy = fn(v) { v * 2 }; let r = scaleBy(3); scaleBy = fn(v) { v * 3 }; r + scaleBy(3)"), 0);
+    EXPECT_EQ(compareInlined("let half = fn(v) { v / 2 }; let steps = 8; let r = half(steps); steps = 2; r + half(steps)"), 0);
+
+    // Sites inlined before a later program assigns the callee make the call again.
+    object::Environment *env = new object::Environment();
+    Program *first = parseInline("let bumpOnce = fn(v) { v + 1 }; let twiceBumped = fn() { bumpOnce(1) + bumpOnce(2) };");
+    EXPECT_EQ(inliner::inlineCalls(first, env), 2);
+    evaluator::eval(first, env);
+    EXPECT_EQ(evaluator::eval(parseInline("twiceBumped()"), env)->inspect(), "5");
+    Program *second = parseInline("bumpOnce = fn(v) { v * 10 };");
+    inliner::inlineCalls(second, env);
+    evaluator::eval(second, env);
+    EXPECT_EQ(evaluator::eval(parseInline("twiceBumped()"), env)->inspect(), "30");
+    EXPECT_EQ(compiler::eval(parseInline("twiceBumped()"), env)->inspect(), "30");
+}
+
+TEST(inliner, test_disabled) {
+    inliner::enabled = false;
+    EXPECT_EQ(inliner::inlineCalls(parseInline("let add = fn(a, b) { a + b }; add(1, 2)"), new object::Environment()), 0);
+    inliner::enabled = true;
+}
@@ -0,0 +1,107 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "isolate.hh"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+object::Object *evalIsolate(const std::string &input) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    return evaluator::eval(program, new object::Environment());
+}
+
+TEST(isolate, test_channel_is_a_bounded_queue) {
+    isolate::Channel channel(3);
+    EXPECT_EQ(channel.capacity(), 4);
+    object::Object *value = nullptr;
+    EXPECT_FALSE(channel.tryReceive(value));
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(channel.trySend(object::Integer::make(i)));
+    }
+    EXPECT_FALSE(channel.trySend(object::Integer::make(4)));
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(channel.tryReceive(value));
+        EXPECT_EQ(dynamic_cast<object::Integer*>(value)->value, i);
+    }
+    EXPECT_FALSE(channel.tryReceive(value));
+}
+
+TEST(isolate, test_channel_delivers_every_value_once) {
+    const int producers = 4;
+    const int consumers = 4;
+    const int each = 5000;
+    isolate::Channel channel(64);
+    std::vector<std::atomic<int>> received(producers * each);
+    std::atomic<int> remaining(producers * each);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < each; i++) {
+                while (!channel.trySend(object::Integer::make(p * each + i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&] {
+            object::Object *value;
+            while (remaining > 0) {
+                if (channel.tryReceive(value)) {
+                    received[dynamic_cast<object::Integer*>(value)->value]++;
+                    remaining--;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < received.size(); i++) {
+        EXPECT_EQ(received[i].load(), 1) << i;
+    }
+}
+
+TEST(isolate, test_isolates_run_programs_side_by_side) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"let fib = \"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; fib(n)\"; let a = isolate(fib, {\"n\": 20}); let b = isolate(fib, {\"n\": 15}); [await(a), await(b)]", "[6765, 610, ]"},
+        // The same names are bound, assigned and typed differently in each isolate.
+        {"let src = \"let acc = start; for (i in 0..10) { acc = acc + step; } acc\"; let xs = isolate(src, {\"start\": \"\", \"step\": \"ab\"}); let ys = isolate(src, {\"start\": 0, \"step\": 3}); [len(await(xs)), await(ys)]", "[20, 30, ]"},
+        {"let ch = channel(2); let worker = isolate(\"let loop = fn(sum) { let x = receive(jobs); if (x) { loop(sum + x) } else { sum } }; loop(0)\", {\"jobs\": ch}); for (i in 0..100) { send(ch, i); } close(ch); await(worker)", "4950"},
+        {"let requests = channel(4); let replies = channel(4); let server = isolate(\"let serve = fn() { let r = receive(requests); if (r) { send(replies, r[0] * 2); serve() } else { 0 } }; serve()\", {\"requests\": requests, \"replies\": replies}); send(requests, [21]); let answer = receive(replies); close(requests); await(server); answer", "42"},
+        // Mutable values are copied on the way in and out.
+        {"let data = [1, [2]]; let ch = channel(1); send(ch, data); data[1][0] = 5; let copy = receive(ch); [copy[1][0], data[1][0]]", "[2, 5, ]"},
+        {"let shared = [1]; let iso = isolate(\"shared[0] = 2; shared\", {\"shared\": shared}); [await(iso)[0], shared[0]]", "[2, 1, ]"},
+        {"let iso = isolate(\"1 +\", {}); await(iso)", "ERROR: parser errors in isolate: no prefix parse function for EOF found"},
+        {"let iso = isolate(\"fn(x) { x }\", {}); await(iso)", "ERROR: cannot share FUNCTION between isolates"},
+        {"let iso = isolate(\"missing\", {}); [await(iso), await(iso)]", "ERROR: identifier not found: missing"},
+        {"isolate(\"1\", {\"f\": fn() { 1 }})", "ERROR: cannot share FUNCTION between isolates"},
+        {"send(channel(1), [spawn(fn() { 1 })])", "ERROR: cannot share FUTURE between isolates"},
+        {"let ch = channel(1); close(ch); [send(ch, 1), receive(ch)]", "ERROR: send on closed channel"},
+        {"let ch = channel(1); send(ch, 1); close(ch); [receive(ch), receive(ch)]", "[1, null, ]"},
+        {"channel(0)", "ERROR: channel capacity must be between 1 and 1048576, got 0"},
+        {"receive(1)", "ERROR: argument to `receive` must be CHANNEL, got INTEGER"},
+        {"isolate(1, {})", "ERROR: argument to `isolate` must be STRING, got INTEGER"},
+        {"isolate(\"1\", {1: 2})", "ERROR: isolate bindings must be named by STRING, got INTEGER"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(evalIsolate(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(isolate, test_failed_tells_errors_from_unshareable_results) {
+    isolate::Isolate ended("let f = fn() { 1 }; f", {}, evaluator::eval);
+    EXPECT_EQ(ended.join()->inspect(), "ERROR: cannot share FUNCTION between isolates");
+    EXPECT_FALSE(ended.failed());
+    isolate::Isolate stopped("let x = 1; x + true", {{"unused", object::Integer::make(1)}}, evaluator::eval);
+    EXPECT_EQ(stopped.join()->inspect(), "ERROR: type mismatch: INTEGER + BOOLEAN");
+    EXPECT_TRUE(stopped.failed());
+}
@@ -0,0 +1,67 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "engines.hh"
+#include "iterator.hh"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(iterator, test_pipelines_pull_one_element_at_a_time) {
+    std::string even = "let even = fn(x) { x / 2 * 2 == x }; ";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"range(3)", "iterator"},
+        {"collect(range(5))", "[0, 1, 2, 3, 4, ]"},
+        {"collect(range(2, 10, 3))", "[2, 5, 8, ]"},
+        {"collect(range(5, 0, -2))", "[5, 3, 1, ]"},
+        {even + "collect(map(filter(range(0, 10), even), fn(x) { x * x }))", "[0, 4, 16, 36, 64, ]"},
+        {even + "collect(take(filter(map(range(0, 1000000000), fn(x) { x * 3 }), even), 4))", "[0, 6, 12, 18, ]"},
+        {"collect(map([\"a\", \"bc\"], len))", "[1, 2, ]"},
+        {"collect(zip([1, 2, 3], range(10, 12)))", "[[1, 10, ], [2, 11, ], ]"},
+        {"fold(range(1, 100001), 0, fn(acc, x) { acc + x })", "5000050000"},
+        {"fold([], 7, fn(acc, x) { x })", "7"},
+        {"let gen = fn() { let i = [0]; while (true) { yield i[0]; i[0] = i[0] + 1; } }; collect(take(map(gen(), fn(x) { x + 1 }), 3))", "[1, 2, 3, ]"},
+        {"let out = []; for (x in take(range(0, 100), 3)) { out[len(out)] = x; } out", "[0, 1, 2, ]"},
+        {"let it = map([1, 2], fn(x) { x * 10 }); [next(it), next(it), next(it)]", "[10, 20, null, ]"},
+        // Only what is pulled is computed, and take stops pulling.
+        {"let calls = [0]; let sq = fn(x) { calls[0] = calls[0] + 1; x * x }; let firstThree = collect(take(map(range(0, 1000000), sq), 3)); [firstThree, calls[0]]", "[[0, 1, 4, ], 3, ]"},
+        {"let calls = [0]; collect(take(map(range(0, 5), fn(x) { calls[0] = calls[0] + 1; x }), 0)); calls[0]", "0"},
+        // An iterator built on another pulls from the same source.
+        {even + "let src = range(0, 10); let evens = filter(src, even); [next(src), next(evens), next(src)]", "[0, 2, 3, ]"},
+        {"let firstTwo = take(range(0, 10), 2); let doubled = map(firstTwo, fn(x) { x * 2 }); [next(firstTwo), collect(doubled)]", "[0, [2, ], ]"},
+        // Definitions of the same names take precedence.
+        {"let map = fn(xs, f) { 42 }; map([1], len)", "42"},
+        {"collect(map(range(3), fn(x) { x + true }))", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {"map(1, fn(x) { x })", "ERROR: argument to `map` must be ARRAY, GENERATOR or ITERATOR, got INTEGER"},
+        {"filter([1], fn(a, b) { a })", "ERROR: function passed to `filter` must take 1 argument, got 2"},
+        {"fold([1], 0, 1)", "ERROR: argument to `fold` must be FUNCTION, got INTEGER"},
+        {"range(0, 5, 0)", "ERROR: range step must not be 0"},
+        {"range(\"a\")", "ERROR: argument to `range` must be INTEGER, got STRING"},
+        {"take([1], -1)", "ERROR: argument to `take` must not be negative, got -1"},
+        {"zip([1])", "ERROR: wrong number of arguments. got=1, want=2 or more"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(iterator, test_take_stops_its_source) {
+    int produced = 0;
+    generator::Generator *source = new generator::Generator([&produced] {
+        for (int64_t i = 0; ; i++) {
+            produced++;
+            generator::yield(object::Integer::make(i));
+        }
+        return evaluator::NULLobj;
+    });
+    object::Object *same = new object::Builtin([](std::vector<object::Object*> args) -> object::Object* {
+        return args[0];
+    });
+    object::Object *chain = iterator::take({iterator::filter({iterator::map({source, same}), same}), object::Integer::make(3)});
+    EXPECT_EQ(iterator::collect({chain})->inspect(), "[0, 1, 2, ]");
+    EXPECT_EQ(produced, 3);
+    EXPECT_EQ(iterator::next({chain}), evaluator::NULLobj);
+    EXPECT_EQ(produced, 3);
+}
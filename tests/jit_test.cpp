@@ -0,0 +1,144 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "repl.hh"
+#include "jit.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+object::Object *evalJit(const std::string &input, repl::engine_t engine, bool enabled) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    object::Environment *env = new object::Environment();
+    bool wasEnabled = jit::enabled;
+    size_t threshold = jit::threshold;
+    jit::enabled = enabled;
+    jit::threshold = 2;
+    object::Object *result = engine(program, env);
+    jit::enabled = wasEnabled;
+    jit::threshold = threshold;
+    return result;
+}
+
+// Runs input interpreted and jitted on both engines and checks all four agree.
+// Returns how many functions the jitted tree-walker run compiled.
+size_t compareJit(const std::string &input) {
+    object::Object *expected = evalJit(input, evaluator::eval, false);
+    size_t before = jit::compiled;
+    object::Object *tree = evalJit(input, evaluator::eval, true);
+    size_t compiled = jit::compiled - before;
+    object::Object *closure = evalJit(input, compiler::eval, true);
+    EXPECT_EQ(tree->type(), expected->type()) << input;
+    EXPECT_EQ(tree->inspect(), expected->inspect()) << input;
+    EXPECT_EQ(closure->type(), expected->type()) << input;
+    EXPECT_EQ(closure->inspect(), expected->inspect()) << input;
+    return compiled;
+}
+
+TEST(jit, test_compiled_functions_match_interpreter) {
+    std::vector<std::string> tests = {
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) }; fib(20)",
+        "let fact = fn(n) { if (n == 0) { 1 } else { n * fact(n - 1) } }; fact(20)",
+        "let sub = fn(a, b) { a - b }; let f = fn(x) { sub(x, 3) * -x }; f(1) + f(2) + f(3)",
+        "let d = fn(a, b) { a / b }; d(7, 2) + d(-7, 2) + d(100, -3)",
+        "let k = 1000; let scale = fn(x) { let y = x * k; let z = y + 7; z / 3 }; scale(1) + scale(2) + scale(3)",
+        "let six = fn(a, b, c, d, e, f) { a - b + c - d + e - f }; six(1, 2, 3, 4, 5, 6) + six(6, 5, 4, 3, 2, 1) + six(1, 1, 1, 1, 1, 1)",
+        "let isEven = fn(n) { if (n == 0) { 1 } else { isOdd(n - 1) } }; let isOdd = fn(n) { if (n == 0) { 0 } else { isEven(n - 1) } }; isEven(10) + isEven(7) + isOdd(9)",
+        "let clamp = fn(x) { if (x > 10) { return 10; } if (x < 0) { return 0; } x }; clamp(-5) + clamp(5) + clamp(50)",
+        "let g = fn(x) { match (x) { 1 => 10, -2 => 20, 5000000000 => { 3 }, _ => x * 2 } }; g(1) + g(-2) + g(5000000000) + g(7)",
+        "let g = fn(x) { match (x) { 1 => { return 5; }, _ => 0 }; x }; g(1) + g(2) + g(3)",
+    };
+
+    for (auto test : tests) {
+        EXPECT_GT(compareJit(test), 0) << test;
+    }
+}
+
+TEST(jit, test_guards_fall_back_to_interpreter) {
+    std::vector<std::string> tests = {
+        // Overflow bails out and the interpreter promotes to a big integer.
+        "let sq = fn(x) { x * x }; sq(2); sq(3); sq(4000000000)",
+        "let inc = fn(x) { x + 1 }; inc(1); inc(2); inc(9223372036854775807)",
+        "let neg = fn(x) { -x }; neg(1); neg(2); neg(-9223372036854775807 - 1)",
+        "let d = fn(a, b) { a / b }; d(4, 2); d(9, 3); d(-9223372036854775807 - 1, -1)",
+        // Errors are still reported by the interpreter.
+        "let d = fn(a, b) { a / b }; d(4, 2); d(9, 3); d(1, 0)",
+        // Non-integer arguments never enter native code.
+        "let add = fn(a, b) { a + b }; add(1, 2); add(3, 4); add(\"a\", \"b\")",
+        "let add = fn(a, b) { a + b }; add(1, 2); add(3, 4); add(true, 1)",
+        "let add = fn(a, b) { a + b }; add(1, 2); add(3, 4); add(99999999999999999999, 1)",
+    };
+
+    for (auto test : tests) {
+        compareJit(test);
+    }
+
+    size_t before = jit::bailouts;
+    compareJit("let sq = fn(x) { x * x }; sq(2); sq(3); sq(4000000000)");
+    EXPECT_EQ(jit::bailouts - before, 2);
+}
+
+TEST(jit, test_unsupported_functions_stay_interpreted) {
+    std::vector<std::string> tests = {
+        "let f = fn(x) { x < 3 }; f(1); f(2); f(5)",
+        "let f = fn(x) { if (x > 1) { x } }; f(1); f(2); f(5)",
+        "let f = fn(x) { len(\"ab\") + x }; f(1); f(2); f(5)",
+        "let f = fn(x) { let g = fn(y) { x + y }; g(x) }; f(1); f(2); f(5)",
+        "let f = fn(x) { if (x) { 1 } else { 2 } }; f(1); f(2); f(5)",
+        "let f = fn(x) { if (x > 0) { let y = 2; y } else { 1 } }; f(1); f(2); f(5)",
+        "let f = fn(x) { puts(x); x }; f(1); f(2); f(5)",
+        "let make = fn(k) { fn(x) { x + k } }; let f = make(2); f(1); f(2); f(5)",
+        "let f = fn(x) { x = x + 1; x }; f(1); f(2); f(5)",
+        "let f = fn(x) { match (x) { 1 => 2 } }; f(1); f(2); f(5)",
+        "let f = fn(x) { match (x) { \"a\" => 2, _ => 1 } }; f(1); f(2); f(5)",
+        "let offset = 1; let f = fn(x) { x + offset }; f(1); offset = 10; f(2); f(5)",
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(compareJit(test), 0) << test;
+    }
+}
+
+TEST(jit, test_assignments_drop_baked_globals) {
+    size_t threshold = jit::threshold;
+    jit::threshold = 2;
+    object::Environment *env = new object::Environment();
+    auto run = [env](const std::string &input) {
+        Lexer l = Lexer(input);
+        Parser p = Parser(&l);
+        return evaluator::eval(p.parseProgram(), env)->inspect();
+    };
+    size_t before = jit::compiled;
+    EXPECT_EQ(run("let scaleFactor = 3; let scaled = fn(v) { v * scaleFactor }; scaled(1); scaled(2); scaled(3)"), "9");
+    EXPECT_EQ(jit::compiled - before, 1);
+    // Parsing the assignment invalidates the code that baked scaleFactor in.
+    EXPECT_EQ(run("scaleFactor = 5; scaled(2)"), "10");
+    EXPECT_EQ(run("scaled(3)"), "15");
+    jit::threshold = threshold;
+}
+
+TEST(jit, test_recompiling_unmaps_stale_code) {
+    size_t threshold = jit::threshold;
+    jit::threshold = 2;
+    object::Environment *env = new object::Environment();
+    auto run = [env](const std::string &input) {
+        Lexer l = Lexer(input);
+        Parser p = Parser(&l);
+        return evaluator::eval(p.parseProgram(), env)->inspect();
+    };
+    size_t compiled = jit::compiled;
+    size_t mapped = jit::mapped;
+    EXPECT_EQ(run("let rounds = 0; let offset = 1; let shifted = fn(v) { v + offset }; shifted(1); shifted(2)"), "3");
+    size_t once = jit::mapped - mapped;
+    EXPECT_GT(once, 0);
+    for (int i = 0; i < 50; i++) {
+        // Each assignment makes the code stale, and the next hot call recompiles it.
+        EXPECT_EQ(run("rounds = " + std::to_string(i) + "; shifted(1); shifted(2)"), "3");
+    }
+    EXPECT_EQ(jit::compiled - compiled, 51);
+    EXPECT_EQ(jit::mapped - mapped, once);
+    jit::threshold = threshold;
+}
@@ -23,7 +23,11 @@ TEST(lexer, test_next_token) {
         "\"foobar\""
         "\"foo bar\""
         "[1, 2];"       
-        "{\"foo\": \"bar\"}";
+        "{\"foo\": \"bar\"}"
+        "for (i in 0..9) { break; continue; }"
+        "while "
+        "match (x) { 1 => 2 }"
+        "2.25 1..2";
 
     std::vector<Token> tests = {   
         Token(token::LET, "let"),
@@ -102,6 +106,34 @@ TEST(lexer, test_next_token) {
         Token(token::COLON, ":"),
         Token(token::STRING, "bar"),
         Token(token::RBRACE, "}"),
+        Token(token::FOR, "for"),
+        Token(token::LPAREN, "("),
+        Token(token::IDENT, "i"),
+        Token(token::IN, "in"),
+        Token(token::INT, "0"),
+        Token(token::DOTDOT, ".."),
+        Token(token::INT, "9"),
+        Token(token::RPAREN, ")"),
+        Token(token::LBRACE, "{"),
+        Token(token::BREAK, "break"),
+        Token(token::SEMICOLON, ";"),
+        Token(token::CONTINUE, "continue"),
+        Token(token::SEMICOLON, ";"),
+        Token(token::RBRACE, "}"),
+        Token(token::WHILE, "while"),
+        Token(token::MATCH, "match"),
+        Token(token::LPAREN, "("),
+        Token(token::IDENT, "x"),
+        Token(token::RPAREN, ")"),
+        Token(token::LBRACE, "{"),
+        Token(token::INT, "1"),
+        Token(token::ARROW, "=>"),
+        Token(token::INT, "2"),
+        Token(token::RBRACE, "}"),
+        Token(token::FLOAT, "2.25"),
+        Token(token::INT, "1"),
+        Token(token::DOTDOT, ".."),
+        Token(token::INT, "2"),
         Token(token::EOF_, ""),
     };
 
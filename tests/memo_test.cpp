@@ -0,0 +1,84 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "engines.hh"
+#include "memo.hh"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(memo, test_memo) {
+    std::string stats = "let s = memoStats(f); [s[\"hits\"], s[\"misses\"], s[\"size\"]]";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        // Without the cache this makes over 10^18 calls.
+        {"let fib = memo(fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }); fib(90)", "2880067194370816120"},
+        {"let f = memo(fn(n) { n * 2 }); f(1); f(2); f(1); " + stats, "[1, 2, 2, ]"},
+        // 1 and true have the same hash_key but are different arguments.
+        {"let f = memo(fn(x) { x }); [f(1), f(true), f(\"1\")]", "[1, true, 1, ]"},
+        {"let f = memo(fn(a, b) { a - b }); [f(1, 2), f(2, 1)]", "[-1, 1, ]"},
+        // Arrays are not hashable: calls with one are not cached.
+        {"let f = memo(fn(xs) { len(xs) }); f([1]); f([1]); " + stats, "[0, 2, 0, ]"},
+        {"let f = memo(len); [f(\"abc\"), f(\"abc\")]", "[3, 3, ]"},
+        {"memo(len)", "memo(builtin function)"},
+        {"memo()", "ERROR: wrong number of arguments. got=0, want=1 or 2"},
+        {"memo(1)", "ERROR: argument to `memo` must be FUNCTION, got INTEGER"},
+        {"memo(fn() { yield 1; })", "ERROR: cannot memoize a generator function"},
+        {"memo(fn(n) { n }, 0)", "ERROR: memo capacity must be positive, got 0"},
+        {"memo(fn(n) { n }, \"a\")", "ERROR: argument to `memo` must be INTEGER, got STRING"},
+        {"memoStats(len)", "ERROR: argument to `memoStats` must be a memoized function, got BUILTIN"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+// A big integer and the int64 equal to its hash have the same hash_key, but
+// each call still gets its own result.
+TEST(memo, test_memo_tells_colliding_arguments_apart) {
+    std::string big = "18446744073709551616";
+    Lexer l = Lexer(big);
+    Parser p = Parser(&l);
+    object::Object *value = evaluator::eval(p.parseProgram(), new object::Environment());
+    std::string small = std::to_string(static_cast<int64_t>(value->hash_key()));
+    std::string input = "let f = memo(fn(x) { x }); [f(" + big + "), f(" + small + "), f(" + big + ")]";
+    EXPECT_EQ(testEval(input)->inspect(), "[" + big + ", " + small + ", " + big + ", ]");
+}
+
+TEST(memo, test_memo_evicts_least_recently_used) {
+    std::string stats = "let s = memoStats(f); [s[\"hits\"], s[\"misses\"], s[\"size\"]]";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        // f(1) is used again before f(3) is stored, so f(2) is evicted.
+        {"let f = memo(fn(n) { n }, 2); f(1); f(2); f(1); f(3); f(1); f(2); " + stats, "[2, 4, 2, ]"},
+        {"let f = memo(fn(n) { n }, 1); f(1); f(2); f(1); " + stats, "[0, 3, 1, ]"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(memo, test_automatic_memoization) {
+    memo::automatic = true;
+    std::string size = "memoStats(f)[\"size\"]";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"let f = fn(n) { if (n < 2) { n } else { f(n - 1) + f(n - 2) } }; f(90)", "2880067194370816120"},
+        {"let f = fn(n) { if (n < 2) { n } else { f(n - 1) + f(n - 2) } }; f(20); " + size, "21"},
+        // Callees and constants that are never assigned may be read.
+        {"let two = 2; let half = fn(n) { n / two }; let f = fn(n) { if (n < 1) { 0 } else { f(half(n)) + 1 } }; f(8); " + size, "5"},
+        // Not recursive.
+        {"let f = fn(n) { n }; " + size, "ERROR: argument to `memoStats` must be a memoized function, got FUNCTION"},
+        // Effects, writes and reads of data that can change rule it out.
+        {"let f = fn(n) { puts(n); if (n > 0) { f(n - 1) } }; " + size, "ERROR: argument to `memoStats` must be a memoized function, got FUNCTION"},
+        {"let xs = [1]; let f = fn(n) { if (n > 0) { f(n - 1) } else { xs[0] } }; " + size, "ERROR: argument to `memoStats` must be a memoized function, got FUNCTION"},
+        {"let k = 1; let f = fn(n) { if (n > 0) { f(n - k) } else { 0 } }; k = 2; " + size, "ERROR: argument to `memoStats` must be a memoized function, got FUNCTION"},
+        // Only global lets are memoized.
+        {"let g = fn() { let f = fn(n) { if (n > 0) { f(n - 1) } else { 0 } }; " + size + " }; g()", "ERROR: argument to `memoStats` must be a memoized function, got FUNCTION"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+    memo::automatic = false;
+}
@@ -12,3 +12,61 @@ TEST(object, test_string_hash_key) {
     ASSERT_EQ(diff1.hash_key(), diff2.hash_key());
     ASSERT_NE(hello1.hash_key(), diff1.hash_key());
 }
+
+TEST(object, test_interned_string_literals) {
+    auto hello1 = object::String::literal(intern::symbol("Hello World"));
+    auto hello2 = object::String::literal(intern::symbol("Hello World"));
+    auto runtime = object::String("Hello World");
+
+    ASSERT_EQ(hello1, hello2);
+    ASSERT_EQ(hello1->hash_key(), runtime.hash_key());
+    ASSERT_TRUE(hello1->equals(&runtime));
+    ASSERT_FALSE(hello1->equals(object::String::literal(intern::symbol("My name is johnny"))));
+}
+
+TEST(object, test_string_rope_concat) {
+    auto left = new object::String(std::string(40, 'a'));
+    auto right = new object::String(std::string(40, 'b'));
+    auto joined = object::String::concat(left, right);
+    auto flat = object::String(std::string(40, 'a') + std::string(40, 'b'));
+
+    ASSERT_EQ(joined->length, 80);
+    ASSERT_EQ(joined->hash_key(), flat.hash_key());
+    ASSERT_EQ(joined->value(), flat.value());
+    ASSERT_TRUE(joined->equals(&flat));
+}
+
+TEST(object, test_shapes_are_interned) {
+    auto id = intern::symbol("id");
+    auto name = intern::symbol("name");
+    auto score = intern::symbol("score");
+    const object::Shape *shape = object::Shape::of({id, name, score});
+
+    ASSERT_EQ(object::Shape::of({score, id, name}), shape);
+    ASSERT_EQ(object::Shape::of({id, name, score, id}), shape);
+    ASSERT_NE(object::Shape::of({id, name}), shape);
+    ASSERT_EQ(shape->keys.size(), 3);
+    for (size_t i = 0; i < shape->keys.size(); i++) {
+        ASSERT_EQ(shape->slot(shape->keys[i]->hash_key()), i);
+    }
+    ASSERT_EQ(shape->slot(object::String("missing").hash_key()), -1);
+}
+
+TEST(object, test_shaped_hash_becomes_a_dictionary) {
+    auto a = object::String::literal(intern::symbol("a"));
+    auto b = object::String::literal(intern::symbol("b"));
+    object::Hash *shaped = new object::Hash(object::Shape::of({a->symbol}), {object::Integer::make(1)});
+    object::Hash *dictionary = new object::Hash(std::map<object::Object*, object::Object*>{{a, object::Integer::make(1)}});
+    ASSERT_EQ(shaped->inspect(), dictionary->inspect());
+
+    shaped->set(new object::String("a"), object::Integer::make(2));
+    ASSERT_TRUE(shaped->shape != nullptr);
+    ASSERT_EQ(shaped->get(a)->inspect(), "2");
+
+    shaped->set(b, object::Integer::make(3));
+    dictionary->set(a, object::Integer::make(2));
+    dictionary->set(b, object::Integer::make(3));
+    ASSERT_TRUE(shaped->shape == nullptr);
+    ASSERT_EQ(shaped->inspect(), dictionary->inspect());
+    ASSERT_EQ(shaped->get(new object::String("b"))->inspect(), "3");
+}
@@ -0,0 +1,162 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "engines.hh"
+#include "packed.hh"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST(packed, test_floats) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"2.5", "2.5"},
+        {"-2.5", "-2.5"},
+        {"1.5 + 2", "3.5"},
+        {"0.1 + 0.2", "0.30000000000000004"},
+        {"3 * 2.0", "6.0"},
+        {"7 / 2.0", "3.5"},
+        {"[1 < 1.5, 2.0 == 2, 2.5 != 2.5]", "[true, true, false, ]"},
+        {"1.0 / 0", "ERROR: division by zero"},
+        {"1.5 + \"a\"", "ERROR: type mismatch: FLOAT + STRING"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(packed, test_packed_arrays) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"pack([1, 2, 3])", "[1, 2, 3, ]"},
+        {"pack([1, 2.5])", "[1.0, 2.5, ]"},
+        {"let xs = pack([1, 2]); xs[2] = 7; [len(xs), xs[0], xs[2], xs[3]]", "[3, 1, 7, null, ]"},
+        {"let xs = pack([1.5]); xs[0] = 2; xs", "[2.0, ]"},
+        {"let xs = pack([1, 2]); xs[0] = 1.5", "ERROR: cannot store FLOAT in INT64_ARRAY"},
+        {"let xs = pack([1, 2]); xs[5] = 1", "ERROR: index out of range: 5 (length 2)"},
+        {"let total = [0]; for (x in pack([1, 2, 3])) { total[0] = total[0] + x; } total[0]", "6"},
+        {"collect(map(pack([1.5, 2.5]), fn(x) { x * 2 }))", "[3.0, 5.0, ]"},
+        {"let xs = pack([1, 2, 3]); [first(xs), last(xs), rest(xs), first(pack([]))]", "[1, 3, [2, 3, ], null, ]"},
+        {"[rest(pack([1.5, 2.5])), rest(pack([]))]", "[[2.5, ], null, ]"},
+        {"let xs = pack([1, 2]); let ys = push(xs, 3); [xs, ys]", "[[1, 2, ], [1, 2, 3, ], ]"},
+        {"let ys = push(pack([1, 2]), 3); ys[2]", "3"},
+        {"let ys = push(pack([1, 2]), 3); ys[0] = 1.5", "ERROR: cannot store FLOAT in INT64_ARRAY"},
+        {"[push(pack([1.5]), 2), push(pack([1]), 2.5), push(pack([1]), \"a\")]", "[[1.5, 2.0, ], [1, 2.5, ], [1, a, ], ]"},
+        {"pack([1, \"a\"])", "ERROR: argument to `pack` must hold only INTEGER and FLOAT elements, within 64 bits"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+TEST(packed, test_numeric_builtins) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"sum([1, 2, 3, 4, 5, 6, 7, 8, 9])", "45"},
+        {"sum([])", "0"},
+        {"sum([0.5, 1, 1.5])", "3.0"},
+        {"[min([3, -1, 2, 8, 5]), max([3, -1, 2, 8, 5]), min([]), max([1.5, 2])]", "[-1, 8, null, 2.0, ]"},
+        {"dot([1, 2, 3], [4, 5, 6])", "32"},
+        {"dot([1, 2], [0.5, 0.5])", "1.5"},
+        {"add([1, 2], pack([3, 4]))", "[4, 6, ]"},
+        {"mul(pack([1.5, 2]), [2, 2])", "[3.0, 4.0, ]"},
+        {"[scale([1, 2, 3], 2), scale([1, 2], 0.5)]", "[[2, 4, 6, ], [0.5, 1.0, ], ]"},
+        {"prefixSum([1, 2, 3, 4])", "[1, 3, 6, 10, ]"},
+        // Integer overflow is worked out again exactly, even where only a
+        // partial sum overflowed.
+        {"sum([9223372036854775807, 1])", "9223372036854775808"},
+        {"sum([9223372036854775807, 0, 0, 0, 1, 0, 0, 0, -2])", "9223372036854775806"},
+        {"dot([4611686018427387904, 1], [2, 1])", "9223372036854775809"},
+        {"add([9223372036854775807, 1], [1, 1])", "[9223372036854775808, 2, ]"},
+        {"mul([4611686018427387904], [2])", "[9223372036854775808, ]"},
+        {"scale([1, 2], 9223372036854775807)", "[9223372036854775807, 18446744073709551614, ]"},
+        {"prefixSum([9223372036854775807, 1, -2])", "[9223372036854775807, 9223372036854775808, 9223372036854775806, ]"},
+        {"let sum = fn(xs) { 0 }; sum([1])", "0"},
+        {"sum()", "ERROR: wrong number of arguments. got=0, want=1"},
+        {"sum(1)", "ERROR: argument to `sum` must be ARRAY, got INTEGER"},
+        {"max([1, [2]])", "ERROR: argument to `max` must hold only INTEGER and FLOAT elements, within 64 bits"},
+        {"dot([1, 2, 3], [1, 2])", "ERROR: arrays passed to `dot` must have the same length, got 3 and 2"},
+        {"scale([1], \"a\")", "ERROR: argument to `scale` must be INTEGER or FLOAT, got STRING"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(testEval(test.first)->inspect(), test.second) << test.first;
+    }
+}
+
+// The AVX2 kernels and the portable loops agree on every length, so the
+// vector bodies and their scalar tails are both covered. The floats are
+// small whole numbers, so adding them in any order is exact.
+TEST(packed, test_kernels_agree_with_and_without_simd) {
+    std::mt19937_64 rng(47);
+    for (size_t n = 1; n < 40; n++) {
+        std::vector<int64_t> a(n), b(n);
+        std::vector<double> x(n), y(n);
+        for (size_t i = 0; i < n; i++) {
+            a[i] = static_cast<int64_t>(rng() % 2001) - 1000;
+            b[i] = static_cast<int64_t>(rng() % 2001) - 1000;
+            x[i] = static_cast<double>(a[i]);
+            y[i] = static_cast<double>(b[i]);
+        }
+        std::vector<std::vector<std::string>> results;
+        for (bool vectorize : {true, false}) {
+            packed::vectorize = vectorize;
+            std::vector<std::string> result;
+            int64_t total;
+            EXPECT_TRUE(packed::kernel::sum(a.data(), n, total));
+            result.push_back(std::to_string(total));
+            result.push_back(std::to_string(packed::kernel::sum(x.data(), n)));
+            result.push_back(std::to_string(packed::kernel::min(a.data(), n)) + " " + std::to_string(packed::kernel::max(a.data(), n)));
+            result.push_back(std::to_string(packed::kernel::min(x.data(), n)) + " " + std::to_string(packed::kernel::max(x.data(), n)));
+            result.push_back(std::to_string(packed::kernel::dot(x.data(), y.data(), n)));
+            std::vector<int64_t> ints(n);
+            EXPECT_TRUE(packed::kernel::add(a.data(), b.data(), ints.data(), n));
+            for (auto v : ints) {
+                result.push_back(std::to_string(v));
+            }
+            std::vector<double> floats(n);
+            packed::kernel::add(x.data(), y.data(), floats.data(), n);
+            packed::kernel::mul(floats.data(), y.data(), floats.data(), n);
+            packed::kernel::scale(floats.data(), 3, floats.data(), n);
+            for (auto v : floats) {
+                result.push_back(std::to_string(v));
+            }
+            results.push_back(result);
+        }
+        EXPECT_EQ(results[0], results[1]) << "n=" << n;
+    }
+    packed::vectorize = true;
+
+    std::vector<int64_t> big = {INT64_MAX, 1, 0, 0, 0};
+    std::vector<int64_t> out(big.size());
+    for (bool vectorize : {true, false}) {
+        packed::vectorize = vectorize;
+        int64_t total;
+        EXPECT_FALSE(packed::kernel::sum(big.data(), big.size(), total));
+        EXPECT_FALSE(packed::kernel::add(big.data(), big.data(), out.data(), big.size()));
+    }
+    packed::vectorize = true;
+}
+
+// A NaN anywhere, in the vector body or the scalar tail, makes min and max
+// NaN on both paths.
+TEST(packed, test_min_and_max_of_nan_agree_with_and_without_simd) {
+    for (size_t n = 1; n < 12; n++) {
+        for (size_t at = 0; at < n; at++) {
+            std::vector<double> xs(n);
+            for (size_t i = 0; i < n; i++) {
+                xs[i] = static_cast<double>(i % 5) - 2;
+            }
+            xs[at] = std::numeric_limits<double>::quiet_NaN();
+            for (bool vectorize : {true, false}) {
+                packed::vectorize = vectorize;
+                EXPECT_TRUE(std::isnan(packed::kernel::min(xs.data(), n))) << "n=" << n << " at=" << at << " vectorize=" << vectorize;
+                EXPECT_TRUE(std::isnan(packed::kernel::max(xs.data(), n))) << "n=" << n << " at=" << at << " vectorize=" << vectorize;
+            }
+        }
+    }
+    packed::vectorize = true;
+}
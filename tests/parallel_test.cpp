@@ -0,0 +1,253 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "parallel.hh"
+#include "scheduler.hh"
+#include "analysis.hh"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+object::Object *evalParallel(const std::string &input, object::Object* (*engine)(Node*, object::Environment*), object::Environment *env) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    // The pool starts on first use; give it workers even on a single core.
+    if (scheduler::threads == 0) {
+        scheduler::threads = 4;
+    }
+    size_t threshold = parallel::threshold;
+    parallel::threshold = 8;
+    object::Object *result = engine(program, env);
+    parallel::threshold = threshold;
+    return result;
+}
+
+// Runs input on both engines with the parallel builtins spreading anything
+// over 8 elements across the pool, checks they agree, and returns the result.
+std::string compareParallel(const std::string &input) {
+    object::Object *tree = evalParallel(input, evaluator::eval, new object::Environment());
+    object::Object *closure = evalParallel(input, compiler::eval, new object::Environment());
+    EXPECT_EQ(closure->inspect(), tree->inspect()) << input;
+    return tree->inspect();
+}
+
+TEST(parallel, test_for_each_runs_every_index_once) {
+    scheduler::threads = scheduler::threads == 0 ? 4 : scheduler::threads;
+    std::vector<std::atomic<int>> seen(1000);
+    scheduler::forEach(seen.size(), [&](size_t i) {
+        seen[i]++;
+        // Nested calls from pool threads help instead of blocking.
+        std::atomic<size_t> inner(0);
+        scheduler::forEach(3, [&](size_t) {
+            inner++;
+        });
+        EXPECT_EQ(inner.load(), 3);
+    });
+    for (size_t i = 0; i < seen.size(); i++) {
+        EXPECT_EQ(seen[i].load(), 1) << i;
+    }
+    EXPECT_FALSE(scheduler::concurrent());
+}
+
+TEST(parallel, test_builtins_match_sequential_results) {
+    std::string range = "let range = fn(n) { let xs = []; for (i in 0..n) { xs[i] = i; } xs }; let xs = range(500); ";
+    struct ParallelTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<ParallelTest> tests = {
+        {range + "let ys = pmap(xs, fn(x) { x * x }); [len(ys), ys[0], ys[7], ys[499]]", "[500, 0, 49, 249001, ]"},
+        {range + "let zs = pfilter(xs, fn(x) { x / 7 * 7 == x }); [len(zs), zs[1], last(zs)]", "[72, 7, 497, ]"},
+        {range + "preduce(xs, 0, fn(a, b) { a + b })", "124750"},
+        {range + "len(preduce(pmap(xs, fn(x) { if (x < 26) { substr(\"abcdefghijklmnopqrstuvwxyz\", x, 1) } else { \"-\" } }), \"\", fn(a, b) { a + b }))", "500"},
+        {range + "substr(preduce(pmap(xs, fn(x) { if (x < 26) { substr(\"abcdefghijklmnopqrstuvwxyz\", x, 1) } else { \"-\" } }), \">\", fn(a, b) { a + b }), 0, 30)", ">abcdefghijklmnopqrstuvwxyz---"},
+        {range + "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; preduce(pmap(xs, fn(x) { fib(x / 50) }), 0, fn(a, b) { a + b })", "4400"},
+        {range + "let name = fn(x) { match (x / 100) { 0 => \"a\", 1 => \"b\", _ => \"c\" } }; join(pmap(pfilter(xs, fn(x) { x / 50 * 50 == x }), name), \"\")", "aabbcccccc"},
+        {range + "let big = 9223372036854775807; preduce(pmap(xs, fn(x) { big }), 0, fn(a, b) { a + b })", "4611686018427387903500"},
+        {range + "let rope = \"abcdefghijklmnopqrstuvwxyz\" + \"abcdefghijklmnopqrstuvwxyz\" + \"abcdefghijklmnopqrstuvwxyz!\"; preduce(pmap(xs, fn(x) { indexOf(rope, \"!\") + len(split(rope, \"q\")) }), 0, fn(a, b) { a + b })", "41000"},
+        {range + "let lookup = {\"even\": 0, \"odd\": 1}; len(pfilter(xs, fn(x) { lookup[if (x / 2 * 2 == x) { \"even\" } else { \"odd\" }] == 1 }))", "250"},
+        {"pmap([], fn(x) { x })", "[]"},
+        {"preduce([], 5, fn(a, b) { a + b })", "5"},
+        {"pmap([\"a\", \"bc\"], len)", "[1, 2, ]"},
+        {"preduce([1, 2, 3], 10, fn(a, b) { a - b })", "4"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(compareParallel(test.input), test.expected) << test.input;
+    }
+}
+
+// With a non-associative f the result depends on the chunking, which must
+// not depend on the pool or on whether the fold runs in parallel at all.
+TEST(parallel, test_reduce_chunks_do_not_depend_on_threads) {
+    std::string input = "let range = fn(n) { let xs = []; for (i in 0..n) { xs[i] = i; } xs }; preduce(range(5000), 0, fn(a, b) { a - b })";
+    std::string parallel = compareParallel(input);
+    size_t threshold = parallel::threshold;
+    parallel::threshold = 1000000;
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    object::Object *sequential = evaluator::eval(p.parseProgram(), new object::Environment());
+    parallel::threshold = threshold;
+    EXPECT_EQ(sequential->inspect(), parallel);
+}
+
+TEST(parallel, test_errors_are_the_first_in_order) {
+    std::string range = "let range = fn(n) { let xs = []; for (i in 0..n) { xs[i] = i; } xs }; let xs = range(400); ";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {range + "pmap(xs, fn(x) { if (x == 390) { missing } else { if (x > 150) { x + true } else { x } } })", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {range + "pfilter(xs, fn(x) { if (x == 3) { -true } else { x / (x - 200) } })", "ERROR: unknown operator: -BOOLEAN"},
+        {range + "preduce(xs, 0, fn(a, b) { if (b == 333) { a + \"s\" } else { a + b } })", "ERROR: type mismatch: INTEGER + STRING"},
+        {"pmap(1, fn(x) { x })", "ERROR: argument to `pmap` must be ARRAY, got INTEGER"},
+        {"pfilter([1], 2)", "ERROR: argument to `pfilter` must be FUNCTION, got INTEGER"},
+        {"pmap([1])", "ERROR: wrong number of arguments. got=1, want=2"},
+        {"pmap([1], fn(a, b) { a })", "ERROR: function passed to `pmap` must take 1 argument, got 2"},
+        {"preduce([1], 0, fn(a) { a })", "ERROR: function passed to `preduce` must take 2 arguments, got 1"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(compareParallel(test.first), test.second) << test.first;
+    }
+}
+
+TEST(parallel, test_side_effects_run_sequentially) {
+    object::Environment *env = new object::Environment();
+    evalParallel("let runningTotal = 0; let addTo = fn(x) { runningTotal = runningTotal + x; runningTotal }; let viaHelper = fn(x) { addTo(x) }; let pure = fn(x) { x + 1 }; let calm = fn(x) { pure(x) * 2 }; let loud = fn(x) { puts(x) }; let say = puts; let viaAlias = fn(x) { say(x) }; let sender = fn(ch) { send(ch, 1) };", evaluator::eval, env);
+    std::vector<std::pair<std::string, bool>> isolated = {
+        {"addTo", false},
+        {"viaHelper", false},
+        {"loud", false},
+        {"pure", true},
+        {"calm", true},
+        {"viaAlias", false},
+        {"sender", false},
+    };
+    for (auto test : isolated) {
+        object::Function *fn = dynamic_cast<object::Function*>(env->get(test.first));
+        ASSERT_FALSE(fn == nullptr) << test.first;
+        EXPECT_EQ(parallel::isolated(fn), test.second) << test.first;
+    }
+
+    // Running totals only come out in order when the calls do.
+    object::Object *result = evalParallel("let range = fn(n) { let xs = []; for (i in 0..n) { xs[i] = i; } xs }; let sums = pmap(range(100), viaHelper); [sums[99], runningTotal]", evaluator::eval, env);
+    EXPECT_EQ(result->inspect(), "[4950, 4950, ]");
+}
+
+TEST(parallel, test_spawn_and_await) {
+    std::string fib = "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; ";
+    std::string sum = "let sum = fn(from, upto) { if (upto - from < 100) { (from + upto - 1) * (upto - from) / 2 } else { let mid = (from + upto) / 2; let left = spawn(fn() { sum(from, mid) }); let right = sum(mid, upto); await(left) + right } }; ";
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {fib + "let a = spawn(fn() { fib(18) }); let b = spawn(fn() { fib(17) }); await(a) + await(b)", "4181"},
+        {sum + "sum(0, 20000)", "199990000"},
+        {"let f = spawn(fn() { [1, 2] }); let g = spawn(fn() { await(f) }); [await(g), await(f)]", "[[1, 2, ], [1, 2, ], ]"},
+        {"let f = spawn(fn() { 7 }); await(f); f", "future(7)"},
+        // Tasks see their scopes as they were at the spawn.
+        {"let shiftAtSpawn = 1; let f = spawn(fn() { shiftAtSpawn + 1 }); shiftAtSpawn = 100; await(f)", "2"},
+        {"let g = fn() { let f = spawn(fn() { boundLater }); let boundLater = 3; await(f) }; g()", "ERROR: identifier not found: boundLater"},
+        {"let make = fn(k) { fn() { k * 2 } }; let f = spawn(make(21)); let k = 0; await(f)", "42"},
+        // Callees with side effects run at the spawn.
+        {"let spawnCounter = 0; let f = spawn(fn() { spawnCounter = spawnCounter + 1; spawnCounter }); [spawnCounter, await(f)]", "[1, 1, ]"},
+        {"await(spawn(fn() { 1 + true }))", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {"spawn(1)", "ERROR: argument to `spawn` must be FUNCTION, got INTEGER"},
+        {"spawn(fn(x) { x })", "ERROR: function passed to `spawn` must take 0 arguments, got 1"},
+        {"spawn()", "ERROR: wrong number of arguments. got=0, want=1"},
+        {"await(5)", "ERROR: argument to `await` must be FUTURE or ISOLATE, got INTEGER"},
+    };
+
+    for (auto test : tests) {
+        EXPECT_EQ(compareParallel(test.first), test.second) << test.first;
+    }
+    EXPECT_FALSE(scheduler::concurrent());
+}
+
+// The spawner stores into arrays and hashes the task reads while it runs.
+// Under ThreadSanitizer this races unless the task got its own copies.
+TEST(parallel, test_spawned_tasks_snapshot_mutable_captures) {
+    std::string input =
+        "let xs = [1, 2, 3]; let table = {\"k\": [1]}; let packed = pack([1, 2]);"
+        "let reads = fn(n) { if (n == 0) { 0 } else { sum(xs) + len(table[\"k\"]) + sum(packed) + reads(n - 1) } };"
+        "let f = spawn(fn() { reads(300) });"
+        "for (i in 3..2000) { xs[len(xs)] = i; table[\"k\"][len(table[\"k\"])] = i; packed[0] = i; }"
+        "[await(f), len(xs), len(table[\"k\"]), packed[0]]";
+    EXPECT_EQ(compareParallel(input), "[3000, 2000, 1998, 1999, ]");
+}
+
+TEST(parallel, test_counters_cover_every_deque) {
+    std::string input = "let sum = fn(from, upto) { if (upto - from < 10) { upto - from } else { let mid = (from + upto) / 2; let left = spawn(fn() { sum(from, mid) }); let right = sum(mid, upto); await(left) + right } }; sum(0, 5000)";
+    EXPECT_EQ(compareParallel(input), "5000");
+    std::vector<scheduler::Counters> counters = scheduler::counters();
+    EXPECT_EQ(counters.size(), scheduler::workers() + 1);
+    // A worker's own deque only fills while it runs a task it stole, so
+    // every worker that has looked for work has stolen or slept.
+    size_t events = 0;
+    for (size_t i = 0; i < scheduler::workers(); i++) {
+        events += counters[i].steals + counters[i].idles;
+    }
+    if (scheduler::workers() > 0) {
+        EXPECT_GT(events, 0);
+    }
+}
+
+// Evaluates definitions then input with parallel arguments on, every
+// argument counting as slow, and returns the decision made at each call site
+// of input with two or more arguments, in source order.
+std::vector<ArgumentProfile::Decision> evalArguments(const std::string &definitions, const std::string &input, object::Object* (*engine)(Node*, object::Environment*), std::string &result) {
+    Lexer defined = Lexer(definitions);
+    Parser skipped = Parser(&defined);
+    size_t skip = skipped.parseProgram()->statements->size();
+    Lexer l = Lexer(definitions + input);
+    Parser p = Parser(&l);
+    Program *program = p.parseProgram();
+    scheduler::threads = scheduler::threads == 0 ? 4 : scheduler::threads;
+    uint64_t nanos = parallel::argumentNanos;
+    parallel::arguments = true;
+    parallel::argumentNanos = 0;
+    result = engine(program, new object::Environment())->inspect();
+    parallel::arguments = false;
+    parallel::argumentNanos = nanos;
+    std::vector<ArgumentProfile::Decision> decisions;
+    for (size_t i = skip; i < program->statements->size(); i++) {
+        analysis::walk((*program->statements)[i], [&](Node *node) {
+            CallExpression *call = dynamic_cast<CallExpression*>(node);
+            if (call != nullptr && call->arguments.size() > 1) {
+                decisions.push_back(call->argumentProfile.decision);
+            }
+            return true;
+        });
+    }
+    return decisions;
+}
+
+TEST(parallel, test_arguments_run_in_parallel_when_pure) {
+    std::string functions = "let score = fn(n) { if (n < 2) { n } else { score(n - 1) + score(n - 2) } }; let combine = fn(a, b, c) { [a, b, c] }; let bad = fn(x) { if (x == 10) { x + true } else { if (x == 11) { -true } else { x } } }; let check = fn(a, b) { a + b }; let sink = channel(64); let loud = fn(x) { send(sink, x); x }; ";
+    struct ArgumentsTest {
+        std::string input;
+        std::string expected;
+        std::vector<ArgumentProfile::Decision> decisions;
+    };
+    std::vector<ArgumentsTest> tests = {
+        {"let go = fn(i) { combine(score(i), score(i + 1), score(i + 2)) }; let runs = []; for (i in 0..12) { runs[i] = go(i); } runs[11]", "[89, 144, 233, ]", {ArgumentProfile::PARALLEL}},
+        // The leftmost error wins, as when arguments run in order.
+        {"let pick = fn(x) { check(bad(x), bad(x + 1)) }; let picks = []; for (i in 0..6) { picks[i] = pick(i); } [picks[5], pick(10)]", "ERROR: type mismatch: INTEGER + BOOLEAN", {ArgumentProfile::PARALLEL}},
+        {"let pick = fn(x) { check(bad(x), bad(x + 1)) }; let picks = []; for (i in 0..6) { picks[i] = pick(i); } [picks[5], pick(11)]", "ERROR: unknown operator: -BOOLEAN", {ArgumentProfile::PARALLEL}},
+        // Arguments with effects always run in order.
+        {"let say = fn(i) { check(loud(i), loud(i)) }; let said = []; for (i in 0..6) { said[i] = say(i); } said[5]", "10", {ArgumentProfile::SEQUENTIAL}},
+        {"let argTotal = 0; let add = fn(i) { check(argTotal = argTotal + i, score(i)) }; for (i in 0..6) { add(i); } argTotal", "15", {ArgumentProfile::SEQUENTIAL}},
+        // Too few evaluations to decide.
+        {"check(score(5), score(6))", "13", {ArgumentProfile::UNDECIDED}},
+    };
+
+    for (auto test : tests) {
+        for (auto engine : {evaluator::eval, compiler::eval}) {
+            std::string result;
+            std::vector<ArgumentProfile::Decision> decisions = evalArguments(functions, test.input, engine, result);
+            EXPECT_EQ(result, test.expected) << test.input;
+            if (scheduler::workers() > 0) {
+                EXPECT_EQ(decisions, test.decisions) << test.input;
+            }
+        }
+    }
+}
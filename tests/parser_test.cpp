@@ -1,4 +1,5 @@
 #include "parser.hh"
+#include "analysis.hh"
 #include <gtest/gtest.h>
 #include <iostream>
 #include <string>
@@ -224,6 +225,27 @@ TEST(parser, test_integer_literal_expression) {
     testIntegerLiteral(expStmt->expression, 5);
 }
 
+TEST(parser, test_float_literal_expression) {
+    std::string input = "2.5;";
+
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+
+    Program* program = p.parseProgram();
+    checkParserErrors(&p);
+
+    if(program->statements->size() != 1)
+        FAIL() << "program.Statements does not contain 1 statements. got=" << program->statements->size() << std::endl;
+
+    ExpressionStatement* expStmt = dynamic_cast<ExpressionStatement*>(program->statements->at(0));
+    ASSERT_FALSE(expStmt == nullptr);
+
+    FloatLiteral* literal = dynamic_cast<FloatLiteral*>(expStmt->expression);
+    ASSERT_FALSE(literal == nullptr) << "Expression not FloatLiteral" << std::endl;
+    EXPECT_EQ(literal->value, 2.5);
+    EXPECT_EQ(literal->token_literal(), "2.5");
+}
+
 TEST(parser, test_prefix_expressions) {
     struct PrefixTest {
         std::string input;
@@ -691,4 +713,192 @@ TEST(parser, test_parsing_hash_literals_with_expressions) {
         std::tuple<int, std::string, int> expectedValue = expected[key->value];
         testInfixExpression(pair.second, std::get<0>(expectedValue), std::get<1>(expectedValue), std::get<2>(expectedValue));
     }
-}
\ No newline at end of file
+}
+TEST(parser, test_while_statement) {
+    std::string input = "while (x < y) { x; break; }";
+
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    Program* program = p.parseProgram();
+    checkParserErrors(&p);
+
+    if(program->statements->size() != 1)
+        FAIL() << "program.Statements does not contain 1 statements. got=" << program->statements->size() << std::endl;
+
+    WhileStatement* loop = dynamic_cast<WhileStatement*>(program->statements->at(0));
+    ASSERT_FALSE(loop == nullptr) << "stmt not *ast.WhileStatement. got=" << program->statements->at(0) << std::endl;
+    testInfixExpression(loop->condition, std::string("x"), "<", std::string("y"));
+    if(loop->body->statements->size() != 2)
+        FAIL() << "body is not 2 statements. got=" << loop->body->statements->size() << std::endl;
+    EXPECT_FALSE(dynamic_cast<BreakStatement*>(loop->body->statements->at(1)) == nullptr) << "last statement is not *ast.BreakStatement" << std::endl;
+}
+
+TEST(parser, test_for_statements) {
+    struct ForTest {
+        std::string input;
+        std::string variable;
+        bool range;
+        std::string expected;
+    };
+
+    std::vector<ForTest> tests = {
+        {"for (x in xs) { continue; }", "x", false, "for(x in xs) continue;"},
+        {"for (i in 0..n + 1) { i }", "i", true, "for(i in 0..(n + 1)) i"},
+        {"for (i in len(xs)..10) { }", "i", true, "for(i in len(xs)..10) "},
+    };
+
+    for (auto test : tests) {
+        Lexer l = Lexer(test.input);
+        Parser p = Parser(&l);
+        Program* program = p.parseProgram();
+        checkParserErrors(&p);
+
+        ASSERT_EQ(program->statements->size(), 1) << test.input;
+        ForStatement* loop = dynamic_cast<ForStatement*>(program->statements->at(0));
+        ASSERT_FALSE(loop == nullptr) << "stmt not *ast.ForStatement. got=" << program->statements->at(0) << std::endl;
+        testIdentifier(loop->variable, test.variable);
+        EXPECT_EQ(loop->end != nullptr, test.range) << test.input;
+        EXPECT_EQ(program->string(), test.expected);
+    }
+}
+
+TEST(parser, test_loop_control_outside_loop) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"break;", "break outside of a loop"},
+        {"if (true) { continue; }", "continue outside of a loop"},
+        {"while (true) { let f = fn() { break; }; }", "break outside of a loop"},
+    };
+
+    for (auto test : tests) {
+        Lexer l = Lexer(test.first);
+        Parser p = Parser(&l);
+        p.parseProgram();
+        std::vector<std::string> errors = p.getErrors();
+        ASSERT_EQ(errors.size(), 1) << test.first;
+        EXPECT_EQ(errors[0], test.second);
+    }
+}
+
+TEST(parser, test_yield_statements) {
+    struct YieldTest {
+        std::string input;
+        std::string expected;
+        std::vector<bool> generators;
+    };
+
+    std::vector<YieldTest> tests = {
+        {"fn(n) { yield n; yield n + 1 }", "fn(n)yield n;yield (n + 1);", {true}},
+        {"fn() { for (x in xs) { if (x) { yield x; } } }", "fn()for(x in xs) ifx yield x;", {true}},
+        {"fn() { fn() { yield 1; } }", "fn()fn()yield 1;", {false, true}},
+        {"fn() { return 1; }", "fn()return 1;", {false}},
+    };
+
+    for (auto test : tests) {
+        Lexer l = Lexer(test.input);
+        Parser p = Parser(&l);
+        Program* program = p.parseProgram();
+        checkParserErrors(&p);
+
+        ASSERT_EQ(program->statements->size(), 1) << test.input;
+        EXPECT_EQ(program->string(), test.expected);
+        std::vector<bool> generators;
+        analysis::walk(program, [&](Node *node) {
+            FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(node);
+            if (fn != nullptr) {
+                generators.push_back(fn->generator);
+            }
+            return true;
+        });
+        EXPECT_EQ(generators, test.generators) << test.input;
+    }
+
+    std::vector<std::string> outside = {"yield 1;", "for (x in xs) { yield x; }"};
+    for (auto input : outside) {
+        Lexer l = Lexer(input);
+        Parser p = Parser(&l);
+        p.parseProgram();
+        std::vector<std::string> errors = p.getErrors();
+        ASSERT_EQ(errors.size(), 1) << input;
+        EXPECT_EQ(errors[0], "yield outside of a function");
+    }
+}
+
+TEST(parser, test_assign_expressions) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"tally = 5", "(tally = 5)"},
+        {"tally = cursor = steps + 1", "(tally = (cursor = (steps + 1)))"},
+        {"grid[k + 1] = v * 2", "((grid[(k + 1)]) = (v * 2))"},
+        {"seen[\"a\"][0] = f(1)", "(((seen[a])[0]) = f(1))"},
+        {"let y = tally = 2;", "let y = (tally = 2);"},
+    };
+
+    for (auto test : tests) {
+        Lexer l = Lexer(test.first);
+        Parser p = Parser(&l);
+        Program* program = p.parseProgram();
+        checkParserErrors(&p);
+
+        ASSERT_EQ(program->statements->size(), 1) << test.first;
+        EXPECT_EQ(program->string(), test.second);
+    }
+
+    std::vector<std::pair<std::string, std::string>> errors = {
+        {"1 = 2", "cannot assign to 1"},
+        {"f() = 3", "cannot assign to f()"},
+        {"tally + 1 = 2", "cannot assign to (tally + 1)"},
+    };
+
+    for (auto test : errors) {
+        Lexer l = Lexer(test.first);
+        Parser p = Parser(&l);
+        p.parseProgram();
+        std::vector<std::string> found = p.getErrors();
+        ASSERT_GE(found.size(), 1) << test.first;
+        EXPECT_EQ(found[0], test.second);
+    }
+}
+
+TEST(parser, test_match_expression) {
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"match (x) { 1 => a, -2 => b + 1, _ => c }", "match(x) {1 => a, (-2) => (b + 1), _ => c}"},
+        {"match (method) { \"GET\" => 1, \"PUT\" => { let y = 2; y }, }", "match(method) {GET => 1, PUT => {let y = 2;y}}"},
+        {"match (f(x)) { }", "match(f(x)) {}"},
+        {"let y = match (x) { _ => 0 };", "let y = match(x) {_ => 0};"},
+    };
+
+    for (auto test : tests) {
+        Lexer l = Lexer(test.first);
+        Parser p = Parser(&l);
+        Program* program = p.parseProgram();
+        checkParserErrors(&p);
+
+        ASSERT_EQ(program->statements->size(), 1) << test.first;
+        EXPECT_EQ(program->string(), test.second);
+    }
+
+    Lexer l = Lexer("match (x) { 1 => 2, _ => 3 }");
+    Parser p = Parser(&l);
+    Program* program = p.parseProgram();
+    checkParserErrors(&p);
+    ExpressionStatement* stmt = dynamic_cast<ExpressionStatement*>(program->statements->at(0));
+    MatchExpression* exp = dynamic_cast<MatchExpression*>(stmt->expression);
+    ASSERT_FALSE(exp == nullptr);
+    ASSERT_EQ(exp->arms.size(), 1);
+    testIntegerLiteral(exp->arms[0].pattern, 1);
+    ASSERT_FALSE(exp->otherwise == nullptr);
+
+    std::vector<std::pair<std::string, std::string>> errors = {
+        {"match (x) { _ => 1, 2 => 3 }", "match arm after _ is unreachable"},
+        {"match (x) { 1 2 }", "expected next token to be =>, got INT instead"},
+        {"match x { 1 => 2 }", "expected next token to be (, got IDENT instead"},
+    };
+
+    for (auto test : errors) {
+        Lexer l = Lexer(test.first);
+        Parser p = Parser(&l);
+        p.parseProgram();
+        std::vector<std::string> found = p.getErrors();
+        ASSERT_GE(found.size(), 1) << test.first;
+        EXPECT_EQ(found[0], test.second);
+    }
+}
@@ -0,0 +1,34 @@
+#include "pool.hh"
+#include "object.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+
+TEST(pool, test_free_list_reuse) {
+    void *first = pool::allocate(40);
+    pool::deallocate(first, 40);
+    void *second = pool::allocate(33);
+    ASSERT_EQ(first, second) << "freed block of the same size class was not reused" << std::endl;
+    pool::deallocate(second, 33);
+}
+
+TEST(pool, test_size_classes) {
+    pool::Stats before = pool::stats();
+    void *small = pool::allocate(1);
+    void *large = pool::allocate(pool::SIZE_CLASS_STEP * pool::SIZE_CLASSES + 1);
+    pool::Stats after = pool::stats();
+    ASSERT_EQ(after.allocations[0], before.allocations[0] + 1);
+    ASSERT_EQ(after.large, before.large + 1);
+    pool::deallocate(small, 1);
+    pool::deallocate(large, pool::SIZE_CLASS_STEP * pool::SIZE_CLASSES + 1);
+}
+
+TEST(pool, test_small_integer_cache) {
+    ASSERT_EQ(object::Integer::make(WFI_SMALL_INT_MIN), object::Integer::make(WFI_SMALL_INT_MIN));
+    ASSERT_EQ(object::Integer::make(WFI_SMALL_INT_MAX), object::Integer::make(WFI_SMALL_INT_MAX));
+    ASSERT_EQ(object::Integer::make(7)->value, 7);
+    ASSERT_NE(object::Integer::make(WFI_SMALL_INT_MAX + 1), object::Integer::make(WFI_SMALL_INT_MAX + 1));
+
+    object::Integer *boxed = new object::Integer(123456);
+    ASSERT_EQ(boxed->value, 123456);
+    delete boxed;
+}
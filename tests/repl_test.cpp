@@ -0,0 +1,67 @@
+#include "repl.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "memo.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Feeds input to a REPL session line by line and returns what it printed.
+std::string runRepl(const std::string &input, repl::engine_t engine) {
+    std::istringstream in(input + "\nexit\n");
+    std::ostringstream out;
+    std::streambuf *cin = std::cin.rdbuf(in.rdbuf());
+    std::streambuf *cout = std::cout.rdbuf(out.rdbuf());
+    repl::Start(engine);
+    std::cin.rdbuf(cin);
+    std::cout.rdbuf(cout);
+    return out.str();
+}
+
+// A proof that took len's result type must not outlive a let that shadows len.
+TEST(repl, test_shadowed_builtins_withdraw_proofs) {
+    for (auto engine : {evaluator::eval, compiler::eval}) {
+        std::string later = runRepl(
+            "let f = fn(a) { len(a) + 1 };\n"
+            "f([1,2])\n"
+            "let len = fn(a) { \"\" };\n"
+            "f([1])", engine);
+        EXPECT_NE(later.find(">> 3\n"), std::string::npos) << later;
+        EXPECT_NE(later.find(">> ERROR: type mismatch: STRING + INTEGER\n"), std::string::npos) << later;
+
+        std::string same = runRepl(
+            "let f = fn(a) { len(a) + 1 };\n"
+            "f([1,2])\n"
+            "let len = fn(a) { \"\" }; f([1])", engine);
+        EXPECT_NE(same.find(">> ERROR: type mismatch: STRING + INTEGER\n"), std::string::npos) << same;
+    }
+}
+
+// An automatic memo must stop answering from its cache once a later program
+// assigns a global its function reads, and keep it when the global is another.
+TEST(repl, test_assigned_globals_withdraw_automatic_memos) {
+    memo::automatic = true;
+    for (auto engine : {evaluator::eval, compiler::eval}) {
+        std::string out = runRepl(
+            "let k = 1;\n"
+            "let f = fn(n) { if (n < 1) { k } else { f(n - 1) + 0 } };\n"
+            "f(3)\n"
+            "k = 100;\n"
+            "f(3)\n"
+            "f(4)", engine);
+        EXPECT_NE(out.find(">> 1\n"), std::string::npos) << out;
+        EXPECT_EQ(out.find(">> 1\n>> 1\n"), std::string::npos) << out;
+        EXPECT_NE(out.find(">> 100\n>> 100\n>> 100\n"), std::string::npos) << out;
+
+        std::string other = runRepl(
+            "let k = 1; let j = 1;\n"
+            "let f = fn(n) { if (n < 1) { k } else { f(n - 1) + 0 } };\n"
+            "f(3)\n"
+            "j = 2;\n"
+            "f(3); memoStats(f)[\"hits\"]", engine);
+        EXPECT_NE(other.find(">> 1\n"), std::string::npos) << other;
+        EXPECT_NE(other.find(">> 2\n>> 1\n"), std::string::npos) << other;
+    }
+    memo::automatic = false;
+}
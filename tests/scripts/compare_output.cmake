@@ -0,0 +1,16 @@
+# Runs SCRIPT with the interpreter and the AOT-compiled COMPILED executable and
+# fails unless stdout, stderr and the exit status all match.
+execute_process(COMMAND ${WFI} ${SCRIPT}
+  OUTPUT_VARIABLE interpreted_out ERROR_VARIABLE interpreted_err RESULT_VARIABLE interpreted_status)
+execute_process(COMMAND ${COMPILED}
+  OUTPUT_VARIABLE compiled_out ERROR_VARIABLE compiled_err RESULT_VARIABLE compiled_status)
+
+if(NOT interpreted_out STREQUAL compiled_out)
+  message(FATAL_ERROR "stdout differs\n--- interpreter\n${interpreted_out}\n--- compiled\n${compiled_out}")
+endif()
+if(NOT interpreted_err STREQUAL compiled_err)
+  message(FATAL_ERROR "stderr differs\n--- interpreter\n${interpreted_err}\n--- compiled\n${compiled_err}")
+endif()
+if(NOT interpreted_status STREQUAL compiled_status)
+  message(FATAL_ERROR "exit status differs: ${interpreted_status} vs ${compiled_status}")
+endif()
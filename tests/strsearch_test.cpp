@@ -0,0 +1,46 @@
+#include "strsearch.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+TEST(strsearch, test_find) {
+    struct FindTest {
+        std::string haystack;
+        std::string needle;
+        size_t expected;
+    };
+
+    std::string longText = std::string(100, 'a') + "needle" + std::string(100, 'a');
+
+    std::vector<FindTest> tests = {
+        {"hello world", "world", 6},
+        {"hello world", "o", 4},
+        {"hello world", "", 0},
+        {"hello", "hello world", strsearch::npos},
+        {"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", "aab", 37},
+        {longText, "needle", 100},
+        {longText, "needles", strsearch::npos},
+        {longText, std::string(100, 'a') + "n", 0},
+    };
+
+    for(auto test : tests) {
+        size_t got = strsearch::find(test.haystack.data(), test.haystack.size(), test.needle.data(), test.needle.size());
+        EXPECT_EQ(got, test.expected) << "find(" << test.haystack << ", " << test.needle << ") wrong. got=" << got << std::endl;
+    }
+}
+
+TEST(strsearch, test_find_matches_scalar) {
+    std::string haystack;
+    for (int i = 0; i < 2000; i++) {
+        haystack += static_cast<char>('a' + (i * 7 + i / 13) % 5);
+    }
+    for (size_t len = 1; len < 40; len += 3) {
+        for (size_t pos = 0; pos + len < haystack.size(); pos += 97) {
+            std::string needle = haystack.substr(pos, len);
+            size_t expected = strsearch::findScalar(haystack.data(), haystack.size(), needle.data(), needle.size());
+            size_t got = strsearch::find(haystack.data(), haystack.size(), needle.data(), needle.size());
+            ASSERT_EQ(got, expected) << "find disagrees with scalar search for needle " << needle << std::endl;
+            ASSERT_EQ(got, haystack.find(needle)) << "find disagrees with std::string::find for needle " << needle << std::endl;
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#include "lexer.hh"
+#include "parser.hh"
+#include "evaluator.hh"
+#include "compiler.hh"
+#include "types.hh"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+
+Program *parseTyped(const std::string &input) {
+    Lexer l = Lexer(input);
+    Parser p = Parser(&l);
+    return p.parseProgram();
+}
+
+// Evaluates input with and without inference on both engines, checks all
+// results agree, and returns the inference report.
+types::Report compareTyped(const std::string &input) {
+    object::Object *expected = evaluator::eval(parseTyped(input), new object::Environment());
+    Program *program = parseTyped(input);
+    object::Environment *env = new object::Environment();
+    types::Report report = types::infer(program, env);
+    object::Object *tree = evaluator::eval(program, env);
+    EXPECT_EQ(tree->type(), expected->type()) << input;
+    EXPECT_EQ(tree->inspect(), expected->inspect()) << input;
+    program = parseTyped(input);
+    env = new object::Environment();
+    types::infer(program, env);
+    object::Object *closure = compiler::eval(program, env);
+    EXPECT_EQ(closure->type(), expected->type()) << input;
+    EXPECT_EQ(closure->inspect(), expected->inspect()) << input;
+    return report;
+}
+
+Expression *lastExpression(Program *program) {
+    return dynamic_cast<ExpressionStatement*>(program->statements->back())->expression;
+}
+
+TEST(types, test_static_types) {
+    struct TypeTest {
+        std::string input;
+        StaticType expected;
+    };
+
+    std::vector<TypeTest> tests = {
+        {"1 + 2 * 3", StaticType::INTEGER},
+        {"1 < 2", StaticType::BOOLEAN},
+        {"!5", StaticType::BOOLEAN},
+        {"-5", StaticType::INTEGER},
+        {"\"a\" + \"b\"", StaticType::STRING},
+        {"let x = 5; let y = x * 2; y", StaticType::INTEGER},
+        {"if (true) { 1 } else { 2 }", StaticType::INTEGER},
+        {"if (true) { 1 } else { \"two\" }", StaticType::UNKNOWN},
+        {"if (true) { 1 }", StaticType::UNKNOWN},
+        {"len(\"four\") + 1", StaticType::INTEGER},
+        {"let len = fn(x) { \"no\" }; len(\"four\")", StaticType::UNKNOWN},
+        {"[1, 2][0]", StaticType::UNKNOWN},
+        {"{1: 2}", StaticType::HASH},
+        {"fn(x) { x }", StaticType::FUNCTION},
+        {"let f = fn(x) { x }; f(1)", StaticType::UNKNOWN},
+        {"let x = 1; let x = \"one\"; x", StaticType::UNKNOWN},
+        {"let f = fn(n) { n + 1 }; f", StaticType::FUNCTION},
+        {"let tally = 0; tally = tally + 1; tally", StaticType::INTEGER},
+        {"let cursor = 0; cursor = \"end\"; cursor", StaticType::UNKNOWN},
+        {"let grid = [1]; grid[0] = \"one\"", StaticType::STRING},
+        {"match (1) { 1 => 2, _ => 3 }", StaticType::INTEGER},
+        {"match (1) { 1 => 2 }", StaticType::UNKNOWN},
+        {"match (1) { 1 => 2, _ => \"3\" }", StaticType::UNKNOWN},
+    };
+
+    for (auto test : tests) {
+        Program *program = parseTyped(test.input);
+        types::infer(program, new object::Environment());
+        EXPECT_EQ(staticTypeName(lastExpression(program)->staticType), staticTypeName(test.expected)) << test.input;
+    }
+}
+
+TEST(types, test_uses_bound_globals) {
+    object::Environment *env = new object::Environment();
+    evaluator::eval(parseTyped("let n = 10; let s = \"x\";"), env);
+    Program *program = parseTyped("n * 2");
+    types::Report report = types::infer(program, env);
+    EXPECT_EQ(lastExpression(program)->staticType, StaticType::INTEGER);
+    EXPECT_EQ(report.monomorphic, 1);
+
+    // A parameter may shadow the global, so only the global use is proven.
+    program = parseTyped("let f = fn(n) { n * 2 }; n * 2");
+    report = types::infer(program, env);
+    EXPECT_EQ(report.operations, 2);
+    EXPECT_EQ(report.monomorphic, 1);
+}
+
+TEST(types, test_type_errors) {
+    struct ErrorTest {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<ErrorTest> tests = {
+        {"5 + true", "type mismatch: INTEGER + BOOLEAN"},
+        {"let f = fn() { \"a\" - \"b\" }; 1", "unknown operator: STRING - STRING"},
+        {"-true", "unknown operator: -BOOLEAN"},
+        {"true + false", "unknown operator: BOOLEAN + BOOLEAN"},
+        {"5[0]", "index operator not supported: INTEGER"},
+        {"{1: 2}[[1]]", "unusable as hash key: ARRAY"},
+        {"{fn(x) { x }: 1}", "unusable as hash key: FUNCTION"},
+        {"for (x in 5) { x }", "cannot iterate over INTEGER"},
+        {"for (i in 0..\"ten\") { i }", "range bounds must be INTEGER, got INTEGER..STRING"},
+        {"5[0] = 1", "index assignment not supported: INTEGER"},
+        {"[1][\"a\"] = 2", "array index must be INTEGER, got STRING"},
+        {"{}[[1]] = 2", "unusable as hash key: ARRAY"},
+    };
+
+    for (auto test : tests) {
+        types::Report report = types::infer(parseTyped(test.input), new object::Environment());
+        ASSERT_EQ(report.errors.size(), 1) << test.input;
+        EXPECT_EQ(report.errors[0], test.expected) << test.input;
+    }
+
+    // Unknown operands never produce errors.
+    types::Report report = types::infer(parseTyped("let f = fn(a, b) { a + b }; f(1, true)"), new object::Environment());
+    EXPECT_EQ(report.errors.size(), 0);
+}
+
+TEST(types, test_proven_results_match) {
+    struct ReportTest {
+        std::string input;
+        size_t operations;
+        size_t monomorphic;
+    };
+
+    std::vector<ReportTest> tests = {
+        {"let x = 5; let y = x * 2 + 1; if (y > 10) { y - 1 } else { -y }", 6, 6},
+        {"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; fib(15)", 5, 0},
+        {"let a = [1, 2, 3]; let i = 1; a[i] + a[2]", 3, 2},
+        {"let h = {\"a\": 1}; h[\"a\"]", 1, 1},
+        {"let s = \"ab\"; s + \"c\" == \"abc\"", 2, 2},
+        {"let b = !true; b != false", 2, 2},
+        {"let big = 9223372036854775807; big + 1", 1, 1},
+        {"let d = 0; 10 / d", 1, 1},
+        {"let n = len(\"four\"); n * n", 1, 1},
+        {"let x = 1; let f = fn() { let x = \"s\"; x + \"t\" }; f()", 1, 0},
+        {"let x = \"s\"; let f = fn() { for (x in 0..3) { if (x * 2 > 3) { return x; } } }; f()", 3, 3},
+        {"let x = 1; let f = fn() { for (x in [\"a\"]) { return x + \"b\"; } }; f()", 1, 0},
+        {"let f = fn() { for (i in 0..5) { let s = \"a\"; let n = i * 2; } 1 }; f()", 1, 1},
+    };
+
+    for (auto test : tests) {
+        types::Report report = compareTyped(test.input);
+        EXPECT_EQ(report.operations, test.operations) << test.input;
+        EXPECT_EQ(report.monomorphic, test.monomorphic) << test.input;
+    }
+
+    types::Report report = compareTyped("let x = 5; x + 1");
+    EXPECT_EQ(report.summary(), "1 of 1 operations proven monomorphic (100%)");
+}
+
+TEST(types, test_assignments_withdraw_proofs) {
+    object::Environment *env = new object::Environment();
+    Program *first = parseTyped("let ticks = 1; let tickNext = fn() { ticks + 1 };");
+    types::infer(first, env);
+    evaluator::eval(first, env);
+    FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(dynamic_cast<LetStatement*>(first->statements->at(1))->value);
+    InfixExpression *sum = dynamic_cast<InfixExpression*>(dynamic_cast<ExpressionStatement*>(fn->body->statements->at(0))->expression);
+    EXPECT_TRUE(sum->profile.proven);
+    EXPECT_EQ(evaluator::eval(parseTyped("tickNext()"), env)->inspect(), "2");
+
+    // Inference on the program that assigns ticks withdraws the earlier proof.
+    Program *second = parseTyped("ticks = \"t\";");
+    types::infer(second, env);
+    evaluator::eval(second, env);
+    EXPECT_FALSE(sum->profile.proven);
+    EXPECT_EQ(evaluator::eval(parseTyped("tickNext()"), env)->inspect(), "ERROR: type mismatch: STRING + INTEGER");
+}
+
+// A global only let in a branch that never ran can be bound by a later
+// program to a value of another type.
+TEST(types, test_unbound_globals_withdraw_proofs) {
+    for (auto engine : {evaluator::eval, compiler::eval}) {
+        object::Environment *env = new object::Environment();
+        Program *first = parseTyped("let f = fn() { let y = 0; x + 1 }; if (false) { let x = 5; }");
+        types::infer(first, env);
+        engine(first, env);
+        FunctionLiteral *fn = dynamic_cast<FunctionLiteral*>(dynamic_cast<LetStatement*>(first->statements->at(0))->value);
+        InfixExpression *sum = dynamic_cast<InfixExpression*>(dynamic_cast<ExpressionStatement*>(fn->body->statements->at(1))->expression);
+        EXPECT_TRUE(sum->profile.proven);
+
+        Program *second = parseTyped("let x = \"\";");
+        types::infer(second, env);
+        engine(second, env);
+        EXPECT_FALSE(sum->profile.proven);
+        EXPECT_EQ(sum->profile.specialization, Specialization::UNINITIALIZED);
+        Program *third = parseTyped("f()");
+        types::infer(third, env);
+        EXPECT_EQ(engine(third, env)->inspect(), "ERROR: type mismatch: STRING + INTEGER");
+    }
+}
+
+// Assignments only make names unknown in the global scope whose programs
+// made them, not in every scope that comes after.
+TEST(types, test_assignments_count_per_global_scope) {
+    object::Environment *assigning = new object::Environment();
+    Program *first = parseTyped("let count = 1; count = \"many\";");
+    types::infer(first, assigning);
+    evaluator::eval(first, assigning);
+
+    Program *second = parseTyped("let count = 5; count * 2");
+    types::infer(second, new object::Environment());
+    EXPECT_EQ(lastExpression(second)->staticType, StaticType::INTEGER);
+}